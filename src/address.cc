@@ -0,0 +1,307 @@
+#include "address.h"
+#include "log.h"
+#include <sstream>
+#include <string.h>
+#include <stddef.h>
+#include <netdb.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+Address::ptr Address::Create(const sockaddr* addr, socklen_t addrlen) {
+    if (addr == nullptr) {
+        return nullptr;
+    }
+    Address::ptr result;
+    switch (addr->sa_family) {
+        case AF_INET:
+            result.reset(new IPv4Address(*(const sockaddr_in*)addr));
+            break;
+        case AF_INET6:
+            result.reset(new IPv6Address(*(const sockaddr_in6*)addr));
+            break;
+        case AF_UNIX: {
+            UnixAddress::ptr ua(new UnixAddress);
+            socklen_t len = std::min(addrlen, (socklen_t)sizeof(sockaddr_un));
+            memcpy(ua->getAddr(), addr, len);
+            ua->setAddrLen(len);
+            result = ua;
+            break;
+        }
+        default:
+            result.reset(new UnknownAddress(*addr));
+            break;
+    }
+    return result;
+}
+
+bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
+        int family, int type, int protocol) {
+    addrinfo hints, *results, *next;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = family;
+    hints.ai_socktype = type;
+    hints.ai_protocol = protocol;
+
+    std::string node;
+    const char* service = nullptr;
+
+    //[ipv6]:port
+    if (!host.empty() && host[0] == '[') {
+        size_t end = host.find(']');
+        if (end != std::string::npos) {
+            if (end + 1 < host.size() && host[end + 1] == ':') {
+                service = host.c_str() + end + 2;
+            }
+            node = host.substr(1, end - 1);
+        }
+    }
+
+    //host:port，只有一个冒号的才当成带端口，不然是没加方括号的ipv6
+    if (node.empty()) {
+        size_t pos = host.find(':');
+        if (pos != std::string::npos && host.find(':', pos + 1) == std::string::npos) {
+            service = host.c_str() + pos + 1;
+            node = host.substr(0, pos);
+        }
+    }
+
+    if (node.empty()) {
+        node = host;
+    }
+    int error = getaddrinfo(node.c_str(), service, &hints, &results);
+    if (error) {
+        CHPE_LOG_DEBUG(g_logger) << "Address::Lookup getaddress(" << host << ", "
+            << family << ", " << type << ") err=" << error << " errstr=" << gai_strerror(error);
+        return false;
+    }
+
+    next = results;
+    while (next) {
+        result.push_back(Create(next->ai_addr, (socklen_t)next->ai_addrlen));
+        next = next->ai_next;
+    }
+    freeaddrinfo(results);
+    return !result.empty();
+}
+
+Address::ptr Address::LookupAny(const std::string& host, int family, int type, int protocol) {
+    std::vector<Address::ptr> result;
+    if (Lookup(result, host, family, type, protocol)) {
+        return result[0];
+    }
+    return nullptr;
+}
+
+IPAddress::ptr Address::LookupAnyIPAddress(const std::string& host, int family, int type, int protocol) {
+    std::vector<Address::ptr> result;
+    if (Lookup(result, host, family, type, protocol)) {
+        for (auto& i : result) {
+            IPAddress::ptr v = std::dynamic_pointer_cast<IPAddress>(i);
+            if (v) {
+                return v;
+            }
+        }
+    }
+    return nullptr;
+}
+
+int Address::getFamily() const {
+    return getAddr()->sa_family;
+}
+
+void Address::updateString() {
+    std::stringstream ss;
+    insert(ss);
+    m_str = ss.str();
+}
+
+bool Address::operator<(const Address& rhs) const {
+    socklen_t minlen = std::min(getAddrLen(), rhs.getAddrLen());
+    int result = memcmp(getAddr(), rhs.getAddr(), minlen);
+    if (result < 0) {
+        return true;
+    } else if (result > 0) {
+        return false;
+    }
+    return getAddrLen() < rhs.getAddrLen();
+}
+
+bool Address::operator==(const Address& rhs) const {
+    return getAddrLen() == rhs.getAddrLen()
+        && memcmp(getAddr(), rhs.getAddr(), getAddrLen()) == 0;
+}
+
+bool Address::operator!=(const Address& rhs) const {
+    return !(*this == rhs);
+}
+
+IPAddress::ptr IPAddress::Create(const char* address, uint16_t port) {
+    addrinfo hints, *results;
+    memset(&hints, 0, sizeof(hints));
+    //只认数字形式，不会去查DNS
+    hints.ai_flags = AI_NUMERICHOST;
+    hints.ai_family = AF_UNSPEC;
+
+    int error = getaddrinfo(address, NULL, &hints, &results);
+    if (error) {
+        CHPE_LOG_DEBUG(g_logger) << "IPAddress::Create(" << address << ", " << port
+            << ") error=" << error << " errstr=" << gai_strerror(error);
+        return nullptr;
+    }
+    IPAddress::ptr result = std::dynamic_pointer_cast<IPAddress>(
+            Address::Create(results->ai_addr, (socklen_t)results->ai_addrlen));
+    if (result) {
+        result->setPort(port);
+    }
+    freeaddrinfo(results);
+    return result;
+}
+
+IPv4Address::ptr IPv4Address::Create(const char* address, uint16_t port) {
+    IPv4Address::ptr rt(new IPv4Address);
+    rt->m_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &rt->m_addr.sin_addr) <= 0) {
+        CHPE_LOG_DEBUG(g_logger) << "IPv4Address::Create(" << address << ", " << port << ") invalid";
+        return nullptr;
+    }
+    rt->updateString();
+    return rt;
+}
+
+IPv4Address::IPv4Address(const sockaddr_in& address) {
+    m_addr = address;
+    updateString();
+}
+
+IPv4Address::IPv4Address(uint32_t address, uint16_t port) {
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sin_family = AF_INET;
+    m_addr.sin_port = htons(port);
+    m_addr.sin_addr.s_addr = htonl(address);
+    updateString();
+}
+
+std::ostream& IPv4Address::insert(std::ostream& os) const {
+    char buf[INET_ADDRSTRLEN] = {0};
+    inet_ntop(AF_INET, &m_addr.sin_addr, buf, sizeof(buf));
+    os << buf << ":" << ntohs(m_addr.sin_port);
+    return os;
+}
+
+uint32_t IPv4Address::getPort() const {
+    return ntohs(m_addr.sin_port);
+}
+
+void IPv4Address::setPort(uint16_t v) {
+    m_addr.sin_port = htons(v);
+    updateString();
+}
+
+IPv6Address::ptr IPv6Address::Create(const char* address, uint16_t port) {
+    IPv6Address::ptr rt(new IPv6Address);
+    rt->m_addr.sin6_port = htons(port);
+    if (inet_pton(AF_INET6, address, &rt->m_addr.sin6_addr) <= 0) {
+        CHPE_LOG_DEBUG(g_logger) << "IPv6Address::Create(" << address << ", " << port << ") invalid";
+        return nullptr;
+    }
+    rt->updateString();
+    return rt;
+}
+
+IPv6Address::IPv6Address() {
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sin6_family = AF_INET6;
+    updateString();
+}
+
+IPv6Address::IPv6Address(const sockaddr_in6& address) {
+    m_addr = address;
+    updateString();
+}
+
+IPv6Address::IPv6Address(const uint8_t address[16], uint16_t port) {
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sin6_family = AF_INET6;
+    m_addr.sin6_port = htons(port);
+    memcpy(&m_addr.sin6_addr.s6_addr, address, 16);
+    updateString();
+}
+
+std::ostream& IPv6Address::insert(std::ostream& os) const {
+    char buf[INET6_ADDRSTRLEN] = {0};
+    inet_ntop(AF_INET6, &m_addr.sin6_addr, buf, sizeof(buf));
+    os << "[" << buf << "]:" << ntohs(m_addr.sin6_port);
+    return os;
+}
+
+uint32_t IPv6Address::getPort() const {
+    return ntohs(m_addr.sin6_port);
+}
+
+void IPv6Address::setPort(uint16_t v) {
+    m_addr.sin6_port = htons(v);
+    updateString();
+}
+
+static const size_t MAX_PATH_LEN = sizeof(((sockaddr_un*)0)->sun_path) - 1;
+
+UnixAddress::UnixAddress() {
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sun_family = AF_UNIX;
+    m_length = offsetof(sockaddr_un, sun_path) + MAX_PATH_LEN;
+    updateString();
+}
+
+UnixAddress::UnixAddress(const std::string& path) {
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sun_family = AF_UNIX;
+    //抽象命名空间的地址不以'\0'结尾，长度就是path的长度
+    size_t len = std::min(path.size(), MAX_PATH_LEN);
+    memcpy(m_addr.sun_path, path.c_str(), len);
+    if (len && path[0] != '\0') {
+        ++len;
+    }
+    m_length = offsetof(sockaddr_un, sun_path) + len;
+    updateString();
+}
+
+std::string UnixAddress::getPath() const {
+    size_t len = m_length > offsetof(sockaddr_un, sun_path) ? m_length - offsetof(sockaddr_un, sun_path) : 0;
+    if (len && m_addr.sun_path[0] == '\0') {
+        return std::string(m_addr.sun_path, len);
+    }
+    return std::string(m_addr.sun_path, strnlen(m_addr.sun_path, len));
+}
+
+std::ostream& UnixAddress::insert(std::ostream& os) const {
+    std::string path = getPath();
+    if (!path.empty() && path[0] == '\0') {
+        return os << "\\0" << path.substr(1);
+    }
+    return os << path;
+}
+
+UnknownAddress::UnknownAddress(int family) {
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.ss_family = family;
+    updateString();
+}
+
+UnknownAddress::UnknownAddress(const sockaddr& addr) {
+    memset(&m_addr, 0, sizeof(m_addr));
+    memcpy(&m_addr, &addr, sizeof(addr));
+    updateString();
+}
+
+std::ostream& UnknownAddress::insert(std::ostream& os) const {
+    os << "[UnknownAddress family=" << m_addr.ss_family << "]";
+    return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const Address& addr) {
+    return addr.insert(os);
+}
+
+}
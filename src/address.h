@@ -0,0 +1,156 @@
+#ifndef __ADDRESS_H__
+#define __ADDRESS_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+namespace cpp_high_perf {
+
+class IPAddress;
+
+//网络地址，sockaddr直接存在对象里面，bind/connect/accept的时候不用再转换
+//toString的字符串在构造和改地址的时候就生成好，const的接口不改任何东西，多个线程共用一个地址没问题
+class Address {
+public:
+    typedef std::shared_ptr<Address> ptr;
+
+    //按sockaddr的family创建对应的子类
+    static Address::ptr Create(const sockaddr* addr, socklen_t addrlen);
+    //域名解析，host可以是 www.baidu.com、www.baidu.com:80、[::1]:80、127.0.0.1:8080，
+    //family/type/protocol会传给getaddrinfo。getaddrinfo是阻塞的，不要在热路径上调
+    static bool Lookup(std::vector<Address::ptr>& result, const std::string& host,
+            int family = AF_INET, int type = 0, int protocol = 0);
+    //解析出来的第一个
+    static Address::ptr LookupAny(const std::string& host,
+            int family = AF_INET, int type = 0, int protocol = 0);
+    //解析出来的第一个IP地址
+    static std::shared_ptr<IPAddress> LookupAnyIPAddress(const std::string& host,
+            int family = AF_INET, int type = 0, int protocol = 0);
+
+    virtual ~Address() {}
+
+    int getFamily() const;
+    virtual const sockaddr* getAddr() const = 0;
+    //可写的指针给recvfrom/getsockname填的，填完要调updateString，只读的地方用const版本
+    virtual sockaddr* getAddr() = 0;
+    virtual socklen_t getAddrLen() const = 0;
+
+    virtual std::ostream& insert(std::ostream& os) const = 0;
+    //可读的地址，地址变了(setPort/setAddrLen)的时候重新生成
+    const std::string& toString() const { return m_str; }
+    //通过可写的getAddr()改了地址之后重新生成toString的字符串
+    void updateString();
+
+    bool operator<(const Address& rhs) const;
+    bool operator==(const Address& rhs) const;
+    bool operator!=(const Address& rhs) const;
+private:
+    std::string m_str;
+};
+
+//IP地址
+class IPAddress : public Address {
+public:
+    typedef std::shared_ptr<IPAddress> ptr;
+
+    //数字形式的地址，不做域名解析
+    static IPAddress::ptr Create(const char* address, uint16_t port = 0);
+
+    virtual uint32_t getPort() const = 0;
+    virtual void setPort(uint16_t v) = 0;
+};
+
+class IPv4Address : public IPAddress {
+public:
+    typedef std::shared_ptr<IPv4Address> ptr;
+
+    //点分十进制的地址，不合法返回空
+    static IPv4Address::ptr Create(const char* address, uint16_t port = 0);
+
+    IPv4Address(const sockaddr_in& address);
+    //address是主机字节序
+    IPv4Address(uint32_t address = INADDR_ANY, uint16_t port = 0);
+
+    const sockaddr* getAddr() const override { return (const sockaddr*)&m_addr; }
+    sockaddr* getAddr() override { return (sockaddr*)&m_addr; }
+    socklen_t getAddrLen() const override { return sizeof(m_addr); }
+    std::ostream& insert(std::ostream& os) const override;
+
+    uint32_t getPort() const override;
+    void setPort(uint16_t v) override;
+private:
+    sockaddr_in m_addr;
+};
+
+class IPv6Address : public IPAddress {
+public:
+    typedef std::shared_ptr<IPv6Address> ptr;
+
+    //冒号十六进制的地址，不合法返回空
+    static IPv6Address::ptr Create(const char* address, uint16_t port = 0);
+
+    IPv6Address();
+    IPv6Address(const sockaddr_in6& address);
+    //address是16个字节的网络字节序地址
+    IPv6Address(const uint8_t address[16], uint16_t port = 0);
+
+    const sockaddr* getAddr() const override { return (const sockaddr*)&m_addr; }
+    sockaddr* getAddr() override { return (sockaddr*)&m_addr; }
+    socklen_t getAddrLen() const override { return sizeof(m_addr); }
+    std::ostream& insert(std::ostream& os) const override;
+
+    uint32_t getPort() const override;
+    void setPort(uint16_t v) override;
+private:
+    sockaddr_in6 m_addr;
+};
+
+//unix域地址，path以'\0'开头的是抽象命名空间
+class UnixAddress : public Address {
+public:
+    typedef std::shared_ptr<UnixAddress> ptr;
+
+    //accept/recvfrom的时候用，长度由系统填
+    UnixAddress();
+    UnixAddress(const std::string& path);
+
+    const sockaddr* getAddr() const override { return (const sockaddr*)&m_addr; }
+    sockaddr* getAddr() override { return (sockaddr*)&m_addr; }
+    socklen_t getAddrLen() const override { return m_length; }
+    void setAddrLen(socklen_t v) { m_length = v; updateString(); }
+    std::string getPath() const;
+    std::ostream& insert(std::ostream& os) const override;
+private:
+    sockaddr_un m_addr;
+    socklen_t m_length;
+};
+
+//不认识的family
+class UnknownAddress : public Address {
+public:
+    typedef std::shared_ptr<UnknownAddress> ptr;
+
+    UnknownAddress(int family);
+    UnknownAddress(const sockaddr& addr);
+
+    const sockaddr* getAddr() const override { return (const sockaddr*)&m_addr; }
+    sockaddr* getAddr() override { return (sockaddr*)&m_addr; }
+    socklen_t getAddrLen() const override { return sizeof(m_addr); }
+    std::ostream& insert(std::ostream& os) const override;
+private:
+    sockaddr_storage m_addr;
+};
+
+std::ostream& operator<<(std::ostream& os, const Address& addr);
+
+}
+
+#endif
@@ -0,0 +1,706 @@
+#include "bytearray.h"
+#include "config.h"
+#include "log.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static ConfigVar<uint32_t>::ptr g_block_pool_size =
+    Config::lookup<uint32_t>("bytearray.block_pool_size", 64, "bytearray free block cache count per thread");
+
+static std::atomic<uint32_t> s_block_pool_size{64};
+
+struct ByteArrayConfigIniter {
+    ByteArrayConfigIniter() {
+        s_block_pool_size = g_block_pool_size->getValue();
+        g_block_pool_size->addListener([](const uint32_t&, const uint32_t& new_value) {
+            s_block_pool_size = new_value;
+        });
+    }
+};
+
+static ByteArrayConfigIniter s_bytearray_config_initer;
+
+//释放的块放在线程自己的池子里，下次直接拿，不用每次malloc/free
+//池子只缓存一种大小(最近释放的那种)，一个进程里基本只用一种块大小
+class BlockPool {
+public:
+    static void* Alloc(size_t size) {
+        Pool* pool = GetPool();
+        if (pool && pool->size == size && !pool->blocks.empty()) {
+            void* p = pool->blocks.back();
+            pool->blocks.pop_back();
+            return p;
+        }
+        void* p = malloc(size);
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    static void Dealloc(void* p, size_t size) {
+        Pool* pool = GetPool();
+        if (pool) {
+            if (pool->size != size) {
+                pool->clear();
+                pool->size = size;
+            }
+            if (pool->blocks.size() < s_block_pool_size) {
+                pool->blocks.push_back(p);
+                return;
+            }
+        }
+        free(p);
+    }
+private:
+    struct Pool {
+        size_t size = 0;
+        std::vector<void*> blocks;
+
+        void clear() {
+            for (auto p : blocks) {
+                free(p);
+            }
+            blocks.clear();
+        }
+    };
+
+    //线程退出的时候把池子里的块都释放掉；之后再释放的块直接free
+    struct PoolHolder {
+        Pool pool;
+        ~PoolHolder() {
+            pool.clear();
+            t_pool = nullptr;
+            t_dead = true;
+        }
+    };
+
+    static Pool* GetPool() {
+        static thread_local PoolHolder t_holder;
+        if (!t_pool && !t_dead) {
+            t_pool = &t_holder.pool;
+        }
+        return t_pool;
+    }
+
+    static thread_local Pool* t_pool;
+    static thread_local bool t_dead;
+};
+
+thread_local BlockPool::Pool* BlockPool::t_pool = nullptr;
+thread_local bool BlockPool::t_dead = false;
+
+ByteArray::Node* ByteArray::NewNode(size_t size) {
+    Node* node = (Node*)BlockPool::Alloc(sizeof(Node) + size);
+    node->ptr = (char*)(node + 1);
+    node->next = nullptr;
+    node->size = size;
+    return node;
+}
+
+void ByteArray::FreeNode(Node* node) {
+    BlockPool::Dealloc(node, sizeof(Node) + node->size);
+}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static const bool s_host_little_endian = true;
+#else
+static const bool s_host_little_endian = false;
+#endif
+
+static inline uint8_t byteswap(uint8_t v) { return v; }
+static inline uint16_t byteswap(uint16_t v) { return __builtin_bswap16(v); }
+static inline uint32_t byteswap(uint32_t v) { return __builtin_bswap32(v); }
+static inline uint64_t byteswap(uint64_t v) { return __builtin_bswap64(v); }
+
+static inline uint32_t EncodeZigzag32(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline uint64_t EncodeZigzag64(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int32_t DecodeZigzag32(uint32_t v) {
+    return (int32_t)((v >> 1) ^ -(v & 1));
+}
+
+static inline int64_t DecodeZigzag64(uint64_t v) {
+    return (int64_t)((v >> 1) ^ -(v & 1));
+}
+
+//varint: 每个字节低7位是数据，最高位表示后面还有没有，返回写了几个字节
+static inline size_t EncodeVarint(char* buf, uint64_t v) {
+    size_t i = 0;
+    while (v >= 0x80) {
+        buf[i++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[i++] = (char)v;
+    return i;
+}
+
+ByteArray::ByteArray(size_t base_size)
+    :m_baseSize(base_size ? base_size : 4096)
+    ,m_position(0)
+    ,m_capacity(m_baseSize)
+    ,m_size(0)
+    ,m_swap(s_host_little_endian)
+    ,m_root(NewNode(m_baseSize))
+    ,m_cur(m_root) {
+}
+
+ByteArray::~ByteArray() {
+    Node* tmp = m_root;
+    while (tmp) {
+        m_cur = tmp;
+        tmp = tmp->next;
+        FreeNode(m_cur);
+    }
+}
+
+bool ByteArray::isLittleEndian() const {
+    return m_swap != s_host_little_endian;
+}
+
+void ByteArray::setIsLittleEndian(bool val) {
+    m_swap = val != s_host_little_endian;
+}
+
+char* ByteArray::contiguous(size_t n) const {
+    if (!m_cur) {
+        return nullptr;
+    }
+    size_t npos = m_position % m_baseSize;
+    if (m_cur->size - npos < n) {
+        return nullptr;
+    }
+    return m_cur->ptr + npos;
+}
+
+void ByteArray::advance(size_t n) {
+    m_position += n;
+    if (m_position % m_baseSize == 0) {
+        m_cur = m_cur->next;
+    }
+    if (m_position > m_size) {
+        m_size = m_position;
+    }
+}
+
+//定长的写，按需要换字节序，放得下的时候直接写进当前块
+#define XX(type, utype) \
+    utype v = (utype)value; \
+    if (m_swap) { \
+        v = byteswap(v); \
+    } \
+    char* p = contiguous(sizeof(v)); \
+    if (p) { \
+        memcpy(p, &v, sizeof(v)); \
+        advance(sizeof(v)); \
+    } else { \
+        write(&v, sizeof(v)); \
+    }
+
+void ByteArray::writeFint8(int8_t value) {
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFuint8(uint8_t value) {
+    write(&value, sizeof(value));
+}
+
+void ByteArray::writeFint16(int16_t value) {
+    XX(int16_t, uint16_t);
+}
+
+void ByteArray::writeFuint16(uint16_t value) {
+    XX(uint16_t, uint16_t);
+}
+
+void ByteArray::writeFint32(int32_t value) {
+    XX(int32_t, uint32_t);
+}
+
+void ByteArray::writeFuint32(uint32_t value) {
+    XX(uint32_t, uint32_t);
+}
+
+void ByteArray::writeFint64(int64_t value) {
+    XX(int64_t, uint64_t);
+}
+
+void ByteArray::writeFuint64(uint64_t value) {
+    XX(uint64_t, uint64_t);
+}
+
+#undef XX
+
+void ByteArray::writeInt32(int32_t value) {
+    writeUint64(EncodeZigzag32(value));
+}
+
+void ByteArray::writeUint32(uint32_t value) {
+    writeUint64(value);
+}
+
+void ByteArray::writeInt64(int64_t value) {
+    writeUint64(EncodeZigzag64(value));
+}
+
+void ByteArray::writeUint64(uint64_t value) {
+    //当前块剩下的够最长的10个字节就直接编码进去
+    char* p = contiguous(10);
+    if (p) {
+        advance(EncodeVarint(p, value));
+        return;
+    }
+    char tmp[10];
+    write(tmp, EncodeVarint(tmp, value));
+}
+
+void ByteArray::writeFloat(float value) {
+    uint32_t v;
+    memcpy(&v, &value, sizeof(value));
+    writeFuint32(v);
+}
+
+void ByteArray::writeDouble(double value) {
+    uint64_t v;
+    memcpy(&v, &value, sizeof(value));
+    writeFuint64(v);
+}
+
+void ByteArray::writeStringF16(const std::string& value) {
+    writeFuint16(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringF32(const std::string& value) {
+    writeFuint32(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringF64(const std::string& value) {
+    writeFuint64(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringVint(const std::string& value) {
+    writeUint64(value.size());
+    write(value.c_str(), value.size());
+}
+
+void ByteArray::writeStringWithoutLength(const std::string& value) {
+    write(value.c_str(), value.size());
+}
+
+#define XX(type) \
+    type v; \
+    if (getReadSize() >= sizeof(v) && contiguous(sizeof(v))) { \
+        memcpy(&v, contiguous(sizeof(v)), sizeof(v)); \
+        advance(sizeof(v)); \
+    } else { \
+        read(&v, sizeof(v)); \
+    } \
+    if (m_swap) { \
+        v = byteswap(v); \
+    } \
+    return v;
+
+int8_t ByteArray::readFint8() {
+    int8_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+
+uint8_t ByteArray::readFuint8() {
+    uint8_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+
+int16_t ByteArray::readFint16() {
+    return (int16_t)readFuint16();
+}
+
+uint16_t ByteArray::readFuint16() {
+    XX(uint16_t);
+}
+
+int32_t ByteArray::readFint32() {
+    return (int32_t)readFuint32();
+}
+
+uint32_t ByteArray::readFuint32() {
+    XX(uint32_t);
+}
+
+int64_t ByteArray::readFint64() {
+    return (int64_t)readFuint64();
+}
+
+uint64_t ByteArray::readFuint64() {
+    XX(uint64_t);
+}
+
+#undef XX
+
+int32_t ByteArray::readInt32() {
+    return DecodeZigzag32((uint32_t)readUint64());
+}
+
+uint32_t ByteArray::readUint32() {
+    return (uint32_t)readUint64();
+}
+
+int64_t ByteArray::readInt64() {
+    return DecodeZigzag64(readUint64());
+}
+
+uint64_t ByteArray::readUint64() {
+    uint64_t result = 0;
+    //当前块里连续的部分，不跨块的时候不用一个字节一个字节地走read
+    size_t avail = std::min(getReadSize(), m_cur ? m_cur->size - m_position % m_baseSize : 0);
+    const uint8_t* p = (const uint8_t*)contiguous(avail);
+    if (p && avail) {
+        size_t n = std::min(avail, (size_t)10);
+        for (size_t i = 0; i < n; ++i) {
+            result |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+            if (!(p[i] & 0x80)) {
+                advance(i + 1);
+                return result;
+            }
+        }
+        if (n == 10) {
+            throw std::logic_error("ByteArray::readUint64 varint too long");
+        }
+    }
+    result = 0;
+    for (int i = 0; i < 70; i += 7) {
+        uint8_t b = readFuint8();
+        result |= (uint64_t)(b & 0x7f) << i;
+        if (!(b & 0x80)) {
+            return result;
+        }
+    }
+    throw std::logic_error("ByteArray::readUint64 varint too long");
+}
+
+float ByteArray::readFloat() {
+    uint32_t v = readFuint32();
+    float value;
+    memcpy(&value, &v, sizeof(v));
+    return value;
+}
+
+double ByteArray::readDouble() {
+    uint64_t v = readFuint64();
+    double value;
+    memcpy(&value, &v, sizeof(v));
+    return value;
+}
+
+#define XX(len) \
+    if (getReadSize() < (len)) { \
+        throw std::out_of_range("ByteArray string length out of range"); \
+    } \
+    std::string buff; \
+    buff.resize(len); \
+    read(&buff[0], len); \
+    return buff;
+
+std::string ByteArray::readStringF16() {
+    uint16_t len = readFuint16();
+    XX(len);
+}
+
+std::string ByteArray::readStringF32() {
+    uint32_t len = readFuint32();
+    XX(len);
+}
+
+std::string ByteArray::readStringF64() {
+    uint64_t len = readFuint64();
+    XX(len);
+}
+
+std::string ByteArray::readStringVint() {
+    uint64_t len = readUint64();
+    XX(len);
+}
+
+#undef XX
+
+void ByteArray::clear() {
+    m_position = m_size = 0;
+    m_capacity = m_baseSize;
+    Node* tmp = m_root->next;
+    while (tmp) {
+        m_cur = tmp;
+        tmp = tmp->next;
+        FreeNode(m_cur);
+    }
+    m_cur = m_root;
+    m_root->next = nullptr;
+}
+
+void ByteArray::write(const void* buf, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    addCapacity(size);
+
+    size_t npos = m_position % m_baseSize;
+    size_t ncap = m_cur->size - npos;
+    size_t bpos = 0;
+
+    while (size > 0) {
+        size_t n = std::min(ncap, size);
+        memcpy(m_cur->ptr + npos, (const char*)buf + bpos, n);
+        m_position += n;
+        bpos += n;
+        size -= n;
+        if (n == ncap) {
+            m_cur = m_cur->next;
+            ncap = m_baseSize;
+            npos = 0;
+        }
+    }
+
+    if (m_position > m_size) {
+        m_size = m_position;
+    }
+}
+
+void ByteArray::read(void* buf, size_t size) {
+    if (size > getReadSize()) {
+        throw std::out_of_range("ByteArray::read not enough len");
+    }
+    if (size == 0) {
+        return;
+    }
+
+    size_t npos = m_position % m_baseSize;
+    size_t ncap = m_cur->size - npos;
+    size_t bpos = 0;
+    while (size > 0) {
+        size_t n = std::min(ncap, size);
+        memcpy((char*)buf + bpos, m_cur->ptr + npos, n);
+        m_position += n;
+        bpos += n;
+        size -= n;
+        if (n == ncap) {
+            m_cur = m_cur->next;
+            ncap = m_baseSize;
+            npos = 0;
+        }
+    }
+}
+
+void ByteArray::read(void* buf, size_t size, size_t position) const {
+    if (position > m_size || size > m_size - position) {
+        throw std::out_of_range("ByteArray::read not enough len");
+    }
+    if (size == 0) {
+        return;
+    }
+
+    Node* cur = m_root;
+    for (size_t i = position / m_baseSize; i > 0; --i) {
+        cur = cur->next;
+    }
+    size_t npos = position % m_baseSize;
+    size_t ncap = m_baseSize - npos;
+    size_t bpos = 0;
+    while (size > 0) {
+        size_t n = std::min(ncap, size);
+        memcpy((char*)buf + bpos, cur->ptr + npos, n);
+        bpos += n;
+        size -= n;
+        if (n == ncap) {
+            cur = cur->next;
+            ncap = m_baseSize;
+            npos = 0;
+        }
+    }
+}
+
+void ByteArray::setPosition(size_t v) {
+    if (v > m_capacity) {
+        throw std::out_of_range("ByteArray::setPosition out of range");
+    }
+    m_position = v;
+    if (m_position > m_size) {
+        m_size = m_position;
+    }
+    m_cur = m_root;
+    for (size_t i = v / m_baseSize; i > 0 && m_cur; --i) {
+        m_cur = m_cur->next;
+    }
+}
+
+bool ByteArray::writeToFile(const std::string& name) const {
+    std::ofstream ofs;
+    ofs.open(name, std::ios::trunc | std::ios::binary);
+    if (!ofs) {
+        CHPE_LOG_ERROR(g_logger) << "writeToFile name=" << name << " error, errno="
+            << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    std::vector<iovec> iovs;
+    getReadBuffers(iovs);
+    for (auto& i : iovs) {
+        ofs.write((const char*)i.iov_base, i.iov_len);
+    }
+    return !!ofs;
+}
+
+bool ByteArray::readFromFile(const std::string& name) {
+    std::ifstream ifs;
+    ifs.open(name, std::ios::binary);
+    if (!ifs) {
+        CHPE_LOG_ERROR(g_logger) << "readFromFile name=" << name << " error, errno="
+            << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    //直接读进块里，不经过临时缓冲区
+    while (ifs) {
+        std::vector<iovec> iovs;
+        getWriteBuffers(iovs, m_baseSize);
+        size_t total = 0;
+        for (auto& i : iovs) {
+            ifs.read((char*)i.iov_base, i.iov_len);
+            total += ifs.gcount();
+            if ((size_t)ifs.gcount() < i.iov_len) {
+                break;
+            }
+        }
+        setPosition(m_position + total);
+    }
+    return ifs.eof();
+}
+
+std::string ByteArray::toString() const {
+    std::string str;
+    str.resize(getReadSize());
+    if (str.empty()) {
+        return str;
+    }
+    read(&str[0], str.size(), m_position);
+    return str;
+}
+
+std::string ByteArray::toHexString() const {
+    std::string str = toString();
+    std::stringstream ss;
+
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (i > 0 && i % 32 == 0) {
+            ss << std::endl;
+        }
+        ss << std::setw(2) << std::setfill('0') << std::hex
+           << (int)(uint8_t)str[i] << " ";
+    }
+
+    return ss.str();
+}
+
+uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len) const {
+    return getReadBuffers(buffers, len, m_position);
+}
+
+uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len, uint64_t position) const {
+    if (position >= m_size) {
+        return 0;
+    }
+    len = std::min(len, (uint64_t)(m_size - position));
+    if (len == 0) {
+        return 0;
+    }
+
+    uint64_t size = len;
+    Node* cur = m_root;
+    for (size_t i = position / m_baseSize; i > 0; --i) {
+        cur = cur->next;
+    }
+    size_t npos = position % m_baseSize;
+    size_t ncap = cur->size - npos;
+    while (len > 0) {
+        iovec iov;
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = std::min((uint64_t)ncap, len);
+        len -= iov.iov_len;
+        cur = cur->next;
+        ncap = m_baseSize;
+        npos = 0;
+        buffers.push_back(iov);
+    }
+    return size;
+}
+
+uint64_t ByteArray::getWriteBuffers(std::vector<iovec>& buffers, uint64_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    addCapacity(len);
+    uint64_t size = len;
+
+    size_t npos = m_position % m_baseSize;
+    size_t ncap = m_cur->size - npos;
+    Node* cur = m_cur;
+    while (len > 0) {
+        iovec iov;
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = std::min((uint64_t)ncap, len);
+        len -= iov.iov_len;
+        cur = cur->next;
+        ncap = m_baseSize;
+        npos = 0;
+        buffers.push_back(iov);
+    }
+    return size;
+}
+
+void ByteArray::addCapacity(size_t size) {
+    size_t old_cap = getCapacity();
+    if (old_cap >= size) {
+        return;
+    }
+
+    size = size - old_cap;
+    size_t count = (size + m_baseSize - 1) / m_baseSize;
+    Node* tmp = m_root;
+    while (tmp->next) {
+        tmp = tmp->next;
+    }
+
+    Node* first = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        tmp->next = NewNode(m_baseSize);
+        if (first == nullptr) {
+            first = tmp->next;
+        }
+        tmp = tmp->next;
+        m_capacity += m_baseSize;
+    }
+
+    if (old_cap == 0) {
+        m_cur = first;
+    }
+}
+
+}
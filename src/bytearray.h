@@ -0,0 +1,140 @@
+#ifndef __BYTEARRAY_H__
+#define __BYTEARRAY_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace cpp_high_perf {
+
+//二进制序列化缓冲区，给rpc的封包/解包用
+//内存是一串固定大小的块连起来的链表，块从线程自己的池子里拿，写的时候只往后加块，不会整体realloc搬数据
+//定长整数按设置的字节序写(默认网络字节序，大端)，变长整数用varint，有符号的先做zigzag
+//getReadBuffers/getWriteBuffers把块导出成iovec，可以直接给readv/writev/sendmsg/recvmsg用，不用多拷一次
+//读越界抛std::out_of_range
+class ByteArray {
+public:
+    typedef std::shared_ptr<ByteArray> ptr;
+
+    //一个块，块头和数据在同一次分配里
+    struct Node {
+        char* ptr;
+        Node* next;
+        size_t size;
+    };
+
+    //base_size是每个块的大小
+    ByteArray(size_t base_size = 4096);
+    ~ByteArray();
+
+    ByteArray(const ByteArray&) = delete;
+    ByteArray& operator=(const ByteArray&) = delete;
+
+    //定长
+    void writeFint8(int8_t value);
+    void writeFuint8(uint8_t value);
+    void writeFint16(int16_t value);
+    void writeFuint16(uint16_t value);
+    void writeFint32(int32_t value);
+    void writeFuint32(uint32_t value);
+    void writeFint64(int64_t value);
+    void writeFuint64(uint64_t value);
+
+    //变长，有符号的是zigzag编码，小的负数也只占一两个字节
+    void writeInt32(int32_t value);
+    void writeUint32(uint32_t value);
+    void writeInt64(int64_t value);
+    void writeUint64(uint64_t value);
+
+    void writeFloat(float value);
+    void writeDouble(double value);
+
+    //长度前缀分别是uint16/uint32/uint64定长，和varint
+    void writeStringF16(const std::string& value);
+    void writeStringF32(const std::string& value);
+    void writeStringF64(const std::string& value);
+    void writeStringVint(const std::string& value);
+    //只有内容，没有长度
+    void writeStringWithoutLength(const std::string& value);
+
+    int8_t readFint8();
+    uint8_t readFuint8();
+    int16_t readFint16();
+    uint16_t readFuint16();
+    int32_t readFint32();
+    uint32_t readFuint32();
+    int64_t readFint64();
+    uint64_t readFuint64();
+
+    int32_t readInt32();
+    uint32_t readUint32();
+    int64_t readInt64();
+    uint64_t readUint64();
+
+    float readFloat();
+    double readDouble();
+
+    std::string readStringF16();
+    std::string readStringF32();
+    std::string readStringF64();
+    std::string readStringVint();
+
+    //清空数据，只留第一个块
+    void clear();
+
+    void write(const void* buf, size_t size);
+    void read(void* buf, size_t size);
+    //从position开始读，不动当前位置
+    void read(void* buf, size_t size, size_t position) const;
+
+    size_t getPosition() const { return m_position; }
+    //超过容量抛std::out_of_range，超过数据大小的话数据大小跟着变
+    void setPosition(size_t v);
+
+    //可以读的部分写到文件里
+    bool writeToFile(const std::string& name) const;
+    //文件内容从当前位置开始写进来，读完位置在末尾，要读的话先setPosition
+    bool readFromFile(const std::string& name);
+
+    size_t getBaseSize() const { return m_baseSize; }
+    //当前位置到数据末尾还有多少可以读
+    size_t getReadSize() const { return m_size - m_position; }
+    size_t getSize() const { return m_size; }
+
+    bool isLittleEndian() const;
+    void setIsLittleEndian(bool val);
+
+    //可以读的部分，不动当前位置
+    std::string toString() const;
+    std::string toHexString() const;
+
+    //把当前位置开始最多len个可以读的字节导出成iovec，返回导出的长度，不动当前位置
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len = ~0ull) const;
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len, uint64_t position) const;
+    //先保证容量，再把当前位置开始的len个字节导出成iovec，写完之后自己setPosition
+    uint64_t getWriteBuffers(std::vector<iovec>& buffers, uint64_t len);
+private:
+    void addCapacity(size_t size);
+    size_t getCapacity() const { return m_capacity - m_position; }
+    //当前块里从当前位置开始连续的n个字节，不够n个返回空
+    char* contiguous(size_t n) const;
+    void advance(size_t n);
+
+    static Node* NewNode(size_t size);
+    static void FreeNode(Node* node);
+private:
+    size_t m_baseSize;
+    size_t m_position;//当前读写的位置
+    size_t m_capacity;//所有块加起来的大小
+    size_t m_size;//数据的大小
+    bool m_swap;//写定长整数要不要换字节序
+    Node* m_root;
+    Node* m_cur;//当前位置所在的块，正好写满最后一块的时候是空
+};
+
+}
+
+#endif
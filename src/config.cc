@@ -2,14 +2,61 @@
 #include "yaml-cpp/yaml.h"
 #include <algorithm>
 #include <list>
+#include <fstream>
+#include <unordered_map>
+#include <dirent.h>
+#include <string.h>
 
 namespace cpp_high_perf {
 
-Config::ConfigVarMap Config::s_datas;
+ConfigVarBase::ptr ConfigVarRegistry::find(const std::string& name, uint64_t hash) const {
+    const Shard& s = shard(hash);
+    RWMutex::ReadLock lock(s.mutex);
+    auto range = s.vars.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->getName() == name) {
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+ConfigVarBase::ptr ConfigVarRegistry::insert(const ConfigVarBase::ptr& var) {
+    Shard& s = shard(var->getHash());
+    RWMutex::WriteLock lock(s.mutex);
+    auto range = s.vars.equal_range(var->getHash());
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->getName() == var->getName()) {
+            return it->second;
+        }
+    }
+    s.vars.insert(std::make_pair(var->getHash(), var));
+    return var;
+}
+
+void ConfigVarRegistry::visit(std::function<void (const ConfigVarBase::ptr&)> cb) const {
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        //先拷出来，回调里面再lookup也不会死锁
+        std::vector<ConfigVarBase::ptr> vars;
+        {
+            RWMutex::ReadLock lock(m_shards[i].mutex);
+            vars.reserve(m_shards[i].vars.size());
+            for (auto& it : m_shards[i].vars) {
+                vars.push_back(it.second);
+            }
+        }
+        for (auto& v : vars) {
+            cb(v);
+        }
+    }
+}
 
 ConfigVarBase::ptr Config::lookupBase(const std::string& name) {
-    auto it = s_datas.find(name);
-    return it == s_datas.end() ? nullptr : it->second;
+    return GetDatas().find(name, ConfigHash(name));
+}
+
+void Config::visit(std::function<void (const ConfigVarBase::ptr&)> cb) {
+    GetDatas().visit(cb);
 }
 
 //这个地方是获取配置信息的地方
@@ -51,17 +98,127 @@ void Config::loadFromYaml(const YAML::Node& root) {
         ConfigVarBase::ptr var = Config::lookupBase(key);
 
         if(var) {
-            if(i.second.IsScalar()) {
-                var->fromString(i.second.Scalar());
-                CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "is scalar: " << var->getName();
-            } else {
-                std::stringstream ss;
-                ss << i.second;
-                var->fromString(ss.str());
-                CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "not scalar: "  << ss.str();
-            }
+            //节点已经解析好了，直接取值，不再输出成字符串重新解析
+            var->fromYaml(i.second);
+            CHPE_LOG_INFO(CHPE_LOG_ROOT()) << (i.second.IsScalar() ? "is scalar: " : "not scalar: ")
+                << var->getName();
         }
     }
 }
 
-}
\ No newline at end of file
+//每个文件上次加载的状态
+struct YamlFileState {
+    bool loaded = false;
+    uint64_t hash = 0;//文件内容的hash
+    std::unordered_map<std::string, std::string> values;//key -> 上次应用的序列化之后的值
+};
+
+static Mutex& GetFileStateMutex() {
+    static Mutex s_mutex;
+    return s_mutex;
+}
+
+static std::map<std::string, YamlFileState>& GetFileStates() {
+    static std::map<std::string, YamlFileState> s_states;
+    return s_states;
+}
+
+size_t Config::loadFromYamlFile(const std::string& file, bool force, bool* skipped) {
+    if (skipped) {
+        *skipped = false;
+    }
+    std::ifstream ifs(file);
+    if (!ifs) {
+        CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "Config open file fail: " << file;
+        return 0;
+    }
+    std::stringstream content;
+    content << ifs.rdbuf();
+    std::string str = content.str();
+    uint64_t hash = ConfigHash(str);
+
+    Mutex::Lock lock(GetFileStateMutex());
+    YamlFileState& state = GetFileStates()[file];
+    if (!force && state.loaded && state.hash == hash) {
+        //内容完全一样，比如touch或者重复保存
+        if (skipped) {
+            *skipped = true;
+        }
+        return 0;
+    }
+
+    YAML::Node root;
+    try {
+        root = YAML::Load(str);
+    } catch (std::exception& e) {
+        CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "Config load file fail: " << file << " " << e.what();
+        return 0;
+    }
+    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
+    listAllMember("", root, all_nodes);
+
+    size_t applied = 0;
+    bool all_ok = true;
+    for (auto& i : all_nodes) {
+        std::string key = i.first;
+        if (key.empty()) {
+            continue;
+        }
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        ConfigVarBase::ptr var = Config::lookupBase(key);
+        if (!var) {
+            continue;
+        }
+
+        std::string val;
+        if (i.second.IsScalar()) {
+            val = i.second.Scalar();
+        } else {
+            std::stringstream ss;
+            ss << i.second;
+            val = ss.str();
+        }
+        auto it = state.values.find(key);
+        if (!force && it != state.values.end() && it->second == val) {
+            continue;
+        }
+        //val只用来比较有没有变化，取值还是直接走节点
+        if (var->fromYaml(i.second)) {
+            state.values[key] = val;
+            ++applied;
+        } else {
+            all_ok = false;
+        }
+    }
+    //有key没应用上的话不记hash，同样的内容再写一遍还会重新加载，失败的key会再试
+    state.loaded = all_ok;
+    state.hash = hash;
+    return applied;
+}
+
+size_t Config::loadFromConfDir(const std::string& path, bool force) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "Config open dir fail: " << path;
+        return 0;
+    }
+    std::vector<std::string> files;
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(dir)) != nullptr) {
+        size_t len = strlen(dp->d_name);
+        if (len > 5 && strcmp(dp->d_name + len - 5, ".yaml") == 0) {
+            files.push_back(path + "/" + dp->d_name);
+        }
+    }
+    closedir(dir);
+    //按名字排好，加载的顺序是确定的
+    std::sort(files.begin(), files.end());
+
+    size_t applied = 0;
+    for (auto& i : files) {
+        applied += loadFromYamlFile(i, force);
+    }
+    return applied;
+}
+
+}
@@ -12,34 +12,72 @@
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <functional>
+#include <atomic>
+#include <type_traits>
+#include <utility>
 #include <yaml-cpp/node/parse.h>
 #include "yaml-cpp/yaml.h"
 #include "log.h"
 
 namespace cpp_high_perf {
 
+//FNV-1a，配置名字和文件内容的hash都用它
+inline uint64_t ConfigHash(const char* data, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline uint64_t ConfigHash(const std::string& str) {
+    return ConfigHash(str.c_str(), str.size());
+}
+
+//每个类型一个唯一的地址，注册的时候记下来，查找的时候比地址就知道类型对不对，不用dynamic_cast
+template <class T>
+class ConfigTypeTag {
+public:
+    static const void* Get() { return &s_tag; }
+private:
+    static const char s_tag;
+};
+
+template <class T>
+const char ConfigTypeTag<T>::s_tag = 0;
+
 //共有的属性放大这个基类里面
 class ConfigVarBase {
 public:
     typedef std::shared_ptr<ConfigVarBase> ptr;
-    ConfigVarBase(const std::string& name, const std::string& description = "")
+    ConfigVarBase(const std::string& name, const std::string& description = "", const void* type_tag = nullptr)
         :m_name(name)
-        ,m_description(description) {
+        ,m_description(description)
+        ,m_typeTag(type_tag) {
             std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower);
+            m_hash = ConfigHash(m_name);
     }
 
     virtual ~ConfigVarBase() {}
 
     const std::string& getName() const { return m_name; }
     const std::string& getDescription() const { return m_description; }
+    uint64_t getHash() const { return m_hash; }
+    const void* getTypeTag() const { return m_typeTag; }
 
     virtual std::string toString() = 0;//方便调试 / 输出文件
     virtual bool fromString(const std::string& val) = 0;//解析配置文件
+    virtual YAML::Node toYaml() = 0;
+    virtual bool fromYaml(const YAML::Node& node) = 0;//直接从解析好的节点取值，不用再转一遍字符串
     virtual std::string getTypeName() const = 0;
 
 private:
     std::string m_name;
     std::string m_description;//描述
+    uint64_t m_hash;//名字的hash，注册的时候算好
+    const void* m_typeTag;//ConfigTypeTag<具体的ConfigVar类型>::Get()
 
 };
 
@@ -52,215 +90,446 @@ public:
     }
 };
 
-//偏特化//string to/from vector<T>
+//bool单独处理，boost只认0/1，yaml里一般写的是true/false
+template <>
+class LexicalCast<std::string, bool> {
+public:
+    bool operator()(const std::string& str) {
+        if (str == "true" || str == "True" || str == "TRUE" || str == "yes" || str == "on" || str == "1") {
+            return true;
+        }
+        if (str == "false" || str == "False" || str == "FALSE" || str == "no" || str == "off" || str == "0") {
+            return false;
+        }
+        throw boost::bad_lexical_cast();
+    }
+};
+
+template <>
+class LexicalCast<bool, std::string> {
+public:
+    std::string operator()(const bool& v) {
+        return v ? "true" : "false";
+    }
+};
+
+//YAML::Node和T之间直接转化，容器不再 节点->字符串->重新解析 一层层地来回倒
+//默认的实现: 标量直接拿Scalar()转，其它的退回到string的转化(自定义类型只写了string的特化也能用)
 template <class T>
-class LexicalCast<std::string, std::vector<T>> {
+class LexicalCast<YAML::Node, T> {
 public:
-    std::vector<T> operator()(const std::string& str) {
-        YAML::Node node  = YAML::Load(str);
-        typename std::vector<T> Vec;
+    T operator()(const YAML::Node& node) {
+        if (node.IsScalar()) {
+            return LexicalCast<std::string, T>()(node.Scalar());
+        }
         std::stringstream ss;
-        for(size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            Vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+        ss << node;
+        return LexicalCast<std::string, T>()(ss.str());
+    }
+};
+
+template <class T>
+class LexicalCast<T, YAML::Node> {
+public:
+    YAML::Node operator()(const T& v) {
+        return toNode(v, std::integral_constant<bool, std::is_arithmetic<T>::value
+                || std::is_same<T, std::string>::value>());
+    }
+private:
+    //数字和字符串直接是标量，不用再解析一遍
+    static YAML::Node toNode(const T& v, std::true_type) {
+        return YAML::Node(LexicalCast<T, std::string>()(v));
+    }
+    static YAML::Node toNode(const T& v, std::false_type) {
+        return YAML::Load(LexicalCast<T, std::string>()(v));
+    }
+};
+
+//偏特化//YAML::Node to/from vector<T>
+template <class T>
+class LexicalCast<YAML::Node, std::vector<T>> {
+public:
+    std::vector<T> operator()(const YAML::Node& node) {
+        typename std::vector<T> Vec;
+        Vec.reserve(node.size());
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            Vec.push_back(LexicalCast<YAML::Node, T>()(*it));
         }
         return Vec;
     }
 };
 
-//偏特化
 template <class T>
-class LexicalCast<std::vector<T>, std::string> {
+class LexicalCast<std::vector<T>, YAML::Node> {
 public:
-    std::string operator()(const std::vector<T>& v) {
-        YAML::Node node; 
+    YAML::Node operator()(const std::vector<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
         for (auto& it : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(it)));
+            node.push_back(LexicalCast<T, YAML::Node>()(it));
         }
-        std::stringstream ss;
-        ss << node;
-        return ss.str();
+        return node;
     }
 };
 
-//偏特化//string to/from list<T>
+//偏特化//YAML::Node to/from list<T>
 template <class T>
-class LexicalCast<std::string, std::list<T>> {
+class LexicalCast<YAML::Node, std::list<T>> {
 public:
-    std::list<T> operator()(const std::string& str) {
-        YAML::Node node  = YAML::Load(str);
+    std::list<T> operator()(const YAML::Node& node) {
         typename std::list<T> Vec;
-        std::stringstream ss;
-        for(size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            Vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            Vec.push_back(LexicalCast<YAML::Node, T>()(*it));
         }
         return Vec;
     }
 };
 
 template <class T>
-class LexicalCast<std::list<T>, std::string> {
+class LexicalCast<std::list<T>, YAML::Node> {
 public:
-    std::string operator()(const std::list<T>& v) {
-        YAML::Node node;
+    YAML::Node operator()(const std::list<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
         for (auto& it : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(it)));
+            node.push_back(LexicalCast<T, YAML::Node>()(it));
         }
-        std::stringstream ss;
-        ss << node;
-        return ss.str();
+        return node;
     }
 };
 
 //偏特化set
 template <class T>
-class LexicalCast<std::string, std::set<T>> {
+class LexicalCast<YAML::Node, std::set<T>> {
 public:
-    std::set<T> operator()(const std::string& str) {
-        YAML::Node node  = YAML::Load(str);
+    std::set<T> operator()(const YAML::Node& node) {
         typename std::set<T> Vec;
-        std::stringstream ss;
-        for(size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            Vec.insert(LexicalCast<std::string, T>()(ss.str()));
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            Vec.insert(LexicalCast<YAML::Node, T>()(*it));
         }
         return Vec;
     }
 };
 
 template <class T>
-class LexicalCast<std::set<T>, std::string> {
+class LexicalCast<std::set<T>, YAML::Node> {
 public:
-    std::string operator()(const std::set<T>& v) {
-        YAML::Node node;
+    YAML::Node operator()(const std::set<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
         for (auto& it : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(it)));
+            node.push_back(LexicalCast<T, YAML::Node>()(it));
         }
-        std::stringstream ss;
-        ss << node;
-        return ss.str();
+        return node;
     }
-}; 
+};
 
 //偏特化unordered_set
 template <class T>
-class LexicalCast<std::string, std::unordered_set<T>> {
+class LexicalCast<YAML::Node, std::unordered_set<T>> {
 public:
-    std::unordered_set<T> operator()(const std::string& str) {
-        YAML::Node node  = YAML::Load(str);
+    std::unordered_set<T> operator()(const YAML::Node& node) {
         typename std::unordered_set<T> Vec;
-        std::stringstream ss;
-        for(size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            Vec.insert(LexicalCast<std::string, T>()(ss.str()));
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            Vec.insert(LexicalCast<YAML::Node, T>()(*it));
         }
         return Vec;
     }
 };
 
 template <class T>
-class LexicalCast<std::unordered_set<T>, std::string> {
+class LexicalCast<std::unordered_set<T>, YAML::Node> {
 public:
-    std::string operator()(const std::unordered_set<T>& v) {
-        YAML::Node node;
+    YAML::Node operator()(const std::unordered_set<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
         for (auto& it : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(it)));
+            node.push_back(LexicalCast<T, YAML::Node>()(it));
         }
-        std::stringstream ss;
-        ss << node;
-        return ss.str();
+        return node;
     }
 };
 
 //偏特化map
 template <class T>
-class LexicalCast<std::string, std::map<std::string, T>> {
+class LexicalCast<YAML::Node, std::map<std::string, T>> {
 public:
-    std::map<std::string, T> operator()(const std::string& str) {
-        YAML::Node node  = YAML::Load(str);
+    std::map<std::string, T> operator()(const YAML::Node& node) {
         typename std::map<std::string, T> Vec;
-        std::stringstream ss;
-        for(auto it = node.begin(); it != node.end(); ++it) {
-            ss.str("");
-            ss << it->second;
-            Vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<std::string, T>()(ss.str())));
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            Vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<YAML::Node, T>()(it->second)));
         }
         return Vec;
     }
 };
 
 template <class T>
-class LexicalCast<std::map<std::string, T>, std::string> {
+class LexicalCast<std::map<std::string, T>, YAML::Node> {
 public:
-    std::string operator()(const std::map<std::string, T>& v) {
-        YAML::Node node;
+    YAML::Node operator()(const std::map<std::string, T>& v) {
+        YAML::Node node(YAML::NodeType::Map);
         for (auto& it : v) {
-            node[it.first] = YAML::Load(LexicalCast<T, std::string>()(it.second));
+            node.force_insert(it.first, LexicalCast<T, YAML::Node>()(it.second));//key本来就不重复，operator[]每次都要线性查找
         }
-        std::stringstream ss;
-        ss << node;
-        return ss.str();
+        return node;
     }
 };
 
 //偏特化unordered_map
 template <class T>
-class LexicalCast<std::string, std::unordered_map<std::string, T>> {
+class LexicalCast<YAML::Node, std::unordered_map<std::string, T>> {
 public:
-    std::unordered_map<std::string, T> operator()(const std::string& str) {
-        YAML::Node node  = YAML::Load(str);
+    std::unordered_map<std::string, T> operator()(const YAML::Node& node) {
         typename std::unordered_map<std::string, T> Vec;
-        std::stringstream ss;
-        for(auto it = node.begin(); it != node.end(); ++it) {
-            ss.str("");
-            ss << it->second;
-            Vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<std::string, T>()(ss.str())));
+        Vec.reserve(node.size());
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            Vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<YAML::Node, T>()(it->second)));
         }
         return Vec;
     }
 };
 
 template <class T>
-class LexicalCast<std::unordered_map<std::string, T>, std::string> {
+class LexicalCast<std::unordered_map<std::string, T>, YAML::Node> {
 public:
-    std::string operator()(const std::unordered_map<std::string, T>& v) {
-        YAML::Node node;
+    YAML::Node operator()(const std::unordered_map<std::string, T>& v) {
+        YAML::Node node(YAML::NodeType::Map);
         for (auto& it : v) {
-            node[it.first] = YAML::Load(LexicalCast<T, std::string>()(it.second));
+            node.force_insert(it.first, LexicalCast<T, YAML::Node>()(it.second));//key本来就不重复，operator[]每次都要线性查找
         }
+        return node;
+    }
+};
+
+//容器和string之间的转化: 只解析/输出一次，中间都走上面YAML::Node的版本
+template <class T>
+class NodeStringCast {
+public:
+    T operator()(const std::string& str) {
+        return LexicalCast<YAML::Node, T>()(YAML::Load(str));
+    }
+};
+
+template <class T>
+class StringNodeCast {
+public:
+    std::string operator()(const T& v) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<T, YAML::Node>()(v);
         return ss.str();
     }
 };
 
+template <class T>
+class LexicalCast<std::string, std::vector<T>> : public NodeStringCast<std::vector<T>> {};
+template <class T>
+class LexicalCast<std::vector<T>, std::string> : public StringNodeCast<std::vector<T>> {};
+
+template <class T>
+class LexicalCast<std::string, std::list<T>> : public NodeStringCast<std::list<T>> {};
+template <class T>
+class LexicalCast<std::list<T>, std::string> : public StringNodeCast<std::list<T>> {};
+
+template <class T>
+class LexicalCast<std::string, std::set<T>> : public NodeStringCast<std::set<T>> {};
+template <class T>
+class LexicalCast<std::set<T>, std::string> : public StringNodeCast<std::set<T>> {};
+
+template <class T>
+class LexicalCast<std::string, std::unordered_set<T>> : public NodeStringCast<std::unordered_set<T>> {};
+template <class T>
+class LexicalCast<std::unordered_set<T>, std::string> : public StringNodeCast<std::unordered_set<T>> {};
+
+template <class T>
+class LexicalCast<std::string, std::map<std::string, T>> : public NodeStringCast<std::map<std::string, T>> {};
+template <class T>
+class LexicalCast<std::map<std::string, T>, std::string> : public StringNodeCast<std::map<std::string, T>> {};
+
+template <class T>
+class LexicalCast<std::string, std::unordered_map<std::string, T>> : public NodeStringCast<std::unordered_map<std::string, T>> {};
+template <class T>
+class LexicalCast<std::unordered_map<std::string, T>, std::string> : public StringNodeCast<std::unordered_map<std::string, T>> {};
+
+//日志配置和YAML::Node的转化，对应log.yaml里面logs下面的每一项
+template <>
+class LexicalCast<YAML::Node, LogDefine> {
+public:
+    LogDefine operator()(const YAML::Node& node) {
+        LogDefine ld;
+        if (!node["name"].IsDefined()) {
+            throw std::logic_error("log config error: name is null");
+        }
+        ld.name = node["name"].as<std::string>();
+        ld.level = LogLevel::FromString(node["level"].IsDefined() ? node["level"].as<std::string>() : "");
+        if (node["formatter"].IsDefined()) {
+            ld.formatter = node["formatter"].as<std::string>();
+        }
+        if (node["async"].IsDefined()) {
+            ld.async = node["async"].as<bool>();
+        }
+
+        YAML::Node appenders = node["appender"];
+        if (appenders.IsDefined()) {
+            for (size_t i = 0; i < appenders.size(); ++i) {
+                auto a = appenders[i];
+                if (!a["type"].IsDefined()) {
+                    throw std::logic_error("log config error: appender type is null, " + ld.name);
+                }
+                std::string type = a["type"].as<std::string>();
+                LogAppenderDefine lad;
+                if (type == "FileLogAppender") {
+                    lad.type = 1;
+                    //以前的配置写的是path，也认
+                    if (a["file"].IsDefined()) {
+                        lad.file = a["file"].as<std::string>();
+                    } else if (a["path"].IsDefined()) {
+                        lad.file = a["path"].as<std::string>();
+                    } else {
+                        throw std::logic_error("log config error: file appender file is null, " + ld.name);
+                    }
+                    if (a["max_size"].IsDefined()) {
+                        std::string size = a["max_size"].as<std::string>();
+                        lad.rotate.maxSize = LogRotateConfig::ParseSize(size);
+                        if (!lad.rotate.maxSize && size != "0") {
+                            throw std::logic_error("log config error: max_size is invalid, " + size);
+                        }
+                    }
+                    if (a["rotate"].IsDefined()) {
+                        lad.rotate.period = LogRotateConfig::PeriodFromString(a["rotate"].as<std::string>());
+                    }
+                    if (a["max_files"].IsDefined()) {
+                        lad.rotate.maxFiles = a["max_files"].as<uint32_t>();
+                    }
+                    if (a["compress"].IsDefined()) {
+                        lad.rotate.compress = a["compress"].as<bool>();
+                    }
+                    if (a["sync"].IsDefined()) {
+                        std::string sync = a["sync"].as<std::string>();
+                        if (!LogSyncConfig::FromString(sync, lad.sync)) {
+                            throw std::logic_error("log config error: sync is invalid, " + sync);
+                        }
+                    }
+                } else if (type == "StdoutLogAppender") {
+                    lad.type = 2;
+                } else {
+                    throw std::logic_error("log config error: appender type is invalid, " + type);
+                }
+                if (a["level"].IsDefined()) {
+                    lad.level = LogLevel::FromString(a["level"].as<std::string>());
+                }
+                if (a["formatter"].IsDefined()) {
+                    lad.formatter = a["formatter"].as<std::string>();
+                }
+                ld.appenders.push_back(lad);
+            }
+        }
+        return ld;
+    }
+};
+
+template <>
+class LexicalCast<LogDefine, YAML::Node> {
+public:
+    YAML::Node operator()(const LogDefine& v) {
+        YAML::Node node;
+        node["name"] = v.name;
+        if (v.level != LogLevel::UNKNOW) {
+            node["level"] = LogLevel::ToString(v.level);
+        }
+        if (!v.formatter.empty()) {
+            node["formatter"] = v.formatter;
+        }
+        if (v.async) {
+            node["async"] = true;
+        }
+        for (auto& a : v.appenders) {
+            YAML::Node na;
+            if (a.type == 1) {
+                na["type"] = "FileLogAppender";
+                na["file"] = a.file;
+                if (a.rotate.maxSize) {
+                    na["max_size"] = a.rotate.maxSize;
+                }
+                if (a.rotate.period != LogRotateConfig::NONE) {
+                    na["rotate"] = LogRotateConfig::PeriodToString(a.rotate.period);
+                }
+                if (a.rotate.maxFiles) {
+                    na["max_files"] = a.rotate.maxFiles;
+                }
+                if (!a.rotate.compress) {
+                    na["compress"] = false;
+                }
+                if (a.sync.policy != LogSyncConfig::NEVER) {
+                    na["sync"] = LogSyncConfig::ToString(a.sync);
+                }
+            } else if (a.type == 2) {
+                na["type"] = "StdoutLogAppender";
+            }
+            if (a.level != LogLevel::DEBUG) {
+                na["level"] = LogLevel::ToString(a.level);
+            }
+            if (!a.formatter.empty()) {
+                na["formatter"] = a.formatter;
+            }
+            node["appender"].push_back(na);
+        }
+        return node;
+    }
+};
+
+template <>
+class LexicalCast<std::string, LogDefine> : public NodeStringCast<LogDefine> {};
+template <>
+class LexicalCast<LogDefine, std::string> : public StringNodeCast<LogDefine> {};
+
+//判断类型能不能用==比较，容器要看里面元素能不能比较
+//(std::vector之类的operator==是模板，光看声明总是能比较的，真用的时候才会报错)
+template <class T>
+class HasEqual {
+    template <class U>
+    static auto test(int) -> decltype(std::declval<const U&>() == std::declval<const U&>(), std::true_type());
+    template <class U>
+    static std::false_type test(...);
+public:
+    static const bool value = decltype(test<T>(0))::value;
+};
+
+template <class T>
+class HasEqual<std::vector<T>> : public HasEqual<T> {};
+template <class T>
+class HasEqual<std::list<T>> : public HasEqual<T> {};
+template <class T>
+class HasEqual<std::set<T>> : public HasEqual<T> {};
+template <class T>
+class HasEqual<std::unordered_set<T>> : public HasEqual<T> {};
+template <class T>
+class HasEqual<std::map<std::string, T>> : public HasEqual<T> {};
+template <class T>
+class HasEqual<std::unordered_map<std::string, T>> : public HasEqual<T> {};
 
 //对于具体的类型，需要继承这个类，类型肯定很多，所以需要定义模板类
 //定义仿函数 FromStr T operator()(const std::string& str)
 //定义仿函数 ToStr std::string operator()(const T& v)
+//值是一份不可变的快照(shared_ptr<const T>)，写的时候整个换掉，
+//读的线程拿到指针就可以一直用，不用加锁也不用拷贝
 template<class T, class FromStr = cpp_high_perf::LexicalCast<std::string, T>, 
         class ToStr = cpp_high_perf::LexicalCast<T, std::string>>
 class ConfigVar : public cpp_high_perf::ConfigVarBase {
 public:
     typedef std::shared_ptr<ConfigVar> ptr;
+    typedef std::shared_ptr<const T> value_ptr;
+    typedef RWMutex RWMutexType;
+    //配置变化的回调，参数是旧值和新值
+    typedef std::function<void (const T& old_value, const T& new_value)> on_change_cb;
     ConfigVar (const std::string& name, const T& default_valse, const std::string& description = ""):
-        ConfigVarBase(name, description)
-        ,m_val(default_valse) {
+        ConfigVarBase(name, description, ConfigTypeTag<ConfigVar>::Get())
+        ,m_val(std::make_shared<const T>(default_valse)) {
 
     }
 
     std::string toString() override {
         try {
             //return boost::lexical_cast<std::string>(m_val);
-            return ToStr()(m_val);
+            return ToStr()(*getValuePtr());
         } catch (std::exception& e) {
             CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "ConfigVar::toString exception"
-                << e.what() << " convert: " << typeid(m_val).name() << " to string";
+                << e.what() << " convert: " << typeid(T).name() << " to string";
         }
         return "";
     }
@@ -269,84 +538,231 @@ public:
         try {
             //m_val = boost::lexical_cast<T>(val);
             setValue(FromStr()(val));
+            return true;
         } catch (std::exception& e) {
             CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "ConfigVar::fromString exception"
-                << e.what() << " convert: string to " << typeid(m_val).name();
+                << e.what() << " convert: string to " << typeid(T).name();
         }
         return false;
     }
 
-    const T getValue() const { return m_val; }
-    void setValue(const T& v) { m_val = v; }
+    YAML::Node toYaml() override {
+        try {
+            return toNode(*getValuePtr(), IsDefaultCast());
+        } catch (std::exception& e) {
+            CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "ConfigVar::toYaml exception"
+                << e.what() << " convert: " << typeid(T).name() << " to node";
+        }
+        return YAML::Node();
+    }
+
+    bool fromYaml(const YAML::Node& node) override {
+        try {
+            setValue(fromNode(node, IsDefaultCast()));
+            return true;
+        } catch (std::exception& e) {
+            CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "ConfigVar::fromYaml exception"
+                << e.what() << " convert: node to " << typeid(T).name();
+        }
+        return false;
+    }
+
+    //当前值的快照，热路径用这个，不拷贝T
+    value_ptr getValuePtr() const { return std::atomic_load(&m_val); }
+    //会拷贝一份T，容器类型的配置尽量用getValuePtr
+    const T getValue() const { return *getValuePtr(); }
+
+    //值没有变化的话什么都不做，变了才换快照并通知回调
+    //写的线程之间串行，读的线程不受影响；回调里不要再设置同一个配置
+    void setValue(const T& v) {
+        Mutex::Lock lock(m_writeMutex);
+        value_ptr old_value = getValuePtr();
+        if (isSame(*old_value, v, std::integral_constant<bool, HasEqual<T>::value>())) {
+            return;
+        }
+        value_ptr new_value = std::make_shared<const T>(v);
+        std::atomic_store(&m_val, new_value);
+
+        std::map<uint64_t, on_change_cb> cbs;
+        {
+            RWMutexType::ReadLock rlock(m_cbMutex);
+            cbs = m_cbs;
+        }
+        for (auto& i : cbs) {
+            i.second(*old_value, *new_value);
+        }
+    }
     std::string getTypeName() const override { return typeid(T).name(); }
+
+    //返回回调的id，删除的时候用
+    uint64_t addListener(on_change_cb cb) {
+        static std::atomic<uint64_t> s_fun_id{0};
+        uint64_t id = ++s_fun_id;
+        RWMutexType::WriteLock lock(m_cbMutex);
+        m_cbs[id] = cb;
+        return id;
+    }
+
+    void delListener(uint64_t key) {
+        RWMutexType::WriteLock lock(m_cbMutex);
+        m_cbs.erase(key);
+    }
+
+    on_change_cb getListener(uint64_t key) {
+        RWMutexType::ReadLock lock(m_cbMutex);
+        auto it = m_cbs.find(key);
+        return it == m_cbs.end() ? nullptr : it->second;
+    }
+
+    void clearListener() {
+        RWMutexType::WriteLock lock(m_cbMutex);
+        m_cbs.clear();
+    }
 private:
-    T m_val;//配置文件里面要写入的值，类型很多(int, string等等)
+    static bool isSame(const T& a, const T& b, std::true_type) {
+        return a == b;
+    }
+    //没有==的类型，比较序列化之后的字符串
+    static bool isSame(const T& a, const T& b, std::false_type) {
+        return ToStr()(a) == ToStr()(b);
+    }
+
+    //用户自己传了FromStr/ToStr的话，节点还是先转成字符串交给它们，保证行为和以前一样
+    typedef std::integral_constant<bool, std::is_same<FromStr, LexicalCast<std::string, T>>::value
+            && std::is_same<ToStr, LexicalCast<T, std::string>>::value> IsDefaultCast;
+
+    static T fromNode(const YAML::Node& node, std::true_type) {
+        return LexicalCast<YAML::Node, T>()(node);
+    }
+    static T fromNode(const YAML::Node& node, std::false_type) {
+        if (node.IsScalar()) {
+            return FromStr()(node.Scalar());
+        }
+        std::stringstream ss;
+        ss << node;
+        return FromStr()(ss.str());
+    }
+    static YAML::Node toNode(const T& v, std::true_type) {
+        return LexicalCast<T, YAML::Node>()(v);
+    }
+    static YAML::Node toNode(const T& v, std::false_type) {
+        return YAML::Load(ToStr()(v));
+    }
+private:
+    value_ptr m_val;//配置文件里面要写入的值，类型很多(int, string等等)，只通过atomic_load/atomic_store访问
+    Mutex m_writeMutex;//写的线程之间互斥
+    RWMutexType m_cbMutex;
+    std::map<uint64_t, on_change_cb> m_cbs;//变化的时候通知这些回调，key是addListener返回的id
+};
+
+//配置项的注册表，按名字的hash分成几片，每片一把读写锁
+//查找只拿一片的读锁，不同片的注册和查找互不影响；片里面直接用算好的hash做key
+class ConfigVarRegistry : Noncopyable {
+public:
+    static const size_t SHARD_COUNT = 16;
+
+    ConfigVarBase::ptr find(const std::string& name, uint64_t hash) const;
+    //已经有同名的就返回已有的那个，没有就放进去，返回var
+    ConfigVarBase::ptr insert(const ConfigVarBase::ptr& var);
+    void visit(std::function<void (const ConfigVarBase::ptr&)> cb) const;
+private:
+    //hash已经算好了，直接拿来用
+    struct IdentityHash {
+        size_t operator()(uint64_t h) const { return (size_t)h; }
+    };
+    struct alignas(64) Shard {
+        mutable RWMutex mutex;
+        std::unordered_multimap<uint64_t, ConfigVarBase::ptr, IdentityHash> vars;
+    };
+    //低位给unordered_multimap分桶用，分片用高位
+    Shard& shard(uint64_t hash) { return m_shards[(hash >> 56) % SHARD_COUNT]; }
+    const Shard& shard(uint64_t hash) const { return m_shards[(hash >> 56) % SHARD_COUNT]; }
+private:
+    Shard m_shards[SHARD_COUNT];
 };
 
 //ConfigVar的管理类
 class Config {
 public:
-    typedef std::map<std::string, cpp_high_perf::ConfigVarBase::ptr> ConfigVarMap;
-    
     //一个是创建
     //存在一个什么问题呢，就是如果没有找到，1）可能真的没有；2）可能只是类型不一样key相同，value类型不同的情况
     template<class T>
     static typename ConfigVar<T>::ptr lookup(const std::string& name, 
         const T& default_valse, const std::string& description = "") {
             //先看看能不能找到
-            auto it = s_datas.find(name);
-            if (it != s_datas.end()) {
+            uint64_t hash = ConfigHash(name);
+            auto base = GetDatas().find(name, hash);
+            if (base) {
                 //表示有，转成我们对应的目标类型
-                auto tmp = std::dynamic_pointer_cast<ConfigVar<T>>(it->second);
+                auto tmp = castVar<T>(base);
                 if (tmp) {
-                    //表示转化成功
                     CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "Lookup name=" << name << " exists";
-                    return tmp;
-                } else {
-                    //直接报错
-                    CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "Lookup name=" << name << " exists but type not "
-                        << typeid(T).name() << "real type =" << it->second->getTypeName()
-                        << " " << it->second->toString();
-                    return nullptr;
                 }
+                return tmp;
             }
 
             //创建之前先判断字符串是否合理，是否有下面这些字符之外的，有就是不合理
-            if (name.find_first_not_of("abcdefghigklmnopqrstuvwxyz._012345678")
+            if (name.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789")
                 != std::string::npos) {
                     CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "Lookup name invalid " << name;
                     throw std::invalid_argument(name);
             }
 
-            //下面就可以创建了
+            //下面就可以创建了，别的线程可能同时注册了同一个名字，以先放进去的为准
             typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_valse, description));
-            s_datas[name] = v;
-
+            base = GetDatas().insert(v);
+            if (base != v) {
+                return castVar<T>(base);
+            }
             return v;
     }
 
     //一个是查找
     template<class T>
     static typename ConfigVar<T>::ptr lookup(const std::string& name) {
-        auto it = s_datas.find(name);
-        if (it == s_datas.end()) {
+        auto base = GetDatas().find(name, ConfigHash(name));
+        if (!base || base->getTypeTag() != ConfigTypeTag<ConfigVar<T>>::Get()) {
             return nullptr;
         }
-
-        return std::dynamic_pointer_cast<ConfigVar<T>>(it->second);//智能指针的强制类型转化，调用拷贝构造函数吧
+        return std::static_pointer_cast<ConfigVar<T>>(base);
     }
 
     //和yaml来进行交互
     static void loadFromYaml(const YAML::Node& root);
 
+    //加载一个yaml文件，文件内容的hash和上次一样就直接跳过；
+    //只应用序列化之后和这个文件上次加载的时候不一样的key，返回应用了多少个key
+    //force为true的时候不管hash，所有的key都重新应用一遍；skipped返回是不是因为内容没变跳过了
+    static size_t loadFromYamlFile(const std::string& file, bool force = false, bool* skipped = nullptr);
+    //加载目录下所有的.yaml文件，返回应用了多少个key
+    static size_t loadFromConfDir(const std::string& path, bool force = false);
+
     //查找配置参数,返回配置参数的基类
     static cpp_high_perf::ConfigVarBase::ptr lookupBase(const std::string& name);
 
+    //遍历所有的配置参数
+    static void visit(std::function<void (const ConfigVarBase::ptr&)> cb);
+
 private:
-    static ConfigVarMap s_datas;
+    //类型对得上就转过去，对不上报错返回nullptr
+    template<class T>
+    static typename ConfigVar<T>::ptr castVar(const ConfigVarBase::ptr& base) {
+        if (base->getTypeTag() == ConfigTypeTag<ConfigVar<T>>::Get()) {
+            return std::static_pointer_cast<ConfigVar<T>>(base);
+        }
+        CHPE_LOG_ERROR(CHPE_LOG_ROOT()) << "Lookup name=" << base->getName() << " exists but type not "
+            << typeid(T).name() << "real type =" << base->getTypeName()
+            << " " << base->toString();
+        return nullptr;
+    }
 
-};
+    //放在函数里的静态变量，保证别的编译单元的全局变量初始化的时候调用lookup也已经构造好了
+    static ConfigVarRegistry& GetDatas() {
+        static ConfigVarRegistry s_datas;
+        return s_datas;
+    }
 
+};
 
 }
 
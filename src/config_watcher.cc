@@ -0,0 +1,140 @@
+#include "config_watcher.h"
+#include "config.h"
+#include "log.h"
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <set>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+ConfigWatcher::ConfigWatcher(const std::string& path)
+    :m_path(path) {
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+bool ConfigWatcher::start() {
+    if (m_thread) {
+        return true;
+    }
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        CHPE_LOG_ERROR(g_logger) << "inotify_init1 fail errno=" << errno << " " << strerror(errno);
+        return false;
+    }
+    //写完关闭和rename进来这两种就够了，写到一半的时候不加载
+    if (inotify_add_watch(m_inotifyFd, m_path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        CHPE_LOG_ERROR(g_logger) << "inotify_add_watch path=" << m_path
+            << " fail errno=" << errno << " " << strerror(errno);
+        close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return false;
+    }
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_thread.reset(new Thread(std::bind(&ConfigWatcher::run, this), "config_watcher"));
+    CHPE_LOG_INFO(g_logger) << "ConfigWatcher start path=" << m_path;
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if (!m_thread) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(m_wakeFd, &one, sizeof(one)) != sizeof(one)) {
+        CHPE_LOG_ERROR(g_logger) << "ConfigWatcher wake fail errno=" << errno;
+    }
+    m_thread->join();
+    m_thread.reset();
+    close(m_inotifyFd);
+    close(m_wakeFd);
+    m_inotifyFd = -1;
+    m_wakeFd = -1;
+}
+
+void ConfigWatcher::reload(const std::string& file) {
+    uint64_t begin = now_us();
+    bool skipped = false;
+    size_t applied = Config::loadFromYamlFile(file, false, &skipped);
+    uint64_t used = now_us() - begin;
+
+    if (skipped) {
+        ++m_skippedCount;
+        CHPE_LOG_DEBUG(g_logger) << "config file unchanged, skip: " << file;
+        return;
+    }
+    m_lastReloadUs = used;
+    m_lastAppliedKeys = applied;
+    m_totalAppliedKeys += applied;
+    //次数最后加，别的线程看到次数变了，这次的其他统计也都是新的
+    ++m_reloadCount;
+    CHPE_LOG_INFO(g_logger) << "config file reloaded: " << file
+        << " applied_keys=" << applied << " used=" << used << "us";
+}
+
+void ConfigWatcher::run() {
+    //inotify_event后面跟着变长的文件名，缓冲区要按inotify_event对齐
+    alignas(struct inotify_event) char buf[4096];
+    struct pollfd fds[2];
+    fds[0].fd = m_inotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wakeFd;
+    fds[1].events = POLLIN;
+
+    while (true) {
+        int rt = poll(fds, 2, -1);
+        if (rt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            CHPE_LOG_ERROR(g_logger) << "ConfigWatcher poll fail errno=" << errno << " " << strerror(errno);
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        //一次把能读的事件读完，同一个文件的多次事件只加载一次
+        std::set<std::string> changed;
+        while (true) {
+            ssize_t len = read(m_inotifyFd, buf, sizeof(buf));
+            if (len <= 0) {
+                break;
+            }
+            for (char* p = buf; p < buf + len;) {
+                struct inotify_event* ev = (struct inotify_event*)p;
+                p += sizeof(struct inotify_event) + ev->len;
+                if (ev->len == 0 || (ev->mask & IN_ISDIR)) {
+                    continue;
+                }
+                std::string name(ev->name);
+                if (name.size() > 5 && name.compare(name.size() - 5, 5, ".yaml") == 0) {
+                    changed.insert(m_path + "/" + name);
+                }
+            }
+        }
+        for (auto& i : changed) {
+            reload(i);
+        }
+    }
+}
+
+}
@@ -0,0 +1,51 @@
+#ifndef __CONFIG_WATCHER_H__
+#define __CONFIG_WATCHER_H__
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+#include "thread.h"
+
+namespace cpp_high_perf {
+
+//用inotify盯着配置目录，.yaml文件写完或者被替换(编辑器一般是先写临时文件再rename)的时候，
+//在自己的线程里重新加载这个文件，不占用处理请求的线程
+//内容没变的文件直接跳过，变了的文件也只应用值有变化的key，见Config::loadFromYamlFile
+class ConfigWatcher {
+public:
+    typedef std::shared_ptr<ConfigWatcher> ptr;
+
+    ConfigWatcher(const std::string& path);
+    ~ConfigWatcher();
+
+    //开始监听，目录打不开返回false
+    bool start();
+    void stop();
+
+    const std::string& getPath() const { return m_path; }
+
+    uint64_t getReloadCount() const { return m_reloadCount; }//重新加载过多少次文件
+    uint64_t getSkippedCount() const { return m_skippedCount; }//内容没变被跳过的次数
+    uint64_t getLastReloadUs() const { return m_lastReloadUs; }//最近一次加载花了多少微秒
+    uint64_t getLastAppliedKeys() const { return m_lastAppliedKeys; }//最近一次应用了多少个key
+    uint64_t getTotalAppliedKeys() const { return m_totalAppliedKeys; }//一共应用了多少个key
+private:
+    void run();
+    void reload(const std::string& file);
+private:
+    std::string m_path;
+    int m_inotifyFd = -1;
+    int m_wakeFd = -1;//eventfd，stop的时候用来唤醒poll
+    Thread::ptr m_thread;
+
+    std::atomic<uint64_t> m_reloadCount{0};
+    std::atomic<uint64_t> m_skippedCount{0};
+    std::atomic<uint64_t> m_lastReloadUs{0};
+    std::atomic<uint64_t> m_lastAppliedKeys{0};
+    std::atomic<uint64_t> m_totalAppliedKeys{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "fd_manager.h"
+#include "hook.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cpp_high_perf {
+
+FdCtx::FdCtx(int fd)
+    :m_isInit(false)
+    ,m_isSocket(false)
+    ,m_isClosed(false)
+    ,m_sysNonblock(false)
+    ,m_userNonblock(false)
+    ,m_fd(fd) {
+    init();
+}
+
+FdCtx::~FdCtx() {
+}
+
+bool FdCtx::init() {
+    if (m_isInit) {
+        return true;
+    }
+    struct stat fd_stat;
+    if (fstat(m_fd, &fd_stat) == -1) {
+        m_isInit = false;
+        m_isSocket = false;
+    } else {
+        m_isInit = true;
+        m_isSocket = S_ISSOCK(fd_stat.st_mode);
+    }
+
+    //socket在系统层面设成非阻塞，阻塞的语义由hook来模拟
+    if (m_isSocket) {
+        int flags = fcntl_f(m_fd, F_GETFL, 0);
+        if (!(flags & O_NONBLOCK)) {
+            fcntl_f(m_fd, F_SETFL, flags | O_NONBLOCK);
+        }
+        m_sysNonblock = true;
+    } else {
+        m_sysNonblock = false;
+    }
+    m_userNonblock = false;
+    m_isClosed = false;
+    return m_isInit;
+}
+
+void FdCtx::setTimeout(int type, uint64_t v) {
+    if (type == SO_RCVTIMEO) {
+        m_recvTimeout = v;
+    } else {
+        m_sendTimeout = v;
+    }
+}
+
+uint64_t FdCtx::getTimeout(int type) {
+    return type == SO_RCVTIMEO ? m_recvTimeout : m_sendTimeout;
+}
+
+FdManager::FdManager() {
+    m_mutex.setStats(LockStats::Get("fd_manager"));
+    m_datas.resize(64);
+}
+
+FdCtx::ptr FdManager::get(int fd, bool auto_create) {
+    if (fd < 0) {
+        return nullptr;
+    }
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if ((size_t)fd < m_datas.size() && (m_datas[fd] || !auto_create)) {
+            return m_datas[fd];
+        }
+        if (!auto_create) {
+            return nullptr;
+        }
+    }
+
+    RWMutexType::WriteLock lock(m_mutex);
+    if ((size_t)fd >= m_datas.size()) {
+        m_datas.resize(fd * 3 / 2 + 1);
+    }
+    if (!m_datas[fd]) {
+        m_datas[fd].reset(new FdCtx(fd));
+    }
+    return m_datas[fd];
+}
+
+void FdManager::del(int fd) {
+    RWMutexType::WriteLock lock(m_mutex);
+    if (fd < 0 || (size_t)fd >= m_datas.size()) {
+        return;
+    }
+    m_datas[fd].reset();
+}
+
+}
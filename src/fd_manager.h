@@ -0,0 +1,74 @@
+#ifndef __FD_MANAGER_H__
+#define __FD_MANAGER_H__
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+#include "mutex.h"
+
+namespace cpp_high_perf {
+
+//hook用的fd上下文: 是不是socket、用户有没有自己设非阻塞、读写超时
+//hook开着的时候socket在系统层面总是非阻塞的，用户看到的还是他自己设的阻塞/非阻塞
+class FdCtx : public std::enable_shared_from_this<FdCtx> {
+public:
+    typedef std::shared_ptr<FdCtx> ptr;
+
+    FdCtx(int fd);
+    ~FdCtx();
+
+    bool isInit() const { return m_isInit; }
+    bool isSocket() const { return m_isSocket; }
+    bool isClose() const { return m_isClosed; }
+
+    void setUserNonblock(bool v) { m_userNonblock = v; }
+    bool getUserNonblock() const { return m_userNonblock; }
+    void setSysNonblock(bool v) { m_sysNonblock = v; }
+    bool getSysNonblock() const { return m_sysNonblock; }
+
+    //type是SO_RCVTIMEO或者SO_SNDTIMEO，毫秒，~0ull表示不超时
+    void setTimeout(int type, uint64_t v);
+    uint64_t getTimeout(int type);
+private:
+    bool init();
+private:
+    //只在构造的时候写
+    bool m_isInit;
+    bool m_isSocket;
+    bool m_isClosed;
+    //下面这些hook的fcntl/ioctl/setsockopt随时会改，别的线程上的读写同时在读，不能用位域挤在一个字节里
+    std::atomic<bool> m_sysNonblock;
+    std::atomic<bool> m_userNonblock;
+    int m_fd;
+    std::atomic<uint64_t> m_recvTimeout{~0ull};
+    std::atomic<uint64_t> m_sendTimeout{~0ull};
+};
+
+//按fd下标放FdCtx，进程里只有一个
+class FdManager {
+public:
+    typedef RWMutex RWMutexType;
+
+    FdManager();
+
+    //auto_create为false的时候没有就返回空
+    FdCtx::ptr get(int fd, bool auto_create = false);
+    void del(int fd);
+private:
+    RWMutexType m_mutex;
+    std::vector<FdCtx::ptr> m_datas;
+};
+
+//hook的close要用，进程退出的时候还有静态对象(日志文件)在析构里close，这个单例故意不释放
+class FdMgr {
+public:
+    static FdManager* GetInstance() {
+        static FdManager* v = new FdManager;
+        return v;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,337 @@
+#include "fiber.h"
+#include "config.h"
+#include "log.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <assert.h>
+#include <atomic>
+#include <vector>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static std::atomic<uint64_t> s_fiber_id{0};
+static std::atomic<uint64_t> s_fiber_count{0};
+
+static thread_local Fiber* t_fiber = nullptr;//当前正在跑的协程
+static thread_local Fiber::ptr t_thread_fiber = nullptr;//线程的主协程
+
+static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
+    Config::lookup<uint32_t>("fiber.stack_size", 128 * 1024, "fiber stack size");
+static ConfigVar<uint32_t>::ptr g_fiber_stack_pool_size =
+    Config::lookup<uint32_t>("fiber.stack_pool_size", 64, "fiber stack cache count per thread");
+
+//创建协程的时候每次都去读配置太慢了，配置变的时候更新一下
+static std::atomic<uint32_t> s_stack_size{128 * 1024};
+static std::atomic<uint32_t> s_stack_pool_size{64};
+
+struct FiberConfigIniter {
+    FiberConfigIniter() {
+        s_stack_size = g_fiber_stack_size->getValue();
+        s_stack_pool_size = g_fiber_stack_pool_size->getValue();
+        g_fiber_stack_size->addListener([](const uint32_t&, const uint32_t& new_value) {
+            s_stack_size = new_value;
+        });
+        g_fiber_stack_pool_size->addListener([](const uint32_t&, const uint32_t& new_value) {
+            s_stack_pool_size = new_value;
+        });
+    }
+};
+
+static FiberConfigIniter s_fiber_config_initer;
+
+//协程栈: mmap出来，最低的一页设成不能访问，栈溢出的时候直接段错误，不会悄悄写坏别的内存
+//用完的栈放在线程自己的池子里，下次创建协程直接拿，不用每次mmap/munmap
+class StackAllocator {
+public:
+    static size_t PageSize() {
+        static size_t s_page = sysconf(_SC_PAGESIZE);
+        return s_page;
+    }
+
+    //size是可以用的大小，返回整块内存的起始地址(保护页)
+    static void* Alloc(size_t size) {
+        Pool* pool = GetPool();
+        if (pool && pool->size == size && !pool->stacks.empty()) {
+            void* p = pool->stacks.back();
+            pool->stacks.pop_back();
+            return p;
+        }
+        void* p = mmap(nullptr, size + PageSize(), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+        mprotect(p, PageSize(), PROT_NONE);
+        return p;
+    }
+
+    static void Dealloc(void* p, size_t size) {
+        Pool* pool = GetPool();
+        if (pool) {
+            //栈大小的配置变了，以前缓存的都不要了
+            if (pool->size != size) {
+                pool->clear();
+                pool->size = size;
+            }
+            if (pool->stacks.size() < s_stack_pool_size) {
+                pool->stacks.push_back(p);
+                return;
+            }
+        }
+        munmap(p, size + PageSize());
+    }
+
+    //栈在中间部分的起始地址
+    static void* StackBase(void* p) {
+        return (char*)p + PageSize();
+    }
+private:
+    struct Pool {
+        size_t size = 0;
+        std::vector<void*> stacks;
+
+        void clear() {
+            for (auto p : stacks) {
+                munmap(p, size + PageSize());
+            }
+            stacks.clear();
+        }
+    };
+
+    //线程退出的时候把池子里的栈都还回去；之后再释放的栈直接munmap
+    struct PoolHolder {
+        Pool pool;
+        ~PoolHolder() {
+            pool.clear();
+            t_pool = nullptr;
+            t_dead = true;
+        }
+    };
+
+    static Pool* GetPool() {
+        static thread_local PoolHolder t_holder;
+        if (!t_pool && !t_dead) {
+            t_pool = &t_holder.pool;
+        }
+        return t_pool;
+    }
+
+    static thread_local Pool* t_pool;
+    static thread_local bool t_dead;
+};
+
+thread_local StackAllocator::Pool* StackAllocator::t_pool = nullptr;
+thread_local bool StackAllocator::t_dead = false;
+
+#if defined(__x86_64__)
+//void chpe_fiber_switch(void** from_sp, void* to_sp)
+//把callee-saved寄存器和浮点控制字压到当前栈上，栈顶存到*from_sp，然后换到to_sp上弹出来
+extern "C" void chpe_fiber_switch(void** from_sp, void* to_sp);
+asm(R"(
+    .text
+    .globl chpe_fiber_switch
+    .hidden chpe_fiber_switch
+    .type chpe_fiber_switch,@function
+chpe_fiber_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size chpe_fiber_switch,.-chpe_fiber_switch
+)");
+
+void Fiber::initContext() {
+    //从高到低: 假的返回地址 | MainFunc(ret跳过去) | rbp rbx r12-r15 | mxcsr+x87控制字
+    //MainFunc入口的时候rsp要是16n+8，和正常call进来一样
+    uintptr_t top = ((uintptr_t)StackAllocator::StackBase(m_stack) + m_stacksize) & ~(uintptr_t)15;
+    uint64_t* sp = (uint64_t*)top;
+    *--sp = 0;
+    *--sp = (uint64_t)(uintptr_t)&Fiber::MainFunc;
+    for (int i = 0; i < 6; ++i) {
+        *--sp = 0;
+    }
+    *--sp = 0x037F00001F80ULL;//默认的mxcsr和x87控制字
+    m_sp = sp;
+}
+
+void Fiber::SwitchContext(Fiber* from, Fiber* to) {
+    chpe_fiber_switch(&from->m_sp, to->m_sp);
+}
+#else
+void Fiber::initContext() {
+    if (getcontext(&m_ctx)) {
+        assert(false);
+    }
+    m_ctx.uc_link = nullptr;
+    m_ctx.uc_stack.ss_sp = StackAllocator::StackBase(m_stack);
+    m_ctx.uc_stack.ss_size = m_stacksize;
+    makecontext(&m_ctx, &Fiber::MainFunc, 0);
+}
+
+void Fiber::SwitchContext(Fiber* from, Fiber* to) {
+    if (swapcontext(&from->m_ctx, &to->m_ctx)) {
+        assert(false);
+    }
+}
+#endif
+
+Fiber::Fiber() {
+    m_state = EXEC;
+    SetThis(this);
+}
+
+Fiber::Fiber(std::function<void()> cb, size_t stacksize)
+    :m_id(++s_fiber_id)
+    ,m_cb(cb) {
+    ++s_fiber_count;
+    m_stacksize = stacksize ? stacksize : s_stack_size.load();
+    //按页对齐，保护页才能正好在栈底
+    m_stacksize = (m_stacksize + StackAllocator::PageSize() - 1) / StackAllocator::PageSize()
+        * StackAllocator::PageSize();
+    m_stack = StackAllocator::Alloc(m_stacksize);
+    if (!m_stack) {
+        --s_fiber_count;
+        CHPE_LOG_ERROR(g_logger) << "Fiber alloc stack fail, size=" << m_stacksize;
+        throw std::bad_alloc();
+    }
+    initContext();
+}
+
+Fiber::~Fiber() {
+    if (m_stack) {
+        --s_fiber_count;
+        //跑到一半的协程不能析构，栈上的东西还没释放
+        assert(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+        StackAllocator::Dealloc(m_stack, m_stacksize);
+    } else {
+        //主协程
+        assert(!m_cb);
+        assert(m_state == EXEC);
+        if (t_fiber == this) {
+            SetThis(nullptr);
+        }
+    }
+}
+
+void Fiber::reset(std::function<void()> cb) {
+    assert(m_stack);
+    assert(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+    m_cb = cb;
+    initContext();
+    m_state = INIT;
+}
+
+Fiber::State Fiber::resume() {
+    assert(m_stack);
+    //协程在A线程挂到io事件上，还没来得及切走，事件就在B线程触发了，C线程来resume它；
+    //等A线程那边真正切走(寄存器都保存好)再跑，切走只要几十纳秒
+    while (m_running.exchange(true, std::memory_order_acquire)) {
+#if defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif
+    }
+    assert(m_state != EXEC && m_state != TERM && m_state != EXCEPT);
+    //热路径，有当前协程的时候不去动shared_ptr的引用计数
+    Fiber* cur = t_fiber ? t_fiber : GetThis().get();
+    m_prev = cur;
+    SetThis(this);
+    m_state = EXEC;
+    SwitchContext(cur, this);
+    //状态要在放开m_running之前取: 放开之后HOLD的协程可能马上被别的线程resume，状态又变了
+    State state = m_state;
+    //回到这里说明这个协程已经切回来了，别的线程可以resume它了
+    m_running.store(false, std::memory_order_release);
+    return state;
+}
+
+void Fiber::yield() {
+    assert(t_fiber == this && m_prev);
+    if (m_state == EXEC) {
+        m_state = HOLD;
+    }
+    Fiber* prev = m_prev;
+    m_prev = nullptr;
+    SetThis(prev);
+    SwitchContext(this, prev);
+}
+
+void Fiber::SetThis(Fiber* f) {
+    t_fiber = f;
+}
+
+Fiber::ptr Fiber::GetThis() {
+    if (t_fiber) {
+        return t_fiber->shared_from_this();
+    }
+    Fiber::ptr main_fiber(new Fiber);
+    assert(t_fiber == main_fiber.get());
+    t_thread_fiber = main_fiber;
+    return t_fiber->shared_from_this();
+}
+
+void Fiber::YieldToReady() {
+    Fiber* cur = t_fiber;
+    assert(cur);
+    cur->m_state = READY;
+    cur->yield();
+}
+
+void Fiber::YieldToHold() {
+    Fiber* cur = t_fiber;
+    assert(cur);
+    cur->m_state = HOLD;
+    cur->yield();
+}
+
+uint64_t Fiber::TotalFibers() {
+    return s_fiber_count;
+}
+
+uint64_t Fiber::GetFiberId() {
+    return t_fiber ? t_fiber->getId() : 0;
+}
+
+void Fiber::MainFunc() {
+    Fiber::ptr cur = GetThis();
+    assert(cur);
+    try {
+        cur->m_cb();
+        cur->m_cb = nullptr;
+        cur->m_state = TERM;
+    } catch (std::exception& e) {
+        cur->m_cb = nullptr;
+        cur->m_state = EXCEPT;
+        CHPE_LOG_ERROR(g_logger) << "Fiber except: " << e.what() << " fiber_id=" << cur->getId();
+    } catch (...) {
+        cur->m_cb = nullptr;
+        cur->m_state = EXCEPT;
+        CHPE_LOG_ERROR(g_logger) << "Fiber except, fiber_id=" << cur->getId();
+    }
+
+    //不能带着自己的引用切走，不然这个协程永远释放不了
+    Fiber* raw = cur.get();
+    cur.reset();
+    raw->yield();
+    assert(false && "never reach fiber_id");
+}
+
+}
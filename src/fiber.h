@@ -0,0 +1,88 @@
+#ifndef __FIBER_H__
+#define __FIBER_H__
+
+#include <memory>
+#include <functional>
+#include <atomic>
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+#include <stdint.h>
+
+namespace cpp_high_perf {
+
+//协程，有自己的栈，在用户态切换上下文
+//x86-64上用自己写的汇编切换，只保存callee-saved寄存器，不像swapcontext那样每次都要系统调用设置信号掩码；
+//别的平台退回ucontext
+//resume从当前协程切到这个协程，yield切回resume它的那个协程，所以可以一层套一层(线程主协程 -> 调度协程 -> 任务协程)
+//每个线程第一次调用GetThis的时候会把线程本身包装成主协程，主协程没有自己的栈
+class Fiber : public std::enable_shared_from_this<Fiber> {
+public:
+    typedef std::shared_ptr<Fiber> ptr;
+
+    enum State {
+        INIT,   //刚创建或者reset过，还没跑
+        READY,  //让出了，等着马上再被调度
+        HOLD,   //让出了，等着别的东西(io/定时器)把它叫醒
+        EXEC,   //正在跑
+        TERM,   //回调跑完了
+        EXCEPT  //回调抛了异常
+    };
+private:
+    //线程的主协程，只能通过GetThis创建
+    Fiber();
+public:
+    //stacksize为0的时候用配置fiber.stack_size
+    Fiber(std::function<void()> cb, size_t stacksize = 0);
+    ~Fiber();
+
+    //跑完了的协程换个回调接着用，栈不用重新分配
+    void reset(std::function<void()> cb);
+    //切到这个协程去跑，回来的时候是它yield了或者跑完了
+    //返回切回来那一刻的状态；返回之后协程可能已经在别的线程跑了，不要再用getState判断
+    State resume();
+    //切回resume我的那个协程，必须是当前正在跑的协程调用
+    void yield();
+
+    uint64_t getId() const { return m_id; }
+    State getState() const { return m_state; }
+    void setState(State s) { m_state = s; }
+    size_t getStackSize() const { return m_stacksize; }
+    bool isFinished() const { return m_state == TERM || m_state == EXCEPT; }
+
+public:
+    //设置当前线程正在跑的协程
+    static void SetThis(Fiber* f);
+    //当前线程正在跑的协程，没有的话先创建主协程
+    static Fiber::ptr GetThis();
+    //当前协程让出，状态改成READY/HOLD
+    static void YieldToReady();
+    static void YieldToHold();
+    //现在有多少个协程(不算主协程)
+    static uint64_t TotalFibers();
+    //当前协程的id，没有协程或者是主协程的时候是0
+    static uint64_t GetFiberId();
+
+private:
+    static void MainFunc();
+    //在栈上准备好第一次切进来的上下文，切进来就从MainFunc开始跑
+    void initContext();
+    static void SwitchContext(Fiber* from, Fiber* to);
+private:
+    uint64_t m_id = 0;
+    size_t m_stacksize = 0;//可以用的栈大小，不算保护页
+    State m_state = INIT;
+#if defined(__x86_64__)
+    void* m_sp = nullptr;//切走的时候寄存器都压在自己栈上，只用记住栈顶
+#else
+    ucontext_t m_ctx;
+#endif
+    void* m_stack = nullptr;//mmap出来的整块内存，最低的一页是保护页
+    Fiber* m_prev = nullptr;//resume我的协程，yield的时候切回去
+    std::atomic<bool> m_running{false};//resume到切回来之间是true，防止两个线程同时跑一个协程
+    std::function<void()> m_cb;
+};
+
+}
+
+#endif
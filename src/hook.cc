@@ -0,0 +1,522 @@
+#include "hook.h"
+#include "fd_manager.h"
+#include "iomanager.h"
+#include "config.h"
+#include "log.h"
+#include <atomic>
+#include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static ConfigVar<int>::ptr g_tcp_connect_timeout =
+    Config::lookup<int>("tcp.connect.timeout", 5000, "tcp connect timeout(ms)");
+
+static thread_local bool t_hook_enable = false;
+
+#define HOOK_FUN(XX) \
+    XX(sleep) \
+    XX(usleep) \
+    XX(nanosleep) \
+    XX(socket) \
+    XX(connect) \
+    XX(accept) \
+    XX(accept4) \
+    XX(read) \
+    XX(readv) \
+    XX(recv) \
+    XX(recvfrom) \
+    XX(recvmsg) \
+    XX(write) \
+    XX(writev) \
+    XX(send) \
+    XX(sendto) \
+    XX(sendmsg) \
+    XX(close) \
+    XX(fcntl) \
+    XX(ioctl) \
+    XX(getsockopt) \
+    XX(setsockopt)
+
+static void hook_init() {
+    static bool is_inited = false;
+    if (is_inited) {
+        return;
+    }
+#define XX(name) name ## _f = (name ## _fun)dlsym(RTLD_NEXT, #name);
+    HOOK_FUN(XX);
+#undef XX
+    is_inited = true;
+}
+
+//原来的函数指针要在所有别的静态变量初始化之前拿到，别的静态初始化里可能就会写日志
+struct HookIniter {
+    HookIniter() {
+        hook_init();
+    }
+};
+
+static HookIniter s_hook_initer __attribute__((init_priority(101)));
+
+//配置的connect超时，每次connect都去读配置太慢，缓存成原子变量
+static std::atomic<uint64_t> s_connect_timeout{~0ull};
+
+struct HookConfigIniter {
+    HookConfigIniter() {
+        s_connect_timeout = g_tcp_connect_timeout->getValue();
+        g_tcp_connect_timeout->addListener([](const int& old_value, const int& new_value) {
+            CHPE_LOG_INFO(g_logger) << "tcp connect timeout changed from "
+                << old_value << " to " << new_value;
+            s_connect_timeout = new_value;
+        });
+    }
+};
+
+static HookConfigIniter s_hook_config_initer;
+
+bool is_hook_enable() {
+    return t_hook_enable;
+}
+
+void set_hook_enable(bool flag) {
+    t_hook_enable = flag;
+}
+
+//当前能不能把协程挂起来等: 要在IOManager的线程里，而且不是线程的主协程
+static IOManager* GetYieldableIOManager() {
+    if (Fiber::GetFiberId() == 0) {
+        return nullptr;
+    }
+    return IOManager::GetThis();
+}
+
+}
+
+//定时器超时的时候置上cancelled，被叫醒的协程看到就知道是超时了
+struct timer_info {
+    int cancelled = 0;
+};
+
+//不在IOManager里，socket又被设成了非阻塞，用poll模拟阻塞
+static int wait_fd_without_iom(int fd, uint32_t event, uint64_t timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = event == cpp_high_perf::IOManager::READ ? POLLIN : POLLOUT;
+    pfd.revents = 0;
+    int timeout = timeout_ms == ~0ull ? -1 : (int)timeout_ms;
+    int rt = 0;
+    do {
+        rt = poll(&pfd, 1, timeout);
+    } while (rt < 0 && errno == EINTR);
+    if (rt == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    return rt < 0 ? -1 : 0;
+}
+
+template<typename OriginFun, typename... Args>
+static ssize_t do_io(int fd, OriginFun fun, const char* hook_fun_name,
+        uint32_t event, int timeout_so, Args&&... args) {
+    if (!cpp_high_perf::t_hook_enable) {
+        return fun(fd, std::forward<Args>(args)...);
+    }
+
+    cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(fd);
+    if (!ctx) {
+        return fun(fd, std::forward<Args>(args)...);
+    }
+    if (ctx->isClose()) {
+        errno = EBADF;
+        return -1;
+    }
+    if (!ctx->isSocket() || ctx->getUserNonblock()) {
+        return fun(fd, std::forward<Args>(args)...);
+    }
+
+    uint64_t to = ctx->getTimeout(timeout_so);
+    std::shared_ptr<timer_info> tinfo(new timer_info);
+
+retry:
+    ssize_t n = fun(fd, std::forward<Args>(args)...);
+    while (n == -1 && errno == EINTR) {
+        n = fun(fd, std::forward<Args>(args)...);
+    }
+    if (n == -1 && errno == EAGAIN) {
+        cpp_high_perf::IOManager* iom = cpp_high_perf::GetYieldableIOManager();
+        if (!iom) {
+            if (wait_fd_without_iom(fd, event, to)) {
+                return -1;
+            }
+            goto retry;
+        }
+
+        cpp_high_perf::Timer::ptr timer;
+        std::weak_ptr<timer_info> winfo(tinfo);
+        if (to != ~0ull) {
+            timer = iom->addConditionTimer(to, [winfo, fd, iom, event]() {
+                auto t = winfo.lock();
+                if (!t || t->cancelled) {
+                    return;
+                }
+                t->cancelled = ETIMEDOUT;
+                iom->cancelEvent(fd, (cpp_high_perf::IOManager::Event)(event));
+            }, winfo);
+        }
+
+        int rt = iom->addEvent(fd, (cpp_high_perf::IOManager::Event)(event));
+        if (rt) {
+            CHPE_LOG_ERROR(cpp_high_perf::g_logger) << hook_fun_name << " addEvent("
+                << fd << ", " << event << ") fail";
+            if (timer) {
+                timer->cancel();
+            }
+            return -1;
+        }
+        cpp_high_perf::Fiber::YieldToHold();
+        if (timer) {
+            timer->cancel();
+        }
+        if (tinfo->cancelled) {
+            errno = tinfo->cancelled;
+            return -1;
+        }
+        goto retry;
+    }
+    return n;
+}
+
+//挂一个定时器把自己叫醒，然后让出
+static bool fiber_sleep(uint64_t ms) {
+    cpp_high_perf::IOManager* iom = cpp_high_perf::GetYieldableIOManager();
+    if (!iom) {
+        return false;
+    }
+    cpp_high_perf::Fiber::ptr fiber = cpp_high_perf::Fiber::GetThis();
+    iom->addTimer(ms, [iom, fiber]() {
+        iom->schedule(fiber);
+    });
+    cpp_high_perf::Fiber::YieldToHold();
+    return true;
+}
+
+extern "C" {
+#define XX(name) name ## _fun name ## _f = nullptr;
+    HOOK_FUN(XX);
+#undef XX
+
+unsigned int sleep(unsigned int seconds) {
+    if (!cpp_high_perf::t_hook_enable || !fiber_sleep((uint64_t)seconds * 1000)) {
+        return sleep_f(seconds);
+    }
+    return 0;
+}
+
+int usleep(useconds_t usec) {
+    if (!cpp_high_perf::t_hook_enable || !fiber_sleep(usec / 1000)) {
+        return usleep_f(usec);
+    }
+    return 0;
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem) {
+    if (!cpp_high_perf::t_hook_enable
+            || !fiber_sleep((uint64_t)req->tv_sec * 1000 + req->tv_nsec / 1000 / 1000)) {
+        return nanosleep_f(req, rem);
+    }
+    return 0;
+}
+
+int socket(int domain, int type, int protocol) {
+    int fd = socket_f(domain, type, protocol);
+    if (!cpp_high_perf::t_hook_enable || fd == -1) {
+        return fd;
+    }
+    cpp_high_perf::FdMgr::GetInstance()->get(fd, true);
+    return fd;
+}
+
+int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen, uint64_t timeout_ms) {
+    if (!cpp_high_perf::t_hook_enable) {
+        return connect_f(fd, addr, addrlen);
+    }
+    cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(fd);
+    if (!ctx) {
+        return connect_f(fd, addr, addrlen);
+    }
+    if (ctx->isClose()) {
+        errno = EBADF;
+        return -1;
+    }
+    if (!ctx->isSocket() || ctx->getUserNonblock()) {
+        return connect_f(fd, addr, addrlen);
+    }
+
+    int n = connect_f(fd, addr, addrlen);
+    if (n == 0) {
+        return 0;
+    } else if (n != -1 || errno != EINPROGRESS) {
+        return n;
+    }
+
+    cpp_high_perf::IOManager* iom = cpp_high_perf::GetYieldableIOManager();
+    if (!iom) {
+        if (wait_fd_without_iom(fd, cpp_high_perf::IOManager::WRITE, timeout_ms)) {
+            return -1;
+        }
+    } else {
+        cpp_high_perf::Timer::ptr timer;
+        std::shared_ptr<timer_info> tinfo(new timer_info);
+        std::weak_ptr<timer_info> winfo(tinfo);
+        if (timeout_ms != ~0ull) {
+            timer = iom->addConditionTimer(timeout_ms, [winfo, fd, iom]() {
+                auto t = winfo.lock();
+                if (!t || t->cancelled) {
+                    return;
+                }
+                t->cancelled = ETIMEDOUT;
+                iom->cancelEvent(fd, cpp_high_perf::IOManager::WRITE);
+            }, winfo);
+        }
+
+        int rt = iom->addEvent(fd, cpp_high_perf::IOManager::WRITE);
+        if (rt == 0) {
+            cpp_high_perf::Fiber::YieldToHold();
+            if (timer) {
+                timer->cancel();
+            }
+            if (tinfo->cancelled) {
+                errno = tinfo->cancelled;
+                return -1;
+            }
+        } else {
+            if (timer) {
+                timer->cancel();
+            }
+            CHPE_LOG_ERROR(cpp_high_perf::g_logger) << "connect addEvent(" << fd << ", WRITE) error";
+        }
+    }
+
+    int error = 0;
+    socklen_t len = sizeof(int);
+    if (-1 == getsockopt_f(fd, SOL_SOCKET, SO_ERROR, &error, &len)) {
+        return -1;
+    }
+    if (!error) {
+        return 0;
+    }
+    errno = error;
+    return -1;
+}
+
+int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen) {
+    return connect_with_timeout(sockfd, addr, addrlen, cpp_high_perf::s_connect_timeout);
+}
+
+int accept(int s, struct sockaddr* addr, socklen_t* addrlen) {
+    int fd = do_io(s, accept_f, "accept", cpp_high_perf::IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+    if (fd >= 0 && cpp_high_perf::t_hook_enable) {
+        cpp_high_perf::FdMgr::GetInstance()->get(fd, true);
+    }
+    return fd;
+}
+
+int accept4(int s, struct sockaddr* addr, socklen_t* addrlen, int flags) {
+    int fd = do_io(s, accept4_f, "accept4", cpp_high_perf::IOManager::READ, SO_RCVTIMEO, addr, addrlen, flags);
+    if (fd >= 0 && cpp_high_perf::t_hook_enable) {
+        cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(fd, true);
+        //用户自己要的非阻塞，和fcntl设的一样对待
+        if (ctx && (flags & SOCK_NONBLOCK)) {
+            ctx->setUserNonblock(true);
+        }
+    }
+    return fd;
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+    return do_io(fd, read_f, "read", cpp_high_perf::IOManager::READ, SO_RCVTIMEO, buf, count);
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
+    return do_io(fd, readv_f, "readv", cpp_high_perf::IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
+}
+
+ssize_t recv(int sockfd, void* buf, size_t len, int flags) {
+    return do_io(sockfd, recv_f, "recv", cpp_high_perf::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+}
+
+ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags, struct sockaddr* src_addr, socklen_t* addrlen) {
+    return do_io(sockfd, recvfrom_f, "recvfrom", cpp_high_perf::IOManager::READ, SO_RCVTIMEO,
+            buf, len, flags, src_addr, addrlen);
+}
+
+ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) {
+    return do_io(sockfd, recvmsg_f, "recvmsg", cpp_high_perf::IOManager::READ, SO_RCVTIMEO, msg, flags);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+    return do_io(fd, write_f, "write", cpp_high_perf::IOManager::WRITE, SO_SNDTIMEO, buf, count);
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+    return do_io(fd, writev_f, "writev", cpp_high_perf::IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
+}
+
+ssize_t send(int s, const void* msg, size_t len, int flags) {
+    return do_io(s, send_f, "send", cpp_high_perf::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags);
+}
+
+ssize_t sendto(int s, const void* msg, size_t len, int flags, const struct sockaddr* to, socklen_t tolen) {
+    return do_io(s, sendto_f, "sendto", cpp_high_perf::IOManager::WRITE, SO_SNDTIMEO,
+            msg, len, flags, to, tolen);
+}
+
+ssize_t sendmsg(int s, const struct msghdr* msg, int flags) {
+    return do_io(s, sendmsg_f, "sendmsg", cpp_high_perf::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
+}
+
+int close(int fd) {
+    //不管hook开没开，fd关掉了上下文都要删，不然fd号被复用的时候拿到的是旧的
+    cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(fd);
+    if (ctx) {
+        auto iom = cpp_high_perf::IOManager::GetThis();
+        if (iom) {
+            iom->cancelAll(fd);
+        }
+        cpp_high_perf::FdMgr::GetInstance()->del(fd);
+    }
+    return close_f(fd);
+}
+
+int fcntl(int fd, int cmd, ... /* arg */ ) {
+    va_list va;
+    va_start(va, cmd);
+    switch (cmd) {
+        case F_SETFL:
+            {
+                int arg = va_arg(va, int);
+                va_end(va);
+                cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(fd);
+                if (!ctx || ctx->isClose() || !ctx->isSocket()) {
+                    return fcntl_f(fd, cmd, arg);
+                }
+                //用户要的阻塞标志记下来，系统层面保持hook需要的
+                ctx->setUserNonblock(arg & O_NONBLOCK);
+                if (ctx->getSysNonblock()) {
+                    arg |= O_NONBLOCK;
+                } else {
+                    arg &= ~O_NONBLOCK;
+                }
+                return fcntl_f(fd, cmd, arg);
+            }
+            break;
+        case F_GETFL:
+            {
+                va_end(va);
+                int arg = fcntl_f(fd, cmd);
+                cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(fd);
+                if (arg == -1 || !ctx || ctx->isClose() || !ctx->isSocket()) {
+                    return arg;
+                }
+                if (ctx->getUserNonblock()) {
+                    return arg | O_NONBLOCK;
+                } else {
+                    return arg & ~O_NONBLOCK;
+                }
+            }
+            break;
+        case F_DUPFD:
+        case F_DUPFD_CLOEXEC:
+        case F_SETFD:
+        case F_SETOWN:
+        case F_SETSIG:
+        case F_SETLEASE:
+        case F_NOTIFY:
+#ifdef F_SETPIPE_SZ
+        case F_SETPIPE_SZ:
+#endif
+            {
+                int arg = va_arg(va, int);
+                va_end(va);
+                return fcntl_f(fd, cmd, arg);
+            }
+            break;
+        case F_GETFD:
+        case F_GETOWN:
+        case F_GETSIG:
+        case F_GETLEASE:
+#ifdef F_GETPIPE_SZ
+        case F_GETPIPE_SZ:
+#endif
+            {
+                va_end(va);
+                return fcntl_f(fd, cmd);
+            }
+            break;
+        case F_SETLK:
+        case F_SETLKW:
+        case F_GETLK:
+            {
+                struct flock* arg = va_arg(va, struct flock*);
+                va_end(va);
+                return fcntl_f(fd, cmd, arg);
+            }
+            break;
+        case F_GETOWN_EX:
+        case F_SETOWN_EX:
+            {
+                struct f_owner_ex* arg = va_arg(va, struct f_owner_ex*);
+                va_end(va);
+                return fcntl_f(fd, cmd, arg);
+            }
+            break;
+        default:
+            va_end(va);
+            return fcntl_f(fd, cmd);
+    }
+}
+
+int ioctl(int d, unsigned long int request, ...) {
+    va_list va;
+    va_start(va, request);
+    void* arg = va_arg(va, void*);
+    va_end(va);
+
+    if (FIONBIO == request) {
+        bool user_nonblock = !!*(int*)arg;
+        cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(d);
+        if (!ctx || ctx->isClose() || !ctx->isSocket()) {
+            return ioctl_f(d, request, arg);
+        }
+        //和fcntl一样，只记用户要的，系统层面不变
+        ctx->setUserNonblock(user_nonblock);
+        return 0;
+    }
+    return ioctl_f(d, request, arg);
+}
+
+int getsockopt(int sockfd, int level, int optname, void* optval, socklen_t* optlen) {
+    return getsockopt_f(sockfd, level, optname, optval, optlen);
+}
+
+int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen) {
+    if (!cpp_high_perf::t_hook_enable) {
+        return setsockopt_f(sockfd, level, optname, optval, optlen);
+    }
+    if (level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO)) {
+        cpp_high_perf::FdCtx::ptr ctx = cpp_high_perf::FdMgr::GetInstance()->get(sockfd);
+        if (ctx) {
+            const timeval* v = (const timeval*)optval;
+            uint64_t ms = v->tv_sec * 1000 + v->tv_usec / 1000;
+            //0表示不超时
+            ctx->setTimeout(optname, ms ? ms : ~0ull);
+        }
+    }
+    return setsockopt_f(sockfd, level, optname, optval, optlen);
+}
+
+}
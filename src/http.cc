@@ -0,0 +1,298 @@
+#include "http.h"
+#include "util.h"
+#include <sstream>
+
+namespace cpp_high_perf {
+
+HttpMethod StringToHttpMethod(StringView m) {
+#define XX(num, name, string) \
+    if (m == #string) { \
+        return HttpMethod::name; \
+    }
+    HTTP_METHOD_MAP(XX);
+#undef XX
+    return HttpMethod::INVALID_METHOD;
+}
+
+static const char* s_method_string[] = {
+#define XX(num, name, string) #string,
+    HTTP_METHOD_MAP(XX)
+#undef XX
+};
+
+const char* HttpMethodToString(HttpMethod m) {
+    uint32_t idx = (uint32_t)m;
+    if (idx >= (sizeof(s_method_string) / sizeof(s_method_string[0]))) {
+        return "<unknown>";
+    }
+    return s_method_string[idx];
+}
+
+const char* HttpStatusToString(HttpStatus s) {
+    switch (s) {
+#define XX(code, name, msg) \
+        case HttpStatus::name: \
+            return #msg;
+        HTTP_STATUS_MAP(XX);
+#undef XX
+        default:
+            return "<unknown>";
+    }
+}
+
+bool HttpStatusAllowsBody(HttpStatus s) {
+    int code = (int)s;
+    return code / 100 != 1 && code != 204 && code != 304;
+}
+
+//整数直接写进字符串，不走ostream
+static void AppendUint(std::string& out, uint64_t v) {
+    char buf[24];
+    out.append(buf, Uint64ToStr(buf, v));
+}
+
+//头名字对上了的时候跳过，自己会写的几个头
+static bool IsFramingHeader(StringView key) {
+    return key.equalsIgnoreCase("content-length")
+        || key.equalsIgnoreCase("connection")
+        || key.equalsIgnoreCase("transfer-encoding");
+}
+
+static void AppendHeaders(std::string& out, const HttpHeaders& headers) {
+    for (auto& i : headers.items()) {
+        if (IsFramingHeader(i.first)) {
+            continue;
+        }
+        out.append(i.first.data(), i.first.size());
+        out.append(": ", 2);
+        out.append(i.second.data(), i.second.size());
+        out.append("\r\n", 2);
+    }
+}
+
+StringView HttpHeaders::own(StringView v) {
+    m_owned.push_back(v.toString());
+    return StringView(m_owned.back());
+}
+
+void HttpHeaders::set(StringView key, StringView val) {
+    for (auto& i : m_items) {
+        if (i.first.equalsIgnoreCase(key)) {
+            i.second = own(val);
+            return;
+        }
+    }
+    StringView k = own(key);
+    m_items.push_back(Item(k, own(val)));
+}
+
+void HttpHeaders::del(StringView key) {
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        if (it->first.equalsIgnoreCase(key)) {
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+const HttpHeaders::Item* HttpHeaders::find(StringView key) const {
+    for (auto& i : m_items) {
+        if (i.first.equalsIgnoreCase(key)) {
+            return &i;
+        }
+    }
+    return nullptr;
+}
+
+StringView HttpHeaders::get(StringView key, StringView def) const {
+    const Item* item = find(key);
+    return item ? item->second : def;
+}
+
+void HttpHeaders::clear() {
+    m_items.clear();
+    m_owned.clear();
+}
+
+void HttpHeaders::detach() {
+    std::deque<std::string> owned;
+    for (auto& i : m_items) {
+        owned.push_back(i.first.toString());
+        i.first = StringView(owned.back());
+        owned.push_back(i.second.toString());
+        i.second = StringView(owned.back());
+    }
+    m_owned.swap(owned);
+}
+
+HttpRequest::HttpRequest(uint8_t version, bool close)
+    :m_method(HttpMethod::GET)
+    ,m_version(version)
+    ,m_close(close)
+    ,m_chunked(false)
+    ,m_contentLength(0)
+    ,m_path("/") {
+}
+
+StringView HttpRequest::own(StringView v) {
+    m_owned.push_back(v.toString());
+    return StringView(m_owned.back());
+}
+
+void HttpRequest::setBody(std::string v) {
+    m_bodyStorage.swap(v);
+    m_body = StringView(m_bodyStorage);
+}
+
+StringView HttpRequest::getParam(StringView key, StringView def) const {
+    //a=1&b=2，一个个比过去
+    size_t pos = 0;
+    while (pos <= m_query.size()) {
+        size_t end = m_query.find('&', pos);
+        if (end == StringView::npos) {
+            end = m_query.size();
+        }
+        StringView kv = m_query.substr(pos, end - pos);
+        size_t eq = kv.find('=');
+        if (kv.substr(0, eq) == key) {
+            return eq == StringView::npos ? StringView() : kv.substr(eq + 1);
+        }
+        pos = end + 1;
+    }
+    return def;
+}
+
+void HttpRequest::detach() {
+    std::deque<std::string> owned;
+    owned.push_back(m_path.toString());
+    m_path = StringView(owned.back());
+    owned.push_back(m_query.toString());
+    m_query = StringView(owned.back());
+    owned.push_back(m_fragment.toString());
+    m_fragment = StringView(owned.back());
+    m_owned.swap(owned);
+    if (m_body.data() != m_bodyStorage.data()) {
+        setBody(m_body.toString());
+    }
+    m_headers.detach();
+}
+
+void HttpRequest::encodeHead(std::string& out) const {
+    out.append(HttpMethodToString(m_method));
+    out.push_back(' ');
+    out.append(m_path.data(), m_path.size());
+    if (!m_query.empty()) {
+        out.push_back('?');
+        out.append(m_query.data(), m_query.size());
+    }
+    if (!m_fragment.empty()) {
+        out.push_back('#');
+        out.append(m_fragment.data(), m_fragment.size());
+    }
+    out.append(" HTTP/");
+    out.push_back('0' + (m_version >> 4));
+    out.push_back('.');
+    out.push_back('0' + (m_version & 0x0F));
+    out.append("\r\n");
+    out.append(m_close ? "connection: close\r\n" : "connection: keep-alive\r\n");
+    AppendHeaders(out, m_headers);
+    if (!m_body.empty()) {
+        out.append("content-length: ");
+        AppendUint(out, m_body.size());
+        out.append("\r\n");
+    }
+    out.append("\r\n");
+}
+
+std::ostream& HttpRequest::dump(std::ostream& os) const {
+    std::string head;
+    encodeHead(head);
+    return os << head << m_body;
+}
+
+std::string HttpRequest::toString() const {
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+HttpResponse::HttpResponse(uint8_t version, bool close)
+    :m_status(HttpStatus::OK)
+    ,m_version(version)
+    ,m_close(close)
+    ,m_chunked(false)
+    ,m_headOnly(false)
+    ,m_contentLength(0) {
+}
+
+StringView HttpResponse::own(StringView v) {
+    m_owned.push_back(v.toString());
+    return StringView(m_owned.back());
+}
+
+void HttpResponse::setBody(std::string v) {
+    m_bodyStorage.swap(v);
+    m_body = StringView(m_bodyStorage);
+}
+
+void HttpResponse::detach() {
+    std::deque<std::string> owned;
+    owned.push_back(m_reason.toString());
+    m_reason = StringView(owned.back());
+    m_owned.swap(owned);
+    if (m_body.data() != m_bodyStorage.data()) {
+        setBody(m_body.toString());
+    }
+    m_headers.detach();
+}
+
+void HttpResponse::encodeHead(std::string& out) const {
+    out.append("HTTP/");
+    out.push_back('0' + (m_version >> 4));
+    out.push_back('.');
+    out.push_back('0' + (m_version & 0x0F));
+    out.push_back(' ');
+    AppendUint(out, (uint64_t)m_status);
+    out.push_back(' ');
+    if (m_reason.empty()) {
+        out.append(HttpStatusToString(m_status));
+    } else {
+        out.append(m_reason.data(), m_reason.size());
+    }
+    out.append("\r\n");
+    out.append(m_close ? "connection: close\r\n" : "connection: keep-alive\r\n");
+    AppendHeaders(out, m_headers);
+    if (HttpStatusAllowsBody(m_status)) {
+        out.append("content-length: ");
+        AppendUint(out, m_body.size());
+        out.append("\r\n");
+    }
+    out.append("\r\n");
+}
+
+std::ostream& HttpResponse::dump(std::ostream& os) const {
+    std::string head;
+    encodeHead(head);
+    os << head;
+    if (isBodySent()) {
+        os << m_body;
+    }
+    return os;
+}
+
+std::string HttpResponse::toString() const {
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req) {
+    return req.dump(os);
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp) {
+    return rsp.dump(os);
+}
+
+}
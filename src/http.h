@@ -0,0 +1,257 @@
+#ifndef __HTTP_H__
+#define __HTTP_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <ostream>
+#include <stdint.h>
+#include "string_view.h"
+
+namespace cpp_high_perf {
+
+#define HTTP_METHOD_MAP(XX)         \
+  XX(0,  DELETE,      DELETE)       \
+  XX(1,  GET,         GET)          \
+  XX(2,  HEAD,        HEAD)         \
+  XX(3,  POST,        POST)         \
+  XX(4,  PUT,         PUT)          \
+  XX(5,  CONNECT,     CONNECT)      \
+  XX(6,  OPTIONS,     OPTIONS)      \
+  XX(7,  TRACE,       TRACE)        \
+  XX(8,  PATCH,       PATCH)
+
+#define HTTP_STATUS_MAP(XX)                                                 \
+  XX(100, CONTINUE,                        Continue)                        \
+  XX(101, SWITCHING_PROTOCOLS,             Switching Protocols)             \
+  XX(200, OK,                              OK)                              \
+  XX(201, CREATED,                         Created)                         \
+  XX(202, ACCEPTED,                        Accepted)                        \
+  XX(204, NO_CONTENT,                      No Content)                      \
+  XX(206, PARTIAL_CONTENT,                 Partial Content)                 \
+  XX(301, MOVED_PERMANENTLY,               Moved Permanently)               \
+  XX(302, FOUND,                           Found)                           \
+  XX(304, NOT_MODIFIED,                    Not Modified)                    \
+  XX(307, TEMPORARY_REDIRECT,              Temporary Redirect)              \
+  XX(400, BAD_REQUEST,                     Bad Request)                     \
+  XX(401, UNAUTHORIZED,                    Unauthorized)                    \
+  XX(403, FORBIDDEN,                       Forbidden)                       \
+  XX(404, NOT_FOUND,                       Not Found)                       \
+  XX(405, METHOD_NOT_ALLOWED,              Method Not Allowed)              \
+  XX(408, REQUEST_TIMEOUT,                 Request Timeout)                 \
+  XX(411, LENGTH_REQUIRED,                 Length Required)                 \
+  XX(413, PAYLOAD_TOO_LARGE,               Payload Too Large)               \
+  XX(414, URI_TOO_LONG,                    URI Too Long)                    \
+  XX(431, REQUEST_HEADER_FIELDS_TOO_LARGE, Request Header Fields Too Large) \
+  XX(500, INTERNAL_SERVER_ERROR,           Internal Server Error)           \
+  XX(501, NOT_IMPLEMENTED,                 Not Implemented)                 \
+  XX(502, BAD_GATEWAY,                     Bad Gateway)                     \
+  XX(503, SERVICE_UNAVAILABLE,             Service Unavailable)             \
+  XX(504, GATEWAY_TIMEOUT,                 Gateway Timeout)                 \
+  XX(505, HTTP_VERSION_NOT_SUPPORTED,      HTTP Version Not Supported)
+
+enum class HttpMethod {
+#define XX(num, name, string) name = num,
+    HTTP_METHOD_MAP(XX)
+#undef XX
+    INVALID_METHOD
+};
+
+enum class HttpStatus {
+#define XX(code, name, desc) name = code,
+    HTTP_STATUS_MAP(XX)
+#undef XX
+};
+
+HttpMethod StringToHttpMethod(StringView m);
+const char* HttpMethodToString(HttpMethod m);
+const char* HttpStatusToString(HttpStatus s);
+//1xx/204/304的响应不能带body，也不能有content-length
+bool HttpStatusAllowsBody(HttpStatus s);
+
+//一组头，名字不区分大小写，按加进来的顺序放
+//值是StringView，解析出来的请求指向连接的缓冲区，一个字节都不拷；
+//自己set进来的会先拷一份放到m_owned里(deque加元素不会让已有元素挪地方)
+//头一般就十来个，线性找比map快，也不用每个头分配一次节点
+class HttpHeaders {
+public:
+    typedef std::pair<StringView, StringView> Item;
+
+    //名字和值都拷一份
+    void set(StringView key, StringView val);
+    //直接引用，调用者保证内存比这个对象活得久(解析器用)
+    void addRef(StringView key, StringView val) { m_items.push_back(Item(key, val)); }
+    void del(StringView key);
+    bool has(StringView key) const { return find(key) != nullptr; }
+    //没有返回def
+    StringView get(StringView key, StringView def = StringView()) const;
+    //没有返回空
+    const Item* find(StringView key) const;
+
+    const std::vector<Item>& items() const { return m_items; }
+    size_t size() const { return m_items.size(); }
+    void clear();
+    void reserve(size_t n) { m_items.reserve(n); }
+
+    //所有引用的内存都拷成自己的，原来的缓冲区之后可以复用
+    void detach();
+private:
+    StringView own(StringView v);
+private:
+    std::vector<Item> m_items;
+    std::deque<std::string> m_owned;
+};
+
+//http请求，解析出来的时候所有字段都指向连接的缓冲区，只在处理这个请求的时候有效
+//要留到之后用的话先detach
+class HttpRequest {
+public:
+    typedef std::shared_ptr<HttpRequest> ptr;
+
+    HttpRequest(uint8_t version = 0x11, bool close = false);
+
+    HttpRequest(const HttpRequest&) = delete;
+    HttpRequest& operator=(const HttpRequest&) = delete;
+
+    HttpMethod getMethod() const { return m_method; }
+    uint8_t getVersion() const { return m_version; }
+    StringView getPath() const { return m_path; }
+    StringView getQuery() const { return m_query; }
+    StringView getFragment() const { return m_fragment; }
+    StringView getBody() const { return m_body; }
+    bool isClose() const { return m_close; }
+    bool isChunked() const { return m_chunked; }
+    uint64_t getContentLength() const { return m_contentLength; }
+    HttpHeaders& getHeaders() { return m_headers; }
+    const HttpHeaders& getHeaders() const { return m_headers; }
+
+    void setMethod(HttpMethod v) { m_method = v; }
+    void setVersion(uint8_t v) { m_version = v; }
+    void setClose(bool v) { m_close = v; }
+    void setChunked(bool v) { m_chunked = v; }
+    void setContentLength(uint64_t v) { m_contentLength = v; }
+
+    //自己设的都拷一份
+    void setPath(StringView v) { m_path = own(v); }
+    void setQuery(StringView v) { m_query = own(v); }
+    void setFragment(StringView v) { m_fragment = own(v); }
+    void setBody(std::string v);
+
+    //解析器用的，直接引用
+    void setPathRef(StringView v) { m_path = v; }
+    void setQueryRef(StringView v) { m_query = v; }
+    void setFragmentRef(StringView v) { m_fragment = v; }
+    void setBodyRef(StringView v) { m_body = v; }
+    //body太大放不进连接缓冲区的时候直接读进这里
+    std::string& bodyStorage() { return m_bodyStorage; }
+
+    StringView getHeader(StringView key, StringView def = StringView()) const {
+        return m_headers.get(key, def);
+    }
+    void setHeader(StringView key, StringView val) { m_headers.set(key, val); }
+    void delHeader(StringView key) { m_headers.del(key); }
+    bool hasHeader(StringView key) const { return m_headers.has(key); }
+
+    //查询参数，没有返回def，不做url解码
+    StringView getParam(StringView key, StringView def = StringView()) const;
+
+    //所有引用的内存都拷成自己的
+    void detach();
+
+    //请求行和头(带最后的空行)追加到out，有body的话按body的长度写Content-Length
+    void encodeHead(std::string& out) const;
+    std::ostream& dump(std::ostream& os) const;
+    std::string toString() const;
+private:
+    StringView own(StringView v);
+private:
+    HttpMethod m_method;
+    uint8_t m_version;//0x11是HTTP/1.1
+    bool m_close;
+    bool m_chunked;
+    uint64_t m_contentLength;
+    StringView m_path;
+    StringView m_query;
+    StringView m_fragment;
+    StringView m_body;
+    HttpHeaders m_headers;
+    std::string m_bodyStorage;
+    std::deque<std::string> m_owned;
+};
+
+//http响应，解析出来的时候和请求一样指向连接的缓冲区
+class HttpResponse {
+public:
+    typedef std::shared_ptr<HttpResponse> ptr;
+
+    HttpResponse(uint8_t version = 0x11, bool close = false);
+
+    HttpResponse(const HttpResponse&) = delete;
+    HttpResponse& operator=(const HttpResponse&) = delete;
+
+    HttpStatus getStatus() const { return m_status; }
+    uint8_t getVersion() const { return m_version; }
+    StringView getReason() const { return m_reason; }
+    StringView getBody() const { return m_body; }
+    bool isClose() const { return m_close; }
+    bool isChunked() const { return m_chunked; }
+    uint64_t getContentLength() const { return m_contentLength; }
+    HttpHeaders& getHeaders() { return m_headers; }
+    const HttpHeaders& getHeaders() const { return m_headers; }
+    //HEAD请求的响应: content-length照body的长度写，body不发
+    bool isHeadOnly() const { return m_headOnly; }
+    //body要不要跟在头后面发出去
+    bool isBodySent() const { return !m_headOnly && HttpStatusAllowsBody(m_status); }
+
+    void setStatus(HttpStatus v) { m_status = v; }
+    void setHeadOnly(bool v) { m_headOnly = v; }
+    void setVersion(uint8_t v) { m_version = v; }
+    void setClose(bool v) { m_close = v; }
+    void setChunked(bool v) { m_chunked = v; }
+    void setContentLength(uint64_t v) { m_contentLength = v; }
+    //为空的时候用状态码对应的默认描述
+    void setReason(StringView v) { m_reason = own(v); }
+    void setBody(std::string v);
+
+    //解析器用的，直接引用
+    void setReasonRef(StringView v) { m_reason = v; }
+    void setBodyRef(StringView v) { m_body = v; }
+    std::string& bodyStorage() { return m_bodyStorage; }
+
+    StringView getHeader(StringView key, StringView def = StringView()) const {
+        return m_headers.get(key, def);
+    }
+    void setHeader(StringView key, StringView val) { m_headers.set(key, val); }
+    void delHeader(StringView key) { m_headers.del(key); }
+    bool hasHeader(StringView key) const { return m_headers.has(key); }
+
+    void detach();
+
+    //状态行和头(带最后的空行)追加到out，Content-Length按body的长度写(1xx/204/304不写)，
+    //body不在里面，发的时候和body分成两个iovec
+    void encodeHead(std::string& out) const;
+    std::ostream& dump(std::ostream& os) const;
+    std::string toString() const;
+private:
+    StringView own(StringView v);
+private:
+    HttpStatus m_status;
+    uint8_t m_version;
+    bool m_close;
+    bool m_chunked;
+    bool m_headOnly;
+    uint64_t m_contentLength;
+    StringView m_reason;
+    StringView m_body;
+    HttpHeaders m_headers;
+    std::string m_bodyStorage;
+    std::deque<std::string> m_owned;
+};
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req);
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp);
+
+}
+
+#endif
@@ -0,0 +1,456 @@
+#include "http_connection.h"
+#include "config.h"
+#include "hook.h"
+#include "iomanager.h"
+#include "util.h"
+#include "log.h"
+#include <sstream>
+#include <limits.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static ConfigVar<uint32_t>::ptr g_http_connection_pool_max_size =
+    Config::lookup<uint32_t>("http.connection_pool.max_size", 32, "http connection pool max idle connections per host");
+
+static ConfigVar<uint64_t>::ptr g_http_connection_pool_max_idle_time =
+    Config::lookup<uint64_t>("http.connection_pool.max_idle_time", 30 * 1000, "http connection pool max idle time(ms)");
+
+static ConfigVar<uint32_t>::ptr g_http_connection_pool_max_request =
+    Config::lookup<uint32_t>("http.connection_pool.max_request", 1000, "http connection pool max requests per connection");
+
+static ConfigVar<uint64_t>::ptr g_http_connection_pool_stats_interval =
+    Config::lookup<uint64_t>("http.connection_pool.stats_interval", 60 * 1000, "http connection pool stats log interval(ms), 0 means no log");
+
+//每次放回连接的时候都要看，缓存成原子变量
+static std::atomic<uint64_t> s_stats_interval{60 * 1000};
+
+struct HttpConnectionPoolConfigIniter {
+    HttpConnectionPoolConfigIniter() {
+        s_stats_interval = g_http_connection_pool_stats_interval->getValue();
+        g_http_connection_pool_stats_interval->addListener([](const uint64_t&, const uint64_t& new_value) {
+            CHPE_LOG_INFO(g_logger) << "http connection pool stats interval changed to " << new_value;
+            s_stats_interval = new_value;
+        });
+    }
+};
+
+static HttpConnectionPoolConfigIniter s_http_connection_pool_config_initer;
+
+static const char* HttpResultErrorToString(HttpResult::Error e) {
+    switch (e) {
+#define XX(name) \
+        case HttpResult::Error::name: \
+            return #name;
+        XX(OK);
+        XX(INVALID_URL);
+        XX(INVALID_HOST);
+        XX(CONNECT_FAIL);
+        XX(SEND_FAIL);
+        XX(RECV_FAIL);
+        XX(INVALID_RESPONSE);
+#undef XX
+        default:
+            return "UNKNOWN";
+    }
+}
+
+std::string HttpResult::toString() const {
+    std::stringstream ss;
+    ss << "[HttpResult result=" << HttpResultErrorToString(result)
+       << " error=" << error
+       << " response=" << (response ? response->toString() : "nullptr")
+       << "]";
+    return ss.str();
+}
+
+HttpConnection::HttpConnection(Socket::ptr sock, size_t buffer_size)
+    :HttpStream(sock, buffer_size ? buffer_size : HttpResponseParser::GetHttpResponseBufferSize())
+    ,m_createTime(GetMonotonicMS())
+    ,m_lastActiveTime(m_createTime) {
+}
+
+bool HttpConnection::sendRequest(HttpRequest::ptr req) {
+    ++m_requestCount;
+    m_reusable = false;
+    m_out.clear();
+    req->encodeHead(m_out);
+    iovec iovs[2];
+    iovs[0].iov_base = &m_out[0];
+    iovs[0].iov_len = m_out.size();
+    StringView body = req->getBody();
+    iovs[1].iov_base = (void*)body.data();
+    iovs[1].iov_len = body.size();
+    return writeFully(iovs, body.empty() ? 1 : 2);
+}
+
+HttpResponse::ptr HttpConnection::recvResponse(bool head_request) {
+    m_reusable = false;
+    if (readHead(m_parser) <= 0) {
+        return nullptr;
+    }
+    HttpResponse::ptr rsp = m_parser.getData();
+    if (!head_request && !readBody(m_parser, *rsp, HttpResponseParser::GetHttpResponseMaxBodySize(),
+                m_parser.isUntilClose())) {
+        return nullptr;
+    }
+    //一直收到关闭的肯定不能再用了，对端多发了东西(响应后面还有数据)也不能用
+    m_reusable = !rsp->isClose() && !m_parser.isUntilClose() && !hasBufferedData();
+    return rsp;
+}
+
+bool HttpConnection::checkAlive() {
+    if (!isConnected() || hasBufferedData()) {
+        return false;
+    }
+    //用原始的recv，hook过的没数据会把协程挂起来等
+    char c;
+    ssize_t n = recv_f(m_sock->getSocket(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+HttpConnectionPool::HttpConnectionPool(const std::string& host, uint16_t port,
+                                       uint32_t max_size, uint64_t max_idle_ms,
+                                       uint32_t max_request, const std::string& vhost)
+    :m_host(host)
+    ,m_vhost(vhost)
+    ,m_port(port)
+    ,m_maxSize(max_size)
+    ,m_maxIdleTime(max_idle_ms)
+    ,m_maxRequest(max_request)
+    ,m_lastReport(GetMonotonicMS()) {
+    if (m_vhost.empty()) {
+        m_vhost = m_host + ":" + std::to_string(m_port);
+    }
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+    for (auto& i : m_conns) {
+        i->close();
+    }
+}
+
+HttpResult::ptr HttpConnectionPool::doGet(const std::string& path, uint64_t timeout_ms,
+                                          const std::map<std::string, std::string>& headers) {
+    return doRequest(HttpMethod::GET, path, timeout_ms, headers, "");
+}
+
+HttpResult::ptr HttpConnectionPool::doPost(const std::string& path, uint64_t timeout_ms,
+                                           const std::map<std::string, std::string>& headers,
+                                           const std::string& body) {
+    return doRequest(HttpMethod::POST, path, timeout_ms, headers, body);
+}
+
+HttpResult::ptr HttpConnectionPool::doRequest(HttpMethod method, const std::string& path, uint64_t timeout_ms,
+                                              const std::map<std::string, std::string>& headers,
+                                              const std::string& body) {
+    if (path.empty() || path[0] != '/') {
+        ++m_requests;
+        ++m_failures;
+        return std::make_shared<HttpResult>(HttpResult::Error::INVALID_URL, nullptr, "invalid path: " + path);
+    }
+    HttpRequest::ptr req = std::make_shared<HttpRequest>();
+    req->setMethod(method);
+    //path、query都指向参数，请求发出去之前一直有效
+    StringView p(path);
+    size_t pos = p.find('?');
+    if (pos == StringView::npos) {
+        req->setPathRef(p);
+    } else {
+        req->setPathRef(p.substr(0, pos));
+        req->setQueryRef(p.substr(pos + 1));
+    }
+    for (auto& i : headers) {
+        req->setHeader(i.first, i.second);
+    }
+    if (!body.empty()) {
+        req->setBodyRef(body);
+    }
+    return doRequest(req, timeout_ms);
+}
+
+//一次请求的截止时间，发请求加收响应一起算
+//SO_RCVTIMEO/SO_SNDTIMEO只管单次读写，对端一个字节一个字节慢慢发的话永远不会超时，
+//所以到时间还没收完就把socket shutdown掉，等在读写上的协程被叫醒，读到0/写出错返回
+//shutdown和请求结束用锁隔开，请求结束之后连接放回去或者关掉，fd号被复用了也不会被误关
+struct RequestDeadline {
+    typedef Mutex MutexType;
+
+    //请求结束，返回是不是已经超时了
+    bool finish() {
+        MutexType::Lock lock(mutex);
+        done = true;
+        return timedout;
+    }
+
+    MutexType mutex;
+    bool done = false;
+    bool timedout = false;
+};
+
+HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req, uint64_t timeout_ms) {
+    ++m_requests;
+    if (!req->hasHeader("host")) {
+        req->setHeader("host", m_vhost);
+    }
+
+    HttpMethod method = req->getMethod();
+    //空闲连接检查完到发请求之间对端也可能刚好关掉，幂等的请求在复用的连接上
+    //一个字节都没收到就断了的话，换一个连接再试，重试也算在timeout_ms里面
+    bool idempotent = method == HttpMethod::GET || method == HttpMethod::HEAD
+        || method == HttpMethod::OPTIONS;
+    uint64_t deadline = timeout_ms ? GetMonotonicMS() + timeout_ms : 0;
+    while (true) {
+        //还剩多少时间，0是不超时
+        uint64_t left = 0;
+        if (deadline) {
+            uint64_t now = GetMonotonicMS();
+            left = now < deadline ? deadline - now : 1;
+        }
+        HttpResult::Error result = HttpResult::Error::OK;
+        std::string error;
+        HttpConnection::ptr conn = getConnection(left, result, error);
+        if (!conn) {
+            ++m_failures;
+            return std::make_shared<HttpResult>(result, nullptr, error);
+        }
+        bool reused = conn->getRequestCount() > 0;
+        Socket::ptr sock = conn->getSocket();
+        //没在IOManager里的时候只有单次读写的超时
+        sock->setRecvTimeout(left);
+        sock->setSendTimeout(left);
+        std::shared_ptr<RequestDeadline> rd(new RequestDeadline);
+        Timer::ptr timer;
+        IOManager* iom = IOManager::GetThis();
+        if (left && iom) {
+            std::weak_ptr<RequestDeadline> weak_rd(rd);
+            timer = iom->addConditionTimer(left, [weak_rd, sock]() {
+                auto t = weak_rd.lock();
+                if (!t) {
+                    return;
+                }
+                RequestDeadline::MutexType::Lock lock(t->mutex);
+                if (t->done) {
+                    return;
+                }
+                t->timedout = true;
+                ::shutdown(sock->getSocket(), SHUT_RDWR);
+            }, weak_rd);
+        }
+
+        errno = 0;
+        bool sent = conn->sendRequest(req);
+        int e = errno;
+        HttpResponse::ptr rsp;
+        if (sent) {
+            rsp = conn->recvResponse(method == HttpMethod::HEAD);
+            e = errno;
+        }
+        bool timedout = rd->finish();
+        if (timer) {
+            timer->cancel();
+        }
+        bool retry = reused && idempotent && e != ETIMEDOUT && !timedout
+            && (!deadline || GetMonotonicMS() < deadline);
+        if (!sent) {
+            releaseConnection(conn, false);
+            if (retry) {
+                ++m_retries;
+                continue;
+            }
+            ++m_failures;
+            return std::make_shared<HttpResult>(HttpResult::Error::SEND_FAIL, nullptr,
+                    (timedout ? "send request timeout " : "send request fail ") + sock->toString());
+        }
+        if (!rsp) {
+            int err = conn->getError();
+            bool empty = !conn->hasBufferedData();
+            releaseConnection(conn, false);
+            if (err) {
+                ++m_failures;
+                return std::make_shared<HttpResult>(HttpResult::Error::INVALID_RESPONSE, nullptr,
+                        "invalid response error=" + std::to_string(err) + " " + sock->toString());
+            }
+            if (retry && empty) {
+                ++m_retries;
+                continue;
+            }
+            ++m_failures;
+            return std::make_shared<HttpResult>(HttpResult::Error::RECV_FAIL, nullptr,
+                    (timedout ? "recv response timeout " : "recv response fail ") + sock->toString());
+        }
+        //连接放回去以后缓冲区会被下一个请求覆盖，响应先拷出来
+        rsp->detach();
+        //刚好收完的时候到时间了，响应是完整的，但是连接已经被shutdown，不能再用
+        releaseConnection(conn, !timedout);
+        return std::make_shared<HttpResult>(HttpResult::Error::OK, rsp, "ok");
+    }
+}
+
+HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms,
+                                                      HttpResult::Error& result, std::string& error) {
+    uint64_t now = GetMonotonicMS();
+    Address::ptr addr;
+    while (true) {
+        std::vector<HttpConnection::ptr> invalid;
+        HttpConnection::ptr conn;
+        {
+            MutexType::Lock lock(m_mutex);
+            //前面的空闲得最久，超时的都去掉
+            while (!m_conns.empty() && m_conns.front()->getLastActiveTime() + m_maxIdleTime <= now) {
+                invalid.push_back(m_conns.front());
+                m_conns.pop_front();
+                ++m_evictIdle;
+            }
+            if (!m_conns.empty()) {
+                conn = m_conns.back();
+                m_conns.pop_back();
+            }
+            addr = m_addr;
+        }
+        for (auto& i : invalid) {
+            i->close();
+        }
+        if (!conn) {
+            break;
+        }
+        //检查要调一次recv，放在锁外面，别的线程放回、拿连接不用等
+        if (conn->checkAlive()) {
+            ++m_reused;
+            ++m_active;
+            return conn;
+        }
+        ++m_evictUnhealthy;
+        conn->close();
+    }
+
+    if (!addr) {
+        //getaddrinfo是阻塞的，只有第一次或者连不上之后才解析，不拿着锁
+        IPAddress::ptr ip = Address::LookupAnyIPAddress(m_host);
+        if (!ip) {
+            ++m_connectFailures;
+            result = HttpResult::Error::INVALID_HOST;
+            error = "invalid host: " + m_host;
+            return nullptr;
+        }
+        ip->setPort(m_port);
+        addr = ip;
+        MutexType::Lock lock(m_mutex);
+        m_addr = addr;
+    }
+
+    Socket::ptr sock = Socket::CreateTCP(addr);
+    if (!sock->connect(addr, timeout_ms ? timeout_ms : ~0ull)) {
+        ++m_connectFailures;
+        //地址可能变了，下次重新解析
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_addr == addr) {
+                m_addr.reset();
+            }
+        }
+        result = HttpResult::Error::CONNECT_FAIL;
+        error = "connect fail: " + addr->toString();
+        return nullptr;
+    }
+    ++m_created;
+    ++m_active;
+    return std::make_shared<HttpConnection>(sock);
+}
+
+void HttpConnectionPool::releaseConnection(HttpConnection::ptr conn, bool ok) {
+    --m_active;
+    uint64_t now = GetMonotonicMS();
+    bool keep = ok && conn->isReusable();
+    if (keep && conn->getRequestCount() >= m_maxRequest) {
+        ++m_evictMaxRequest;
+        keep = false;
+    }
+    if (keep) {
+        conn->setLastActiveTime(now);
+        MutexType::Lock lock(m_mutex);
+        if (m_conns.size() < m_maxSize) {
+            m_conns.push_back(conn);
+        } else {
+            ++m_evictOverflow;
+            keep = false;
+        }
+    } else if (ok) {
+        //对端要关或者响应收到关闭为止
+        ++m_evictClose;
+    } else {
+        ++m_evictError;
+    }
+    if (!keep) {
+        conn->close();
+    }
+    report(now);
+}
+
+void HttpConnectionPool::report(uint64_t now) {
+    uint64_t interval = s_stats_interval;
+    if (interval == 0) {
+        return;
+    }
+    {
+        MutexType::Lock lock(m_mutex);
+        if (now - m_lastReport < interval) {
+            return;
+        }
+        m_lastReport = now;
+    }
+    CHPE_LOG_INFO(g_logger) << "http connection pool stats " << toString();
+}
+
+size_t HttpConnectionPool::getIdleCount() {
+    MutexType::Lock lock(m_mutex);
+    return m_conns.size();
+}
+
+std::string HttpConnectionPool::toString() {
+    std::stringstream ss;
+    ss << "[HttpConnectionPool host=" << m_host << ":" << m_port
+       << " idle=" << getIdleCount()
+       << " active=" << m_active
+       << " requests=" << m_requests
+       << " failures=" << m_failures
+       << " retries=" << m_retries
+       << " created=" << m_created
+       << " reused=" << m_reused
+       << " connect_failures=" << m_connectFailures
+       << " evict_idle=" << m_evictIdle
+       << " evict_max_request=" << m_evictMaxRequest
+       << " evict_unhealthy=" << m_evictUnhealthy
+       << " evict_overflow=" << m_evictOverflow
+       << " evict_close=" << m_evictClose
+       << " evict_error=" << m_evictError
+       << "]";
+    return ss.str();
+}
+
+HttpConnectionPool::ptr HttpConnectionPoolManager::get(const std::string& host, uint16_t port) {
+    MutexType::Lock lock(m_mutex);
+    HttpConnectionPool::ptr& pool = m_pools[std::make_pair(host, port)];
+    if (!pool) {
+        pool.reset(new HttpConnectionPool(host, port,
+                    g_http_connection_pool_max_size->getValue(),
+                    g_http_connection_pool_max_idle_time->getValue(),
+                    g_http_connection_pool_max_request->getValue()));
+    }
+    return pool;
+}
+
+void HttpConnectionPoolManager::add(HttpConnectionPool::ptr pool) {
+    MutexType::Lock lock(m_mutex);
+    m_pools[std::make_pair(pool->getHost(), pool->getPort())] = pool;
+}
+
+void HttpConnectionPoolManager::del(const std::string& host, uint16_t port) {
+    MutexType::Lock lock(m_mutex);
+    m_pools.erase(std::make_pair(host, port));
+}
+
+}
@@ -0,0 +1,180 @@
+#ifndef __HTTP_CONNECTION_H__
+#define __HTTP_CONNECTION_H__
+
+#include <memory>
+#include <string>
+#include <map>
+#include <deque>
+#include <atomic>
+#include "http_stream.h"
+#include "address.h"
+#include "mutex.h"
+#include "singleton.h"
+
+namespace cpp_high_perf {
+
+//一次http请求的结果
+struct HttpResult {
+    typedef std::shared_ptr<HttpResult> ptr;
+    enum class Error {
+        OK = 0,
+        //url不对
+        INVALID_URL,
+        //域名解析不出来
+        INVALID_HOST,
+        //连不上
+        CONNECT_FAIL,
+        //发请求失败
+        SEND_FAIL,
+        //收响应失败(连接断了或者超时)
+        RECV_FAIL,
+        //响应格式不对或者太大
+        INVALID_RESPONSE
+    };
+
+    HttpResult(Error r, HttpResponse::ptr rsp, const std::string& e)
+        :result(r)
+        ,response(rsp)
+        ,error(e) {}
+
+    std::string toString() const;
+
+    Error result;
+    HttpResponse::ptr response;
+    std::string error;
+};
+
+//客户端的一条http连接，一问一答
+//收到的响应直接指向连接的缓冲区，下一次sendRequest之前有效，要留着的话先detach
+class HttpConnection : public HttpStream {
+public:
+    typedef std::shared_ptr<HttpConnection> ptr;
+
+    //buffer_size为0的时候用配置 http.response.buffer_size
+    HttpConnection(Socket::ptr sock, size_t buffer_size = 0);
+
+    bool sendRequest(HttpRequest::ptr req);
+    //失败返回空，getError()不为0的话是响应有问题
+    //HEAD请求的响应带了content-length也没有body，要告诉它
+    HttpResponse::ptr recvResponse(bool head_request = false);
+
+    uint64_t getCreateTime() const { return m_createTime; }
+    //最后一次用完放回连接池的时间
+    uint64_t getLastActiveTime() const { return m_lastActiveTime; }
+    void setLastActiveTime(uint64_t v) { m_lastActiveTime = v; }
+    //发过的请求数
+    uint64_t getRequestCount() const { return m_requestCount; }
+    //上一个响应之后还能不能接着用: 对端没说要关，body也收完整了
+    bool isReusable() const { return m_reusable; }
+
+    //对端有没有关掉连接，不阻塞，空闲连接拿出来用之前检查一下
+    //对端关了或者连接上有不该有的数据都算不健康
+    bool checkAlive();
+private:
+    HttpResponseParser m_parser;
+    std::string m_out;
+    uint64_t m_createTime;
+    uint64_t m_lastActiveTime;
+    uint64_t m_requestCount = 0;
+    bool m_reusable = false;
+};
+
+//连到同一个host:port的长连接池，doGet/doPost在协程里是协程阻塞的
+//用完的连接放回池子，下次从最近放回去的开始拿(最热的连接，对端也最不可能已经关掉)
+//空闲超过max_idle_ms、用了max_request次、对端关了的连接不再用，出错的连接直接关掉不放回去
+//GET/HEAD/OPTIONS在复用的连接上还没收到响应就断了的话，换个连接重试
+//最多留max_size个空闲连接，并发超过的时候照样新建，用完多出来的关掉
+//统计信息每隔 http.connection_pool.stats_interval 打一次日志
+class HttpConnectionPool {
+public:
+    typedef std::shared_ptr<HttpConnectionPool> ptr;
+    typedef Mutex MutexType;
+
+    //host可以是域名，第一次建连接的时候才解析，连不上的时候重新解析
+    //vhost是请求里的host头，空的时候用host:port
+    HttpConnectionPool(const std::string& host, uint16_t port,
+                       uint32_t max_size = 32, uint64_t max_idle_ms = 30 * 1000,
+                       uint32_t max_request = 1000, const std::string& vhost = "");
+    ~HttpConnectionPool();
+
+    HttpConnectionPool(const HttpConnectionPool&) = delete;
+    HttpConnectionPool& operator=(const HttpConnectionPool&) = delete;
+
+    //path可以带?query，timeout_ms是整个请求的超时(建连接、发请求、收完响应、重试一起算)，0是不超时
+    HttpResult::ptr doGet(const std::string& path, uint64_t timeout_ms,
+                          const std::map<std::string, std::string>& headers = {});
+    HttpResult::ptr doPost(const std::string& path, uint64_t timeout_ms,
+                           const std::map<std::string, std::string>& headers = {},
+                           const std::string& body = "");
+    HttpResult::ptr doRequest(HttpMethod method, const std::string& path, uint64_t timeout_ms,
+                              const std::map<std::string, std::string>& headers = {},
+                              const std::string& body = "");
+    //req的host头没有的话会加上，返回的响应已经detach，和连接没关系了
+    HttpResult::ptr doRequest(HttpRequest::ptr req, uint64_t timeout_ms);
+
+    const std::string& getHost() const { return m_host; }
+    uint16_t getPort() const { return m_port; }
+
+    //现在空闲的连接数
+    size_t getIdleCount();
+    //现在借出去的连接数
+    uint64_t getActiveCount() const { return m_active; }
+    //统计信息，打日志用
+    std::string toString();
+private:
+    //timeout_ms是建连接的超时，0是不超时，拿不到的时候result和error是原因
+    HttpConnection::ptr getConnection(uint64_t timeout_ms, HttpResult::Error& result, std::string& error);
+    //ok为false(这次请求出错了)或者连接不能再用的时候关掉
+    void releaseConnection(HttpConnection::ptr conn, bool ok);
+    //打统计日志，到时间了才打
+    void report(uint64_t now);
+private:
+    std::string m_host;
+    std::string m_vhost;
+    uint16_t m_port;
+    uint32_t m_maxSize;
+    uint64_t m_maxIdleTime;
+    uint32_t m_maxRequest;
+
+    MutexType m_mutex;
+    //解析出来的地址，连不上的时候清掉重新解析
+    Address::ptr m_addr;
+    //空闲连接，后面是最近放回来的
+    std::deque<HttpConnection::ptr> m_conns;
+    uint64_t m_lastReport;
+
+    std::atomic<uint64_t> m_active{0};
+    //统计
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_failures{0};
+    std::atomic<uint64_t> m_retries{0};
+    std::atomic<uint64_t> m_created{0};
+    std::atomic<uint64_t> m_reused{0};
+    std::atomic<uint64_t> m_connectFailures{0};
+    std::atomic<uint64_t> m_evictIdle{0};
+    std::atomic<uint64_t> m_evictMaxRequest{0};
+    std::atomic<uint64_t> m_evictUnhealthy{0};
+    std::atomic<uint64_t> m_evictOverflow{0};
+    std::atomic<uint64_t> m_evictClose{0};
+    std::atomic<uint64_t> m_evictError{0};
+};
+
+//按host:port拿连接池，第一次拿的时候按配置 http.connection_pool.* 创建
+class HttpConnectionPoolManager {
+public:
+    typedef Mutex MutexType;
+
+    HttpConnectionPool::ptr get(const std::string& host, uint16_t port);
+    //自己设置参数的池子放进来，已经有的话替换掉
+    void add(HttpConnectionPool::ptr pool);
+    void del(const std::string& host, uint16_t port);
+private:
+    MutexType m_mutex;
+    std::map<std::pair<std::string, uint16_t>, HttpConnectionPool::ptr> m_pools;
+};
+
+typedef Singleton<HttpConnectionPoolManager> HttpConnectionPoolMgr;
+
+}
+
+#endif
@@ -0,0 +1,534 @@
+#include "http_parser.h"
+#include "config.h"
+#include "log.h"
+#include <atomic>
+#include <string.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static ConfigVar<uint64_t>::ptr g_http_request_buffer_size =
+    Config::lookup<uint64_t>("http.request.buffer_size", 4 * 1024ull, "http request buffer size, also the header size limit");
+
+static ConfigVar<uint64_t>::ptr g_http_request_max_body_size =
+    Config::lookup<uint64_t>("http.request.max_body_size", 64 * 1024 * 1024ull, "http request max body size");
+
+static ConfigVar<uint64_t>::ptr g_http_response_buffer_size =
+    Config::lookup<uint64_t>("http.response.buffer_size", 4 * 1024ull, "http response buffer size, also the header size limit");
+
+static ConfigVar<uint64_t>::ptr g_http_response_max_body_size =
+    Config::lookup<uint64_t>("http.response.max_body_size", 64 * 1024 * 1024ull, "http response max body size");
+
+//每个请求都要用，缓存成原子变量
+static std::atomic<uint64_t> s_http_request_buffer_size{0};
+static std::atomic<uint64_t> s_http_request_max_body_size{0};
+static std::atomic<uint64_t> s_http_response_buffer_size{0};
+static std::atomic<uint64_t> s_http_response_max_body_size{0};
+
+//名字里允许的字符(RFC7230 token)，查表
+static bool s_token_chars[256];
+
+struct HttpParserIniter {
+    HttpParserIniter() {
+        for (int c = 0; c < 256; ++c) {
+            s_token_chars[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')
+                || (c >= 'A' && c <= 'Z') || (c && strchr("!#$%&'*+-.^_`|~", c));
+        }
+
+#define XX(var, v) \
+        v = var->getValue(); \
+        var->addListener([](const uint64_t&, const uint64_t& new_value) { \
+            v = new_value; \
+        });
+        XX(g_http_request_buffer_size, s_http_request_buffer_size);
+        XX(g_http_request_max_body_size, s_http_request_max_body_size);
+        XX(g_http_response_buffer_size, s_http_response_buffer_size);
+        XX(g_http_response_max_body_size, s_http_response_max_body_size);
+#undef XX
+    }
+};
+
+static HttpParserIniter s_http_parser_initer;
+
+static inline bool IsToken(char c) {
+    return s_token_chars[(unsigned char)c];
+}
+
+//请求行里uri和版本的字符: 可见字符
+static inline bool IsVisible(char c) {
+    return (unsigned char)c > ' ' && c != 0x7f;
+}
+
+//头的值和状态描述: 可见字符、空格、tab，还有obs-text(>=0x80)
+static inline bool IsValueChar(char c) {
+    return (unsigned char)c >= ' ' ? c != 0x7f : c == '\t';
+}
+
+uint64_t HttpRequestParser::GetHttpRequestBufferSize() {
+    return s_http_request_buffer_size;
+}
+
+uint64_t HttpRequestParser::GetHttpRequestMaxBodySize() {
+    return s_http_request_max_body_size;
+}
+
+uint64_t HttpResponseParser::GetHttpResponseBufferSize() {
+    return s_http_response_buffer_size;
+}
+
+uint64_t HttpResponseParser::GetHttpResponseMaxBodySize() {
+    return s_http_response_max_body_size;
+}
+
+HttpParser::HttpParser(bool request)
+    :m_request(request)
+    ,m_state(request ? S_REQ_START : S_RSP_VERSION) {
+    m_headers.reserve(16);
+}
+
+void HttpParser::reset() {
+    m_state = m_request ? S_REQ_START : S_RSP_VERSION;
+    m_error = 0;
+    m_nread = 0;
+    m_mark = 0;
+    m_headers.clear();
+    m_contentLength = 0;
+    m_hasContentLength = false;
+    m_chunked = false;
+    m_close = false;
+}
+
+#define FAIL(code) \
+    m_nread = p - data; \
+    m_error = code; \
+    return -1;
+
+#define MARK_TO(r) \
+    (r).off = m_mark; \
+    (r).len = (uint32_t)(p - data) - m_mark;
+
+int HttpParser::execute(const char* data, size_t len) {
+    if (m_error) {
+        return -1;
+    }
+    if (m_state == S_DONE) {
+        return m_nread;
+    }
+
+    const char* p = data + m_nread;
+    const char* end = data + len;
+    while (p < end) {
+        switch (m_state) {
+        case S_REQ_START:
+            //请求前面多出来的空行跳过
+            if (*p == '\r' || *p == '\n') {
+                ++p;
+                break;
+            }
+            if (!IsToken(*p)) {
+                FAIL(400);
+            }
+            m_mark = p - data;
+            m_state = S_REQ_METHOD;
+            ++p;
+            break;
+        case S_REQ_METHOD:
+            while (p < end && IsToken(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p != ' ') {
+                FAIL(400);
+            }
+            MARK_TO(m_fields[0]);
+            m_state = S_REQ_URI_START;
+            ++p;
+            break;
+        case S_REQ_URI_START:
+            if (!IsVisible(*p)) {
+                FAIL(400);
+            }
+            m_mark = p - data;
+            m_state = S_REQ_URI;
+            ++p;
+            break;
+        case S_REQ_URI:
+            while (p < end && IsVisible(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p != ' ') {
+                FAIL(400);
+            }
+            MARK_TO(m_fields[1]);
+            ++p;
+            m_mark = p - data;
+            m_state = S_REQ_VERSION;
+            break;
+        case S_REQ_VERSION:
+            while (p < end && IsVisible(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p != '\r') {
+                FAIL(400);
+            }
+            MARK_TO(m_fields[2]);
+            m_state = S_LINE_LF;
+            ++p;
+            break;
+        case S_RSP_VERSION:
+            while (p < end && IsVisible(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p != ' ') {
+                FAIL(400);
+            }
+            MARK_TO(m_fields[0]);
+            ++p;
+            m_mark = p - data;
+            m_state = S_RSP_STATUS;
+            break;
+        case S_RSP_STATUS:
+            while (p < end && *p >= '0' && *p <= '9') {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            MARK_TO(m_fields[1]);
+            if (*p == ' ') {
+                ++p;
+                m_mark = p - data;
+                m_state = S_RSP_REASON;
+            } else if (*p == '\r') {
+                //没有描述
+                m_fields[2].off = p - data;
+                m_fields[2].len = 0;
+                ++p;
+                m_state = S_LINE_LF;
+            } else {
+                FAIL(400);
+            }
+            break;
+        case S_RSP_REASON:
+            while (p < end && IsValueChar(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p != '\r') {
+                FAIL(400);
+            }
+            MARK_TO(m_fields[2]);
+            m_state = S_LINE_LF;
+            ++p;
+            break;
+        case S_LINE_LF:
+        case S_HEADER_LF:
+            if (*p != '\n') {
+                FAIL(400);
+            }
+            m_state = S_HEADER_START;
+            ++p;
+            break;
+        case S_HEADER_START:
+            if (*p == '\r') {
+                m_state = S_HEADERS_END_LF;
+                ++p;
+                break;
+            }
+            //以空格开头的折行(obs-fold)已经废弃了，不支持
+            if (!IsToken(*p)) {
+                FAIL(400);
+            }
+            m_mark = p - data;
+            m_state = S_HEADER_NAME;
+            ++p;
+            break;
+        case S_HEADER_NAME:
+            while (p < end && IsToken(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p != ':') {
+                FAIL(400);
+            }
+            MARK_TO(m_name);
+            m_state = S_HEADER_VALUE_START;
+            ++p;
+            break;
+        case S_HEADER_VALUE_START:
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            m_mark = p - data;
+            m_state = S_HEADER_VALUE;
+            break;
+        case S_HEADER_VALUE:
+            while (p < end && IsValueChar(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p != '\r') {
+                FAIL(400);
+            }
+            m_headers.push_back(std::make_pair(m_name, Range()));
+            MARK_TO(m_headers.back().second);
+            m_state = S_HEADER_LF;
+            ++p;
+            break;
+        case S_HEADERS_END_LF:
+            if (*p != '\n') {
+                FAIL(400);
+            }
+            ++p;
+            m_nread = p - data;
+            m_state = S_DONE;
+            //一次给了很多数据的时候，头收全了也要看是不是超过了上限
+            if (m_nread > getHeadLimit()) {
+                m_error = m_request ? 431 : 400;
+                return -1;
+            }
+            if (!onHeadComplete(data)) {
+                return -1;
+            }
+            return m_nread;
+        default:
+            FAIL(400);
+        }
+    }
+
+    m_nread = p - data;
+    //缓冲区都满了头还没完
+    if (m_nread >= getHeadLimit()) {
+        m_error = m_request ? 431 : 400;
+        return -1;
+    }
+    return 0;
+}
+
+#undef MARK_TO
+#undef FAIL
+
+uint8_t HttpParser::ParseVersion(StringView v) {
+    if (v.size() != 8 || !v.startsWith("HTTP/") || v[6] != '.'
+            || v[5] < '0' || v[5] > '9' || v[7] < '0' || v[7] > '9') {
+        return 0;
+    }
+    return ((v[5] - '0') << 4) | (v[7] - '0');
+}
+
+//按逗号分开的每一项，去掉两头空格
+template<class Fun>
+static void ForEachToken(StringView v, Fun fun) {
+    size_t pos = 0;
+    while (pos <= v.size()) {
+        size_t end = v.find(',', pos);
+        if (end == StringView::npos) {
+            end = v.size();
+        }
+        StringView t = v.substr(pos, end - pos).trim();
+        if (!t.empty()) {
+            fun(t);
+        }
+        pos = end + 1;
+    }
+}
+
+bool HttpParser::parseFraming(const char* data, uint8_t version) {
+    //1.1默认长连接，1.0默认短连接
+    m_close = version < 0x11;
+    bool keep_alive = false;
+    bool other_coding = false;
+    for (auto& i : m_headers) {
+        StringView key = View(data, i.first);
+        StringView val = View(data, i.second).trim();
+        if (key.equalsIgnoreCase("content-length")) {
+            if (val.empty() || val.size() > 19) {
+                return setError(400);
+            }
+            uint64_t v = 0;
+            for (size_t n = 0; n < val.size(); ++n) {
+                if (val[n] < '0' || val[n] > '9') {
+                    return setError(400);
+                }
+                v = v * 10 + (val[n] - '0');
+            }
+            //出现两次而且不一样，不知道该信哪个
+            if (m_hasContentLength && v != m_contentLength) {
+                return setError(400);
+            }
+            m_contentLength = v;
+            m_hasContentLength = true;
+        } else if (key.equalsIgnoreCase("transfer-encoding")) {
+            //chunked必须是最后一个
+            m_chunked = false;
+            other_coding = false;
+            ForEachToken(val, [&](StringView t) {
+                if (t.equalsIgnoreCase("chunked")) {
+                    m_chunked = true;
+                } else {
+                    m_chunked = false;
+                    other_coding = true;
+                }
+            });
+        } else if (key.equalsIgnoreCase("connection")) {
+            ForEachToken(val, [&](StringView t) {
+                if (t.equalsIgnoreCase("close")) {
+                    m_close = true;
+                } else if (t.equalsIgnoreCase("keep-alive")) {
+                    keep_alive = true;
+                }
+            });
+        }
+    }
+    if (keep_alive && version < 0x11) {
+        m_close = false;
+    }
+    if (m_request) {
+        //请求的body长度一定要能确定，两个都有的是走私攻击的常用手段，直接拒掉
+        if (other_coding) {
+            return setError(501);
+        }
+        if (m_chunked && m_hasContentLength) {
+            return setError(400);
+        }
+    } else if (m_chunked) {
+        m_hasContentLength = false;
+        m_contentLength = 0;
+    }
+    if (m_contentLength > getBodyLimit()) {
+        return setError(413);
+    }
+    return true;
+}
+
+HttpRequestParser::HttpRequestParser()
+    :HttpParser(true) {
+}
+
+void HttpRequestParser::reset() {
+    HttpParser::reset();
+    m_data.reset();
+}
+
+bool HttpRequestParser::onHeadComplete(const char* data) {
+    HttpMethod method = StringToHttpMethod(View(data, m_fields[0]));
+    if (method == HttpMethod::INVALID_METHOD) {
+        CHPE_LOG_DEBUG(g_logger) << "invalid http method " << View(data, m_fields[0]);
+        return setError(501);
+    }
+    uint8_t version = ParseVersion(View(data, m_fields[2]));
+    if (version != 0x11 && version != 0x10) {
+        CHPE_LOG_DEBUG(g_logger) << "invalid http version " << View(data, m_fields[2]);
+        return setError(version ? 505 : 400);
+    }
+    if (!parseFraming(data, version)) {
+        return false;
+    }
+
+    HttpRequest::ptr req(new HttpRequest(version, m_close));
+    req->setMethod(method);
+    req->setChunked(m_chunked);
+    req->setContentLength(m_contentLength);
+
+    //绝对形式的 http://host/path 去掉前面的协议和主机
+    StringView uri = View(data, m_fields[1]);
+    if (!uri.empty() && uri[0] != '/' && uri[0] != '*') {
+        size_t pos = uri.find("://");
+        if (pos == StringView::npos) {
+            return setError(400);
+        }
+        pos = uri.find('/', pos + 3);
+        uri = pos == StringView::npos ? StringView("/") : uri.substr(pos);
+    }
+    size_t frag = uri.find('#');
+    if (frag != StringView::npos) {
+        req->setFragmentRef(uri.substr(frag + 1));
+        uri = uri.substr(0, frag);
+    }
+    size_t query = uri.find('?');
+    if (query != StringView::npos) {
+        req->setQueryRef(uri.substr(query + 1));
+        uri = uri.substr(0, query);
+    }
+    req->setPathRef(uri);
+
+    HttpHeaders& headers = req->getHeaders();
+    headers.reserve(m_headers.size());
+    for (auto& i : m_headers) {
+        headers.addRef(View(data, i.first), View(data, i.second).trim());
+    }
+    m_data = req;
+    return true;
+}
+
+HttpResponseParser::HttpResponseParser()
+    :HttpParser(false) {
+}
+
+void HttpResponseParser::reset() {
+    HttpParser::reset();
+    m_data.reset();
+    m_untilClose = false;
+}
+
+bool HttpResponseParser::onHeadComplete(const char* data) {
+    uint8_t version = ParseVersion(View(data, m_fields[0]));
+    if (!version) {
+        return setError(400);
+    }
+    StringView status = View(data, m_fields[1]);
+    if (status.size() != 3) {
+        return setError(400);
+    }
+    if (!parseFraming(data, version)) {
+        return false;
+    }
+    int code = (status[0] - '0') * 100 + (status[1] - '0') * 10 + (status[2] - '0');
+    //1xx/204/304没有body，带了content-length(304是原来资源的长度)或者chunked也不能按它去收
+    bool no_body = !HttpStatusAllowsBody((HttpStatus)code);
+    if (no_body) {
+        m_contentLength = 0;
+        m_chunked = false;
+    }
+
+    HttpResponse::ptr rsp(new HttpResponse(version, m_close));
+    rsp->setStatus((HttpStatus)code);
+    rsp->setReasonRef(View(data, m_fields[2]));
+    rsp->setChunked(m_chunked);
+    rsp->setContentLength(m_contentLength);
+    m_untilClose = !no_body && !m_chunked && !m_hasContentLength;
+    if (m_untilClose) {
+        rsp->setClose(true);
+    }
+
+    HttpHeaders& headers = rsp->getHeaders();
+    headers.reserve(m_headers.size());
+    for (auto& i : m_headers) {
+        headers.addRef(View(data, i.first), View(data, i.second).trim());
+    }
+    m_data = rsp;
+    return true;
+}
+
+}
@@ -0,0 +1,141 @@
+#ifndef __HTTP_PARSER_H__
+#define __HTTP_PARSER_H__
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include "http.h"
+
+namespace cpp_high_perf {
+
+//http消息头的解析器，一个字节一个字节走的状态机(和ragel生成的那种一样)，不依赖外部库
+//不拷贝任何东西: 解析过程中只记偏移，头收全之后才生成指向缓冲区的StringView
+//记的是相对消息开头的偏移，所以没解析完的时候调用者可以把整段数据挪到缓冲区前面再接着解析
+//可以分好几次喂: 每次传从消息开头到现在收到的全部数据，接着上次停下的地方往后扫
+//只解析头，body按getContentLength/isChunked由调用者去读
+class HttpParser {
+public:
+    virtual ~HttpParser() {}
+
+    //data是消息的开头，len是目前收到的长度
+    //返回: >0 头收全了，是头的长度(包括最后的空行)；0 还没收全；-1 出错，看getError
+    int execute(const char* data, size_t len);
+    //解析下一个消息之前调用
+    virtual void reset();
+
+    bool isFinished() const { return m_state == S_DONE; }
+    bool hasError() const { return m_error != 0; }
+    //出错的时候对应的状态码(400/413/431/501/505)，没出错是0
+    int getError() const { return m_error; }
+
+    uint64_t getContentLength() const { return m_contentLength; }
+    bool isChunked() const { return m_chunked; }
+    //已经扫过的字节数
+    size_t getNRead() const { return m_nread; }
+protected:
+    enum State {
+        //请求行
+        S_REQ_START,
+        S_REQ_METHOD,
+        S_REQ_URI_START,
+        S_REQ_URI,
+        S_REQ_VERSION,
+        //状态行
+        S_RSP_VERSION,
+        S_RSP_STATUS,
+        S_RSP_REASON,
+        //下面两种共用
+        S_LINE_LF,
+        S_HEADER_START,
+        S_HEADER_NAME,
+        S_HEADER_VALUE_START,
+        S_HEADER_VALUE,
+        S_HEADER_LF,
+        S_HEADERS_END_LF,
+        S_DONE
+    };
+
+    //相对消息开头的一段
+    struct Range {
+        uint32_t off = 0;
+        uint32_t len = 0;
+    };
+
+    HttpParser(bool request);
+
+    //头收全了，data和execute最后一次传进来的一样，子类在这里生成消息，出错的时候setError返回false
+    virtual bool onHeadComplete(const char* data) = 0;
+    //头的长度上限
+    virtual uint64_t getHeadLimit() const = 0;
+    virtual uint64_t getBodyLimit() const = 0;
+
+    bool setError(int code) { m_error = code; return false; }
+    static StringView View(const char* data, const Range& r) {
+        return StringView(data + r.off, r.len);
+    }
+    //HTTP/1.1 -> 0x11，不认识的返回0
+    static uint8_t ParseVersion(StringView v);
+    //解析Content-Length/Transfer-Encoding/Connection这几个决定怎么读body和连接要不要关的头
+    bool parseFraming(const char* data, uint8_t version);
+protected:
+    bool m_request;
+    int m_state;
+    int m_error = 0;
+    size_t m_nread = 0;
+    uint32_t m_mark = 0;
+    Range m_fields[3];//请求行是 方法/uri/版本，状态行是 版本/状态码/描述
+    Range m_name;
+    std::vector<std::pair<Range, Range> > m_headers;
+    uint64_t m_contentLength = 0;
+    bool m_hasContentLength = false;
+    bool m_chunked = false;
+    bool m_close = false;
+};
+
+class HttpRequestParser : public HttpParser {
+public:
+    typedef std::shared_ptr<HttpRequestParser> ptr;
+
+    HttpRequestParser();
+
+    void reset() override;
+    //头解析完之后才有，字段都指向execute传进来的data
+    HttpRequest::ptr getData() const { return m_data; }
+
+    //配置 http.request.buffer_size / http.request.max_body_size
+    static uint64_t GetHttpRequestBufferSize();
+    static uint64_t GetHttpRequestMaxBodySize();
+protected:
+    bool onHeadComplete(const char* data) override;
+    uint64_t getHeadLimit() const override { return GetHttpRequestBufferSize(); }
+    uint64_t getBodyLimit() const override { return GetHttpRequestMaxBodySize(); }
+private:
+    HttpRequest::ptr m_data;
+};
+
+class HttpResponseParser : public HttpParser {
+public:
+    typedef std::shared_ptr<HttpResponseParser> ptr;
+
+    HttpResponseParser();
+
+    void reset() override;
+    HttpResponse::ptr getData() const { return m_data; }
+    //既没有Content-Length也不是chunked，body一直到连接关闭
+    bool isUntilClose() const { return m_untilClose; }
+
+    //配置 http.response.buffer_size / http.response.max_body_size
+    static uint64_t GetHttpResponseBufferSize();
+    static uint64_t GetHttpResponseMaxBodySize();
+protected:
+    bool onHeadComplete(const char* data) override;
+    uint64_t getHeadLimit() const override { return GetHttpResponseBufferSize(); }
+    uint64_t getBodyLimit() const override { return GetHttpResponseMaxBodySize(); }
+private:
+    HttpResponse::ptr m_data;
+    bool m_untilClose = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "http_server.h"
+#include "log.h"
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+HttpServer::HttpServer(bool keepalive, IOManager* io_worker, IOManager* accept_worker)
+    :TcpServer(io_worker, accept_worker)
+    ,m_isKeepalive(keepalive) {
+    m_dispatch.reset(new ServletDispatch);
+}
+
+void HttpServer::handleClient(Socket::ptr client) {
+    HttpSession::ptr session(new HttpSession(client));
+    while (true) {
+        HttpRequest::ptr req = session->recvRequest();
+        if (!req) {
+            int err = session->getError();
+            if (err) {
+                CHPE_LOG_DEBUG(g_logger) << "recv http request fail, status=" << err
+                    << " client:" << *client;
+                HttpResponse::ptr rsp(new HttpResponse(0x11, true));
+                rsp->setStatus((HttpStatus)err);
+                session->sendResponse(rsp);
+            }
+            break;
+        }
+        ++m_requestCount;
+
+        HttpResponse::ptr rsp(new HttpResponse(req->getVersion(),
+                    req->isClose() || !m_isKeepalive || isStop()));
+        rsp->setHeader("server", getName());
+        //HEAD也按GET处理，只是body不发，content-length还是body的长度
+        rsp->setHeadOnly(req->getMethod() == HttpMethod::HEAD);
+        m_dispatch->handle(req, rsp, session);
+        //后面还有pipeline过来的请求就先不发，处理完一起发
+        if (!session->sendResponse(rsp, rsp->isClose() || !session->hasBufferedData())) {
+            break;
+        }
+        if (rsp->isClose()) {
+            break;
+        }
+    }
+    session->close();
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef __HTTP_SERVER_H__
+#define __HTTP_SERVER_H__
+
+#include <memory>
+#include "tcp_server.h"
+#include "http_session.h"
+#include "servlet.h"
+
+namespace cpp_high_perf {
+
+//http/1.1服务器，一个连接上循环: 收请求 -> 按路径分给servlet -> 回响应
+//支持长连接和pipeline，请求有问题(解析出错、头太长、body太大)的时候回对应的状态码然后关掉连接
+class HttpServer : public TcpServer {
+public:
+    typedef std::shared_ptr<HttpServer> ptr;
+
+    //keepalive为false的时候每个请求之后都关连接
+    HttpServer(bool keepalive = true,
+               IOManager* io_worker = IOManager::GetThis(),
+               IOManager* accept_worker = IOManager::GetThis());
+
+    ServletDispatch::ptr getServletDispatch() const { return m_dispatch; }
+    void setServletDispatch(ServletDispatch::ptr v) { m_dispatch = v; }
+
+    //处理过的请求数
+    uint64_t getRequestCount() const { return m_requestCount; }
+protected:
+    void handleClient(Socket::ptr client) override;
+private:
+    bool m_isKeepalive;
+    ServletDispatch::ptr m_dispatch;
+    std::atomic<uint64_t> m_requestCount{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "http_session.h"
+#include "log.h"
+#include <limits.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+HttpSession::HttpSession(Socket::ptr sock, size_t buffer_size)
+    :HttpStream(sock, buffer_size ? buffer_size : HttpRequestParser::GetHttpRequestBufferSize()) {
+}
+
+HttpRequest::ptr HttpSession::recvRequest() {
+    if (readHead(m_parser) <= 0) {
+        return nullptr;
+    }
+    HttpRequest::ptr req = m_parser.getData();
+    if (!readBody(m_parser, *req, HttpRequestParser::GetHttpRequestMaxBodySize(), false)) {
+        return nullptr;
+    }
+    return req;
+}
+
+bool HttpSession::sendResponse(HttpResponse::ptr rsp, bool flush_now) {
+    rsp->encodeHead(m_out);
+    m_pending.push_back(std::make_pair(m_out.size(), rsp));
+    if (flush_now || m_pending.size() >= IOV_MAX / 2) {
+        return flush();
+    }
+    return true;
+}
+
+bool HttpSession::flush() {
+    if (m_pending.empty()) {
+        return true;
+    }
+    //每个响应两段: 头(在m_out里)和body
+    std::vector<iovec> iovs;
+    iovs.reserve(m_pending.size() * 2);
+    size_t pos = 0;
+    for (auto& i : m_pending) {
+        iovec iov;
+        iov.iov_base = &m_out[pos];
+        iov.iov_len = i.first - pos;
+        iovs.push_back(iov);
+        pos = i.first;
+        //HEAD和1xx/204/304的响应只发头
+        StringView body = i.second->getBody();
+        if (!body.empty() && i.second->isBodySent()) {
+            iov.iov_base = (void*)body.data();
+            iov.iov_len = body.size();
+            iovs.push_back(iov);
+        }
+    }
+    bool ok = writeFully(&iovs[0], iovs.size());
+    m_out.clear();
+    m_pending.clear();
+    return ok;
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef __HTTP_SESSION_H__
+#define __HTTP_SESSION_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "http_stream.h"
+
+namespace cpp_high_perf {
+
+//服务端的一条http连接
+//收到的请求指向连接的缓冲区，只在处理这个请求的时候有效
+//pipeline的时候缓冲区里还有下一个请求，响应先攒起来，没有请求要处理了(要去socket收数据)的时候一起发，
+//几个响应一次sendmsg发出去
+class HttpSession : public HttpStream {
+public:
+    typedef std::shared_ptr<HttpSession> ptr;
+
+    //buffer_size为0的时候用配置 http.request.buffer_size
+    HttpSession(Socket::ptr sock, size_t buffer_size = 0);
+
+    //失败返回空，getError()不为0的话是请求有问题，应该回对应的状态码然后关掉连接
+    HttpRequest::ptr recvRequest();
+    //flush为false的时候先攒着，下次收数据之前或者flush的时候再发
+    bool sendResponse(HttpResponse::ptr rsp, bool flush_now = true);
+    bool flush();
+    //还没发出去的响应数
+    size_t getPendingCount() const { return m_pending.size(); }
+protected:
+    bool beforeRecv() override { return flush(); }
+private:
+    HttpRequestParser m_parser;
+    //攒着的响应，头都编码在m_out里，m_pending记每个头在m_out里的结尾
+    std::string m_out;
+    std::vector<std::pair<size_t, HttpResponse::ptr> > m_pending;
+};
+
+}
+
+#endif
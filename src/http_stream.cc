@@ -0,0 +1,260 @@
+#include "http_stream.h"
+#include "log.h"
+#include <algorithm>
+#include <string.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+HttpStream::HttpStream(Socket::ptr sock, size_t buffer_size)
+    :m_sock(sock)
+    ,m_buf(buffer_size ? buffer_size : 4096) {
+}
+
+HttpStream::~HttpStream() {
+}
+
+void HttpStream::close() {
+    if (m_sock) {
+        m_sock->close();
+    }
+}
+
+bool HttpStream::fill() {
+    if (!beforeRecv()) {
+        return false;
+    }
+    if (m_begin == m_end) {
+        m_begin = m_end = 0;
+    } else if (m_end == m_buf.size() && m_begin > 0) {
+        memmove(&m_buf[0], &m_buf[m_begin], m_end - m_begin);
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    if (m_end == m_buf.size()) {
+        return false;
+    }
+    ssize_t n = m_sock->recv(&m_buf[m_end], m_buf.size() - m_end);
+    if (n <= 0) {
+        return false;
+    }
+    m_end += n;
+    return true;
+}
+
+bool HttpStream::recvFully(char* buf, size_t len) {
+    if (!beforeRecv()) {
+        return false;
+    }
+    while (len > 0) {
+        ssize_t n = m_sock->recv(buf, len);
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+int HttpStream::readHead(HttpParser& parser) {
+    m_error = 0;
+    parser.reset();
+    while (true) {
+        int rt = parser.execute(&m_buf[0] + m_begin, m_end - m_begin);
+        if (rt > 0) {
+            m_begin += rt;
+            return rt;
+        }
+        if (rt < 0) {
+            m_error = parser.getError();
+            CHPE_LOG_DEBUG(g_logger) << "http parse error=" << m_error << " " << *m_sock;
+            return -1;
+        }
+        if (!fill()) {
+            //缓冲区满了头还没完(配置改大了上限，缓冲区还是原来的大小)
+            if (m_end - m_begin == m_buf.size()) {
+                m_error = 431;
+            }
+            return -1;
+        }
+    }
+}
+
+bool HttpStream::readFixedBody(uint64_t length, StringView& body, std::string& storage) {
+    size_t have = m_end - m_begin;
+    if (length <= have) {
+        body = StringView(&m_buf[0] + m_begin, length);
+        m_begin += length;
+        return true;
+    }
+
+    //缓冲区后面放不下，收进消息自己的内存里，已经收到的那一段拷过去
+    if (length > m_buf.size() - m_begin) {
+        storage.resize(length);
+        memcpy(&storage[0], &m_buf[0] + m_begin, have);
+        m_begin = m_end;
+        if (!recvFully(&storage[have], length - have)) {
+            return false;
+        }
+        body = StringView(storage);
+        return true;
+    }
+
+    //放得下，接着往缓冲区后面收，前面的头还被引用着，不能挪
+    if (!beforeRecv()) {
+        return false;
+    }
+    while (m_end < m_begin + length) {
+        ssize_t n = m_sock->recv(&m_buf[0] + m_end, m_buf.size() - m_end);
+        if (n <= 0) {
+            return false;
+        }
+        m_end += n;
+    }
+    body = StringView(&m_buf[0] + m_begin, length);
+    m_begin += length;
+    return true;
+}
+
+bool HttpStream::readChunkedBody(uint64_t max_body, std::string& storage) {
+    //一行，不带最后的\r\n
+    auto read_line = [this](StringView& line) {
+        while (true) {
+            const char* begin = &m_buf[0] + m_begin;
+            const char* lf = (const char*)memchr(begin, '\n', m_end - m_begin);
+            if (lf) {
+                if (lf == begin || lf[-1] != '\r') {
+                    m_error = 400;
+                    return false;
+                }
+                line = StringView(begin, lf - 1 - begin);
+                m_begin += lf + 1 - begin;
+                return true;
+            }
+            if (!fill()) {
+                if (m_end - m_begin == m_buf.size()) {
+                    m_error = 400;
+                }
+                return false;
+            }
+        }
+    };
+
+    storage.clear();
+    StringView line;
+    while (true) {
+        if (!read_line(line)) {
+            return false;
+        }
+        //长度是十六进制，后面可能跟着 ;扩展
+        uint64_t size = 0;
+        size_t i = 0;
+        for (; i < line.size(); ++i) {
+            char c = line[i];
+            int v = 0;
+            if (c >= '0' && c <= '9') {
+                v = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                v = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                v = c - 'A' + 10;
+            } else {
+                break;
+            }
+            if (i >= 15) {
+                m_error = 400;
+                return false;
+            }
+            size = (size << 4) | v;
+        }
+        if (i == 0 || (i < line.size() && line[i] != ';' && line[i] != ' ' && line[i] != '\t')) {
+            m_error = 400;
+            return false;
+        }
+
+        if (size == 0) {
+            //trailer不要，读到空行为止
+            do {
+                if (!read_line(line)) {
+                    return false;
+                }
+            } while (!line.empty());
+            return true;
+        }
+
+        if (storage.size() + size > max_body) {
+            m_error = 413;
+            return false;
+        }
+        size_t old = storage.size();
+        storage.resize(old + size);
+        size_t have = std::min((uint64_t)(m_end - m_begin), size);
+        memcpy(&storage[old], &m_buf[0] + m_begin, have);
+        m_begin += have;
+        if (have < size && !recvFully(&storage[old + have], size - have)) {
+            return false;
+        }
+
+        //数据后面的\r\n
+        if (!read_line(line)) {
+            return false;
+        }
+        if (!line.empty()) {
+            m_error = 400;
+            return false;
+        }
+    }
+}
+
+bool HttpStream::readUntilClose(uint64_t max_body, std::string& storage) {
+    storage.assign(&m_buf[0] + m_begin, m_end - m_begin);
+    m_begin = m_end;
+    if (!beforeRecv()) {
+        return false;
+    }
+    size_t len = storage.size();
+    while (true) {
+        if (len > max_body) {
+            m_error = 413;
+            return false;
+        }
+        storage.resize(std::max(len + m_buf.size(), storage.capacity()));
+        ssize_t n = m_sock->recv(&storage[len], storage.size() - len);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            return false;
+        }
+        len += n;
+    }
+    storage.resize(len);
+    return true;
+}
+
+bool HttpStream::writeFully(iovec* iov, size_t count) {
+    while (count > 0) {
+        ssize_t n = m_sock->send(iov, count);
+        if (n <= 0) {
+            CHPE_LOG_DEBUG(g_logger) << "http write error n=" << n << " errno=" << errno
+                << " errstr=" << strerror(errno) << " " << *m_sock;
+            return false;
+        }
+        //跳过已经写完的，写了一半的那个往后挪
+        size_t left = n;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+}
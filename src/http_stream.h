@@ -0,0 +1,91 @@
+#ifndef __HTTP_STREAM_H__
+#define __HTTP_STREAM_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#include "socket.h"
+#include "http_parser.h"
+
+namespace cpp_high_perf {
+
+//一条http连接的收发，服务端的HttpSession和客户端的HttpConnection共用
+//收: 一个固定大小的缓冲区，一次recv可能收到好几个消息(pipeline)，解析出来的消息直接指向缓冲区，
+//    只有缓冲区里没有完整的消息要再收的时候，才把剩下的半个消息挪到缓冲区开头，所以上一个消息这时候必须已经处理完了
+//    body放得下就留在缓冲区里；放不下的时候收进消息自己的bodyStorage，chunked的也解码到bodyStorage里
+//发: 消息头和body分成两个iovec，用sendmsg一起发出去，不拼接
+class HttpStream {
+public:
+    typedef std::shared_ptr<HttpStream> ptr;
+
+    //buffer_size也是消息头的长度上限
+    HttpStream(Socket::ptr sock, size_t buffer_size);
+    virtual ~HttpStream();
+
+    HttpStream(const HttpStream&) = delete;
+    HttpStream& operator=(const HttpStream&) = delete;
+
+    Socket::ptr getSocket() const { return m_sock; }
+    bool isConnected() const { return m_sock && m_sock->isConnected(); }
+    void close();
+
+    //缓冲区里还有没处理的数据(pipeline过来的下一个消息)
+    bool hasBufferedData() const { return m_end > m_begin; }
+    //上一次收消息失败的原因: 0是连接断了/超时，其他是解析出错对应的状态码
+    int getError() const { return m_error; }
+protected:
+    //收消息头，头交给parser解析，头收全了就从缓冲区里消费掉，返回头的长度，失败返回-1
+    int readHead(HttpParser& parser);
+    //按parser解析出来的结果收body，Msg是HttpRequest或者HttpResponse
+    //until_close为true的时候(响应既没有长度也不是chunked)一直收到连接关闭
+    template<class Msg>
+    bool readBody(const HttpParser& parser, Msg& msg, uint64_t max_body, bool until_close);
+    //所有数据都写出去，处理只写了一部分的情况，iov会被改掉
+    bool writeFully(iovec* iov, size_t count);
+    //要从socket收数据之前调用，HttpSession在这里把攒着的响应先发出去
+    virtual bool beforeRecv() { return true; }
+private:
+    //storage是消息自己的bodyStorage
+    bool readFixedBody(uint64_t length, StringView& body, std::string& storage);
+    bool readChunkedBody(uint64_t max_body, std::string& storage);
+    bool readUntilClose(uint64_t max_body, std::string& storage);
+    //缓冲区后面没地方了先把没处理的挪到开头，再收一次，收到0或者出错返回false
+    bool fill();
+    //从socket收到buf里，收满len个字节
+    bool recvFully(char* buf, size_t len);
+protected:
+    Socket::ptr m_sock;
+    std::vector<char> m_buf;
+    size_t m_begin = 0;//没处理的数据的开头
+    size_t m_end = 0;//数据的结尾
+    int m_error = 0;
+};
+
+template<class Msg>
+bool HttpStream::readBody(const HttpParser& parser, Msg& msg, uint64_t max_body, bool until_close) {
+    if (parser.isChunked()) {
+        //要一边收一边解码，缓冲区会被挪动，先把头拷出来
+        msg.detach();
+        if (!readChunkedBody(max_body, msg.bodyStorage())) {
+            return false;
+        }
+        msg.setBodyRef(StringView(msg.bodyStorage()));
+    } else if (until_close) {
+        if (!readUntilClose(max_body, msg.bodyStorage())) {
+            return false;
+        }
+        msg.setBodyRef(StringView(msg.bodyStorage()));
+    } else if (parser.getContentLength()) {
+        StringView body;
+        if (!readFixedBody(parser.getContentLength(), body, msg.bodyStorage())) {
+            return false;
+        }
+        msg.setBodyRef(body);
+    }
+    return true;
+}
+
+}
+
+#endif
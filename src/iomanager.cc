@@ -0,0 +1,341 @@
+#include "iomanager.h"
+#include "log.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <assert.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+IOManager::FdContext::EventContext& IOManager::FdContext::getContext(Event event) {
+    switch (event) {
+        case IOManager::READ:
+            return read;
+        case IOManager::WRITE:
+            return write;
+        default:
+            assert(false && "getContext");
+    }
+    return read;
+}
+
+void IOManager::FdContext::resetContext(EventContext& ctx) {
+    ctx.scheduler = nullptr;
+    ctx.fiber.reset();
+    ctx.cb = nullptr;
+}
+
+void IOManager::FdContext::triggerEvent(Event event) {
+    assert(events & event);
+    events = (Event)(events & ~event);
+    EventContext& ctx = getContext(event);
+    if (ctx.cb) {
+        ctx.scheduler->schedule(&ctx.cb);
+    } else {
+        ctx.scheduler->schedule(&ctx.fiber);
+    }
+    ctx.scheduler = nullptr;
+}
+
+IOManager::IOManager(size_t threads, bool use_caller, const std::string& name)
+    :Scheduler(threads, use_caller, name) {
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    assert(m_epfd >= 0);
+
+    m_tickleFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(m_tickleFd >= 0);
+
+    //eventfd的data.ptr是空的，和fd上下文区分开
+    epoll_event event;
+    memset(&event, 0, sizeof(epoll_event));
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = nullptr;
+    int rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFd, &event);
+    assert(!rt);
+    (void)rt;
+
+    contextResize(64);
+    start();
+}
+
+IOManager::~IOManager() {
+    stop();
+    close(m_epfd);
+    close(m_tickleFd);
+    for (auto ctx : m_fdContexts) {
+        delete ctx;
+    }
+}
+
+void IOManager::contextResize(size_t size) {
+    static LockStats* s_fd_stats = LockStats::Get("iomanager.fd");
+    size_t old = m_fdContexts.size();
+    m_fdContexts.resize(size);
+    for (size_t i = old; i < size; ++i) {
+        m_fdContexts[i] = new FdContext;
+        m_fdContexts[i]->fd = i;
+        m_fdContexts[i]->mutex.setStats(s_fd_stats);
+    }
+}
+
+IOManager::FdContext* IOManager::getFdContext(int fd, bool create) {
+    if (fd < 0) {
+        return nullptr;
+    }
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if ((size_t)fd < m_fdContexts.size()) {
+            return m_fdContexts[fd];
+        }
+    }
+    if (!create) {
+        return nullptr;
+    }
+    RWMutexType::WriteLock lock(m_mutex);
+    if ((size_t)fd >= m_fdContexts.size()) {
+        contextResize(fd * 3 / 2 + 1);
+    }
+    return m_fdContexts[fd];
+}
+
+int IOManager::addEvent(int fd, Event event, std::function<void()> cb) {
+    FdContext* fd_ctx = getFdContext(fd, true);
+    if (!fd_ctx) {
+        return -1;
+    }
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (fd_ctx->events & event) {
+        CHPE_LOG_ERROR(g_logger) << "addEvent assert fd=" << fd << " event=" << event
+            << " fd_ctx.events=" << fd_ctx->events;
+        return -1;
+    }
+
+    int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epoll_event));
+    epevent.events = EPOLLET | fd_ctx->events | event;
+    epevent.data.ptr = fd_ctx;
+    if (epoll_ctl(m_epfd, op, fd, &epevent)) {
+        CHPE_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+            << epevent.events << "):" << errno << " (" << strerror(errno) << ")";
+        return -1;
+    }
+
+    ++m_pendingEventCount;
+    fd_ctx->events = (Event)(fd_ctx->events | event);
+    FdContext::EventContext& event_ctx = fd_ctx->getContext(event);
+    assert(!event_ctx.scheduler && !event_ctx.fiber && !event_ctx.cb);
+    //不是在调度器的线程里加的事件，就放到自己这里跑
+    event_ctx.scheduler = Scheduler::GetThis() ? Scheduler::GetThis() : this;
+    if (cb) {
+        event_ctx.cb.swap(cb);
+    } else {
+        event_ctx.fiber = Fiber::GetThis();
+        assert(event_ctx.fiber->getState() == Fiber::EXEC);
+    }
+    return 0;
+}
+
+bool IOManager::delEvent(int fd, Event event) {
+    FdContext* fd_ctx = getFdContext(fd, false);
+    if (!fd_ctx) {
+        return false;
+    }
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (!(fd_ctx->events & event)) {
+        return false;
+    }
+
+    Event new_events = (Event)(fd_ctx->events & ~event);
+    int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epoll_event));
+    epevent.events = EPOLLET | new_events;
+    epevent.data.ptr = fd_ctx;
+    if (epoll_ctl(m_epfd, op, fd, &epevent)) {
+        CHPE_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+            << epevent.events << "):" << errno << " (" << strerror(errno) << ")";
+        return false;
+    }
+
+    --m_pendingEventCount;
+    fd_ctx->events = new_events;
+    fd_ctx->resetContext(fd_ctx->getContext(event));
+    return true;
+}
+
+bool IOManager::cancelEvent(int fd, Event event) {
+    FdContext* fd_ctx = getFdContext(fd, false);
+    if (!fd_ctx) {
+        return false;
+    }
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (!(fd_ctx->events & event)) {
+        return false;
+    }
+
+    Event new_events = (Event)(fd_ctx->events & ~event);
+    int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epoll_event));
+    epevent.events = EPOLLET | new_events;
+    epevent.data.ptr = fd_ctx;
+    if (epoll_ctl(m_epfd, op, fd, &epevent)) {
+        CHPE_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+            << epevent.events << "):" << errno << " (" << strerror(errno) << ")";
+        return false;
+    }
+
+    fd_ctx->triggerEvent(event);
+    --m_pendingEventCount;
+    return true;
+}
+
+bool IOManager::cancelAll(int fd) {
+    FdContext* fd_ctx = getFdContext(fd, false);
+    if (!fd_ctx) {
+        return false;
+    }
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (!fd_ctx->events) {
+        return false;
+    }
+
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epoll_event));
+    epevent.data.ptr = fd_ctx;
+    if (epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, &epevent)) {
+        CHPE_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << EPOLL_CTL_DEL << ", " << fd
+            << "):" << errno << " (" << strerror(errno) << ")";
+        return false;
+    }
+
+    if (fd_ctx->events & READ) {
+        fd_ctx->triggerEvent(READ);
+        --m_pendingEventCount;
+    }
+    if (fd_ctx->events & WRITE) {
+        fd_ctx->triggerEvent(WRITE);
+        --m_pendingEventCount;
+    }
+    assert(fd_ctx->events == NONE);
+    return true;
+}
+
+IOManager* IOManager::GetThis() {
+    return dynamic_cast<IOManager*>(Scheduler::GetThis());
+}
+
+void IOManager::tickle(int worker) {
+    //大家睡在同一个epoll上，叫不了指定的线程，叫醒一个；醒错了的在idle里会接着叫
+    if (!hasIdleThreads()) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t rt = write(m_tickleFd, &one, sizeof(one));
+    if (rt != sizeof(one)) {
+        CHPE_LOG_ERROR(g_logger) << "IOManager tickle write fail, errno=" << errno;
+    }
+}
+
+bool IOManager::stopping() {
+    return m_pendingEventCount == 0 && !hasTimer() && Scheduler::stopping();
+}
+
+void IOManager::onTimerInsertedAtFront() {
+    tickle(-1);
+}
+
+void IOManager::idle() {
+    CHPE_LOG_DEBUG(g_logger) << getName() << " idle worker=" << GetWorkerIndex();
+    static const int MAX_EVENTS = 256;
+    static const int MAX_TIMEOUT = 3000;
+    std::unique_ptr<epoll_event[]> events(new epoll_event[MAX_EVENTS]);
+    int worker = GetWorkerIndex();
+
+    while (true) {
+        if (stopping()) {
+            CHPE_LOG_DEBUG(g_logger) << getName() << " idle stopping exit, worker=" << worker;
+            break;
+        }
+
+        //进idle之前已经加了空闲计数，再看一眼有没有活，有的话就不睡了(和schedule那边配对，不会丢唤醒)
+        int timeout = 0;
+        if (!hasWork(worker)) {
+            uint64_t next_timeout = getNextTimer();
+            timeout = next_timeout < (uint64_t)MAX_TIMEOUT ? (int)next_timeout : MAX_TIMEOUT;
+        }
+        int rt = 0;
+        do {
+            rt = epoll_wait(m_epfd, events.get(), MAX_EVENTS, timeout);
+        } while (rt < 0 && errno == EINTR);
+
+        std::vector<std::function<void()>> cbs;
+        listExpiredCb(cbs);
+        if (!cbs.empty()) {
+            schedule(cbs.begin(), cbs.end());
+        }
+
+        bool tickled = false;
+        for (int i = 0; i < rt; ++i) {
+            epoll_event& event = events[i];
+            if (event.data.ptr == nullptr) {
+                uint64_t dummy;
+                while (read(m_tickleFd, &dummy, sizeof(dummy)) > 0);
+                tickled = true;
+                continue;
+            }
+
+            FdContext* fd_ctx = (FdContext*)event.data.ptr;
+            FdContext::MutexType::Lock lock(fd_ctx->mutex);
+            //出错或者对端关闭了，读写都要叫醒，让它们自己去read/write拿到错误
+            if (event.events & (EPOLLERR | EPOLLHUP)) {
+                event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->events;
+            }
+            int real_events = NONE;
+            if (event.events & EPOLLIN) {
+                real_events |= READ;
+            }
+            if (event.events & EPOLLOUT) {
+                real_events |= WRITE;
+            }
+            if ((fd_ctx->events & real_events) == NONE) {
+                continue;
+            }
+
+            int left_events = (fd_ctx->events & ~real_events);
+            int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+            event.events = EPOLLET | left_events;
+            int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
+            if (rt2) {
+                CHPE_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd_ctx->fd << ", "
+                    << event.events << "):" << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
+                continue;
+            }
+
+            if (real_events & READ) {
+                fd_ctx->triggerEvent(READ);
+                --m_pendingEventCount;
+            }
+            if (real_events & WRITE) {
+                fd_ctx->triggerEvent(WRITE);
+                --m_pendingEventCount;
+            }
+        }
+
+        //被叫醒的可能不是收件箱里有活的那个线程，自己有没有活都要接着叫，
+        //不然那个线程要睡到epoll_wait超时(最多3秒)，比如同时往两个线程各放一个指定线程的任务
+        if (tickled && hasPinnedWorkForIdle(worker)) {
+            tickle(-1);
+        }
+
+        //回到run里面去跑任务
+        Fiber::YieldToHold();
+    }
+}
+
+}
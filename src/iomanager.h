@@ -0,0 +1,87 @@
+#ifndef __IOMANAGER_H__
+#define __IOMANAGER_H__
+
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <sys/epoll.h>
+#include "scheduler.h"
+#include "timer.h"
+#include "mutex.h"
+
+namespace cpp_high_perf {
+
+//基于epoll的io调度器，协程可以挂在fd的读/写事件上，事件来了再被调度回来接着跑
+//epoll用边缘触发，一个事件触发一次之后就从epoll里去掉，想再等要重新addEvent
+//没活的工作线程都睡在epoll_wait上，有新任务的时候往eventfd里写一下把它们叫醒
+//fd的上下文放在按fd下标的数组里，不用map查
+//同时也是定时器管理器，epoll_wait的超时时间就是最近一个定时器到期的时间
+class IOManager : public Scheduler, public TimerManager {
+public:
+    typedef std::shared_ptr<IOManager> ptr;
+    typedef RWMutex RWMutexType;
+
+    enum Event {
+        NONE  = 0x0,
+        READ  = EPOLLIN,
+        WRITE = EPOLLOUT
+    };
+private:
+    //一个fd上的事件
+    struct FdContext {
+        typedef Mutex MutexType;
+        struct EventContext {
+            Scheduler* scheduler = nullptr;//事件在哪个调度器上执行
+            Fiber::ptr fiber;//等事件的协程
+            std::function<void()> cb;//或者是回调
+        };
+
+        EventContext& getContext(Event event);
+        void resetContext(EventContext& ctx);
+        //事件来了，把协程/回调放回调度器，并且把这个事件去掉
+        void triggerEvent(Event event);
+
+        EventContext read;
+        EventContext write;
+        int fd = 0;
+        Event events = NONE;//现在注册了的事件
+        MutexType mutex;
+    };
+public:
+    //构造完就start了
+    IOManager(size_t threads = 1, bool use_caller = true, const std::string& name = "");
+    ~IOManager();
+
+    //cb为空的时候等事件的是当前协程，调用完要自己YieldToHold；成功返回0，失败返回-1
+    int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+    //去掉事件，不触发
+    bool delEvent(int fd, Event event);
+    //去掉事件，并且触发一次(等的协程会被叫醒)
+    bool cancelEvent(int fd, Event event);
+    //去掉fd上所有的事件，都触发一次
+    bool cancelAll(int fd);
+
+    //还在等的事件数
+    size_t getPendingEventCount() const { return m_pendingEventCount; }
+
+    static IOManager* GetThis();
+protected:
+    void tickle(int worker) override;
+    bool stopping() override;
+    void idle() override;
+    void onTimerInsertedAtFront() override;
+
+    void contextResize(size_t size);
+    //create为true的时候没有就创建
+    FdContext* getFdContext(int fd, bool create);
+private:
+    int m_epfd = -1;
+    int m_tickleFd = -1;//eventfd
+    std::atomic<size_t> m_pendingEventCount{0};
+    RWMutexType m_mutex;//只保护m_fdContexts扩容
+    std::vector<FdContext*> m_fdContexts;
+};
+
+}
+
+#endif
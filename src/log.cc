@@ -1,4 +1,5 @@
 #include "log.h"
+#include "config.h"
 #include <cstddef>
 #include <memory>
 #include <string>
@@ -7,6 +8,7 @@
 #include <thread>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 namespace cpp_high_perf {
 
@@ -31,22 +33,180 @@ const char* LogLevel::ToString(LogLevel::Level level) {
     return "UNKNOW";
 }
 
-LogEventWrap::LogEventWrap(LogEvent::ptr e) : m_event(e) {
+LogLevel::Level LogLevel::FromString(const std::string& str) {
+    std::string v = str;
+    std::transform(v.begin(), v.end(), v.begin(), ::toupper);
+#define XX(name) \
+    if (v == #name) { \
+        return LogLevel::name; \
+    }
+    XX(DEBUG);
+    XX(INFO);
+    XX(WARN);
+    XX(ERROR);
+    XX(FATAL);
+#undef XX
+    return LogLevel::UNKNOW;
+}
+
+LogStream& LogStream::operator<<(long long v) {
+    if (avail() >= 21) {
+        m_len += Int64ToStr(m_buf + m_len, v);
+    } else {
+        char tmp[24];
+        append(tmp, Int64ToStr(tmp, v));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(unsigned long long v) {
+    if (avail() >= 21) {
+        m_len += Uint64ToStr(m_buf + m_len, v);
+    } else {
+        char tmp[24];
+        append(tmp, Uint64ToStr(tmp, v));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(double v) {
+    char tmp[32];
+    int len = snprintf(tmp, sizeof(tmp), "%g", v);//和ostream默认的精度一样
+    if (len > 0) {
+        append(tmp, std::min((size_t)len, sizeof(tmp) - 1));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const void* v) {
+    char tmp[32];
+    int len = snprintf(tmp, sizeof(tmp), "%p", v);
+    if (len > 0) {
+        append(tmp, std::min((size_t)len, sizeof(tmp) - 1));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const char* v) {
+    if (v) {
+        append(v, strlen(v));
+    } else {
+        append("(null)", 6);
+    }
+    return *this;
+}
 
+LogStream& LogStream::operator<<(std::ostream& (*pf)(std::ostream&)) {
+    std::ostream& os = beginOstream();
+    pf(os);
+    endOstream();
+    return *this;
+}
+
+namespace {
+//直接写到LogStream剩余空间里的streambuf，写满了就失败，不会扩容
+class LogStreamBuf : public std::streambuf {
+public:
+    void reset(char* begin, char* end) { setp(begin, end); }
+    size_t written() const { return pptr() - pbase(); }
+protected:
+    int_type overflow(int_type c) override { return traits_type::eof(); }
+};
+
+struct LogOstream {
+    LogStreamBuf buf;
+    std::ostream os;
+    LogOstream() : os(&buf) {}
+};
+
+static thread_local LogOstream t_log_ostream;
+static thread_local LogStream* t_log_ostream_owner = nullptr;
+}
+
+std::ostream& LogStream::beginOstream() {
+    t_log_ostream_owner = this;
+    t_log_ostream.buf.reset(m_buf + m_len, m_buf + kCapacity);
+    t_log_ostream.os.clear();
+    return t_log_ostream.os;
+}
+
+void LogStream::endOstream() {
+    if (t_log_ostream_owner == this) {
+        m_len += t_log_ostream.buf.written();
+        t_log_ostream_owner = nullptr;
+    }
+}
+
+namespace {
+//线程局部的LogEvent对象池，稳定之后宏里面不会再new
+struct LogEventPool {
+    static const size_t kMaxSize = 16;
+    std::vector<LogEvent*> free;
+    ~LogEventPool() {
+        for (auto& i : free) {
+            delete i;
+        }
+    }
+};
+
+static thread_local LogEventPool t_event_pool;
+}
+
+LogEventWrap::LogEventWrap(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line) {
+    if (t_event_pool.free.empty()) {
+        m_event = new LogEvent;
+    } else {
+        m_event = t_event_pool.free.back();
+        t_event_pool.free.pop_back();
+    }
+    m_event->reset(std::move(logger), level, file, line, GetElapseMS(), GetThreadId(), GetFiberId(),
+            GetCurrentUS(), &Thread::GetName());
+}
+
+LogEventWrap::LogEventWrap(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line, uint64_t elapse
+            , uint32_t thread_id, uint32_t fiber_id, uint64_t time) {
+    if (t_event_pool.free.empty()) {
+        m_event = new LogEvent;
+    } else {
+        m_event = t_event_pool.free.back();
+        t_event_pool.free.pop_back();
+    }
+    m_event->reset(logger, level, file, line, elapse, thread_id, fiber_id, time, &Thread::GetName());
 }
 
 LogEventWrap::~LogEventWrap() {
-    m_event->getLogger()->log(m_event->getLevel(), m_event);
+    m_event->getLogger()->log(m_event->getLevel(), *m_event);
+    //还回去之前把logger放掉，不然池子里会一直拿着logger的引用
+    m_event->reset(nullptr, LogLevel::UNKNOW, nullptr, 0, 0, 0, 0, 0);
+    if (t_event_pool.free.size() < LogEventPool::kMaxSize) {
+        t_event_pool.free.push_back(m_event);
+    } else {
+        delete m_event;
+    }
 }
 
-std::stringstream& LogEventWrap::getSS() {
+LogStream& LogEventWrap::getSS() {
     return m_event->getSS();
 }
 
-LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t m_line, uint32_t elapse
-            , uint32_t thread_id, uint32_t fiber_id, uint64_t time)
+LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t m_line, uint64_t elapse
+            , uint32_t thread_id, uint32_t fiber_id, uint64_t time, const std::string* thread_name)
             :m_logger(logger), m_level(level), m_file(file), m_line(m_line), m_elapse(elapse), m_threadId(thread_id), 
-            m_fiberId(fiber_id), m_time(time) {}
+            m_fiberId(fiber_id), m_time(time), m_threadName(thread_name) {}
+
+void LogEvent::reset(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line, uint64_t elapse
+            , uint32_t thread_id, uint32_t fiber_id, uint64_t time, const std::string* thread_name) {
+    m_logger = std::move(logger);
+    m_level = level;
+    m_file = file;
+    m_line = line;
+    m_elapse = elapse;
+    m_threadId = thread_id;
+    m_fiberId = fiber_id;
+    m_time = time;
+    m_threadName = thread_name;
+    m_ss.clear();
+}
 
 void LogEvent::format(const char* fmt, ...) {
     va_list al;
@@ -56,219 +216,403 @@ void LogEvent::format(const char* fmt, ...) {
 }
 
 void LogEvent::format(const char* fmt, va_list al) {
-    char *buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);
-    if (len != -1) {
-        m_ss << std::string(buf, len);
-        free(buf);
+    //直接格式化到内联缓冲区里，放不下就截断
+    size_t avail = m_ss.avail();
+    if (avail == 0) {
+        return;
+    }
+    int len = vsnprintf(m_ss.current(), avail, fmt, al);
+    if (len > 0) {
+        m_ss.add(std::min((size_t)len, avail - 1));
     }
 }
 
 //在头文件指定默认值，在cpp文件就不应该再指定了
-Logger::Logger(const std::string& name):m_name(name), m_level(LogLevel::DEBUG) {
-    m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
+//logger默认的日志格式
+static const char* s_default_pattern = "%d{%Y-%m-%d %H:%M:%S.%ms}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+Logger::Logger(const std::string& name):m_name(name), m_level(LogLevel::DEBUG), m_effectiveLevel(LogLevel::DEBUG)
+    , m_appenders(new AppenderList) {
+    m_formatter.reset(new LogFormatter(s_default_pattern));
+}
+
+//logger树的锁，只有改级别和建logger的时候用，写日志不碰它
+//函数里的静态变量，别的编译单元静态初始化的时候拿logger也不会用到没构造的锁
+static Mutex& GetHierarchyMutex() {
+    static Mutex s_mutex;
+    return s_mutex;
+}
+
+void Logger::setLevel(LogLevel::Level val) {
+    Mutex::Lock lock(GetHierarchyMutex());
+    m_level = val;
+    updateEffectiveLevel();
+}
+
+void Logger::updateEffectiveLevel() {
+    LogLevel::Level level = m_level;
+    if (level == LogLevel::UNKNOW) {
+        level = m_parent ? m_parent->getLevel() : LogLevel::DEBUG;
+    }
+    m_effectiveLevel.store(level, std::memory_order_relaxed);
+    for (auto& i : m_children) {
+        i->updateEffectiveLevel();
+    }
+}
+
+std::shared_ptr<const Logger::AppenderList> Logger::getEffectiveAppenders() {
+    auto appenders = getAppenders();
+    Logger* l = m_parent.get();
+    while (appenders->empty() && l) {
+        appenders = l->getAppenders();
+        l = l->m_parent.get();
+    }
+    return appenders;
+}
+
+std::shared_ptr<const Logger::AppenderList> Logger::getAppenders() {
+    Spinlock::Lock lock(m_mutex);
+    return m_appenders;
 }
 
 void Logger::addAppender(LogAppender::ptr appender) {
-    if (!appender->getFormatter()) {
-        appender->setFormatter(m_formatter);//来保证每个都有格式器
+    Spinlock::Lock lock(m_mutex);
+    {
+        LogAppender::MutexType::Lock alock(appender->m_mutex);
+        if (!appender->m_hasFormatter) {
+            appender->m_formatter = m_formatter;//来保证每个都有格式器
+        }
     }
-    m_appenders.push_back(appender);
+    //拷贝一份再改，不动正在被别的线程遍历的旧列表
+    std::shared_ptr<AppenderList> list(new AppenderList(*m_appenders));
+    list->push_back(appender);
+    m_appenders = list;
 }
 
 void Logger::delAppender(LogAppender::ptr appender) {
-    for (auto it = m_appenders.begin(); it != m_appenders.end(); ++it) {
-        if (*it == appender) {
-            m_appenders.erase(it);
-            break;
+    Spinlock::Lock lock(m_mutex);
+    auto it = std::find(m_appenders->begin(), m_appenders->end(), appender);
+    if (it == m_appenders->end()) {
+        return;
+    }
+    std::shared_ptr<AppenderList> list(new AppenderList(*m_appenders));
+    list->erase(list->begin() + (it - m_appenders->begin()));
+    m_appenders = list;
+}
+
+void Logger::setAppenders(const std::vector<LogAppender::ptr>& appenders) {
+    Spinlock::Lock lock(m_mutex);
+    for (auto& i : appenders) {
+        LogAppender::MutexType::Lock alock(i->m_mutex);
+        if (!i->m_hasFormatter) {
+            i->m_formatter = m_formatter;
+        }
+    }
+    m_appenders.reset(new AppenderList(appenders));
+}
+
+void Logger::clearAppenders() {
+    Spinlock::Lock lock(m_mutex);
+    m_appenders.reset(new AppenderList);
+}
+
+void Logger::setFormatter(LogFormatter::ptr val) {
+    Spinlock::Lock lock(m_mutex);
+    m_formatter = val;
+    for (auto& i : *m_appenders) {
+        LogAppender::MutexType::Lock alock(i->m_mutex);
+        if (!i->m_hasFormatter) {
+            i->m_formatter = m_formatter;
         }
     }
 }
 
-void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
+bool Logger::setFormatter(const std::string& val) {
+    LogFormatter::ptr fmt(new LogFormatter(val));
+    if (fmt->isError()) {
+        std::cout << "Logger setFormatter name=" << m_name << " value=" << val << " invalid formatter" << std::endl;
+        return false;
+    }
+    setFormatter(fmt);
+    return true;
+}
+
+LogFormatter::ptr Logger::getFormatter() {
+    Spinlock::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+void Logger::log(LogLevel::Level level, const LogEvent& event) {
     //输出大于等于日志级别的日志
-    if (level >= m_level) {
-        auto self = shared_from_this();//获取指向当前对象的shared_ptr
-        for (auto& i : m_appenders) {
-            i->log(self, level, event);//这个是appenders的输出函数
+    if (level >= getLevel()) {
+        if (m_async) {
+            //异步模式只进缓冲区，格式化和写文件都交给刷新线程
+            AsyncLogFlusherMgr::GetInstance()->push(shared_from_this(), level, event);
+        } else {
+            callAppenders(level, event);
         }
     }
 }
 
-void Logger::debug(LogEvent::ptr event) {
+void Logger::callAppenders(LogLevel::Level level, const LogEvent& event) {
+    auto self = shared_from_this();//获取指向当前对象的shared_ptr
+    auto appenders = getEffectiveAppenders();
+    for (auto& i : *appenders) {
+        i->log(self, level, event);//这个是appenders的输出函数
+    }
+}
+
+void Logger::flush() {
+    if (m_async) {
+        AsyncLogFlusherMgr::GetInstance()->flush();
+    }
+    flushAppenders();
+}
+
+void Logger::flushAppenders() {
+    auto appenders = getEffectiveAppenders();
+    for (auto& i : *appenders) {
+        i->flush();
+    }
+}
+
+void Logger::debug(const LogEvent& event) {
     log(LogLevel::DEBUG, event);
 }
 
-void Logger::info(LogEvent::ptr event) {
+void Logger::info(const LogEvent& event) {
     log(LogLevel::INFO, event);
 }
 
-void Logger::warn(LogEvent::ptr event) {
+void Logger::warn(const LogEvent& event) {
     log(LogLevel::WARN, event);
 }
 
-void Logger::error(LogEvent::ptr event) {
+void Logger::error(const LogEvent& event) {
     log(LogLevel::ERROR, event);
 }
 
-void Logger::fatal(LogEvent::ptr event) {
+void Logger::fatal(const LogEvent& event) {
     log(LogLevel::FATAL, event);
 }
 
-FileLogAppender::FileLogAppender(const std::string& filename):m_filename(filename) {
-    reopen();
+FileLogAppender::FileLogAppender(const std::string& filename, const LogRotateConfig& rotate)
+    :m_filename(filename)
+    ,m_file(LogFile::Get(filename)) {
+    m_file->setRotateConfig(rotate);
+    //没攒满的缓冲区靠日志刷新线程定时写出去
+    AsyncLogFlusherMgr::GetInstance();
 }
 
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+//appender格式化用的线程局部缓冲区，clear之后容量还在
+static thread_local std::string t_format_buffer;
+
+void LogAppender::setFormatter(LogFormatter::ptr val) {
+    MutexType::Lock lock(m_mutex);
+    m_formatter = val;
+    m_hasFormatter = !!val;
+}
+
+LogFormatter::ptr LogAppender::getFormatter() {
+    MutexType::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+const std::string& LogAppender::formatEvent(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent& event) {
+    t_format_buffer.clear();
+    LogFormatter::ptr fmt = getFormatter();
+    if (fmt) {
+        fmt->format(t_format_buffer, logger, level, event);
+    }
+    return t_format_buffer;
+}
+
+void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, const LogEvent& event) {
     if (level >= m_level) {
-        m_filestream << m_formatter->format(logger, level, event);
+        const std::string& str = formatEvent(logger, level, event);
+        //写和切分都在LogFile自己的锁里面，几个appender写同一个文件也不会交错
+        m_file->write(str.data(), str.size(), event.getTime(), level >= LogLevel::ERROR);
     }
 }
 
+void FileLogAppender::flush() {
+    m_file->flush();
+}
+
 bool FileLogAppender::reopen() {
-    if (m_filestream) {//是来写入文件的
-        m_filestream.close();
-    }
-    m_filestream.open(m_filename);
-    return !!m_filestream;//相当于is_open(), !!转换数据类型
+    return m_file->reopen();
+}
+
+StdoutLogAppender::StdoutLogAppender()
+    :m_sink(LogSink::Stdout()) {
+    AsyncLogFlusherMgr::GetInstance();
 }
 
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, const LogEvent& event) {
     if (level >= m_level) {
-        std::string str = m_formatter->format(logger, level, event);
-        std::cout << str << std::endl;
+        const std::string& str = formatEvent(logger, level, event);
+        m_sink->write(str.data(), str.size(), event.getTime(), level >= LogLevel::ERROR);
     }
 }
 
+void StdoutLogAppender::flush() {
+    m_sink->flush();
+}
+
 LogFormatter::LogFormatter(const std::string& pattern):m_pattern(pattern) {
     //初始化一下打印的格式吧,也就是标准的日志格式
     init();//来进行解析日志格式的
 }
 
-std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
-    std::stringstream ss;
-    for (auto& i : m_items) {
-        i->format(ss, logger, level, event);
-    }
-    return ss.str();
+std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, const LogEvent& event) {
+    std::string str;
+    format(str, logger, level, event);
+    return str;
 }
 
-class MessageFormatItem : public LogFormatter::FormatItem {
-    public:
-    MessageFormatItem(const std::string& str = "") {}
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            os << event->getContent();
-        }
-};
-
-class LevelFormatItem : public LogFormatter::FormatItem {
-    public:
-        LevelFormatItem(const std::string& str = "") {}
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            os << LogLevel::ToString(level);
-        }
-};
-
-class ElapseFormatItem : public LogFormatter::FormatItem {
-    public:
-        ElapseFormatItem(const std::string& str = "") {}
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            os << event->getElapse();
-        }
+namespace {
+//时间前缀按秒缓存，同一秒内的日志直接拷贝，不用每条都localtime_r + strftime
+//按DateFormat的id直接映射到槽位上，每个线程一份，不需要加锁
+struct DateCache {
+    uint64_t id = 0;
+    time_t sec = -1;
+    size_t len = 0;
+    uint16_t ends[8];//每一段parts在buf里的结束位置
+    char buf[64];
 };
+static const size_t s_date_cache_size = 8;
+static thread_local DateCache t_date_cache[s_date_cache_size];
+static std::atomic<uint64_t> s_date_format_id{0};
 
-class NameFormatItem : public LogFormatter::FormatItem {
-    public:
-        NameFormatItem(const std::string& str = "") {}
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            os << logger->getName();
-        }
-};
+void append_int(std::string& out, int64_t v) {
+    char buf[24];
+    out.append(buf, Int64ToStr(buf, v));
+}
 
-class ThreadIdFormatItem : public LogFormatter::FormatItem {
-    public:
-        ThreadIdFormatItem(const std::string& str = "") {}
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            os << event->getThreadId();
-        }
-};
+void append_uint(std::string& out, uint64_t v) {
+    char buf[24];
+    out.append(buf, Uint64ToStr(buf, v));
+}
 
-class FiberIdFormatItem : public LogFormatter::FormatItem {
-    public:
-        FiberIdFormatItem(const std::string& str = "") {}
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            os << event->getFiberId();
-        }
-};
+//补0到固定的位数
+void append_fixed(std::string& out, uint32_t v, int width) {
+    char buf[8];
+    for (int i = width - 1; i >= 0; --i) {
+        buf[i] = '0' + v % 10;
+        v /= 10;
+    }
+    out.append(buf, width);
+}
+}
 
-class DateTimeFormatItem : public LogFormatter::FormatItem {
-    public:
-        DateTimeFormatItem(const std::string& format = "%Y-%m-%d %H:%M:%S"):m_format(format) {
-            if (m_format.empty()) {
-                m_format = "%Y-%m-%d %H:%M:%S";
+LogFormatter::DateFormat LogFormatter::parseDateFormat(const std::string& fmt) {
+    DateFormat df;
+    df.fmt = fmt;
+    df.id = ++s_date_format_id;
+    std::string part;
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] == '%' && i + 1 < fmt.size()) {
+            //%%是strftime的转义，原样留给它
+            if (fmt[i + 1] == '%') {
+                part.append("%%");
+                ++i;
+                continue;
+            }
+            if (i + 2 < fmt.size() && fmt[i + 2] == 's' && (fmt[i + 1] == 'm' || fmt[i + 1] == 'u')
+                    && df.subSecond.size() < DateFormat::kMaxSubSecond) {
+                df.parts.push_back(part);
+                df.subSecond.push_back(fmt[i + 1] == 'm' ? 3 : 6);
+                part.clear();
+                i += 2;
+                continue;
             }
         }
-
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            struct tm tm;
-            time_t time = event->getTime();
-            localtime_r(&time, &tm);
-            char buf[64];
-            strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-            os << buf;
-        }
-    private:
-        std::string m_format;
-};
-
-class FilenameFormatItem : public LogFormatter::FormatItem {
-    public:
-        FilenameFormatItem(const std::string& str = "") {}
-        void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level,LogEvent::ptr event) override {
-            os << event->getFile();
-        }
-};
-
-class LineFormatItem : public LogFormatter::FormatItem {
-public:
-    LineFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getLine();
-    }
-};
-
-class NewLineFormatItem : public LogFormatter::FormatItem {
-public:
-    NewLineFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-        os << std::endl;
+        part.push_back(fmt[i]);
     }
-};
-
-class StringFormatItem : public LogFormatter::FormatItem {
-public:
-    StringFormatItem(const std::string& str)
-        :m_string(str) {}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-        os << m_string;
-    }
-private:
-    std::string m_string;
-};
+    df.parts.push_back(part);
+    return df;
+}
 
-class TabFormatItem : public LogFormatter::FormatItem {
-public:
-    TabFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override {
-        os << "\t";
+void LogFormatter::format(std::string& out, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent& event) {
+    for (auto& op : m_ops) {
+        switch (op.code) {
+            case Op::LITERAL:
+                out.append(m_literals, op.offset, op.len);
+                break;
+            case Op::MESSAGE:
+                out.append(event.getStream().data(), event.getStream().size());
+                break;
+            case Op::LEVEL:
+                out.append(LogLevel::ToString(level));
+                break;
+            case Op::ELAPSE:
+                append_uint(out, event.getElapse());
+                break;
+            case Op::NAME:
+                out.append(logger->getName());
+                break;
+            case Op::THREAD_ID:
+                append_uint(out, event.getThreadId());
+                break;
+            case Op::THREAD_NAME:
+                if (event.getThreadName()) {
+                    out.append(*event.getThreadName());
+                }
+                break;
+            case Op::FIBER_ID:
+                append_uint(out, event.getFiberId());
+                break;
+            case Op::DATETIME: {
+                const DateFormat& df = m_dateFormats[op.offset];
+                time_t sec = event.getTime() / 1000000;
+                uint32_t usec = event.getTime() % 1000000;
+                DateCache& cache = t_date_cache[df.id % s_date_cache_size];
+                if (cache.id != df.id || cache.sec != sec) {
+                    struct tm tm;
+                    localtime_r(&sec, &tm);
+                    cache.len = 0;
+                    for (size_t i = 0; i < df.parts.size(); ++i) {
+                        if (!df.parts[i].empty()) {
+                            cache.len += strftime(cache.buf + cache.len, sizeof(cache.buf) - cache.len,
+                                    df.parts[i].c_str(), &tm);
+                        }
+                        cache.ends[i] = cache.len;
+                    }
+                    cache.id = df.id;
+                    cache.sec = sec;
+                }
+                size_t begin = 0;
+                for (size_t i = 0; i < df.parts.size(); ++i) {
+                    out.append(cache.buf + begin, cache.ends[i] - begin);
+                    begin = cache.ends[i];
+                    if (i < df.subSecond.size()) {
+                        if (df.subSecond[i] == 3) {
+                            append_fixed(out, usec / 1000, 3);
+                        } else {
+                            append_fixed(out, usec, 6);
+                        }
+                    }
+                }
+                break;
+            }
+            case Op::FILENAME:
+                if (event.getFile()) {
+                    out.append(event.getFile());
+                }
+                break;
+            case Op::LINE:
+                append_int(out, event.getLine());
+                break;
+            default:
+                break;
+        }
     }
-private:
-    std::string m_string;
-};
+}
 
 //主要是来区分用户给定的pattern这一个日志格式！是否是合法的！
 //比如 %xxx %xxx{xxx} %% 转义
 void LogFormatter::init() {
+    m_error = false;
     //解析pattern这一个日志格式的// m_pattern "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"
     //str, format, type
     std::vector<std::tuple<std::string, std::string, int>> vec;
@@ -337,6 +681,7 @@ void LogFormatter::init() {
         } else if (fmt_status == 1) {
             std::cout << "pattern parse error: " << m_pattern << " - " << m_pattern.substr(i) << std::endl;
             vec.push_back(std::make_tuple("<<pattern_error>>", fmt, 0));
+            m_error = true;
         }
     }
 
@@ -344,38 +689,65 @@ void LogFormatter::init() {
         vec.push_back(std::make_tuple(nstr, "", 0));//(e.g.) 最后一个字符为[ ] :(没搞懂nstr到底是啥东西呢)
     }
 
-    //创建一个静态的映射表 s_format_items，将字符串映射到创建 FormatItem 对象的函数上（返回的是智能指针）
-    static std::map<std::string, std::function<FormatItem::ptr(const std::string& str)> > s_format_items = {
-//传递进来了两个参数，str和C，其中的C是class参数
-#define XX(str, C) {#str, [](const std::string& fmt) {return FormatItem::ptr(new C(fmt));}}//就是初始化一个map不是
-        //{"m", [](const std::string& fmt) {return FormatItem::ptr(new MessageFormatItem(fmt));}},
-        
-        XX(m, MessageFormatItem),
-        XX(p, LevelFormatItem),
-        XX(r, ElapseFormatItem),
-        XX(c, NameFormatItem),
-        XX(t, ThreadIdFormatItem),
-        XX(n, NewLineFormatItem),
-        XX(d, DateTimeFormatItem),
-        XX(f, FilenameFormatItem),
-        XX(l, LineFormatItem),
-        XX(T, TabFormatItem),
-        XX(F, FiberIdFormatItem),
+    //每个格式字符对应的指令，%n %T是固定的字符，直接当成字面量
+    static std::map<std::string, int> s_format_ops = {
+#define XX(str, code) {#str, code}
+        XX(m, Op::MESSAGE),
+        XX(p, Op::LEVEL),
+        XX(r, Op::ELAPSE),
+        XX(c, Op::NAME),
+        XX(t, Op::THREAD_ID),
+        XX(N, Op::THREAD_NAME),
+        XX(d, Op::DATETIME),
+        XX(f, Op::FILENAME),
+        XX(l, Op::LINE),
+        XX(F, Op::FIBER_ID),
 #undef XX
     };
 
+    m_ops.clear();
+    m_literals.clear();
+    m_dateFormats.clear();
+
+    //追加一段字面量，和前一条字面量指令挨着的话直接合并
+    auto add_literal = [this](const std::string& str) {
+        if (str.empty()) {
+            return;
+        }
+        if (!m_ops.empty() && m_ops.back().code == Op::LITERAL
+                && m_ops.back().offset + m_ops.back().len == m_literals.size()) {
+            m_ops.back().len += str.size();
+        } else {
+            m_ops.push_back(Op{Op::LITERAL, (uint32_t)m_literals.size(), (uint32_t)str.size()});
+        }
+        m_literals.append(str);
+    };
+
     for(auto& i : vec) {
+        const std::string& str = std::get<0>(i);
         if(std::get<2>(i) == 0) {//这是得到type吧
-            //将解析出的FormatItem放到m_items中 [ ] :
-            m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(i))));
+            //[ ] : 之类的普通字符
+            add_literal(str);
+        } else if (str == "n") {
+            add_literal("\n");
+        } else if (str == "T") {
+            add_literal("\t");
         } else {
-            auto it = s_format_items.find(std::get<0>(i));//这个地方是来查找的
-            if (it == s_format_items.end()) {
+            auto it = s_format_ops.find(str);//这个地方是来查找的
+            if (it == s_format_ops.end()) {
                 //报错
                 std::cout << "!!!error_format!!!" << std::endl;
-                m_items.push_back(FormatItem::ptr(new StringFormatItem("<<error_format %" + std::get<0>(i) + ">>")));
+                add_literal("<<error_format %" + str + ">>");
+                m_error = true;
+            } else if (it->second == Op::DATETIME) {
+                std::string fmt = std::get<1>(i);
+                if (fmt.empty()) {
+                    fmt = "%Y-%m-%d %H:%M:%S";
+                }
+                m_ops.push_back(Op{Op::DATETIME, (uint32_t)m_dateFormats.size(), 0});
+                m_dateFormats.push_back(parseDateFormat(fmt));
             } else {
-                m_items.push_back(it->second(std::get<1>(i)));//这个地方是来创建的
+                m_ops.push_back(Op{(uint8_t)it->second, 0, 0});
             }
         }
     }
@@ -384,13 +756,339 @@ void LogFormatter::init() {
 LoggerManager::LoggerManager() {
     m_root.reset(new Logger);
     m_root->addAppender(LogAppender::ptr(new StdoutLogAppender));
+    m_loggers[m_root->getName()] = m_root;
 };
 
 Logger::ptr LoggerManager::getLogger(const std::string& name) {
-    auto it = m_loggers.find(name);
-    return it == m_loggers.end() ? m_root : it->second;
+    if (name.empty()) {
+        return m_root;
+    }
+    {
+        MutexType::ReadLock lock(m_mutex);
+        auto it = m_loggers.find(name);
+        if (it != m_loggers.end()) {
+            return it->second;
+        }
+    }
+
+    MutexType::WriteLock lock(m_mutex);
+    //从最上面一层开始，缺哪层建哪层
+    Logger::ptr parent = m_root;
+    size_t pos = 0;
+    while (true) {
+        pos = name.find('.', pos);
+        std::string sub = name.substr(0, pos);
+        auto it = m_loggers.find(sub);
+        if (it != m_loggers.end()) {
+            parent = it->second;
+        } else {
+            Logger::ptr logger(new Logger(sub));
+            logger->m_parent = parent;
+            logger->m_level = LogLevel::UNKNOW;
+            {
+                Mutex::Lock hlock(GetHierarchyMutex());
+                parent->m_children.push_back(logger.get());
+                logger->updateEffectiveLevel();
+            }
+            m_loggers[sub] = logger;
+            parent = logger;
+        }
+        if (pos == std::string::npos) {
+            break;
+        }
+        ++pos;
+    }
+    return parent;
+};
+
+static LogAppender::ptr create_appender(const LogAppenderDefine& define) {
+    LogAppender::ptr ap;
+    if (define.type == 1) {
+        FileLogAppender::ptr file(new FileLogAppender(define.file, define.rotate));
+        file->setSyncConfig(define.sync);
+        ap = file;
+    } else if (define.type == 2) {
+        ap.reset(new StdoutLogAppender);
+    } else {
+        return nullptr;
+    }
+    ap->setLevel(define.level);
+    if (!define.formatter.empty()) {
+        LogFormatter::ptr fmt(new LogFormatter(define.formatter));
+        if (fmt->isError()) {
+            std::cout << "log appender formatter invalid: " << define.formatter << std::endl;
+        } else {
+            ap->setFormatter(fmt);
+        }
+    }
+    return ap;
+}
+
+void LoggerManager::reload(const std::set<LogDefine>& defines) {
+    Mutex::Lock lock(m_reloadMutex);
+    for (auto& i : defines) {
+        auto it = m_defines.find(i);
+        if (it != m_defines.end() && *it == i) {
+            //没有变化的logger完全不动
+            continue;
+        }
+        applyDefine(i);
+    }
+    for (auto& i : m_defines) {
+        if (defines.find(i) == defines.end()) {
+            //配置里删掉的logger恢复成默认的样子
+            resetLogger(i.name);
+        }
+    }
+    m_defines = defines;
+}
+
+void LoggerManager::applyDefine(const LogDefine& define) {
+    Logger::ptr logger = getLogger(define.name);
+    //root没写级别就是DEBUG，其它的没写就继承父亲的
+    LogLevel::Level level = define.level;
+    if (level == LogLevel::UNKNOW && logger == m_root) {
+        level = LogLevel::DEBUG;
+    }
+    logger->setLevel(level);
+    if (define.formatter.empty() || !logger->setFormatter(define.formatter)) {
+        logger->setFormatter(s_default_pattern);
+    }
+
+    //配置没变的appender继续用原来的对象，只新建变了的
+    ConfiguredAppenders& old = m_configured[define.name];
+    std::vector<bool> used(old.size(), false);
+    ConfiguredAppenders now;
+    std::vector<LogAppender::ptr> appenders;
+    for (auto& i : define.appenders) {
+        LogAppender::ptr ap;
+        for (size_t k = 0; k < old.size(); ++k) {
+            if (!used[k] && old[k].first == i) {
+                ap = old[k].second;
+                used[k] = true;
+                break;
+            }
+        }
+        if (!ap) {
+            ap = create_appender(i);
+            if (!ap) {
+                std::cout << "log appender type invalid, logger=" << define.name << " type=" << i.type << std::endl;
+                continue;
+            }
+        }
+        now.push_back(std::make_pair(i, ap));
+        appenders.push_back(ap);
+    }
+
+    //从异步切回同步之前，先把缓冲区里的写出去，免得和后面的同步日志乱序
+    if (logger->isAsync() && !define.async) {
+        logger->flush();
+    }
+    logger->setAppenders(appenders);
+    logger->setAsync(define.async);
+    //不再用的appender先刷一下，缓冲的内容不丢
+    for (size_t k = 0; k < old.size(); ++k) {
+        if (!used[k]) {
+            old[k].second->flush();
+        }
+    }
+    old.swap(now);
+}
+
+void LoggerManager::resetLogger(const std::string& name) {
+    Logger::ptr logger = getLogger(name);
+    if (logger->isAsync()) {
+        logger->flush();
+    }
+    logger->setAsync(false);
+    logger->setFormatter(s_default_pattern);
+    if (logger == m_root) {
+        logger->setLevel(LogLevel::DEBUG);
+        logger->setAppenders({LogAppender::ptr(new StdoutLogAppender)});
+    } else {
+        logger->setLevel(LogLevel::UNKNOW);
+        logger->clearAppenders();
+    }
+    auto it = m_configured.find(name);
+    if (it != m_configured.end()) {
+        for (auto& i : it->second) {
+            i.second->flush();
+        }
+        m_configured.erase(it);
+    }
+}
+
+//配置文件里的logs，变化的时候更新logger
+static ConfigVar<std::set<LogDefine> >::ptr g_log_defines =
+    Config::lookup("logs", std::set<LogDefine>(), "logs config");
+
+struct LogIniter {
+    LogIniter() {
+        g_log_defines->addListener([](const std::set<LogDefine>& old_value,
+                    const std::set<LogDefine>& new_value) {
+            CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "on_logger_conf_changed";
+            LoggerMgr::GetInstance()->reload(new_value);
+        });
+    }
 };
 
+static LogIniter __log_init;
+
+void LoggerManager::init() {
+    reload(g_log_defines->getValue());
+}
+
+AsyncLogFlusher::AsyncLogFlusher() {
+    m_thread.reset(new Thread(std::bind(&AsyncLogFlusher::run, this), "log_flusher"));
+}
+
+AsyncLogFlusher::~AsyncLogFlusher() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    if (m_thread) {
+        m_thread->join();
+    }
+}
+
+//线程退出的时候把自己的缓冲区标记为dead，缓冲区本身由刷新器写完后回收
+namespace {
+struct ThreadBufferHolder {
+    std::shared_ptr<void> buf;
+    std::atomic<bool>* dead = nullptr;
+    ~ThreadBufferHolder() {
+        if (dead) {
+            *dead = true;
+        }
+    }
+};
+static thread_local ThreadBufferHolder t_buffer_holder;
+}
+
+AsyncLogFlusher::ThreadBuffer::ptr AsyncLogFlusher::getThreadBuffer() {
+    if (t_buffer_holder.buf) {
+        return std::static_pointer_cast<ThreadBuffer>(t_buffer_holder.buf);
+    }
+    ThreadBuffer::ptr buf(new ThreadBuffer);
+    buf->front.records.reserve(m_flushThreshold);
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.push_back(buf);
+    }
+    t_buffer_holder.buf = buf;
+    t_buffer_holder.dead = &buf->dead;
+    return buf;
+}
+
+void AsyncLogFlusher::push(Logger::ptr logger, LogLevel::Level level, const LogEvent& event) {
+    //线程局部缓冲区，只有刷新线程交换的时候才会竞争这把锁
+    ThreadBuffer* buf = static_cast<ThreadBuffer*>(t_buffer_holder.buf.get());
+    if (!buf) {
+        buf = getThreadBuffer().get();
+    }
+    size_t size = 0;
+    {
+        std::lock_guard<std::mutex> lock(buf->mutex);
+        Batch& b = buf->front;
+        if (b.records.size() >= m_maxPending) {
+            ++m_dropped;
+            return;
+        }
+        //把事件拷贝进来，日志内容追加到data后面
+        const LogStream& ss = event.getStream();
+        b.records.push_back(Record{logger, level, event.getFile(), event.getLine(), event.getElapse()
+                , event.getThreadId(), event.getFiberId(), event.getTime(), event.getThreadName()
+                , (uint32_t)b.data.size(), (uint32_t)ss.size()});
+        b.data.append(ss.data(), ss.size());
+        size = b.records.size();
+    }
+    //达到阈值就提前唤醒刷新线程，不用等到定时器
+    if (size == m_flushThreshold && !m_notified.exchange(true)) {
+        m_cond.notify_one();
+    }
+}
+
+size_t AsyncLogFlusher::flush() {
+    std::lock_guard<std::mutex> round(m_roundMutex);
+    std::vector<ThreadBuffer::ptr> buffers;
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        buffers = m_buffers;
+    }
+
+    size_t count = 0;
+    std::vector<Logger::ptr> loggers;//这一轮写过的logger，最后统一刷一次
+    for (auto& buf : buffers) {
+        {
+            //交换前后台缓冲区，被交换走的m_back已经clear过了，容量还保留着
+            std::lock_guard<std::mutex> lock(buf->mutex);
+            buf->front.swap(m_back);
+        }
+        for (auto& r : m_back.records) {
+            m_event.reset(r.logger, r.level, r.file, r.line, r.elapse, r.threadId, r.fiberId, r.time, r.threadName);
+            m_event.getSS().append(m_back.data.data() + r.offset, r.len);
+            r.logger->callAppenders(r.level, m_event);
+            if (std::find(loggers.begin(), loggers.end(), r.logger) == loggers.end()) {
+                loggers.push_back(r.logger);
+            }
+        }
+        count += m_back.records.size();
+        m_back.clear();
+    }
+    m_event.reset(nullptr, LogLevel::UNKNOW, nullptr, 0, 0, 0, 0, 0);
+
+    for (auto& i : loggers) {
+        i->flushAppenders();
+    }
+    m_flushed += count;
+
+    //回收已经退出的线程的缓冲区
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    for (auto it = m_buffers.begin(); it != m_buffers.end();) {
+        if ((*it)->dead) {
+            std::lock_guard<std::mutex> buf_lock((*it)->mutex);
+            if ((*it)->front.records.empty()) {
+                it = m_buffers.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+    return count;
+}
+
+uint64_t AsyncLogFlusher::getQueueDepth() {
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    uint64_t depth = 0;
+    for (auto& buf : m_buffers) {
+        std::lock_guard<std::mutex> buf_lock(buf->mutex);
+        depth += buf->front.records.size();
+    }
+    return depth;
+}
+
+void AsyncLogFlusher::run() {
+    while (true) {
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait_for(lock, std::chrono::milliseconds(m_flushInterval), [this]() {
+                return m_stop || m_notified;
+            });
+            m_notified = false;
+            stop = m_stop;
+        }
+        flush();
+        //同步写的logger攒在sink里的也一起刷出去
+        LogSink::FlushAll();
+        if (stop) {
+            break;
+        }
+    }
+}
+
 
 
 } 
\ No newline at end of file
@@ -3,21 +3,30 @@
 
 #include "singleton.h"
 #include "util.h"
+#include "mutex.h"
+#include "thread.h"
+#include "log_file.h"
 #include <bits/types/time_t.h>
 #include <cstdint>
 #include <string>
 #include <stdint.h>
 #include <memory>
 #include <stdarg.h>
+#include <string.h>
 #include <list>
 #include <sstream>
 #include <fstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
+//级别判断过了才去拿线程id、协程id、时间这些，都在LogEventWrap里面从线程局部的缓存取
 #define CHPE_LOG_LEVEL(logger, level) \
     if(logger->getLevel() <= level) \
-        cpp_high_perf::LogEventWrap(cpp_high_perf::LogEvent::ptr(new cpp_high_perf::LogEvent(logger, level, __FILE__, __LINE__, 0, cpp_high_perf::GetThreadId(), cpp_high_perf::GetFiberId(), time(0)))).getSS()
+        cpp_high_perf::LogEventWrap(logger, level, __FILE__, __LINE__).getSS()
 
 #define CHPE_LOG_DEBUG(logger) CHPE_LOG_LEVEL(logger, cpp_high_perf::LogLevel::DEBUG)
 #define CHPE_LOG_INFO(logger) CHPE_LOG_LEVEL(logger, cpp_high_perf::LogLevel::INFO)
@@ -27,7 +36,7 @@
 
 #define CHPE_LOG_FMT_LEVEL(logger, level, fmt, ...) \
     if(logger->getLevel() <= level) \
-        cpp_high_perf::LogEventWrap(cpp_high_perf::LogEvent::ptr(new cpp_high_perf::LogEvent(logger, level, __FILE__, __LINE__, 0, cpp_high_perf::GetThreadId(), cpp_high_perf::GetFiberId(), time(0)))).getEvent()->format(fmt, __VA_ARGS__)
+        cpp_high_perf::LogEventWrap(logger, level, __FILE__, __LINE__).getEvent()->format(fmt, __VA_ARGS__)
 
 #define CHPE_LOG_FMT_DEBUG(logger, fmt, ...) CHPE_LOG_FMT_LEVEL(logger, cpp_high_perf::LogLevel::DEBUG, fmt, __VA_ARGS__)
 #define CHPE_LOG_FMT_INFO(logger, fmt, ...) CHPE_LOG_FMT_LEVEL(logger, cpp_high_perf::LogLevel::INFO, fmt, __VA_ARGS__)
@@ -37,6 +46,8 @@
 
 //读取loggermanager里面的默认logger
 #define CHPE_LOG_ROOT() cpp_high_perf::LoggerMgr::GetInstance()->getRoot()
+//按名字拿logger，没有就创建，比如 CHPE_LOG_NAME("system.net.http")
+#define CHPE_LOG_NAME(name) cpp_high_perf::LoggerMgr::GetInstance()->getLogger(name)
 
 namespace cpp_high_perf {//命名空间设置为cpp_high_perf，避免命名冲突
 //shared_ptr是智能指针，可以自动释放内存，不需要手动释放，就像悬崖上面的安全绳，一个对象有很多根，最后一根没了对象就没了
@@ -54,59 +65,145 @@ public:
     };
 
     static const char* ToString(LogLevel::Level level);
+    //不区分大小写，认不出来返回UNKNOW
+    static LogLevel::Level FromString(const std::string& str);
 
 };
 
+//日志内容的流，用定长的内联缓冲区代替std::stringstream，写的时候不会申请内存
+//超过容量的部分直接截断
+class LogStream {
+public:
+    static const size_t kCapacity = 4096;
+
+    LogStream() {}
+
+    const char* data() const { return m_buf; }
+    size_t size() const { return m_len; }
+    size_t avail() const { return kCapacity - m_len; }
+    std::string toString() const { return std::string(m_buf, m_len); }
+    void clear() { m_len = 0; }
+
+    void append(const char* str, size_t len) {
+        if (len > avail()) {
+            len = avail();
+        }
+        memcpy(m_buf + m_len, str, len);
+        m_len += len;
+    }
+    //给vsnprintf之类的直接往里写
+    char* current() { return m_buf + m_len; }
+    void add(size_t len) { m_len += len; }
+
+    LogStream& operator<<(bool v) { return *this << (v ? '1' : '0'); }
+    LogStream& operator<<(char v) {
+        if (m_len < kCapacity) {
+            m_buf[m_len++] = v;
+        }
+        return *this;
+    }
+    LogStream& operator<<(signed char v) { return *this << (char)v; }
+    LogStream& operator<<(unsigned char v) { return *this << (char)v; }
+    LogStream& operator<<(short v) { return *this << (long long)v; }
+    LogStream& operator<<(unsigned short v) { return *this << (unsigned long long)v; }
+    LogStream& operator<<(int v) { return *this << (long long)v; }
+    LogStream& operator<<(unsigned int v) { return *this << (unsigned long long)v; }
+    LogStream& operator<<(long v) { return *this << (long long)v; }
+    LogStream& operator<<(unsigned long v) { return *this << (unsigned long long)v; }
+    LogStream& operator<<(long long v);
+    LogStream& operator<<(unsigned long long v);
+    LogStream& operator<<(float v) { return *this << (double)v; }
+    LogStream& operator<<(double v);
+    LogStream& operator<<(const void* v);
+    LogStream& operator<<(const char* v);
+    LogStream& operator<<(const std::string& v) {
+        append(v.c_str(), v.size());
+        return *this;
+    }
+    //std::endl之类的操作符
+    LogStream& operator<<(std::ostream& (*pf)(std::ostream&));
+
+    //其它自定义了operator<<(std::ostream&)的类型，借一个线程局部的ostream直接写进缓冲区
+    template<class T>
+    LogStream& operator<<(const T& v) {
+        std::ostream& os = beginOstream();
+        os << v;
+        endOstream();
+        return *this;
+    }
+private:
+    std::ostream& beginOstream();
+    void endOstream();
+private:
+    size_t m_len = 0;
+    char m_buf[kCapacity];
+};
+
 //日志事件
 class LogEvent {
 public:
     typedef std::shared_ptr<LogEvent> ptr;//main可以直接 LogEvent::ptr f直接创建一个智能指针
-    //LogEvent();//默认构造函数
-    LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t m_line, uint32_t elapse
-            , uint32_t thread_id, uint32_t fiber_id, uint64_t time);
+    LogEvent() {}
+    //thread_name要是一直有效的字符串(Thread::GetName()返回的就是)，为空的时候%N输出空
+    LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t m_line, uint64_t elapse
+            , uint32_t thread_id, uint32_t fiber_id, uint64_t time, const std::string* thread_name = nullptr);
+
+    //对象池复用的时候重新填一遍字段，内容清空
+    void reset(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t m_line, uint64_t elapse
+            , uint32_t thread_id, uint32_t fiber_id, uint64_t time, const std::string* thread_name = nullptr);
 
     const char* getFile() const { return m_file; }
     int32_t getLine() const { return m_line; }
-    uint32_t getElapse() const { return m_elapse; }
+    uint64_t getElapse() const { return m_elapse; }
     uint32_t getThreadId() const { return m_threadId; }
     uint32_t getFiberId() const { return m_fiberId; }
     uint64_t getTime() const { return m_time; }
-    std::string getContent() const { return m_ss.str(); }//这个返回的是临时的对象
-    std::shared_ptr<Logger> getLogger() const { return m_logger; }
+    const std::string* getThreadName() const { return m_threadName; }
+    std::string getContent() const { return m_ss.toString(); }//这个返回的是临时的对象，热路径用getStream()
+    const LogStream& getStream() const { return m_ss; }
+    const std::shared_ptr<Logger>& getLogger() const { return m_logger; }
     LogLevel::Level getLevel() const { return m_level; }
 
     //为了 test.cc 里面可以 SYLAR_LOG_FMT_ERROR(logger, "test macro fmt error %s", "aa");
     void format(const char* fmt, ...);
     void format(const char* fmt, va_list al);
 
-    std::stringstream& getSS() { return m_ss; }
+    LogStream& getSS() { return m_ss; }
 
 private:
 
     //为了满足m_event->getLogger()的写法，所以需要加上一个Logger的指针
     std::shared_ptr<Logger> m_logger;
     //level也是同理
-    LogLevel::Level m_level;
+    LogLevel::Level m_level = LogLevel::DEBUG;
 
 
     const char* m_file = nullptr;//文件名
     int32_t m_line = 0;//行号
-    uint32_t m_elapse = 0;//程序启动开始到现在的毫秒数
+    uint64_t m_elapse = 0;//程序启动开始到现在的毫秒数，单调时钟
     uint32_t m_threadId = 0;//线程ID
     uint32_t m_fiberId = 0;//协程ID
-    uint64_t m_time = 0;//时间戳(毫秒级别)
+    uint64_t m_time = 0;//时间戳(微秒)
+    const std::string* m_threadName = nullptr;//线程名，指向Thread里全局的名字表
     //std::string m_content;//日志内容,但是好像不太需要，换成string stream吧
-    std::stringstream m_ss;//日志内容
+    LogStream m_ss;//日志内容，内联缓冲区
 };
 
+//宏里面用的临时对象，从线程局部的对象池里面拿一个LogEvent，析构的时候写日志并还回去
 class LogEventWrap {
 public:
-    LogEventWrap(LogEvent::ptr e);
+    //宏里面用的，线程id、线程名、协程id、时间都在这里取
+    LogEventWrap(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line);
+    LogEventWrap(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line, uint64_t elapse
+            , uint32_t thread_id, uint32_t fiber_id, uint64_t time);
     ~LogEventWrap();
-    LogEvent::ptr getEvent() const {return m_event;}
-    std::stringstream& getSS();
+    LogEvent* getEvent() const {return m_event;}
+    LogStream& getSS();
 private:
-    LogEvent::ptr m_event;
+    LogEventWrap(const LogEventWrap&) = delete;
+    LogEventWrap& operator=(const LogEventWrap&) = delete;
+private:
+    LogEvent* m_event;
 };
 
 //日志格式定义器,来决定最终打印日志的
@@ -115,70 +212,154 @@ public:
     typedef std::shared_ptr<LogFormatter> ptr;
     LogFormatter(const std::string& pattern);//构造函数
     //%t    %thread_id %m%n
-    std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);//成员函数
-public:
-    //解析的子模块
-    class FormatItem {
-        public:
-            typedef std::shared_ptr<FormatItem> ptr;
-            FormatItem(const std::string& fmt = "") {};
-            virtual ~FormatItem() {} // 虚类
-            //virtual std::string format(LogEvent::ptr event) = 0;
-            virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+    //%d{...}里面除了strftime的格式，还可以用%ms(3位毫秒)和%us(6位微秒)
+    std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, const LogEvent& event);//成员函数
+    //直接追加到调用者给的缓冲区后面，缓冲区复用的话不会申请内存
+    void format(std::string& out, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent& event);
+
+    void init();//初始化, 把pattern编译成下面的指令序列
+    bool isError() const { return m_error; }
+    const std::string& getPattern() const { return m_pattern; }
+private:
+    //编译之后的一条指令，format的时候按顺序执行，没有虚函数
+    struct Op {
+        enum Code {
+            LITERAL = 0,//字面量，包括%T %n和%%，相邻的会拼在一起
+            MESSAGE,    //%m
+            LEVEL,      //%p
+            ELAPSE,     //%r
+            NAME,       //%c
+            THREAD_ID,  //%t
+            THREAD_NAME,//%N
+            FIBER_ID,   //%F
+            DATETIME,   //%d
+            FILENAME,   //%f
+            LINE        //%l
+        };
+        uint8_t code;
+        uint32_t offset;//LITERAL: 在m_literals里的偏移; DATETIME: m_dateFormats的下标
+        uint32_t len;   //LITERAL: 长度
+    };
+
+    //时间格式，id用来做线程局部缓存的key
+    //%ms %us是秒以下的部分(3位毫秒/6位微秒)，strftime不认识，在这里把格式拆开:
+    //parts[0] sub[0] parts[1] sub[1] ... parts[n]，parts按秒缓存，sub每条日志现算
+    struct DateFormat {
+        static const size_t kMaxSubSecond = 4;
+        std::string fmt;
+        uint64_t id;
+        std::vector<std::string> parts;
+        std::vector<uint8_t> subSecond;//每个是3或者6，表示几位
     };
 
-    void init();//初始化,
+    static DateFormat parseDateFormat(const std::string& fmt);
 private:
-    std::vector<FormatItem::ptr> m_items;
+    std::vector<Op> m_ops;
+    std::string m_literals;//所有字面量拼在一起
+    std::vector<DateFormat> m_dateFormats;
     std::string m_pattern;//格式模板吧，就是id,time,level...输出顺序
+    bool m_error = false;
 };
 
 //日志输出器(比如控制台输出，或者文件输出)，但是需要格式化输出 LogFormatter
 class LogAppender {
+friend class Logger;
 public:
     typedef std::shared_ptr<LogAppender> ptr;
+    //写目的地只是一次内存拷贝或者一次write，临界区很短，用自旋锁
+    typedef Spinlock MutexType;
     LogAppender(LogLevel::Level level = LogLevel::DEBUG) : m_level(level) {}//构造函数
 
     virtual ~LogAppender() {}//由于这个类考虑到会被继承，所以析构函数设置为虚函数
 
-    virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;//纯虚函数，子类必须实现
+    virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, const LogEvent& event) = 0;//纯虚函数，子类必须实现
     //上面函数加入logger目的是为了打印日志的名称
-    void setFormatter(LogFormatter::ptr val) { m_formatter = val; }
-    LogFormatter::ptr getFormatter() const { return m_formatter; }
+    virtual void flush() {}//把自己缓冲的内容刷到目的地，默认什么都不做
+    //自己设置的格式器，logger改格式的时候不会覆盖它；设置成空就重新跟着logger走
+    void setFormatter(LogFormatter::ptr val);
+    LogFormatter::ptr getFormatter();
+    bool hasFormatter() const { return m_hasFormatter; }
 
     LogLevel::Level getLevel() const { return m_level; }
     void setLevel(LogLevel::Level val) { m_level = val; }
+protected:
+    //格式化在锁外面做，返回格式化好的线程局部缓冲区
+    const std::string& formatEvent(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent& event);
 protected://虚拟的基类要用到level
-    LogLevel::Level m_level = LogLevel::DEBUG; //日志级别
+    std::atomic<LogLevel::Level> m_level{LogLevel::DEBUG}; //日志级别
+    MutexType m_mutex;//保护m_formatter和写目的地
     LogFormatter::ptr m_formatter;//日志格式器
+    bool m_hasFormatter = false;//m_formatter是不是自己设置的
 };
 
 //日志器
+//LoggerManager创建的logger按名字里的'.'组成一棵树，比如 system.net.http 的父亲是 system.net，
+//最上面是root。没有自己的appender就用最近的祖先的，级别设成UNKNOW就继承父亲的
 class Logger : public std::enable_shared_from_this<Logger>{
+friend class LoggerManager;
 public:
     typedef std::shared_ptr<Logger> ptr;
 
     Logger(const std::string& name = "root");//默认构造函数
 
-    void log(LogLevel::Level level, LogEvent::ptr event);//成员函数
+    void log(LogLevel::Level level, const LogEvent& event);//成员函数
+    //直接在当前线程调用所有appender，异步模式下由后台刷新线程调用
+    void callAppenders(LogLevel::Level level, const LogEvent& event);
 
-    void debug(LogEvent::ptr event);//成员函数
-    void info(LogEvent::ptr event);//成员函数
-    void warn(LogEvent::ptr event);//成员函数
-    void error(LogEvent::ptr event);//成员函数
-    void fatal(LogEvent::ptr event);//成员函数
+    void debug(const LogEvent& event);//成员函数
+    void info(const LogEvent& event);//成员函数
+    void warn(const LogEvent& event);//成员函数
+    void error(const LogEvent& event);//成员函数
+    void fatal(const LogEvent& event);//成员函数
 
     void addAppender(LogAppender::ptr appender);//成员函数
     void delAppender(LogAppender::ptr appender);//成员函数
-
-    LogLevel::Level getLevel() const { return m_level; }
-    void setLevel(LogLevel::Level val) { m_level = val; }
+    //整个换掉，配置重新加载的时候用，写日志的线程看到的要么是旧列表要么是新列表
+    void setAppenders(const std::vector<LogAppender::ptr>& appenders);
+    void clearAppenders();
+
+    //没有自己格式器的appender会跟着一起换
+    void setFormatter(LogFormatter::ptr val);
+    //pattern不合法返回false，不会替换
+    bool setFormatter(const std::string& val);
+    LogFormatter::ptr getFormatter();
+
+    //生效的级别(自己的或者继承来的)，宏里面每次都会判断，所以缓存成一个原子变量，只有一次load
+    LogLevel::Level getLevel() const { return m_effectiveLevel.load(std::memory_order_relaxed); }
+    //设置自己的级别，UNKNOW表示继承父亲的，会顺带更新所有子孙的生效级别
+    void setLevel(LogLevel::Level val);
+    //自己设置的级别，可能是UNKNOW
+    LogLevel::Level getOwnLevel() const { return m_level; }
+    Logger::ptr getParent() const { return m_parent; }
 
     const std::string& getName() const { return m_name; }
+
+    //异步模式: log()只把事件放进当前线程的缓冲区，由AsyncLogFlusher的后台线程写出
+    void setAsync(bool val) { m_async = val; }
+    bool isAsync() const { return m_async; }
+    //把异步缓冲区里的日志全部写出，并刷新所有appender，退出前调用
+    void flush();
+    //只刷新自己的appender
+    void flushAppenders();
+private:
+    typedef std::vector<LogAppender::ptr> AppenderList;
+    //拿一份appender列表的快照，只在锁里拷贝一个shared_ptr
+    std::shared_ptr<const AppenderList> getAppenders();
+    //自己没有appender就往上找祖先的
+    std::shared_ptr<const AppenderList> getEffectiveAppenders();
+    //重新计算自己和子孙的生效级别，调用的时候要拿着树的锁
+    void updateEffectiveLevel();
 private:
     std::string m_name;//日志名称
-    LogLevel::Level m_level;//日志级别
-    std::list<LogAppender::ptr> m_appenders;//Appender集合
+    std::atomic<LogLevel::Level> m_level;//日志级别
+    std::atomic<LogLevel::Level> m_effectiveLevel;//生效的日志级别
+    Logger::ptr m_parent;//创建的时候设置，之后不会再变
+    std::vector<Logger*> m_children;//子logger，由LoggerManager管理生命周期
+    std::atomic<bool> m_async{false};//是否异步输出
+    //写时复制: 增删appender的时候拷贝一份新的列表再换上去，
+    //正在写日志的线程手里还拿着旧列表的引用，不受影响
+    Spinlock m_mutex;//只保护m_appenders这个指针和m_formatter
+    std::shared_ptr<const AppenderList> m_appenders;//Appender集合
     LogFormatter::ptr m_formatter;
 };
 
@@ -186,40 +367,193 @@ private:
 class StdoutLogAppender : public LogAppender {
 public:
     typedef std::shared_ptr<StdoutLogAppender> ptr;
-    virtual void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;//告诉编译器我要重写这个函数
+    StdoutLogAppender();
+    virtual void log(Logger::ptr logger, LogLevel::Level level, const LogEvent& event) override;//告诉编译器我要重写这个函数
+    void flush() override;
 private:
-
+    LogSink::ptr m_sink;//所有StdoutLogAppender共用一个
 };
 
 //继承LogAppender类，输出到文件
 class FileLogAppender : public LogAppender {
 public:
     typedef std::shared_ptr<FileLogAppender> ptr;
-    virtual void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
-    FileLogAppender(const std::string& filename);
+    virtual void log(Logger::ptr logger, LogLevel::Level level, const LogEvent& event) override;
+    void flush() override;
+    //同一个路径的appender共用一个LogFile，切分的配置以最后设置的为准
+    FileLogAppender(const std::string& filename, const LogRotateConfig& rotate = LogRotateConfig());
 
     bool reopen();//文件涉及重新打开
+    LogFile::ptr getFile() const { return m_file; }
+    void setSyncConfig(const LogSyncConfig& val) { m_file->setSyncConfig(val); }
 private:
     std::string m_filename;
-    std::ofstream m_filestream;
+    LogFile::ptr m_file;
+};
+
+//配置文件里的一个appender
+struct LogAppenderDefine {
+    int type = 0;//1 File, 2 Stdout
+    LogLevel::Level level = LogLevel::DEBUG;
+    std::string formatter;
+    std::string file;
+    LogRotateConfig rotate;//只有文件appender用
+    LogSyncConfig sync;//只有文件appender用
+
+    bool operator==(const LogAppenderDefine& oth) const {
+        return type == oth.type
+            && level == oth.level
+            && formatter == oth.formatter
+            && file == oth.file
+            && rotate == oth.rotate
+            && sync == oth.sync;
+    }
+};
+
+//配置文件里的一个logger，logs下面的一项
+struct LogDefine {
+    std::string name;
+    LogLevel::Level level = LogLevel::UNKNOW;
+    std::string formatter;
+    bool async = false;
+    std::vector<LogAppenderDefine> appenders;
+
+    bool operator==(const LogDefine& oth) const {
+        return name == oth.name
+            && level == oth.level
+            && formatter == oth.formatter
+            && async == oth.async
+            && appenders == oth.appenders;
+    }
+
+    //放在set里面，按名字排序
+    bool operator<(const LogDefine& oth) const {
+        return name < oth.name;
+    }
 };
 
 //日志器管理类
 class LoggerManager {
 public:
+    typedef RWMutex MutexType;
     LoggerManager();
+    //没有就创建，中间缺的层级也一起创建，比如 a.b.c 会把 a 和 a.b 也建出来
     Logger::ptr getLogger(const std::string& name);
 
     void init();//可以跟配置文件结合起来，从配置读出来，很快产生一个LoggerManager
     Logger::ptr getRoot() const { return m_root; }
+
+    //按配置更新logger，和上一次的配置比较: 没变的logger不动，
+    //appender的配置没变就继续用原来的对象，打开的文件和缓冲区都还在
+    void reload(const std::set<LogDefine>& defines);
+private:
+    //一个logger下面由配置创建出来的appender
+    typedef std::vector<std::pair<LogAppenderDefine, LogAppender::ptr> > ConfiguredAppenders;
+
+    void applyDefine(const LogDefine& define);
+    void resetLogger(const std::string& name);
 private:
+    MutexType m_mutex;
     std::map<std::string, Logger::ptr> m_loggers;
     Logger::ptr m_root;//主要的logger，就是有一个默认的logger
 
+    Mutex m_reloadMutex;//同一时间只能有一个reload
+    std::set<LogDefine> m_defines;//上一次生效的配置
+    std::map<std::string, ConfiguredAppenders> m_configured;
+
 };
 
 //日志器管理类单例模式
 typedef cpp_high_perf::Singleton<LoggerManager> LoggerMgr;
 
+//异步日志刷新器(双缓冲)
+//生产者线程把事件放进自己线程的前台缓冲区(只和刷新线程竞争这一把锁)，
+//后台刷新线程定时或者在缓冲区达到阈值时，把前台缓冲区和后台缓冲区交换，然后批量写出
+class AsyncLogFlusher {
+public:
+    AsyncLogFlusher();
+    ~AsyncLogFlusher();
+
+    //生产者调用，缓冲区满了就丢弃并计数
+    void push(Logger::ptr logger, LogLevel::Level level, const LogEvent& event);
+    //在调用线程上把所有线程的缓冲区写出去，返回写出的条数
+    size_t flush();
+
+    //刷新周期(毫秒)
+    void setFlushInterval(uint32_t ms) { m_flushInterval = ms; }
+    uint32_t getFlushInterval() const { return m_flushInterval; }
+    //单个线程缓冲区积累到多少条就提前唤醒刷新线程
+    void setFlushThreshold(size_t n) { m_flushThreshold = n; }
+    size_t getFlushThreshold() const { return m_flushThreshold; }
+    //单个线程缓冲区最多积累多少条，超过就丢弃
+    void setMaxPending(size_t n) { m_maxPending = n; }
+    size_t getMaxPending() const { return m_maxPending; }
+
+    uint64_t getQueueDepth();//当前还没写出去的条数
+    uint64_t getDropped() const { return m_dropped; }//丢弃的条数
+    uint64_t getFlushed() const { return m_flushed; }//已经写出去的条数
+private:
+    //事件拷贝进缓冲区之后的样子，日志内容放在Batch::data里面
+    struct Record {
+        Logger::ptr logger;
+        LogLevel::Level level;
+        const char* file;
+        int32_t line;
+        uint64_t elapse;
+        uint32_t threadId;
+        uint32_t fiberId;
+        uint64_t time;
+        const std::string* threadName;
+        uint32_t offset;//内容在data里的偏移
+        uint32_t len;//内容长度
+    };
+
+    //一个缓冲区，clear之后容量保留，稳定之后不会再申请内存
+    struct Batch {
+        std::vector<Record> records;
+        std::string data;
+        void clear() {
+            records.clear();
+            data.clear();
+        }
+        void swap(Batch& o) {
+            records.swap(o.records);
+            data.swap(o.data);
+        }
+    };
+
+    //每个生产者线程一个
+    struct ThreadBuffer {
+        typedef std::shared_ptr<ThreadBuffer> ptr;
+        std::mutex mutex;
+        Batch front;
+        std::atomic<bool> dead{false};//线程已经退出，写完就可以回收了
+    };
+
+    ThreadBuffer::ptr getThreadBuffer();
+    void run();
+private:
+    std::atomic<uint32_t> m_flushInterval{100};
+    std::atomic<size_t> m_flushThreshold{1024};
+    std::atomic<size_t> m_maxPending{65536};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_flushed{0};
+
+    std::mutex m_buffersMutex;//保护m_buffers
+    std::vector<ThreadBuffer::ptr> m_buffers;
+
+    std::mutex m_roundMutex;//一次只能有一个线程在交换并写出
+    Batch m_back;//后台缓冲区，只在m_roundMutex下使用
+    LogEvent m_event;//从Record还原出来交给appender，只在m_roundMutex下使用
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::atomic<bool> m_notified{false};
+    bool m_stop = false;
+    Thread::ptr m_thread;
+};
+
+typedef cpp_high_perf::Singleton<AsyncLogFlusher> AsyncLogFlusherMgr;
+
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,643 @@
+#include "log_file.h"
+#include "config.h"
+#include "util.h"
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <zlib.h>
+
+namespace cpp_high_perf {
+
+uint64_t LogRotateConfig::ParseSize(const std::string& str) {
+    if (str.empty()) {
+        return 0;
+    }
+    char* end = nullptr;
+    unsigned long long v = strtoull(str.c_str(), &end, 10);
+    if (end == str.c_str()) {
+        return 0;
+    }
+    std::string unit(end);
+    if (unit.empty() || unit == "B" || unit == "b") {
+        return v;
+    } else if (unit == "K" || unit == "k" || unit == "KB" || unit == "kb") {
+        return v << 10;
+    } else if (unit == "M" || unit == "m" || unit == "MB" || unit == "mb") {
+        return v << 20;
+    } else if (unit == "G" || unit == "g" || unit == "GB" || unit == "gb") {
+        return v << 30;
+    }
+    return 0;
+}
+
+LogRotateConfig::Period LogRotateConfig::PeriodFromString(const std::string& str) {
+    std::string s = str;
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    if (s == "hourly" || s == "hour") {
+        return HOURLY;
+    } else if (s == "daily" || s == "day") {
+        return DAILY;
+    }
+    return NONE;
+}
+
+const char* LogRotateConfig::PeriodToString(Period p) {
+    switch (p) {
+        case HOURLY:
+            return "hourly";
+        case DAILY:
+            return "daily";
+        default:
+            return "none";
+    }
+}
+
+//t所在的那个周期往后数n个周期的起点(本地时间)
+static time_t period_start(time_t t, LogRotateConfig::Period p, int n) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_sec = 0;
+    tm.tm_min = 0;
+    if (p == LogRotateConfig::HOURLY) {
+        tm.tm_hour += n;
+    } else {
+        tm.tm_hour = 0;
+        tm.tm_mday += n;
+    }
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+bool LogSyncConfig::FromString(const std::string& str, LogSyncConfig& conf) {
+    std::string s = str;
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    if (s.empty() || s == "never" || s == "none") {
+        conf.policy = NEVER;
+        return true;
+    } else if (s == "error") {
+        conf.policy = ON_ERROR;
+        return true;
+    }
+    char* end = nullptr;
+    unsigned long v = strtoul(s.c_str(), &end, 10);
+    //1000 和 1000ms 都认
+    if (end == s.c_str() || !v || (*end && strcmp(end, "ms") != 0)) {
+        return false;
+    }
+    conf.policy = INTERVAL;
+    conf.intervalMs = v;
+    return true;
+}
+
+std::string LogSyncConfig::ToString(const LogSyncConfig& conf) {
+    switch (conf.policy) {
+        case INTERVAL:
+            return std::to_string(conf.intervalMs);
+        case ON_ERROR:
+            return "error";
+        default:
+            return "never";
+    }
+}
+
+//所有的sink，刷新线程定时把它们刷一遍。进程退出的时候可能还有sink在析构，这个表故意不释放
+namespace {
+struct LogSinkRegistry {
+    Mutex mutex;
+    std::set<LogSink*> sinks;
+};
+}
+
+static LogSinkRegistry& GetSinkRegistry() {
+    static LogSinkRegistry* s_registry = new LogSinkRegistry;
+    return *s_registry;
+}
+
+LogSink::ptr LogSink::Stdout() {
+    static LogSink::ptr s_stdout(new LogSink(STDOUT_FILENO));
+    return s_stdout;
+}
+
+void LogSink::FlushAll() {
+    LogSinkRegistry& r = GetSinkRegistry();
+    Mutex::Lock lock(r.mutex);
+    uint64_t now = GetMonotonicMS();
+    for (auto& i : r.sinks) {
+        MutexType::Lock sink_lock(i->m_mutex);
+        i->writeOut(nullptr, 0);
+        i->afterFlush();
+        if (i->m_sync.policy == LogSyncConfig::INTERVAL
+                && now >= i->m_lastSync + i->m_sync.intervalMs) {
+            i->sync();
+        }
+    }
+}
+
+LogSink::LogSink(int fd, size_t buffer_size)
+    :m_fd(fd)
+    ,m_bufferSize(buffer_size) {
+    m_mutex.setStats(LockStats::Get("log_sink"));
+    m_buffer.reserve(m_bufferSize);
+    m_lastSync = GetMonotonicMS();
+    LogSinkRegistry& r = GetSinkRegistry();
+    Mutex::Lock lock(r.mutex);
+    r.sinks.insert(this);
+    m_registered = true;
+}
+
+LogSink::~LogSink() {
+    unregister();
+    MutexType::Lock lock(m_mutex);
+    writeOut(nullptr, 0);
+}
+
+void LogSink::unregister() {
+    LogSinkRegistry& r = GetSinkRegistry();
+    Mutex::Lock lock(r.mutex);
+    if (m_registered) {
+        r.sinks.erase(this);
+        m_registered = false;
+    }
+}
+
+void LogSink::writeOut(const char* data, size_t len) {
+    struct iovec iov[2];
+    int cnt = 0;
+    if (!m_buffer.empty()) {
+        iov[cnt].iov_base = &m_buffer[0];
+        iov[cnt].iov_len = m_buffer.size();
+        ++cnt;
+    }
+    if (len) {
+        iov[cnt].iov_base = (void*)data;
+        iov[cnt].iov_len = len;
+        ++cnt;
+    }
+    struct iovec* cur = iov;
+    while (cnt > 0 && m_fd >= 0) {
+        ssize_t n = writev(m_fd, cur, cnt);
+        ++m_writeCalls;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            //写不进去就丢掉，不能让缓冲区无限涨
+            break;
+        }
+        //只写了一部分，跳过写完的，接着写剩下的
+        while (cnt > 0 && (size_t)n >= cur->iov_len) {
+            n -= cur->iov_len;
+            ++cur;
+            --cnt;
+        }
+        if (cnt > 0) {
+            cur->iov_base = (char*)cur->iov_base + n;
+            cur->iov_len -= n;
+        }
+    }
+    if (!m_buffer.empty() || len) {
+        m_dirty = true;
+    }
+    m_buffer.clear();
+}
+
+void LogSink::sync() {
+    m_lastSync = GetMonotonicMS();
+    if (!m_dirty || m_fd < 0) {
+        return;
+    }
+    m_dirty = false;
+    ++m_syncCalls;
+    fdatasync(m_fd);
+}
+
+void LogSink::write(const char* data, size_t len, uint64_t now_us, bool urgent) {
+    MutexType::Lock lock(m_mutex);
+    beforeWrite(len, now_us);
+    if (m_buffer.size() + len > m_bufferSize) {
+        //放不下就连同这一行一起写出去，大的行也不用先拷进缓冲区
+        writeOut(data, len);
+    } else {
+        m_buffer.append(data, len);
+    }
+    if (urgent && m_sync.policy == LogSyncConfig::ON_ERROR) {
+        writeOut(nullptr, 0);
+        sync();
+    }
+}
+
+void LogSink::flush() {
+    MutexType::Lock lock(m_mutex);
+    writeOut(nullptr, 0);
+    afterFlush();
+}
+
+void LogSink::setSyncConfig(const LogSyncConfig& val) {
+    MutexType::Lock lock(m_mutex);
+    m_sync = val;
+}
+
+LogSyncConfig LogSink::getSyncConfig() {
+    MutexType::Lock lock(m_mutex);
+    return m_sync;
+}
+
+//每收到一次重新打开的请求加一，各个文件写的时候和自己记的比一下
+static std::atomic<uint32_t> s_reopen_gen{0};
+
+//路径到文件的表，只放weak_ptr，文件的生命周期由appender管
+namespace {
+struct LogFileRegistry {
+    Mutex mutex;
+    std::map<std::string, std::weak_ptr<LogFile> > files;
+};
+}
+
+static LogFileRegistry& GetRegistry() {
+    static LogFileRegistry s_registry;
+    return s_registry;
+}
+
+LogFile::ptr LogFile::Get(const std::string& path) {
+    LogFileRegistry& r = GetRegistry();
+    Mutex::Lock lock(r.mutex);
+    for (auto it = r.files.begin(); it != r.files.end();) {
+        if (it->second.expired()) {
+            r.files.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    auto it = r.files.find(path);
+    if (it != r.files.end()) {
+        LogFile::ptr f = it->second.lock();
+        if (f) {
+            return f;
+        }
+    }
+    LogFile::ptr f(new LogFile(path));
+    r.files[path] = f;
+    return f;
+}
+
+void LogFile::RequestReopen() {
+    s_reopen_gen.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LogFile::ReopenAll() {
+    std::vector<LogFile::ptr> files;
+    {
+        LogFileRegistry& r = GetRegistry();
+        Mutex::Lock lock(r.mutex);
+        for (auto& i : r.files) {
+            LogFile::ptr f = i.second.lock();
+            if (f) {
+                files.push_back(f);
+            }
+        }
+    }
+    for (auto& f : files) {
+        f->reopen();
+    }
+}
+
+LogFile::LogFile(const std::string& path)
+    :LogSink(-1)
+    ,m_path(path) {
+    MutexType::Lock lock(m_mutex);
+    openFile();
+}
+
+LogFile::~LogFile() {
+    unregister();
+    MutexType::Lock lock(m_mutex);
+    writeOut(nullptr, 0);
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool LogFile::openFile() {
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_reopenGen = s_reopen_gen.load(std::memory_order_relaxed);
+    //追加打开，重启和重新打开都不会把已有的内容清掉，几个进程写同一个文件也不会互相覆盖
+    m_fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        m_size = 0;
+        std::cout << "log file open fail: " << m_path << " errno=" << errno << std::endl;
+        return false;
+    }
+    struct stat st;
+    m_size = fstat(m_fd, &st) == 0 ? st.st_size : 0;
+    return true;
+}
+
+void LogFile::updateNextRotate(uint64_t now_us) {
+    if (m_rotate.period == LogRotateConfig::NONE) {
+        m_nextRotate = 0;
+        return;
+    }
+    m_nextRotate = (uint64_t)period_start(now_us / 1000000, m_rotate.period, 1) * 1000000;
+}
+
+std::string LogFile::rotateFile(uint64_t now_us) {
+    //先把缓冲的内容写到旧文件里，一行都不丢
+    writeOut(nullptr, 0);
+    if (m_sync.policy != LogSyncConfig::NEVER) {
+        sync();
+    }
+
+    time_t now = now_us / 1000000;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y%m%d-%H%M%S", &tm);
+    //同一秒切了好几次就在后面加序号，序号自己记着，前面的被清理掉了也不会重复用
+    if (now != m_lastRotateSec) {
+        m_lastRotateSec = now;
+        m_rotateSeq = 0;
+    }
+    std::string target;
+    do {
+        target = m_path + "." + buf;
+        if (m_rotateSeq) {
+            target += "." + std::to_string(m_rotateSeq);
+        }
+        ++m_rotateSeq;
+    } while (access(target.c_str(), F_OK) == 0
+            || access((target + ".gz").c_str(), F_OK) == 0);
+    if (rename(m_path.c_str(), target.c_str())) {
+        std::cout << "log file rotate fail: " << m_path << " -> " << target
+                  << " errno=" << errno << std::endl;
+        target.clear();
+    }
+    openFile();
+    updateNextRotate(now_us);
+
+    //压缩和清理都交给后台线程
+    if (!target.empty() && (m_rotate.compress || m_rotate.maxFiles)) {
+        Singleton<LogFileCompressor>::GetInstance()->add(target, m_path, m_rotate);
+    }
+    return target;
+}
+
+void LogFile::beforeWrite(size_t len, uint64_t now_us) {
+    if (s_reopen_gen.load(std::memory_order_relaxed) != m_reopenGen) {
+        writeOut(nullptr, 0);
+        openFile();
+    }
+    if ((m_nextRotate && now_us >= m_nextRotate)
+            || (m_rotate.maxSize && m_size && m_size + len > m_rotate.maxSize)) {
+        rotateFile(now_us);
+    }
+    m_size += len;
+}
+
+void LogFile::afterFlush() {
+    if (s_reopen_gen.load(std::memory_order_relaxed) != m_reopenGen) {
+        openFile();
+    }
+}
+
+bool LogFile::reopen() {
+    MutexType::Lock lock(m_mutex);
+    writeOut(nullptr, 0);
+    return openFile();
+}
+
+std::string LogFile::rotate() {
+    MutexType::Lock lock(m_mutex);
+    return rotateFile(GetCurrentUS());
+}
+
+void LogFile::setRotateConfig(const LogRotateConfig& val) {
+    MutexType::Lock lock(m_mutex);
+    m_rotate = val;
+    uint64_t now_us = GetCurrentUS();
+    updateNextRotate(now_us);
+    //按时间切的时候，上次留下来的文件已经不是这个周期的了，先切掉
+    if (m_rotate.period != LogRotateConfig::NONE && m_size) {
+        struct stat st;
+        if (stat(m_path.c_str(), &st) == 0
+                && st.st_mtime < period_start(now_us / 1000000, m_rotate.period, 0)) {
+            rotateFile(now_us);
+        }
+    }
+}
+
+LogRotateConfig LogFile::getRotateConfig() {
+    MutexType::Lock lock(m_mutex);
+    return m_rotate;
+}
+
+uint64_t LogFile::getSize() {
+    MutexType::Lock lock(m_mutex);
+    return m_size;
+}
+
+LogFileCompressor::LogFileCompressor() {
+}
+
+LogFileCompressor::~LogFileCompressor() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    if (m_thread) {
+        m_thread->join();
+    }
+}
+
+void LogFileCompressor::add(const std::string& file, const std::string& base, const LogRotateConfig& conf) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop) {
+            return;
+        }
+        m_tasks.push_back(Task{file, base, conf});
+        if (!m_thread) {
+            m_thread.reset(new Thread(std::bind(&LogFileCompressor::run, this), "log_compress"));
+        }
+    }
+    m_cond.notify_one();
+}
+
+void LogFileCompressor::waitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idleCond.wait(lock, [this]() { return m_tasks.empty() && !m_busy; });
+}
+
+void LogFileCompressor::run() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_busy = false;
+            while (m_tasks.empty()) {
+                m_idleCond.notify_all();
+                if (m_stop) {
+                    return;
+                }
+                m_cond.wait(lock);
+            }
+            //停止的时候也把剩下的做完
+            task = m_tasks.front();
+            m_tasks.pop_front();
+            m_busy = true;
+        }
+        if (task.conf.compress && Gzip(task.file, task.file + ".gz")) {
+            unlink(task.file.c_str());
+        }
+        if (task.conf.maxFiles) {
+            Prune(task.base, task.conf.maxFiles);
+        }
+    }
+}
+
+bool LogFileCompressor::Gzip(const std::string& src, const std::string& dst) {
+    int fd = open(src.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    //先写临时文件，写完再改名，清理的时候不会把半截的.gz算进去
+    std::string tmp = dst + ".tmp";
+    gzFile gz = gzopen(tmp.c_str(), "wb");
+    if (!gz) {
+        close(fd);
+        return false;
+    }
+    std::vector<char> buf(64 * 1024);
+    bool ok = true;
+    ssize_t n = 0;
+    while ((n = read(fd, &buf[0], buf.size())) > 0) {
+        if (gzwrite(gz, &buf[0], n) != n) {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && n == 0;
+    ok = gzclose(gz) == Z_OK && ok;
+    close(fd);
+    if (!ok || rename(tmp.c_str(), dst.c_str())) {
+        std::cout << "log file compress fail: " << src << std::endl;
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+//切出来的文件名是 base.YYYYmmdd-HHMMSS[.序号][.gz]，拆出时间和序号用来排序
+static bool parse_rotated_name(const std::string& suffix, std::string& ts, int& seq) {
+    std::string s = suffix;
+    if (s.size() > 3 && s.compare(s.size() - 3, 3, ".gz") == 0) {
+        s.resize(s.size() - 3);
+    }
+    if (s.size() < 15 || s[8] != '-') {
+        return false;
+    }
+    for (size_t i = 0; i < 15; ++i) {
+        if (i != 8 && !isdigit(s[i])) {
+            return false;
+        }
+    }
+    ts = s.substr(0, 15);
+    seq = 0;
+    if (s.size() == 15) {
+        return true;
+    }
+    if (s[15] != '.' || s.size() == 16) {
+        return false;
+    }
+    for (size_t i = 16; i < s.size(); ++i) {
+        if (!isdigit(s[i])) {
+            return false;
+        }
+    }
+    seq = atoi(s.c_str() + 16);
+    return true;
+}
+
+void LogFileCompressor::Prune(const std::string& base, uint32_t max_files) {
+    std::string dir = ".";
+    std::string prefix = base;
+    size_t pos = base.rfind('/');
+    if (pos != std::string::npos) {
+        dir = pos ? base.substr(0, pos) : "/";
+        prefix = base.substr(pos + 1);
+    }
+    prefix += ".";
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    std::vector<std::tuple<std::string, int, std::string> > files;
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(d)) != nullptr) {
+        std::string name = dp->d_name;
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        std::string ts;
+        int seq = 0;
+        if (parse_rotated_name(name.substr(prefix.size()), ts, seq)) {
+            files.push_back(std::make_tuple(ts, seq, dir + "/" + name));
+        }
+    }
+    closedir(d);
+
+    if (files.size() <= max_files) {
+        return;
+    }
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() - max_files; ++i) {
+        unlink(std::get<2>(files[i]).c_str());
+    }
+}
+
+//收到SIGHUP只记一下，真正的重新打开在下一次写或者刷新的时候做
+static void on_sighup(int) {
+    LogFile::RequestReopen();
+}
+
+static ConfigVar<bool>::ptr g_log_reopen_on_sighup =
+    Config::lookup("log.reopen_on_sighup", false, "reopen log files on SIGHUP");
+
+static void set_sighup_reopen(bool v) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sa.sa_handler = v ? on_sighup : SIG_DFL;
+    sigaction(SIGHUP, &sa, nullptr);
+}
+
+struct LogFileIniter {
+    LogFileIniter() {
+        if (g_log_reopen_on_sighup->getValue()) {
+            set_sighup_reopen(true);
+        }
+        g_log_reopen_on_sighup->addListener([](const bool& old_value, const bool& new_value) {
+            set_sighup_reopen(new_value);
+        });
+    }
+};
+
+static LogFileIniter __log_file_init;
+
+}
@@ -0,0 +1,193 @@
+#ifndef __LOG_FILE_H__
+#define __LOG_FILE_H__
+
+#include "mutex.h"
+#include "thread.h"
+#include <stdint.h>
+#include <time.h>
+#include <memory>
+#include <string>
+#include <list>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace cpp_high_perf {
+
+//日志文件的切分策略
+struct LogRotateConfig {
+    enum Period {
+        NONE = 0,
+        HOURLY = 1,
+        DAILY = 2
+    };
+
+    uint64_t maxSize = 0;//超过多少字节就切，0表示不按大小切
+    Period period = NONE;//按整点/零点切
+    uint32_t maxFiles = 0;//切出来的文件最多留几个，0表示都留
+    bool compress = true;//切出来的文件在后台压缩成.gz
+
+    bool operator==(const LogRotateConfig& oth) const {
+        return maxSize == oth.maxSize
+            && period == oth.period
+            && maxFiles == oth.maxFiles
+            && compress == oth.compress;
+    }
+    bool operator!=(const LogRotateConfig& oth) const { return !(*this == oth); }
+
+    //"100M" "512K" "1G" 或者直接是字节数，不合法返回0
+    static uint64_t ParseSize(const std::string& str);
+    //none/hourly/daily，不认识的当成none
+    static Period PeriodFromString(const std::string& str);
+    static const char* PeriodToString(Period p);
+};
+
+//什么时候把写出去的日志落盘(fdatasync)
+struct LogSyncConfig {
+    enum Policy {
+        NEVER = 0,//交给系统自己刷
+        INTERVAL = 1,//每intervalMs毫秒一次，在刷新线程里做
+        ON_ERROR = 2//写了ERROR及以上的日志马上落盘
+    };
+
+    Policy policy = NEVER;
+    uint32_t intervalMs = 1000;
+
+    bool operator==(const LogSyncConfig& oth) const {
+        return policy == oth.policy && intervalMs == oth.intervalMs;
+    }
+    bool operator!=(const LogSyncConfig& oth) const { return !(*this == oth); }
+
+    //never/error/数字(毫秒)，不合法返回false
+    static bool FromString(const std::string& str, LogSyncConfig& conf);
+    static std::string ToString(const LogSyncConfig& conf);
+};
+
+//往一个fd写日志: 格式化好的行先攒在用户态的大缓冲区里，满了或者刷新的时候一次writev写出去，
+//一行日志平均下来远不到一次系统调用。没攒满的由日志刷新线程定时刷出去
+class LogSink {
+public:
+    typedef std::shared_ptr<LogSink> ptr;
+    typedef Mutex MutexType;
+
+    //标准输出，所有StdoutLogAppender共用
+    static LogSink::ptr Stdout();
+    //把所有sink的缓冲区写出去，到时间的顺便落盘，日志刷新线程定时调用
+    static void FlushAll();
+
+    LogSink(int fd, size_t buffer_size = 64 * 1024);
+    virtual ~LogSink();
+
+    //urgent表示ERROR及以上，ON_ERROR策略下会马上写出去并落盘
+    void write(const char* data, size_t len, uint64_t now_us, bool urgent = false);
+    void flush();
+
+    void setSyncConfig(const LogSyncConfig& val);
+    LogSyncConfig getSyncConfig();
+    uint64_t getWriteCalls() const { return m_writeCalls; }//write/writev的次数
+    uint64_t getSyncCalls() const { return m_syncCalls; }//fdatasync的次数
+protected:
+    //下面几个都要在m_mutex里面调用
+    //在写进缓冲区之前调用，子类在这里切文件
+    virtual void beforeWrite(size_t len, uint64_t now_us) {}
+    //缓冲区写出去之后调用
+    virtual void afterFlush() {}
+    //缓冲区里的加上data(可以为空)一起写出去
+    void writeOut(const char* data, size_t len);
+    void sync();
+    //子类析构的时候先从刷新列表里摘掉，免得刷新线程碰到析构了一半的对象
+    void unregister();
+protected:
+    MutexType m_mutex;
+    int m_fd;
+    std::string m_buffer;
+    size_t m_bufferSize;
+    LogSyncConfig m_sync;
+    bool m_dirty = false;//上次落盘之后有没有写过
+    uint64_t m_lastSync = 0;//上次落盘的时间(毫秒，单调时钟)
+    std::atomic<uint64_t> m_writeCalls{0};
+    std::atomic<uint64_t> m_syncCalls{0};
+    bool m_registered = false;
+};
+
+//一个日志文件，同一个路径在进程里只有一个对象，几个appender写同一个文件的时候共用它，
+//切分也只会发生一次。文件以O_APPEND打开，重启不会把原来的日志清掉
+class LogFile : public LogSink {
+public:
+    typedef std::shared_ptr<LogFile> ptr;
+
+    //拿到这个路径对应的文件，没有就打开一个
+    static LogFile::ptr Get(const std::string& path);
+    //让所有文件在下一次写或者刷新的时候重新打开，只改一个原子变量，可以在信号处理函数里调用
+    static void RequestReopen();
+    //把所有文件刷出去再重新打开，外部把文件挪走之后用
+    static void ReopenAll();
+
+    ~LogFile();
+
+    bool reopen();
+    //马上切一次，返回切出来的文件名，没切成返回空
+    std::string rotate();
+
+    void setRotateConfig(const LogRotateConfig& val);
+    LogRotateConfig getRotateConfig();
+    const std::string& getPath() const { return m_path; }
+    uint64_t getSize();
+private:
+    LogFile(const std::string& path);
+
+    //now_us是这条日志的时间(微秒)，用来判断有没有到切分的时间点
+    void beforeWrite(size_t len, uint64_t now_us) override;
+    //收到重新打开的请求之后，刷新的时候也要重新打开
+    void afterFlush() override;
+
+    //下面几个都要在m_mutex里面调用
+    bool openFile();
+    void updateNextRotate(uint64_t now_us);
+    std::string rotateFile(uint64_t now_us);
+private:
+    std::string m_path;
+    uint64_t m_size = 0;//当前文件的大小
+    uint64_t m_nextRotate = 0;//下一个切分时间点(微秒)，0表示不按时间切
+    uint32_t m_reopenGen = 0;//上一次打开时看到的重新打开计数
+    time_t m_lastRotateSec = 0;//上一次切分是哪一秒
+    uint32_t m_rotateSeq = 0;//这一秒里下一个文件的序号
+    LogRotateConfig m_rotate;
+};
+
+//切出来的文件的后台处理: 压缩，然后按数量清理旧文件，写日志的线程不会等它
+class LogFileCompressor {
+public:
+    LogFileCompressor();
+    ~LogFileCompressor();
+
+    //file是切出来的文件，base是原来的日志路径，用来找同一组的旧文件
+    void add(const std::string& file, const std::string& base, const LogRotateConfig& conf);
+    //等队列里的都处理完，测试用
+    void waitIdle();
+
+    //把src压成dst，成功返回true
+    static bool Gzip(const std::string& src, const std::string& dst);
+    //base切出来的文件只留最新的max_files个
+    static void Prune(const std::string& base, uint32_t max_files);
+private:
+    struct Task {
+        std::string file;
+        std::string base;
+        LogRotateConfig conf;
+    };
+    void run();
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::condition_variable m_idleCond;
+    std::list<Task> m_tasks;
+    bool m_busy = false;
+    bool m_stop = false;
+    Thread::ptr m_thread;//第一次有任务的时候再起线程
+};
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "mutex.h"
+#include "config.h"
+#include <stdexcept>
+#include <errno.h>
+#include <map>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+namespace cpp_high_perf {
+
+Semaphore::Semaphore(uint32_t count) {
+    if (sem_init(&m_semaphore, 0, count)) {
+        throw std::logic_error("sem_init error");
+    }
+}
+
+Semaphore::~Semaphore() {
+    sem_destroy(&m_semaphore);
+}
+
+void Semaphore::wait() {
+    //被信号打断了接着等
+    while (sem_wait(&m_semaphore)) {
+        if (errno != EINTR) {
+            throw std::logic_error("sem_wait error");
+        }
+    }
+}
+
+void Semaphore::notify() {
+    if (sem_post(&m_semaphore)) {
+        throw std::logic_error("sem_post error");
+    }
+}
+
+std::atomic<bool> LockStats::s_enabled{false};
+
+//统计对象创建了就不删，锁里面存的是裸指针
+//这里的锁自己不挂统计
+static Mutex& GetStatsMutex() {
+    static Mutex s_mutex;
+    return s_mutex;
+}
+
+static std::map<std::string, std::unique_ptr<LockStats> >& GetStatsMap() {
+    static std::map<std::string, std::unique_ptr<LockStats> > s_stats;
+    return s_stats;
+}
+
+LockStats* LockStats::Get(const std::string& name) {
+    Mutex::Lock lock(GetStatsMutex());
+    auto& m = GetStatsMap();
+    auto it = m.find(name);
+    if (it != m.end()) {
+        return it->second.get();
+    }
+    LockStats* stats = new LockStats;
+    stats->name = name;
+    m[name].reset(stats);
+    return stats;
+}
+
+namespace {
+//Dump时候的快照，别的线程还在加计数，拿活的计数器排序比较结果会变，sort就乱了
+struct LockStatsSnapshot {
+    std::string name;
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t waitNs;
+};
+}
+
+std::ostream& LockStats::Dump(std::ostream& os) {
+    std::vector<LockStatsSnapshot> all;
+    {
+        Mutex::Lock lock(GetStatsMutex());
+        for (auto& i : GetStatsMap()) {
+            LockStats* s = i.second.get();
+            all.push_back({s->name, s->acquisitions, s->contended, s->waitNs});
+        }
+    }
+    std::sort(all.begin(), all.end(), [](const LockStatsSnapshot& a, const LockStatsSnapshot& b) {
+        return a.waitNs > b.waitNs;
+    });
+    os << "[LockStats enabled=" << IsEnabled() << "]" << std::endl;
+    for (auto& s : all) {
+        os << "    " << s.name << ": acquisitions=" << s.acquisitions
+           << " contended=" << s.contended
+           << " wait_us=" << s.waitNs / 1000
+           << " avg_wait_ns=" << (s.contended ? s.waitNs / s.contended : 0) << std::endl;
+    }
+    return os;
+}
+
+void LockStats::ResetAll() {
+    Mutex::Lock lock(GetStatsMutex());
+    for (auto& i : GetStatsMap()) {
+        i.second->acquisitions = 0;
+        i.second->contended = 0;
+        i.second->waitNs = 0;
+    }
+}
+
+static ConfigVar<bool>::ptr g_lock_stats =
+    Config::lookup("lock.stats", false, "record lock contention stats");
+
+struct LockStatsIniter {
+    LockStatsIniter() {
+        LockStats::SetEnabled(g_lock_stats->getValue());
+        g_lock_stats->addListener([](const bool&, const bool& new_value) {
+            LockStats::SetEnabled(new_value);
+        });
+    }
+};
+
+static LockStatsIniter s_lock_stats_initer;
+
+}
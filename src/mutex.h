@@ -0,0 +1,326 @@
+#ifndef __MUTEX_H__
+#define __MUTEX_H__
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+#include <ostream>
+
+namespace cpp_high_perf {
+
+//不允许拷贝的基类，锁都继承它
+class Noncopyable {
+public:
+    Noncopyable() = default;
+    ~Noncopyable() = default;
+    Noncopyable(const Noncopyable&) = delete;
+    Noncopyable& operator=(const Noncopyable&) = delete;
+};
+
+//信号量
+class Semaphore : Noncopyable {
+public:
+    Semaphore(uint32_t count = 0);
+    ~Semaphore();
+
+    void wait();
+    void notify();
+private:
+    sem_t m_semaphore;
+};
+
+//锁的竞争统计: 加锁次数、其中要等的次数、等了多久
+//锁默认不统计，setStats之后才统计；同一个名字的锁共用一份统计(比如每个fd一把锁)
+//配置lock.stats为false的时候挂了统计也不记，线上出问题的时候打开，不用上perf就能看到哪把锁抢得厉害
+struct LockStats {
+    std::string name;
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> waitNs{0};
+
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool v) { s_enabled.store(v, std::memory_order_relaxed); }
+
+    static uint64_t NowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    //按名字拿统计，没有就创建，返回的指针一直有效
+    static LockStats* Get(const std::string& name);
+    //按等待时间从长到短输出
+    static std::ostream& Dump(std::ostream& os);
+    static void ResetAll();
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+//挂了统计的锁走这里: 统计开着的时候先try一下，拿不到才算竞争，记下等了多久
+//没挂统计的锁不进来，只多一次判断
+template<class TryLock, class Lock>
+inline void LockWithStats(LockStats* stats, TryLock try_lock, Lock do_lock) {
+    if (!LockStats::IsEnabled()) {
+        do_lock();
+        return;
+    }
+    stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (try_lock()) {
+        return;
+    }
+    uint64_t begin = LockStats::NowNs();
+    do_lock();
+    stats->contended.fetch_add(1, std::memory_order_relaxed);
+    stats->waitNs.fetch_add(LockStats::NowNs() - begin, std::memory_order_relaxed);
+}
+
+//局部锁的模板，构造的时候加锁，析构的时候解锁
+template<class T>
+class ScopedLockImpl {
+public:
+    ScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.lock();
+        m_locked = true;
+    }
+
+    ~ScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.lock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+//局部读锁
+template<class T>
+class ReadScopedLockImpl {
+public:
+    ReadScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.rdlock();
+        m_locked = true;
+    }
+
+    ~ReadScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.rdlock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+//局部写锁
+template<class T>
+class WriteScopedLockImpl {
+public:
+    WriteScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.wrlock();
+        m_locked = true;
+    }
+
+    ~WriteScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.wrlock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+//互斥量
+class Mutex : Noncopyable {
+public:
+    typedef ScopedLockImpl<Mutex> Lock;
+    Mutex() {
+        pthread_mutex_init(&m_mutex, nullptr);
+    }
+
+    ~Mutex() {
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void lock() {
+        if (m_stats) {
+            LockWithStats(m_stats,
+                [this]() { return pthread_mutex_trylock(&m_mutex) == 0; },
+                [this]() { pthread_mutex_lock(&m_mutex); });
+            return;
+        }
+        pthread_mutex_lock(&m_mutex);
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    //要在开始用锁之前设
+    void setStats(LockStats* stats) { m_stats = stats; }
+private:
+    pthread_mutex_t m_mutex;
+    LockStats* m_stats = nullptr;
+};
+
+//读写锁，读多写少的地方用
+class RWMutex : Noncopyable {
+public:
+    typedef ReadScopedLockImpl<RWMutex> ReadLock;
+    typedef WriteScopedLockImpl<RWMutex> WriteLock;
+
+    RWMutex() {
+        pthread_rwlock_init(&m_lock, nullptr);
+    }
+
+    ~RWMutex() {
+        pthread_rwlock_destroy(&m_lock);
+    }
+
+    void rdlock() {
+        if (m_stats) {
+            LockWithStats(m_stats,
+                [this]() { return pthread_rwlock_tryrdlock(&m_lock) == 0; },
+                [this]() { pthread_rwlock_rdlock(&m_lock); });
+            return;
+        }
+        pthread_rwlock_rdlock(&m_lock);
+    }
+
+    void wrlock() {
+        if (m_stats) {
+            LockWithStats(m_stats,
+                [this]() { return pthread_rwlock_trywrlock(&m_lock) == 0; },
+                [this]() { pthread_rwlock_wrlock(&m_lock); });
+            return;
+        }
+        pthread_rwlock_wrlock(&m_lock);
+    }
+
+    void unlock() {
+        pthread_rwlock_unlock(&m_lock);
+    }
+
+    //要在开始用锁之前设
+    void setStats(LockStats* stats) { m_stats = stats; }
+private:
+    pthread_rwlock_t m_lock;
+    LockStats* m_stats = nullptr;
+};
+
+//自旋锁，临界区很短的时候用，不会让线程睡眠
+class Spinlock : Noncopyable {
+public:
+    typedef ScopedLockImpl<Spinlock> Lock;
+    Spinlock() {
+        pthread_spin_init(&m_mutex, 0);
+    }
+
+    ~Spinlock() {
+        pthread_spin_destroy(&m_mutex);
+    }
+
+    void lock() {
+        if (m_stats) {
+            LockWithStats(m_stats,
+                [this]() { return pthread_spin_trylock(&m_mutex) == 0; },
+                [this]() { pthread_spin_lock(&m_mutex); });
+            return;
+        }
+        pthread_spin_lock(&m_mutex);
+    }
+
+    void unlock() {
+        pthread_spin_unlock(&m_mutex);
+    }
+
+    //要在开始用锁之前设
+    void setStats(LockStats* stats) { m_stats = stats; }
+private:
+    pthread_spinlock_t m_mutex;
+    LockStats* m_stats = nullptr;
+};
+
+//原子变量做的自旋锁，比pthread的自旋锁少一次函数调用，等的时候pause一下让出流水线
+class CASLock : Noncopyable {
+public:
+    typedef ScopedLockImpl<CASLock> Lock;
+    CASLock() {
+        m_mutex.clear();
+    }
+
+    void lock() {
+        if (m_stats) {
+            LockWithStats(m_stats,
+                [this]() { return !m_mutex.test_and_set(std::memory_order_acquire); },
+                [this]() { spin(); });
+            return;
+        }
+        spin();
+    }
+
+    void unlock() {
+        m_mutex.clear(std::memory_order_release);
+    }
+
+    //要在开始用锁之前设
+    void setStats(LockStats* stats) { m_stats = stats; }
+private:
+    void spin() {
+        while (m_mutex.test_and_set(std::memory_order_acquire)) {
+#if defined(__x86_64__)
+            __builtin_ia32_pause();
+#endif
+        }
+    }
+private:
+    std::atomic_flag m_mutex;
+    LockStats* m_stats = nullptr;
+};
+
+}
+
+#endif
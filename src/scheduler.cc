@@ -0,0 +1,367 @@
+#include "scheduler.h"
+#include "log.h"
+#include "util.h"
+#include "hook.h"
+#include <assert.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static thread_local Scheduler* t_scheduler = nullptr;
+static thread_local int t_worker = -1;
+
+//偷任务的时候随机选起点，不然大家都先去偷同一个线程
+static uint32_t random_next() {
+    static thread_local uint32_t t_seed = 0;
+    if (t_seed == 0) {
+        t_seed = (uint32_t)GetThreadId() * 2654435761u | 1;
+    }
+    t_seed ^= t_seed << 13;
+    t_seed ^= t_seed >> 17;
+    t_seed ^= t_seed << 5;
+    return t_seed;
+}
+
+Scheduler::Scheduler(size_t threads, bool use_caller, const std::string& name)
+    :m_name(name)
+    ,m_useCaller(use_caller) {
+    assert(threads > 0);
+    LockStats* inbox_stats = LockStats::Get("scheduler.inbox");
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers.push_back(std::unique_ptr<Worker>(new Worker));
+        m_workers.back()->inboxMutex.setStats(inbox_stats);
+    }
+    m_injectMutex.setStats(LockStats::Get("scheduler.inject"));
+
+    if (use_caller) {
+        Fiber::GetThis();
+        assert(GetThis() == nullptr);
+        setThis();
+        t_worker = 0;
+        m_rootFiber.reset(new Fiber(std::bind(&Scheduler::run, this, 0)));
+    }
+}
+
+Scheduler::~Scheduler() {
+    assert(m_stopping);
+    for (auto& w : m_workers) {
+        for (auto t : w->inbox) {
+            delete t;
+        }
+        while (Task* t = w->queue.steal()) {
+            delete t;
+        }
+    }
+    for (auto t : m_inject) {
+        delete t;
+    }
+    if (GetThis() == this) {
+        t_scheduler = nullptr;
+        t_worker = -1;
+    }
+}
+
+Scheduler* Scheduler::GetThis() {
+    return t_scheduler;
+}
+
+int Scheduler::GetWorkerIndex() {
+    return t_worker;
+}
+
+void Scheduler::setThis() {
+    t_scheduler = this;
+}
+
+void Scheduler::start() {
+    if (!m_stopping) {
+        return;
+    }
+    m_stopping = false;
+    assert(m_threads.empty());
+    for (size_t i = m_useCaller ? 1 : 0; i < m_workers.size(); ++i) {
+        m_threads.push_back(Thread::ptr(new Thread([this, i]() {
+            run((int)i);
+        }, m_name + "_" + std::to_string(i))));
+    }
+}
+
+void Scheduler::stop() {
+    m_autoStop = true;
+    m_stopping = true;
+    if (m_useCaller) {
+        //use_caller的时候只能在创建调度器的线程里stop
+        assert(GetThis() == this);
+    }
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        tickle((int)i);
+    }
+
+    if (m_rootFiber && !m_rootFiber->isFinished()) {
+        m_rootFiber->resume();
+        CHPE_LOG_DEBUG(g_logger) << m_name << " root fiber end";
+    }
+
+    std::vector<Thread::ptr> threads;
+    threads.swap(m_threads);
+    for (auto& t : threads) {
+        t->join();
+    }
+}
+
+void Scheduler::scheduleTask(Task* task) {
+    if (task->thread >= (int)m_workers.size()) {
+        CHPE_LOG_ERROR(g_logger) << m_name << " schedule to invalid worker " << task->thread
+            << ", worker count=" << m_workers.size();
+        task->thread = -1;
+    }
+    int self = t_scheduler == this ? t_worker : -1;
+    ++m_pending;
+    int target = -1;
+    if (task->thread >= 0) {
+        //指定了线程的只能放到那个线程的收件箱，放到队列里会被别人偷走
+        Worker& w = *m_workers[task->thread];
+        Spinlock::Lock lock(w.inboxMutex);
+        w.inbox.push_back(task);
+        ++w.inboxSize;
+        target = task->thread;
+    } else if (self >= 0) {
+        m_workers[self]->queue.push(task);
+    } else {
+        Spinlock::Lock lock(m_injectMutex);
+        m_inject.push_back(task);
+        ++m_injectSize;
+    }
+    //和idle里面先加m_idleThreadCount再看有没有活配对，两边总有一边能看到对方
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (hasIdleThreads()) {
+        tickle(target);
+    }
+}
+
+Scheduler::Task* Scheduler::nextTask(int worker) {
+    Worker& w = *m_workers[worker];
+    Task* task = nullptr;
+    if (w.inboxSize.load(std::memory_order_relaxed) > 0) {
+        Spinlock::Lock lock(w.inboxMutex);
+        if (!w.inbox.empty()) {
+            task = w.inbox.front();
+            w.inbox.pop_front();
+            --w.inboxSize;
+        }
+    }
+    if (!task) {
+        task = w.queue.pop();
+    }
+    if (!task && m_injectSize.load(std::memory_order_relaxed) > 0) {
+        //公共队列一次多拿一些放到自己队列里，少抢几次锁，别的线程也能从这里偷
+        size_t moved = 0;
+        {
+            Spinlock::Lock lock(m_injectMutex);
+            if (!m_inject.empty()) {
+                task = m_inject.front();
+                m_inject.pop_front();
+                --m_injectSize;
+            }
+            while (!m_inject.empty() && moved < 32) {
+                w.queue.push(m_inject.front());
+                m_inject.pop_front();
+                --m_injectSize;
+                ++moved;
+            }
+        }
+        if (moved && hasIdleThreads()) {
+            tickle(-1);
+        }
+    }
+    if (!task && m_workers.size() > 1) {
+        size_t n = m_workers.size();
+        size_t start = random_next() % n;
+        for (size_t i = 0; i < n && !task; ++i) {
+            size_t victim = (start + i) % n;
+            if ((int)victim == worker) {
+                continue;
+            }
+            task = m_workers[victim]->queue.steal();
+            if (task) {
+                ++w.steals;
+            }
+        }
+    }
+    if (task) {
+        //先加active再减pending，stopping不会在中间看到两个都是0
+        ++m_activeThreadCount;
+        --m_pending;
+    }
+    return task;
+}
+
+void Scheduler::run(int worker) {
+    CHPE_LOG_DEBUG(g_logger) << m_name << " run worker=" << worker;
+    setThis();
+    t_worker = worker;
+    Fiber::GetThis();
+    //工作线程里跑的都是协程，默认打开hook；use_caller的调用线程出来之后恢复原样
+    bool hook_enable = is_hook_enable();
+    set_hook_enable(true);
+
+    Worker& w = *m_workers[worker];
+    Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this)));
+    Fiber::ptr cb_fiber;//回调用的协程，跑完了下一个回调接着用
+
+    while (true) {
+        Task* task = nextTask(worker);
+        if (task) {
+            int thread = task->thread;
+            if (task->fiber) {
+                Fiber::ptr fiber;
+                fiber.swap(task->fiber);
+                delete task;
+                if (!fiber->isFinished()) {
+                    //用resume返回的状态，切回来之后协程可能已经被io事件/定时器交给别的线程跑了
+                    Fiber::State state = fiber->resume();
+                    ++w.executed;
+                    if (state == Fiber::READY) {
+                        schedule(fiber, thread);
+                    }
+                    //HOLD的协程由把它挂起的人(io事件/定时器)负责再schedule
+                }
+            } else {
+                if (cb_fiber) {
+                    cb_fiber->reset(task->cb);
+                } else {
+                    cb_fiber.reset(new Fiber(task->cb));
+                }
+                delete task;
+                Fiber::State state = cb_fiber->resume();
+                ++w.executed;
+                if (state == Fiber::READY) {
+                    schedule(cb_fiber, thread);
+                    cb_fiber.reset();
+                } else if (state != Fiber::TERM && state != Fiber::EXCEPT) {
+                    //HOLD的协程归挂起它的人了，这里不能再reset复用
+                    cb_fiber.reset();
+                }
+            }
+            --m_activeThreadCount;
+            continue;
+        }
+
+        if (idle_fiber->isFinished()) {
+            CHPE_LOG_DEBUG(g_logger) << m_name << " idle fiber term, worker=" << worker;
+            //最后一个任务可能是在别的线程跑完的，它们还在睡，叫醒它们自己发现可以停了
+            for (size_t i = 0; i < m_workers.size(); ++i) {
+                if ((int)i != worker) {
+                    tickle((int)i);
+                }
+            }
+            break;
+        }
+        ++m_idleThreadCount;
+        w.idle = true;
+        idle_fiber->resume();
+        w.idle = false;
+        --m_idleThreadCount;
+    }
+    set_hook_enable(hook_enable);
+}
+
+bool Scheduler::hasWork(int worker) const {
+    const Worker& w = *m_workers[worker];
+    if (w.inboxSize > 0 || m_injectSize > 0) {
+        return true;
+    }
+    for (auto& i : m_workers) {
+        if (!i->queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Scheduler::hasPinnedWorkForIdle(int worker) const {
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        if ((int)i != worker && m_workers[i]->idle && m_workers[i]->inboxSize > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::wake(int worker) {
+    Worker& w = *m_workers[worker];
+    std::lock_guard<std::mutex> lock(w.waitMutex);
+    w.signaled = true;
+    w.waitCond.notify_one();
+}
+
+void Scheduler::tickle(int worker) {
+    if (worker >= 0) {
+        wake(worker);
+        return;
+    }
+    //叫醒一个在睡觉的线程就够了，它起来会去偷
+    size_t n = m_workers.size();
+    size_t start = m_tickleCursor++;
+    for (size_t i = 0; i < n; ++i) {
+        size_t idx = (start + i) % n;
+        if (m_workers[idx]->idle) {
+            wake((int)idx);
+            return;
+        }
+    }
+}
+
+bool Scheduler::stopping() {
+    return m_autoStop && m_stopping && m_pending == 0 && m_activeThreadCount == 0;
+}
+
+void Scheduler::idle() {
+    Worker& w = *m_workers[t_worker];
+    while (!stopping()) {
+        {
+            std::unique_lock<std::mutex> lock(w.waitMutex);
+            w.waitCond.wait(lock, [&]() {
+                return w.signaled || hasWork(t_worker) || stopping();
+            });
+            w.signaled = false;
+        }
+        Fiber::YieldToHold();
+    }
+}
+
+Scheduler::WorkerStats Scheduler::getWorkerStats(size_t worker) const {
+    WorkerStats stats;
+    if (worker >= m_workers.size()) {
+        return stats;
+    }
+    const Worker& w = *m_workers[worker];
+    stats.queueLength = w.queue.size();
+    stats.inboxLength = w.inboxSize;
+    stats.steals = w.steals;
+    stats.executed = w.executed;
+    stats.idle = w.idle;
+    return stats;
+}
+
+std::ostream& Scheduler::dump(std::ostream& os) const {
+    os << "[Scheduler name=" << m_name
+       << " workers=" << m_workers.size()
+       << " pending=" << m_pending
+       << " active=" << m_activeThreadCount
+       << " idle=" << m_idleThreadCount
+       << " stopping=" << m_stopping
+       << "]" << std::endl;
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        WorkerStats s = getWorkerStats(i);
+        os << "    worker " << i << ": queue=" << s.queueLength
+           << " inbox=" << s.inboxLength
+           << " steals=" << s.steals
+           << " executed=" << s.executed
+           << " idle=" << s.idle << std::endl;
+    }
+    return os;
+}
+
+}
@@ -0,0 +1,154 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <ostream>
+#include "fiber.h"
+#include "thread.h"
+#include "mutex.h"
+#include "work_steal_queue.h"
+
+namespace cpp_high_perf {
+
+//M:N协程调度器，N个工作线程跑M个协程/回调
+//每个工作线程有一个自己的工作窃取队列，自己线程里schedule的任务放进去，不用加锁；闲下来的线程随机去别人那里偷
+//指定了线程的任务放到那个线程的收件箱(加锁)，别的线程不会偷；不是工作线程schedule进来的任务放到一个公共队列
+//use_caller为true的时候，创建调度器的线程也算一个工作线程(编号0)，stop的时候它才进去跑
+//没活干的时候工作线程跑idle协程，子类(IOManager)覆盖idle/tickle在epoll上睡觉
+class Scheduler {
+public:
+    typedef std::shared_ptr<Scheduler> ptr;
+
+    //每个工作线程的统计
+    struct WorkerStats {
+        size_t queueLength = 0;//自己队列里的任务数
+        size_t inboxLength = 0;//指定给这个线程的任务数
+        uint64_t steals = 0;//从别的线程偷到的次数
+        uint64_t executed = 0;//执行过的任务数
+        bool idle = false;
+    };
+
+    //threads是总的工作线程数(包括use_caller的调用线程)
+    Scheduler(size_t threads = 1, bool use_caller = true, const std::string& name = "");
+    virtual ~Scheduler();
+
+    const std::string& getName() const { return m_name; }
+
+    //当前线程所属的调度器
+    static Scheduler* GetThis();
+    //当前线程在调度器里的编号，不是工作线程的话是-1
+    static int GetWorkerIndex();
+
+    void start();
+    //等所有任务跑完再返回，use_caller的时候调用线程会进去帮忙跑
+    void stop();
+
+    //thread是工作线程的编号(0 ~ threads-1)，-1表示哪个线程都可以
+    template<class FiberOrCb>
+    void schedule(FiberOrCb fc, int thread = -1) {
+        Task* task = new Task(fc, thread);
+        if (!task->fiber && !task->cb) {
+            delete task;
+            return;
+        }
+        scheduleTask(task);
+    }
+
+    template<class InputIterator>
+    void schedule(InputIterator begin, InputIterator end) {
+        while (begin != end) {
+            schedule(*begin);
+            ++begin;
+        }
+    }
+
+    size_t getWorkerCount() const { return m_workers.size(); }
+    WorkerStats getWorkerStats(size_t worker) const;
+    //还没开始跑的任务数
+    uint64_t getPendingCount() const { return m_pending; }
+    std::ostream& dump(std::ostream& os) const;
+
+protected:
+    //有活了，叫醒空闲的线程；worker为-1表示随便哪个
+    virtual void tickle(int worker);
+    //返回true表示可以停了
+    virtual bool stopping();
+    //没活干的时候跑这个，返回了这个线程就退出调度了
+    virtual void idle();
+
+    void run(int worker);
+    void setThis();
+    bool hasIdleThreads() const { return m_idleThreadCount > 0; }
+    //这个线程现在有没有能跑的活，idle里面用来判断要不要继续睡
+    bool hasWork(int worker) const;
+    //有没有指定给别的线程的任务，而那个线程正在睡觉；大家一起在epoll上睡的时候叫不准是哪个线程醒，醒错了要接着叫
+    bool hasPinnedWorkForIdle(int worker) const;
+
+private:
+    struct Task {
+        Fiber::ptr fiber;
+        std::function<void()> cb;
+        int thread;
+
+        Task(Fiber::ptr f, int thr)
+            :fiber(f), thread(thr) {
+        }
+        Task(Fiber::ptr* f, int thr)
+            :thread(thr) {
+            fiber.swap(*f);
+        }
+        Task(std::function<void()> f, int thr)
+            :cb(f), thread(thr) {
+        }
+        Task(std::function<void()>* f, int thr)
+            :thread(thr) {
+            cb.swap(*f);
+        }
+    };
+
+    struct Worker {
+        WorkStealQueue<Task*> queue;
+        Spinlock inboxMutex;
+        std::list<Task*> inbox;
+        std::atomic<size_t> inboxSize{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> executed{0};
+        std::atomic<bool> idle{false};
+        //基础的idle在这里等
+        std::mutex waitMutex;
+        std::condition_variable waitCond;
+        bool signaled = false;
+    };
+
+    void scheduleTask(Task* task);
+    Task* nextTask(int worker);
+    void wake(int worker);
+private:
+    std::string m_name;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<Thread::ptr> m_threads;
+    Fiber::ptr m_rootFiber;//use_caller的时候，调用线程里跑run的协程
+
+    Spinlock m_injectMutex;
+    std::list<Task*> m_inject;//不是工作线程schedule进来的任务
+    std::atomic<size_t> m_injectSize{0};
+
+    std::atomic<uint64_t> m_pending{0};
+    std::atomic<size_t> m_activeThreadCount{0};
+    std::atomic<size_t> m_idleThreadCount{0};
+    std::atomic<size_t> m_tickleCursor{0};
+    std::atomic<bool> m_stopping{true};
+    std::atomic<bool> m_autoStop{false};
+    bool m_useCaller;
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "servlet.h"
+#include <fnmatch.h>
+
+namespace cpp_high_perf {
+
+FunctionServlet::FunctionServlet(callback cb)
+    :Servlet("FunctionServlet")
+    ,m_cb(cb) {
+}
+
+int32_t FunctionServlet::handle(HttpRequest::ptr request, HttpResponse::ptr response,
+                                HttpSession::ptr session) {
+    return m_cb(request, response, session);
+}
+
+NotFoundServlet::NotFoundServlet(const std::string& name)
+    :Servlet("NotFoundServlet") {
+    m_content = "<html><head><title>404 Not Found</title></head><body><center><h1>404 Not Found</h1></center><hr><center>"
+        + name + "</center></body></html>";
+}
+
+int32_t NotFoundServlet::handle(HttpRequest::ptr request, HttpResponse::ptr response,
+                                HttpSession::ptr session) {
+    response->setStatus(HttpStatus::NOT_FOUND);
+    response->setHeader("content-type", "text/html");
+    //不拷，m_content比响应活得久
+    response->setBodyRef(m_content);
+    return 0;
+}
+
+ServletDispatch::ServletDispatch()
+    :Servlet("ServletDispatch") {
+    m_default.reset(new NotFoundServlet("cpp_high_perf/1.0.0"));
+}
+
+int32_t ServletDispatch::handle(HttpRequest::ptr request, HttpResponse::ptr response,
+                                HttpSession::ptr session) {
+    Servlet::ptr slt = getMatchedServlet(request->getPath());
+    if (slt) {
+        slt->handle(request, response, session);
+    }
+    return 0;
+}
+
+void ServletDispatch::rebuildIndex() {
+    m_index.clear();
+    for (auto& i : m_datas) {
+        m_index[StringView(i.first)] = i.second;
+    }
+}
+
+void ServletDispatch::addServlet(const std::string& uri, Servlet::ptr slt) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_datas[uri] = slt;
+    rebuildIndex();
+}
+
+void ServletDispatch::addServlet(const std::string& uri, FunctionServlet::callback cb) {
+    addServlet(uri, Servlet::ptr(new FunctionServlet(cb)));
+}
+
+void ServletDispatch::addGlobServlet(const std::string& uri, Servlet::ptr slt) {
+    RWMutexType::WriteLock lock(m_mutex);
+    for (auto it = m_globs.begin(); it != m_globs.end(); ++it) {
+        if (it->first == uri) {
+            m_globs.erase(it);
+            break;
+        }
+    }
+    m_globs.push_back(std::make_pair(uri, slt));
+}
+
+void ServletDispatch::addGlobServlet(const std::string& uri, FunctionServlet::callback cb) {
+    addGlobServlet(uri, Servlet::ptr(new FunctionServlet(cb)));
+}
+
+void ServletDispatch::delServlet(const std::string& uri) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_datas.erase(uri);
+    rebuildIndex();
+}
+
+void ServletDispatch::delGlobServlet(const std::string& uri) {
+    RWMutexType::WriteLock lock(m_mutex);
+    for (auto it = m_globs.begin(); it != m_globs.end(); ++it) {
+        if (it->first == uri) {
+            m_globs.erase(it);
+            break;
+        }
+    }
+}
+
+Servlet::ptr ServletDispatch::getServlet(StringView uri) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_index.find(uri);
+    return it == m_index.end() ? nullptr : it->second;
+}
+
+Servlet::ptr ServletDispatch::getGlobServlet(StringView uri) {
+    RWMutexType::ReadLock lock(m_mutex);
+    if (m_globs.empty()) {
+        return nullptr;
+    }
+    //fnmatch要'\0'结尾的
+    std::string path = uri.toString();
+    for (auto& i : m_globs) {
+        if (!fnmatch(i.first.c_str(), path.c_str(), 0)) {
+            return i.second;
+        }
+    }
+    return nullptr;
+}
+
+Servlet::ptr ServletDispatch::getMatchedServlet(StringView uri) {
+    Servlet::ptr slt = getServlet(uri);
+    if (slt) {
+        return slt;
+    }
+    slt = getGlobServlet(uri);
+    return slt ? slt : m_default;
+}
+
+}
@@ -0,0 +1,98 @@
+#ifndef __SERVLET_H__
+#define __SERVLET_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include "http.h"
+#include "http_session.h"
+#include "mutex.h"
+
+namespace cpp_high_perf {
+
+//处理一类请求
+class Servlet {
+public:
+    typedef std::shared_ptr<Servlet> ptr;
+
+    Servlet(const std::string& name) : m_name(name) {}
+    virtual ~Servlet() {}
+
+    //返回0表示处理了
+    virtual int32_t handle(HttpRequest::ptr request, HttpResponse::ptr response,
+                           HttpSession::ptr session) = 0;
+
+    const std::string& getName() const { return m_name; }
+protected:
+    std::string m_name;
+};
+
+//用回调处理
+class FunctionServlet : public Servlet {
+public:
+    typedef std::shared_ptr<FunctionServlet> ptr;
+    typedef std::function<int32_t (HttpRequest::ptr request, HttpResponse::ptr response,
+                                   HttpSession::ptr session)> callback;
+
+    FunctionServlet(callback cb);
+    int32_t handle(HttpRequest::ptr request, HttpResponse::ptr response,
+                   HttpSession::ptr session) override;
+private:
+    callback m_cb;
+};
+
+//路径都对不上的时候用的
+class NotFoundServlet : public Servlet {
+public:
+    typedef std::shared_ptr<NotFoundServlet> ptr;
+
+    NotFoundServlet(const std::string& name);
+    int32_t handle(HttpRequest::ptr request, HttpResponse::ptr response,
+                   HttpSession::ptr session) override;
+private:
+    std::string m_content;
+};
+
+//按路径分发: 先找精确匹配的(哈希表，直接拿StringView查，不用先拷成string)，
+//再按加进来的顺序一个个试通配的(fnmatch，比如 /static/*)，都没有用默认的
+class ServletDispatch : public Servlet {
+public:
+    typedef std::shared_ptr<ServletDispatch> ptr;
+    typedef RWMutex RWMutexType;
+
+    ServletDispatch();
+    int32_t handle(HttpRequest::ptr request, HttpResponse::ptr response,
+                   HttpSession::ptr session) override;
+
+    void addServlet(const std::string& uri, Servlet::ptr slt);
+    void addServlet(const std::string& uri, FunctionServlet::callback cb);
+    void addGlobServlet(const std::string& uri, Servlet::ptr slt);
+    void addGlobServlet(const std::string& uri, FunctionServlet::callback cb);
+
+    void delServlet(const std::string& uri);
+    void delGlobServlet(const std::string& uri);
+
+    Servlet::ptr getDefault() const { return m_default; }
+    void setDefault(Servlet::ptr v) { m_default = v; }
+
+    Servlet::ptr getServlet(StringView uri);
+    Servlet::ptr getGlobServlet(StringView uri);
+    //精确 -> 通配 -> 默认
+    Servlet::ptr getMatchedServlet(StringView uri);
+private:
+    //m_datas改了之后重建索引，索引的key指向m_datas里的string
+    void rebuildIndex();
+private:
+    RWMutexType m_mutex;
+    std::map<std::string, Servlet::ptr> m_datas;
+    std::unordered_map<StringView, Servlet::ptr, StringViewHash> m_index;
+    std::vector<std::pair<std::string, Servlet::ptr> > m_globs;
+    Servlet::ptr m_default;
+};
+
+}
+
+#endif
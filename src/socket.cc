@@ -0,0 +1,476 @@
+#include "socket.h"
+#include "fd_manager.h"
+#include "iomanager.h"
+#include "hook.h"
+#include "log.h"
+#include <sstream>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+Socket::ptr Socket::CreateTCP(Address::ptr address) {
+    return Socket::ptr(new Socket(address->getFamily(), TCP, 0));
+}
+
+Socket::ptr Socket::CreateUDP(Address::ptr address) {
+    Socket::ptr sock(new Socket(address->getFamily(), UDP, 0));
+    //udp不用connect，创建出来就能收发
+    sock->newSock();
+    sock->m_isConnected = true;
+    return sock;
+}
+
+Socket::ptr Socket::CreateTCPSocket() {
+    return Socket::ptr(new Socket(IPv4, TCP, 0));
+}
+
+Socket::ptr Socket::CreateUDPSocket() {
+    Socket::ptr sock(new Socket(IPv4, UDP, 0));
+    sock->newSock();
+    sock->m_isConnected = true;
+    return sock;
+}
+
+Socket::ptr Socket::CreateTCPSocket6() {
+    return Socket::ptr(new Socket(IPv6, TCP, 0));
+}
+
+Socket::ptr Socket::CreateUDPSocket6() {
+    Socket::ptr sock(new Socket(IPv6, UDP, 0));
+    sock->newSock();
+    sock->m_isConnected = true;
+    return sock;
+}
+
+Socket::ptr Socket::CreateUnixTCPSocket() {
+    return Socket::ptr(new Socket(UNIX, TCP, 0));
+}
+
+Socket::ptr Socket::CreateUnixUDPSocket() {
+    return Socket::ptr(new Socket(UNIX, UDP, 0));
+}
+
+Socket::Socket(int family, int type, int protocol)
+    :m_sock(-1)
+    ,m_family(family)
+    ,m_type(type)
+    ,m_protocol(protocol)
+    ,m_isConnected(false) {
+}
+
+Socket::~Socket() {
+    close();
+}
+
+int64_t Socket::getSendTimeout() {
+    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    if (ctx) {
+        uint64_t v = ctx->getTimeout(SO_SNDTIMEO);
+        return v == ~0ull ? -1 : (int64_t)v;
+    }
+    return -1;
+}
+
+void Socket::setSendTimeout(int64_t v) {
+    struct timeval tv;
+    if (v < 0) {
+        v = 0;
+    }
+    tv.tv_sec = v / 1000;
+    tv.tv_usec = v % 1000 * 1000;
+    setOption(SOL_SOCKET, SO_SNDTIMEO, tv);
+}
+
+int64_t Socket::getRecvTimeout() {
+    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    if (ctx) {
+        uint64_t v = ctx->getTimeout(SO_RCVTIMEO);
+        return v == ~0ull ? -1 : (int64_t)v;
+    }
+    return -1;
+}
+
+void Socket::setRecvTimeout(int64_t v) {
+    struct timeval tv;
+    if (v < 0) {
+        v = 0;
+    }
+    tv.tv_sec = v / 1000;
+    tv.tv_usec = v % 1000 * 1000;
+    setOption(SOL_SOCKET, SO_RCVTIMEO, tv);
+}
+
+bool Socket::getOption(int level, int option, void* result, socklen_t* len) {
+    int rt = getsockopt(m_sock, level, option, result, len);
+    if (rt) {
+        CHPE_LOG_DEBUG(g_logger) << "getOption sock=" << m_sock << " level=" << level
+            << " option=" << option << " errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setOption(int level, int option, const void* result, socklen_t len) {
+    if (setsockopt(m_sock, level, option, result, len)) {
+        CHPE_LOG_DEBUG(g_logger) << "setOption sock=" << m_sock << " level=" << level
+            << " option=" << option << " errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setTcpNoDelay(bool v) {
+    int val = v ? 1 : 0;
+    return setOption(IPPROTO_TCP, TCP_NODELAY, val);
+}
+
+bool Socket::setReuseAddr(bool v) {
+    int val = v ? 1 : 0;
+    return setOption(SOL_SOCKET, SO_REUSEADDR, val);
+}
+
+bool Socket::setReusePort(bool v) {
+    if (!isValid()) {
+        newSock();
+    }
+    int val = v ? 1 : 0;
+    return setOption(SOL_SOCKET, SO_REUSEPORT, val);
+}
+
+Socket::ptr Socket::accept() {
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    int flags = SOCK_CLOEXEC;
+    //协程里反正要设成非阻塞，accept的时候直接带上
+    if (is_hook_enable()) {
+        flags |= SOCK_NONBLOCK;
+    }
+    int newsock = ::accept4(m_sock, (sockaddr*)&addr, &len, flags);
+    if (newsock == -1) {
+        CHPE_LOG_DEBUG(g_logger) << "accept(" << m_sock << ") errno="
+            << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    Socket::ptr sock(new Socket(m_family, m_type, m_protocol));
+    if (sock->init(newsock, Address::Create((sockaddr*)&addr, len))) {
+        return sock;
+    }
+    return nullptr;
+}
+
+bool Socket::init(int sock, Address::ptr remote) {
+    FdCtx::ptr ctx = FdMgr::GetInstance()->get(sock);
+    if (ctx && ctx->isSocket() && !ctx->isClose()) {
+        //SOCK_NONBLOCK只是为了省一次fcntl，对用户还是(协程)阻塞的
+        ctx->setUserNonblock(false);
+    }
+    m_sock = sock;
+    m_isConnected = true;
+    m_remoteAddress = remote;
+    //accept出来的不需要SO_REUSEADDR，只设nodelay
+    if (m_type == SOCK_STREAM && m_family != AF_UNIX) {
+        setTcpNoDelay(true);
+    }
+    return true;
+}
+
+void Socket::initSock() {
+    int val = 1;
+    setOption(SOL_SOCKET, SO_REUSEADDR, val);
+    if (m_type == SOCK_STREAM && m_family != AF_UNIX) {
+        setOption(IPPROTO_TCP, TCP_NODELAY, val);
+    }
+}
+
+void Socket::newSock() {
+    m_sock = socket(m_family, m_type | SOCK_CLOEXEC, m_protocol);
+    if (m_sock != -1) {
+        initSock();
+    } else {
+        CHPE_LOG_ERROR(g_logger) << "socket(" << m_family << ", " << m_type << ", "
+            << m_protocol << ") errno=" << errno << " errstr=" << strerror(errno);
+    }
+}
+
+bool Socket::bind(const Address::ptr addr) {
+    if (!isValid()) {
+        newSock();
+        if (!isValid()) {
+            return false;
+        }
+    }
+    if (addr->getFamily() != m_family) {
+        CHPE_LOG_ERROR(g_logger) << "bind sock.family(" << m_family << ") addr.family("
+            << addr->getFamily() << ") not equal, addr=" << addr->toString();
+        return false;
+    }
+    //const的引用，用只读的getAddr，地址可能是好几个socket共用的
+    const Address& a = *addr;
+    if (::bind(m_sock, a.getAddr(), a.getAddrLen())) {
+        CHPE_LOG_ERROR(g_logger) << "bind error errno=" << errno
+            << " errstr=" << strerror(errno) << " addr=" << addr->toString();
+        return false;
+    }
+    getLocalAddress();
+    return true;
+}
+
+bool Socket::connect(const Address::ptr addr, uint64_t timeout_ms) {
+    m_remoteAddress = addr;
+    if (!isValid()) {
+        newSock();
+        if (!isValid()) {
+            return false;
+        }
+    }
+    if (addr->getFamily() != m_family) {
+        CHPE_LOG_ERROR(g_logger) << "connect sock.family(" << m_family << ") addr.family("
+            << addr->getFamily() << ") not equal, addr=" << addr->toString();
+        return false;
+    }
+    const Address& a = *addr;
+    int rt = 0;
+    if (timeout_ms == ~0ull) {
+        rt = ::connect(m_sock, a.getAddr(), a.getAddrLen());
+    } else {
+        rt = ::connect_with_timeout(m_sock, a.getAddr(), a.getAddrLen(), timeout_ms);
+    }
+    if (rt) {
+        CHPE_LOG_DEBUG(g_logger) << "sock=" << m_sock << " connect(" << addr->toString()
+            << ") timeout=" << timeout_ms << " error errno=" << errno << " errstr=" << strerror(errno);
+        close();
+        return false;
+    }
+    m_isConnected = true;
+    getLocalAddress();
+    return true;
+}
+
+bool Socket::listen(int backlog) {
+    if (!isValid()) {
+        CHPE_LOG_ERROR(g_logger) << "listen error sock=-1";
+        return false;
+    }
+    if (::listen(m_sock, backlog)) {
+        CHPE_LOG_ERROR(g_logger) << "listen error errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::close() {
+    m_isConnected = false;
+    if (m_sock == -1) {
+        return true;
+    }
+    int rt = ::close(m_sock);
+    m_sock = -1;
+    return rt == 0;
+}
+
+//流式socket写的时候带上MSG_NOSIGNAL，对端关了返回EPIPE，而不是整个进程收到SIGPIPE
+static int send_flags(int type, int flags) {
+    return type == SOCK_STREAM ? (flags | MSG_NOSIGNAL) : flags;
+}
+
+ssize_t Socket::send(const void* buffer, size_t length, int flags) {
+    if (isConnected()) {
+        return ::send(m_sock, buffer, length, send_flags(m_type, flags));
+    }
+    return -1;
+}
+
+ssize_t Socket::send(const iovec* buffers, size_t length, int flags) {
+    if (isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec*)buffers;
+        msg.msg_iovlen = std::min(length, (size_t)IOV_MAX);
+        return ::sendmsg(m_sock, &msg, send_flags(m_type, flags));
+    }
+    return -1;
+}
+
+ssize_t Socket::sendTo(const void* buffer, size_t length, const Address::ptr to, int flags) {
+    if (isConnected()) {
+        const Address& a = *to;
+        return ::sendto(m_sock, buffer, length, send_flags(m_type, flags), a.getAddr(), a.getAddrLen());
+    }
+    return -1;
+}
+
+ssize_t Socket::sendTo(const iovec* buffers, size_t length, const Address::ptr to, int flags) {
+    if (isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec*)buffers;
+        msg.msg_iovlen = std::min(length, (size_t)IOV_MAX);
+        const Address& a = *to;
+        msg.msg_name = (void*)a.getAddr();
+        msg.msg_namelen = a.getAddrLen();
+        return ::sendmsg(m_sock, &msg, send_flags(m_type, flags));
+    }
+    return -1;
+}
+
+ssize_t Socket::recv(void* buffer, size_t length, int flags) {
+    if (isConnected()) {
+        return ::recv(m_sock, buffer, length, flags);
+    }
+    return -1;
+}
+
+ssize_t Socket::recv(iovec* buffers, size_t length, int flags) {
+    if (isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = buffers;
+        msg.msg_iovlen = std::min(length, (size_t)IOV_MAX);
+        return ::recvmsg(m_sock, &msg, flags);
+    }
+    return -1;
+}
+
+//系统通过可写的getAddr填了地址之后，unix域地址要记下长度，toString的字符串重新生成
+static void update_address(Address::ptr addr, socklen_t len) {
+    UnixAddress::ptr ua = std::dynamic_pointer_cast<UnixAddress>(addr);
+    if (ua) {
+        ua->setAddrLen(len);
+    } else {
+        addr->updateString();
+    }
+}
+
+ssize_t Socket::recvFrom(void* buffer, size_t length, Address::ptr from, int flags) {
+    if (isConnected()) {
+        socklen_t len = from->getAddrLen();
+        ssize_t rt = ::recvfrom(m_sock, buffer, length, flags, from->getAddr(), &len);
+        if (rt >= 0) {
+            update_address(from, len);
+        }
+        return rt;
+    }
+    return -1;
+}
+
+ssize_t Socket::recvFrom(iovec* buffers, size_t length, Address::ptr from, int flags) {
+    if (isConnected()) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = buffers;
+        msg.msg_iovlen = std::min(length, (size_t)IOV_MAX);
+        msg.msg_name = from->getAddr();
+        msg.msg_namelen = from->getAddrLen();
+        ssize_t rt = ::recvmsg(m_sock, &msg, flags);
+        if (rt >= 0) {
+            update_address(from, msg.msg_namelen);
+        }
+        return rt;
+    }
+    return -1;
+}
+
+//按family建一个空地址，给getpeername/getsockname填
+static Address::ptr create_empty_address(int family) {
+    switch (family) {
+        case AF_INET:
+            return Address::ptr(new IPv4Address());
+        case AF_INET6:
+            return Address::ptr(new IPv6Address());
+        case AF_UNIX:
+            return Address::ptr(new UnixAddress());
+        default:
+            return Address::ptr(new UnknownAddress(family));
+    }
+}
+
+Address::ptr Socket::getRemoteAddress() {
+    if (m_remoteAddress) {
+        return m_remoteAddress;
+    }
+    Address::ptr result = create_empty_address(m_family);
+    socklen_t addrlen = result->getAddrLen();
+    if (getpeername(m_sock, result->getAddr(), &addrlen)) {
+        return Address::ptr(new UnknownAddress(m_family));
+    }
+    update_address(result, addrlen);
+    m_remoteAddress = result;
+    return m_remoteAddress;
+}
+
+Address::ptr Socket::getLocalAddress() {
+    if (m_localAddress) {
+        return m_localAddress;
+    }
+    Address::ptr result = create_empty_address(m_family);
+    socklen_t addrlen = result->getAddrLen();
+    if (getsockname(m_sock, result->getAddr(), &addrlen)) {
+        CHPE_LOG_ERROR(g_logger) << "getsockname error sock=" << m_sock
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        return Address::ptr(new UnknownAddress(m_family));
+    }
+    update_address(result, addrlen);
+    m_localAddress = result;
+    return m_localAddress;
+}
+
+int Socket::getError() {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (!getOption(SOL_SOCKET, SO_ERROR, &error, &len)) {
+        error = errno;
+    }
+    return error;
+}
+
+std::ostream& Socket::dump(std::ostream& os) const {
+    os << "[Socket sock=" << m_sock
+       << " is_connected=" << m_isConnected
+       << " family=" << m_family
+       << " type=" << m_type
+       << " protocol=" << m_protocol;
+    if (m_localAddress) {
+        os << " local_address=" << m_localAddress->toString();
+    }
+    if (m_remoteAddress) {
+        os << " remote_address=" << m_remoteAddress->toString();
+    }
+    os << "]";
+    return os;
+}
+
+std::string Socket::toString() const {
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+bool Socket::cancelRead() {
+    IOManager* iom = IOManager::GetThis();
+    return iom && iom->cancelEvent(m_sock, IOManager::READ);
+}
+
+bool Socket::cancelWrite() {
+    IOManager* iom = IOManager::GetThis();
+    return iom && iom->cancelEvent(m_sock, IOManager::WRITE);
+}
+
+bool Socket::cancelAccept() {
+    IOManager* iom = IOManager::GetThis();
+    return iom && iom->cancelEvent(m_sock, IOManager::READ);
+}
+
+bool Socket::cancelAll() {
+    IOManager* iom = IOManager::GetThis();
+    return iom && iom->cancelAll(m_sock);
+}
+
+std::ostream& operator<<(std::ostream& os, const Socket& sock) {
+    return sock.dump(os);
+}
+
+}
@@ -0,0 +1,139 @@
+#ifndef __SOCKET_H__
+#define __SOCKET_H__
+
+#include <memory>
+#include <string>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#include "address.h"
+
+namespace cpp_high_perf {
+
+//socket的封装
+//在开了hook的线程(IOManager的协程)里创建和使用的时候，读写/accept/connect是协程阻塞的:
+//没数据就把协程挂到IOManager上，线程去跑别的协程，超时用setRecvTimeout/setSendTimeout设
+//不在协程里用就是普通的阻塞socket
+//带iovec的send/recv直接走sendmsg/recvmsg，协议头和包体分开放，不用先拼成一个大字符串
+class Socket : public std::enable_shared_from_this<Socket> {
+public:
+    typedef std::shared_ptr<Socket> ptr;
+    typedef std::weak_ptr<Socket> weak_ptr;
+
+    enum Type {
+        TCP = SOCK_STREAM,
+        UDP = SOCK_DGRAM
+    };
+
+    enum Family {
+        IPv4 = AF_INET,
+        IPv6 = AF_INET6,
+        UNIX = AF_UNIX
+    };
+
+    //和address同一个family的socket
+    static Socket::ptr CreateTCP(Address::ptr address);
+    static Socket::ptr CreateUDP(Address::ptr address);
+
+    static Socket::ptr CreateTCPSocket();
+    static Socket::ptr CreateUDPSocket();
+    static Socket::ptr CreateTCPSocket6();
+    static Socket::ptr CreateUDPSocket6();
+    static Socket::ptr CreateUnixTCPSocket();
+    static Socket::ptr CreateUnixUDPSocket();
+
+    //真正的fd在bind/connect的时候才创建
+    Socket(int family, int type, int protocol = 0);
+    ~Socket();
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    //超时(毫秒)，-1表示不超时
+    int64_t getSendTimeout();
+    void setSendTimeout(int64_t v);
+    int64_t getRecvTimeout();
+    void setRecvTimeout(int64_t v);
+
+    bool getOption(int level, int option, void* result, socklen_t* len);
+    template<class T>
+    bool getOption(int level, int option, T& result) {
+        socklen_t length = sizeof(T);
+        return getOption(level, option, &result, &length);
+    }
+
+    bool setOption(int level, int option, const void* result, socklen_t len);
+    template<class T>
+    bool setOption(int level, int option, const T& value) {
+        return setOption(level, option, &value, sizeof(T));
+    }
+
+    bool setTcpNoDelay(bool v);
+    bool setReuseAddr(bool v);
+    //几个进程/线程各自bind同一个端口，内核按连接分给它们，要在bind之前设
+    bool setReusePort(bool v);
+
+    //新连接用accept4一次拿到，顺带设好CLOEXEC，协程里还会直接带上SOCK_NONBLOCK，
+    //省掉一次fcntl；对端地址也是accept的时候一起拿到的
+    Socket::ptr accept();
+    bool bind(const Address::ptr addr);
+    //timeout_ms为~0ull的时候用配置里的tcp.connect.timeout
+    bool connect(const Address::ptr addr, uint64_t timeout_ms = ~0ull);
+    bool listen(int backlog = SOMAXCONN);
+    bool close();
+
+    //返回值和系统调用一样: >0 字节数，=0 对端关闭，<0 出错
+    ssize_t send(const void* buffer, size_t length, int flags = 0);
+    ssize_t send(const iovec* buffers, size_t length, int flags = 0);
+    ssize_t sendTo(const void* buffer, size_t length, const Address::ptr to, int flags = 0);
+    ssize_t sendTo(const iovec* buffers, size_t length, const Address::ptr to, int flags = 0);
+
+    ssize_t recv(void* buffer, size_t length, int flags = 0);
+    ssize_t recv(iovec* buffers, size_t length, int flags = 0);
+    ssize_t recvFrom(void* buffer, size_t length, Address::ptr from, int flags = 0);
+    ssize_t recvFrom(iovec* buffers, size_t length, Address::ptr from, int flags = 0);
+
+    //第一次调用的时候取，之后缓存
+    Address::ptr getRemoteAddress();
+    Address::ptr getLocalAddress();
+
+    int getSocket() const { return m_sock; }
+    int getFamily() const { return m_family; }
+    int getType() const { return m_type; }
+    int getProtocol() const { return m_protocol; }
+    bool isConnected() const { return m_isConnected; }
+    bool isValid() const { return m_sock != -1; }
+    //SO_ERROR
+    int getError();
+
+    std::ostream& dump(std::ostream& os) const;
+    std::string toString() const;
+
+    //把等在这个socket上的协程叫醒，它们的调用会失败返回
+    bool cancelRead();
+    bool cancelWrite();
+    bool cancelAccept();
+    bool cancelAll();
+private:
+    void initSock();
+    void newSock();
+    //accept出来的fd
+    bool init(int sock, Address::ptr remote);
+private:
+    int m_sock;
+    int m_family;
+    int m_type;
+    int m_protocol;
+    bool m_isConnected;
+
+    Address::ptr m_localAddress;
+    Address::ptr m_remoteAddress;
+};
+
+std::ostream& operator<<(std::ostream& os, const Socket& sock);
+
+}
+
+#endif
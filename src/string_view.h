@@ -0,0 +1,129 @@
+#ifndef __STRING_VIEW_H__
+#define __STRING_VIEW_H__
+
+#include <string>
+#include <ostream>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace cpp_high_perf {
+
+//c++11没有std::string_view，自己写一个够用的
+//只是一个指针加长度，不管内存，指向的缓冲区要比它活得久
+class StringView {
+public:
+    static const size_t npos = (size_t)-1;
+
+    StringView() : m_data(""), m_size(0) {}
+    StringView(const char* data, size_t size) : m_data(data), m_size(size) {}
+    StringView(const char* str) : m_data(str), m_size(strlen(str)) {}
+    StringView(const std::string& str) : m_data(str.data()), m_size(str.size()) {}
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const char* begin() const { return m_data; }
+    const char* end() const { return m_data + m_size; }
+    char operator[](size_t i) const { return m_data[i]; }
+
+    std::string toString() const { return std::string(m_data, m_size); }
+
+    StringView substr(size_t pos, size_t n = npos) const {
+        if (pos > m_size) {
+            pos = m_size;
+        }
+        if (n > m_size - pos) {
+            n = m_size - pos;
+        }
+        return StringView(m_data + pos, n);
+    }
+
+    size_t find(char c, size_t pos = 0) const {
+        if (pos >= m_size) {
+            return npos;
+        }
+        const void* p = memchr(m_data + pos, c, m_size - pos);
+        return p ? (const char*)p - m_data : npos;
+    }
+
+    size_t find(StringView s, size_t pos = 0) const {
+        if (s.m_size > m_size) {
+            return npos;
+        }
+        for (size_t i = pos; i + s.m_size <= m_size; ++i) {
+            if (memcmp(m_data + i, s.m_data, s.m_size) == 0) {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    bool startsWith(StringView s) const {
+        return m_size >= s.m_size && memcmp(m_data, s.m_data, s.m_size) == 0;
+    }
+
+    int compare(StringView rhs) const {
+        int rt = memcmp(m_data, rhs.m_data, m_size < rhs.m_size ? m_size : rhs.m_size);
+        if (rt) {
+            return rt;
+        }
+        return m_size < rhs.m_size ? -1 : (m_size > rhs.m_size ? 1 : 0);
+    }
+
+    //http的头名字不区分大小写
+    bool equalsIgnoreCase(StringView rhs) const {
+        return m_size == rhs.m_size && strncasecmp(m_data, rhs.m_data, m_size) == 0;
+    }
+
+    //去掉两头的空格和tab
+    StringView trim() const {
+        size_t b = 0;
+        size_t e = m_size;
+        while (b < e && (m_data[b] == ' ' || m_data[b] == '\t')) {
+            ++b;
+        }
+        while (e > b && (m_data[e - 1] == ' ' || m_data[e - 1] == '\t')) {
+            --e;
+        }
+        return StringView(m_data + b, e - b);
+    }
+
+    //FNV-1a，和ConfigHash一样
+    uint64_t hash() const {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < m_size; ++i) {
+            h ^= (unsigned char)m_data[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+private:
+    const char* m_data;
+    size_t m_size;
+};
+
+inline bool operator==(StringView lhs, StringView rhs) {
+    return lhs.size() == rhs.size() && memcmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+inline bool operator!=(StringView lhs, StringView rhs) {
+    return !(lhs == rhs);
+}
+
+inline bool operator<(StringView lhs, StringView rhs) {
+    return lhs.compare(rhs) < 0;
+}
+
+inline std::ostream& operator<<(std::ostream& os, StringView v) {
+    return os.write(v.data(), v.size());
+}
+
+//放unordered_map里用
+struct StringViewHash {
+    size_t operator()(StringView v) const { return v.hash(); }
+};
+
+}
+
+#endif
@@ -0,0 +1,287 @@
+#include "tcp_server.h"
+#include "fd_manager.h"
+#include "config.h"
+#include "log.h"
+#include "util.h"
+#include <sstream>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+static ConfigVar<int>::ptr g_system_port =
+    Config::lookup<int>("system.port", 8080, "system port");
+
+static ConfigVar<uint64_t>::ptr g_tcp_server_read_timeout =
+    Config::lookup<uint64_t>("tcp_server.read_timeout", 60 * 1000 * 2, "tcp server read timeout(ms), 0 means no timeout");
+
+static ConfigVar<uint64_t>::ptr g_tcp_server_write_timeout =
+    Config::lookup<uint64_t>("tcp_server.write_timeout", 60 * 1000 * 2, "tcp server write timeout(ms), 0 means no timeout");
+
+static ConfigVar<uint64_t>::ptr g_tcp_server_graceful_timeout =
+    Config::lookup<uint64_t>("tcp_server.graceful_timeout", 5000, "tcp server graceful stop timeout(ms)");
+
+//accept的时候要用，缓存成原子变量，不用每个连接都去拿配置的锁
+static std::atomic<uint64_t> s_read_timeout{60 * 1000 * 2};
+static std::atomic<uint64_t> s_write_timeout{60 * 1000 * 2};
+//accept因为fd、内存不够失败之后歇多久(毫秒)
+static const uint64_t s_accept_backoff = 50;
+
+struct TcpServerConfigIniter {
+    TcpServerConfigIniter() {
+        s_read_timeout = g_tcp_server_read_timeout->getValue();
+        g_tcp_server_read_timeout->addListener([](const uint64_t&, const uint64_t& new_value) {
+            CHPE_LOG_INFO(g_logger) << "tcp server read timeout changed to " << new_value;
+            s_read_timeout = new_value;
+        });
+        s_write_timeout = g_tcp_server_write_timeout->getValue();
+        g_tcp_server_write_timeout->addListener([](const uint64_t&, const uint64_t& new_value) {
+            CHPE_LOG_INFO(g_logger) << "tcp server write timeout changed to " << new_value;
+            s_write_timeout = new_value;
+        });
+    }
+};
+
+static TcpServerConfigIniter s_tcp_server_config_initer;
+
+uint64_t TcpServer::GetReadTimeout() {
+    return s_read_timeout;
+}
+
+uint64_t TcpServer::GetWriteTimeout() {
+    return s_write_timeout;
+}
+
+TcpServer::TcpServer(IOManager* io_worker, IOManager* accept_worker)
+    :m_ioWorker(io_worker)
+    ,m_acceptWorker(accept_worker)
+    ,m_name("cpp_high_perf/1.0.0") {
+}
+
+TcpServer::~TcpServer() {
+    for (auto& i : m_socks) {
+        i->close();
+    }
+    m_socks.clear();
+}
+
+bool TcpServer::bind() {
+    int port = g_system_port->getValue();
+    if (port < 0 || port > 65535) {
+        CHPE_LOG_ERROR(g_logger) << "invalid system.port=" << port;
+        return false;
+    }
+    return bind(Address::ptr(new IPv4Address(INADDR_ANY, port)));
+}
+
+bool TcpServer::bind(Address::ptr addr) {
+    std::vector<Address::ptr> addrs;
+    std::vector<Address::ptr> fails;
+    addrs.push_back(addr);
+    return bind(addrs, fails);
+}
+
+bool TcpServer::bind(const std::vector<Address::ptr>& addrs, std::vector<Address::ptr>& fails) {
+    for (auto& addr : addrs) {
+        std::vector<Socket::ptr> socks;
+        if (!listenShards(addr, socks)) {
+            fails.push_back(addr);
+            continue;
+        }
+        m_socks.insert(m_socks.end(), socks.begin(), socks.end());
+    }
+
+    if (!fails.empty()) {
+        m_socks.clear();
+        return false;
+    }
+
+    for (auto& i : m_socks) {
+        CHPE_LOG_INFO(g_logger) << "server bind success: " << *i;
+    }
+    return true;
+}
+
+bool TcpServer::listenShards(Address::ptr addr, std::vector<Socket::ptr>& socks) {
+    //unix域的socket没有SO_REUSEPORT，只开一个
+    size_t count = addr->getFamily() == AF_UNIX ? 1 : m_acceptWorker->getWorkerCount();
+    Address::ptr bind_addr = addr;
+    for (size_t i = 0; i < count; ++i) {
+        Socket::ptr sock = Socket::CreateTCP(bind_addr);
+        if (count > 1 && !sock->setReusePort(true)) {
+            //内核不支持的话退回到一个监听socket
+            CHPE_LOG_WARN(g_logger) << "SO_REUSEPORT not supported, addr=" << addr->toString()
+                << " use one listen socket";
+            count = 1;
+        }
+        if (!sock->bind(bind_addr)) {
+            CHPE_LOG_ERROR(g_logger) << "bind fail errno=" << errno << " errstr=" << strerror(errno)
+                << " addr=[" << bind_addr->toString() << "]";
+            return false;
+        }
+        if (!sock->listen()) {
+            CHPE_LOG_ERROR(g_logger) << "listen fail errno=" << errno << " errstr=" << strerror(errno)
+                << " addr=[" << bind_addr->toString() << "]";
+            return false;
+        }
+        //端口是0的时候，后面的要绑到第一个实际拿到的端口上
+        if (i == 0) {
+            bind_addr = sock->getLocalAddress();
+        }
+        socks.push_back(sock);
+    }
+    return true;
+}
+
+bool TcpServer::start() {
+    if (!m_isStop) {
+        return true;
+    }
+    m_isStop = false;
+    int workers = m_acceptWorker->getWorkerCount();
+    for (size_t i = 0; i < m_socks.size(); ++i) {
+        //在协程外面创建的fd没有hook的上下文，accept会把线程卡住，这里补上
+        FdMgr::GetInstance()->get(m_socks[i]->getSocket(), true);
+        //同一个地址的几个监听socket分到不同的accept线程上
+        m_acceptWorker->schedule(std::bind(&TcpServer::startAccept,
+                    shared_from_this(), m_socks[i]), i % workers);
+    }
+    return true;
+}
+
+void TcpServer::stop() {
+    if (m_isStop.exchange(true)) {
+        return;
+    }
+    auto self = shared_from_this();
+    //不用cancelAll+close: 被cancel叫醒的accept会在hook里重试，赶上另一个线程还没close的话又注册上事件，
+    //fd关掉之后这个事件永远不会来，accept协程就一直挂着，IOManager也停不下来
+    //监听socket shutdown之后，等着的accept被叫醒，之后的accept都马上返回EINVAL，accept循环自己退出再close
+    for (auto& sock : m_socks) {
+        ::shutdown(sock->getSocket(), SHUT_RDWR);
+    }
+    m_socks.clear();
+
+    if (getConnectionCount() > 0) {
+        m_ioWorker->addTimer(g_tcp_server_graceful_timeout->getValue(), [self]() {
+            self->cancelClients();
+        });
+    }
+}
+
+void TcpServer::startAccept(Socket::ptr sock) {
+    //accept出错的日志一秒最多打一条，中间没打的记个数
+    uint64_t last_error_log = 0;
+    uint64_t suppressed = 0;
+    while (!m_isStop) {
+        Socket::ptr client = sock->accept();
+        if (!client) {
+            int err = errno;
+            if (m_isStop) {
+                break;
+            }
+            //监听socket自己坏了，再accept也没用
+            if (err == EBADF || err == EINVAL || err == ENOTSOCK) {
+                CHPE_LOG_ERROR(g_logger) << "accept errno=" << err
+                    << " errstr=" << strerror(err) << " sock=" << *sock;
+                break;
+            }
+            //被信号打断，或者连接在accept之前就被对端断了，马上接着accept
+            if (err == EINTR || err == ECONNABORTED) {
+                continue;
+            }
+            //EMFILE/ENFILE/ENOBUFS/ENOMEM这些，等着的连接还在，监听socket一直可读，
+            //马上重试协程会空转，日志也会刷屏，歇一会儿再来
+            uint64_t now = GetMonotonicMS();
+            if (now - last_error_log >= 1000) {
+                CHPE_LOG_ERROR(g_logger) << "accept errno=" << err
+                    << " errstr=" << strerror(err) << " suppressed=" << suppressed
+                    << " sock=" << *sock;
+                last_error_log = now;
+                suppressed = 0;
+            } else {
+                ++suppressed;
+            }
+            usleep(s_accept_backoff * 1000);
+            continue;
+        }
+        ++m_acceptCount;
+        uint64_t timeout = s_read_timeout;
+        if (timeout) {
+            client->setRecvTimeout(timeout);
+        }
+        timeout = s_write_timeout;
+        if (timeout) {
+            client->setSendTimeout(timeout);
+        }
+        //accept的时候就记下来，stop的时候还没轮到跑的连接也算在里面
+        {
+            Mutex::Lock lock(m_mutex);
+            m_clients[client.get()] = client;
+        }
+        m_ioWorker->schedule(std::bind(&TcpServer::onClient, shared_from_this(), client));
+    }
+    sock->close();
+}
+
+void TcpServer::onClient(Socket::ptr client) {
+    handleClient(client);
+    Mutex::Lock lock(m_mutex);
+    m_clients.erase(client.get());
+}
+
+void TcpServer::cancelClients() {
+    std::vector<Socket::ptr> clients;
+    {
+        Mutex::Lock lock(m_mutex);
+        for (auto& i : m_clients) {
+            Socket::ptr client = i.second.lock();
+            if (client) {
+                clients.push_back(client);
+            }
+        }
+    }
+    //shutdown之后等在读写上的协程会被epoll叫醒，读到0/写出错，handleClient自己返回
+    for (auto& client : clients) {
+        CHPE_LOG_INFO(g_logger) << "graceful stop timeout, shutdown " << *client;
+        ::shutdown(client->getSocket(), SHUT_RDWR);
+    }
+}
+
+void TcpServer::handleClient(Socket::ptr client) {
+    CHPE_LOG_INFO(g_logger) << "handleClient: " << *client;
+}
+
+size_t TcpServer::getConnectionCount() const {
+    Mutex::Lock lock(m_mutex);
+    return m_clients.size();
+}
+
+std::vector<Address::ptr> TcpServer::getAddresses() const {
+    std::vector<Address::ptr> addrs;
+    for (auto& i : m_socks) {
+        addrs.push_back(i->getLocalAddress());
+    }
+    return addrs;
+}
+
+std::string TcpServer::toString(const std::string& prefix) {
+    std::stringstream ss;
+    ss << prefix << "[name=" << m_name
+       << " io_worker=" << (m_ioWorker ? m_ioWorker->getName() : "")
+       << " accept_worker=" << (m_acceptWorker ? m_acceptWorker->getName() : "")
+       << " read_timeout=" << GetReadTimeout()
+       << " write_timeout=" << GetWriteTimeout()
+       << " connections=" << getConnectionCount()
+       << " accepted=" << m_acceptCount << "]" << std::endl;
+    std::string pfx = prefix.empty() ? "    " : prefix;
+    for (auto& i : m_socks) {
+        ss << pfx << pfx << *i << std::endl;
+    }
+    return ss.str();
+}
+
+}
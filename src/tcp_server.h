@@ -0,0 +1,90 @@
+#ifndef __TCP_SERVER_H__
+#define __TCP_SERVER_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <functional>
+#include "address.h"
+#include "socket.h"
+#include "iomanager.h"
+#include "mutex.h"
+
+namespace cpp_high_perf {
+
+//TCP服务器，多个reactor:
+//accept_worker的每个工作线程各有一个自己的监听socket(SO_REUSEPORT绑同一个地址)，内核按连接把新连接分给它们，
+//不会所有线程抢同一个accept队列，一个accept循环只能到3万/秒左右，这样能跟着核数涨
+//accept到的连接交给io_worker去处理，子类覆盖handleClient写自己的协议
+//连接的读写超时用配置 tcp_server.read_timeout / tcp_server.write_timeout，改了之后新来的连接马上生效
+class TcpServer : public std::enable_shared_from_this<TcpServer> {
+public:
+    typedef std::shared_ptr<TcpServer> ptr;
+
+    //两个都要是IOManager，默认是当前线程所在的
+    TcpServer(IOManager* io_worker = IOManager::GetThis(),
+              IOManager* accept_worker = IOManager::GetThis());
+    virtual ~TcpServer();
+
+    TcpServer(const TcpServer&) = delete;
+    TcpServer& operator=(const TcpServer&) = delete;
+
+    //绑配置里的 system.port，所有网卡
+    bool bind();
+    //每个accept线程一个监听socket，端口是0的时候第一个绑到哪个端口后面的就跟着绑哪个
+    virtual bool bind(Address::ptr addr);
+    //fails返回绑不上的地址，全部绑上才返回true
+    virtual bool bind(const std::vector<Address::ptr>& addrs, std::vector<Address::ptr>& fails);
+
+    //每个监听socket在自己的accept线程上开始accept
+    virtual bool start();
+    //平滑停止: 先关掉监听socket不再接新连接，已经在处理的连接接着跑，
+    //过了 tcp_server.graceful_timeout 还没结束的连接再取消它们的读写，让handleClient出错返回
+    virtual void stop();
+
+    const std::string& getName() const { return m_name; }
+    void setName(const std::string& v) { m_name = v; }
+    bool isStop() const { return m_isStop; }
+
+    //现在的配置值，毫秒
+    static uint64_t GetReadTimeout();
+    static uint64_t GetWriteTimeout();
+
+    //监听socket，一个地址对应accept线程数个
+    std::vector<Socket::ptr> getSocks() const { return m_socks; }
+    //监听的地址(端口是0的时候是真正绑上的端口)
+    std::vector<Address::ptr> getAddresses() const;
+    //现在还在handleClient里的连接数
+    size_t getConnectionCount() const;
+    //accept到的连接总数
+    uint64_t getAcceptCount() const { return m_acceptCount; }
+
+    virtual std::string toString(const std::string& prefix = "");
+protected:
+    //处理一个连接，在io_worker上跑，返回的时候连接就算结束了
+    virtual void handleClient(Socket::ptr client);
+    //一个监听socket的accept循环，stop之后退出
+    virtual void startAccept(Socket::ptr sock);
+private:
+    //listen之后按accept线程数再多开几个同地址的监听socket
+    bool listenShards(Address::ptr addr, std::vector<Socket::ptr>& socks);
+    void onClient(Socket::ptr client);
+    //过了平滑停止的时间还没结束的连接，取消它们的读写
+    void cancelClients();
+protected:
+    IOManager* m_ioWorker;
+    IOManager* m_acceptWorker;
+    std::vector<Socket::ptr> m_socks;
+    std::string m_name;
+    std::atomic<bool> m_isStop{true};
+private:
+    mutable Mutex m_mutex;
+    std::map<Socket*, std::weak_ptr<Socket>> m_clients;//正在处理的连接
+    std::atomic<uint64_t> m_acceptCount{0};
+};
+
+}
+
+#endif
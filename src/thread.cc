@@ -0,0 +1,88 @@
+#include "thread.h"
+#include "util.h"
+#include <stdexcept>
+#include <set>
+
+namespace cpp_high_perf {
+
+//线程名都放在这里，不会删，线程名的种类不多
+static const std::string* InternName(const std::string& name) {
+    static Mutex s_mutex;
+    static std::set<std::string> s_names;
+    Mutex::Lock lock(s_mutex);
+    return &*s_names.insert(name).first;
+}
+
+static const std::string* DefaultName() {
+    static const std::string* s_name = InternName("UNKNOWN");
+    return s_name;
+}
+
+static thread_local Thread* t_thread = nullptr;
+static thread_local const std::string* t_thread_name = nullptr;
+
+Thread* Thread::GetThis() {
+    return t_thread;
+}
+
+const std::string& Thread::GetName() {
+    if (!t_thread_name) {
+        t_thread_name = DefaultName();
+    }
+    return *t_thread_name;
+}
+
+void Thread::SetName(const std::string& name) {
+    if (name.empty()) {
+        return;
+    }
+    if (t_thread) {
+        t_thread->m_name = name;
+    }
+    t_thread_name = InternName(name);
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+}
+
+Thread::Thread(std::function<void()> cb, const std::string& name)
+    :m_cb(cb)
+    ,m_name(name.empty() ? "UNKNOWN" : name) {
+    int rt = pthread_create(&m_thread, nullptr, &Thread::run, this);
+    if (rt) {
+        //这里不写日志，日志的刷新线程自己也是用Thread创建的
+        throw std::logic_error("pthread_create error, name=" + m_name);
+    }
+    m_semaphore.wait();
+}
+
+Thread::~Thread() {
+    if (m_thread) {
+        pthread_detach(m_thread);
+    }
+}
+
+void Thread::join() {
+    if (m_thread) {
+        int rt = pthread_join(m_thread, nullptr);
+        if (rt) {
+            throw std::logic_error("pthread_join error, name=" + m_name);
+        }
+        m_thread = 0;
+    }
+}
+
+void* Thread::run(void* arg) {
+    Thread* thread = (Thread*)arg;
+    t_thread = thread;
+    t_thread_name = InternName(thread->m_name);
+    thread->m_id = GetThreadId();
+    //内核里的线程名最长15个字符
+    pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
+
+    std::function<void()> cb;
+    cb.swap(thread->m_cb);
+    thread->m_semaphore.notify();
+    cb();
+    return 0;
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef __THREAD_H__
+#define __THREAD_H__
+
+#include <memory>
+#include <string>
+#include <functional>
+#include <pthread.h>
+#include <sys/types.h>
+#include "mutex.h"
+
+namespace cpp_high_perf {
+
+//线程，带名字(top -H和gdb里能看到)和内核线程id
+//构造函数等新线程把id和名字设好了才返回，构造完getId就能用
+class Thread : Noncopyable {
+public:
+    typedef std::shared_ptr<Thread> ptr;
+
+    Thread(std::function<void()> cb, const std::string& name);
+    //没有join的线程会detach
+    ~Thread();
+
+    pid_t getId() const { return m_id; }
+    const std::string& getName() const { return m_name; }
+
+    void join();
+
+    //当前线程，不是Thread创建的线程返回nullptr
+    static Thread* GetThis();
+    //当前线程的名字，不是Thread创建的线程默认是UNKNOWN
+    //名字是放在全局的表里的，返回的引用一直有效(线程退出了也有效)，日志里可以只存它的地址
+    static const std::string& GetName();
+    static void SetName(const std::string& name);
+private:
+    static void* run(void* arg);
+private:
+    pid_t m_id = -1;
+    pthread_t m_thread = 0;
+    std::function<void()> m_cb;
+    std::string m_name;
+    Semaphore m_semaphore;
+};
+
+}
+
+#endif
@@ -0,0 +1,371 @@
+#include "timer.h"
+#include "util.h"
+#include "log.h"
+#include <string.h>
+
+namespace cpp_high_perf {
+
+static Logger::ptr g_logger = CHPE_LOG_NAME("system");
+
+Timer::Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager* manager)
+    :m_recurring(recurring)
+    ,m_ms(ms)
+    ,m_cb(cb)
+    ,m_manager(manager) {
+}
+
+bool Timer::cancel() {
+    Timer::ptr self;//锁放掉之后再析构
+    TimerManager::MutexType::Lock lock(m_manager->m_mutex);
+    if (!m_cb) {
+        return false;
+    }
+    m_cb = nullptr;
+    if (m_level >= 0) {
+        m_manager->remove(this);
+    }
+    self.swap(m_self);
+    return true;
+}
+
+bool Timer::refresh() {
+    bool at_front = false;
+    {
+        TimerManager::MutexType::Lock lock(m_manager->m_mutex);
+        if (!m_cb || m_level < 0) {
+            return false;
+        }
+        m_manager->remove(this);
+        m_next = m_manager->now() + m_ms;
+        at_front = m_manager->insertTimer(this);
+    }
+    if (at_front) {
+        m_manager->onTimerInsertedAtFront();
+    }
+    return true;
+}
+
+bool Timer::reset(uint64_t ms, bool from_now) {
+    if (ms == m_ms && !from_now) {
+        return true;
+    }
+    bool at_front = false;
+    {
+        TimerManager::MutexType::Lock lock(m_manager->m_mutex);
+        if (!m_cb || m_level < 0) {
+            return false;
+        }
+        m_manager->remove(this);
+        uint64_t start = from_now ? m_manager->now() : m_next - m_ms;
+        m_ms = ms;
+        m_next = start + m_ms;
+        at_front = m_manager->insertTimer(this);
+    }
+    if (at_front) {
+        m_manager->onTimerInsertedAtFront();
+    }
+    return true;
+}
+
+TimerManager::TimerManager() {
+    memset(m_level0, 0, sizeof(m_level0));
+    memset(m_levelN, 0, sizeof(m_levelN));
+    memset(m_bitmap0, 0, sizeof(m_bitmap0));
+    memset(m_bitmapN, 0, sizeof(m_bitmapN));
+    m_lastClock = GetMonotonicMS();
+    m_mutex.setStats(LockStats::Get("timer"));
+}
+
+TimerManager::~TimerManager() {
+    std::vector<Timer::ptr> selfs;
+    MutexType::Lock lock(m_mutex);
+    for (int l = 0; l <= LEVELN_COUNT; ++l) {
+        int size = l ? LEVELN_SIZE : LEVEL0_SIZE;
+        for (int s = 0; s < size; ++s) {
+            Timer*& head = slotHead(l, s);
+            while (head) {
+                Timer* t = head;
+                remove(t);
+                selfs.push_back(std::move(t->m_self));
+            }
+        }
+    }
+    lock.unlock();
+}
+
+Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring) {
+    Timer::ptr timer(new Timer(ms, cb, recurring, this));
+    bool at_front = false;
+    {
+        MutexType::Lock lock(m_mutex);
+        timer->m_next = now() + ms;
+        timer->m_self = timer;
+        at_front = insertTimer(timer.get());
+    }
+    if (at_front) {
+        onTimerInsertedAtFront();
+    }
+    return timer;
+}
+
+static void OnTimer(std::weak_ptr<void> weak_cond, std::function<void()> cb) {
+    std::shared_ptr<void> tmp = weak_cond.lock();
+    if (tmp) {
+        cb();
+    }
+}
+
+Timer::ptr TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb,
+        std::weak_ptr<void> weak_cond, bool recurring) {
+    return addTimer(ms, std::bind(&OnTimer, weak_cond, cb), recurring);
+}
+
+uint64_t TimerManager::getNextTimer() {
+    MutexType::Lock lock(m_mutex);
+    uint64_t n = now();
+    uint64_t e = nextExpire();
+    m_waitUntil = e;
+    if (e == ~0ull) {
+        return ~0ull;
+    }
+    return e > n ? e - n : 0;
+}
+
+void TimerManager::listExpiredCb(std::vector<std::function<void()>>& cbs) {
+    std::vector<Timer*> expired;
+    std::vector<Timer::ptr> selfs;//锁放掉之后再析构
+    MutexType::Lock lock(m_mutex);
+    uint64_t n = now();
+    advance(n, expired);
+    if (expired.empty()) {
+        return;
+    }
+    cbs.reserve(cbs.size() + expired.size());
+    for (auto t : expired) {
+        if (t->m_recurring) {
+            cbs.push_back(t->m_cb);
+            t->m_next = n + t->m_ms;
+            insert(t);
+        } else {
+            cbs.push_back(std::move(t->m_cb));
+            t->m_cb = nullptr;
+            selfs.push_back(std::move(t->m_self));
+        }
+    }
+    lock.unlock();
+}
+
+bool TimerManager::hasTimer() {
+    MutexType::Lock lock(m_mutex);
+    return m_count > 0;
+}
+
+size_t TimerManager::getTimerCount() {
+    MutexType::Lock lock(m_mutex);
+    return m_count;
+}
+
+uint64_t TimerManager::now() {
+    uint64_t clock = GetMonotonicMS();
+    if (clock < m_lastClock) {
+        //时钟往回跳了，时间轮不能往回转，当作这段时间没有走
+        ++m_rollbackCount;
+        CHPE_LOG_ERROR(g_logger) << "TimerManager detect clock rollback " << m_lastClock - clock << "ms";
+        m_lastClock = clock;
+    }
+    return m_current - 1 + (clock - m_lastClock);
+}
+
+bool TimerManager::insertTimer(Timer* timer) {
+    insert(timer);
+    if (timer->m_next < m_waitUntil) {
+        m_waitUntil = timer->m_next;
+        return true;
+    }
+    return false;
+}
+
+Timer*& TimerManager::slotHead(int level, int slot) {
+    return level ? m_levelN[level - 1][slot] : m_level0[slot];
+}
+
+void TimerManager::setBit(int level, int slot) {
+    if (level) {
+        m_bitmapN[level - 1] |= 1ull << slot;
+    } else {
+        m_bitmap0[slot >> 6] |= 1ull << (slot & 63);
+    }
+}
+
+void TimerManager::clearBit(int level, int slot) {
+    if (level) {
+        m_bitmapN[level - 1] &= ~(1ull << slot);
+    } else {
+        m_bitmap0[slot >> 6] &= ~(1ull << (slot & 63));
+    }
+}
+
+int TimerManager::findSlot(int level, int from) {
+    if (level) {
+        if (from >= LEVELN_SIZE) {
+            return -1;
+        }
+        uint64_t bits = m_bitmapN[level - 1] & (~0ull << from);
+        return bits ? __builtin_ctzll(bits) : -1;
+    }
+    for (int w = from >> 6; w < LEVEL0_SIZE / 64; ++w) {
+        uint64_t bits = m_bitmap0[w];
+        if (w == (from >> 6)) {
+            bits &= ~0ull << (from & 63);
+        }
+        if (bits) {
+            return (w << 6) + __builtin_ctzll(bits);
+        }
+    }
+    return -1;
+}
+
+void TimerManager::insert(Timer* timer) {
+    uint64_t expires = timer->m_next;
+    if (expires < m_current) {
+        expires = m_current;
+    }
+    uint64_t delta = expires - m_current;
+    int level = 0;
+    int slot = 0;
+    if (delta < (uint64_t)LEVEL0_SIZE) {
+        slot = expires & (LEVEL0_SIZE - 1);
+    } else {
+        //太远的先放在最上层的最后面，转到了再按真正的时间放
+        uint64_t max_delta = (1ull << (LEVEL0_BITS + LEVELN_BITS * LEVELN_COUNT)) - 1;
+        if (delta > max_delta) {
+            expires = m_current + max_delta;
+            delta = max_delta;
+        }
+        for (level = 1; level <= LEVELN_COUNT; ++level) {
+            int shift = LEVEL0_BITS + LEVELN_BITS * level;
+            if (delta < (1ull << shift)) {
+                slot = (expires >> (shift - LEVELN_BITS)) & (LEVELN_SIZE - 1);
+                break;
+            }
+        }
+    }
+
+    Timer*& head = slotHead(level, slot);
+    timer->m_level = level;
+    timer->m_slot = slot;
+    timer->m_prev = nullptr;
+    timer->m_nextInSlot = head;
+    if (head) {
+        head->m_prev = timer;
+    }
+    head = timer;
+    setBit(level, slot);
+    ++m_count;
+}
+
+void TimerManager::remove(Timer* timer) {
+    Timer*& head = slotHead(timer->m_level, timer->m_slot);
+    if (timer->m_prev) {
+        timer->m_prev->m_nextInSlot = timer->m_nextInSlot;
+    } else {
+        head = timer->m_nextInSlot;
+    }
+    if (timer->m_nextInSlot) {
+        timer->m_nextInSlot->m_prev = timer->m_prev;
+    }
+    if (!head) {
+        clearBit(timer->m_level, timer->m_slot);
+    }
+    timer->m_level = -1;
+    timer->m_prev = nullptr;
+    timer->m_nextInSlot = nullptr;
+    --m_count;
+}
+
+void TimerManager::cascade(int level, int slot) {
+    Timer*& head = slotHead(level, slot);
+    Timer* t = head;
+    head = nullptr;
+    clearBit(level, slot);
+    while (t) {
+        Timer* next = t->m_nextInSlot;
+        --m_count;
+        insert(t);
+        t = next;
+    }
+}
+
+void TimerManager::advance(uint64_t target, std::vector<Timer*>& expired) {
+    uint64_t base = m_current - 1;
+    if (target <= base) {
+        return;
+    }
+    while (m_current <= target) {
+        if (m_count == 0) {
+            m_current = target + 1;
+            break;
+        }
+        int idx = m_current & (LEVEL0_SIZE - 1);
+        if (idx == 0) {
+            //第0层转完一圈，上面一层的下一个槽落下来；那一层也转完一圈的话接着往上
+            for (int level = 1; level <= LEVELN_COUNT; ++level) {
+                int slot = (m_current >> (LEVEL0_BITS + LEVELN_BITS * (level - 1))) & (LEVELN_SIZE - 1);
+                cascade(level, slot);
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+        Timer*& head = m_level0[idx];
+        while (head) {
+            Timer* t = head;
+            remove(t);
+            expired.push_back(t);
+        }
+        //空槽直接跳过，最多跳到这一圈的末尾
+        int next = idx + 1 < LEVEL0_SIZE ? findSlot(0, idx + 1) : -1;
+        uint64_t next_tick = next >= 0 ? (m_current & ~(uint64_t)(LEVEL0_SIZE - 1)) + next
+                                       : (m_current | (LEVEL0_SIZE - 1)) + 1;
+        m_current = next_tick < target + 1 ? next_tick : target + 1;
+    }
+    m_lastClock += target - base;
+}
+
+uint64_t TimerManager::nextExpire() {
+    if (m_count == 0) {
+        return ~0ull;
+    }
+    int idx = m_current & (LEVEL0_SIZE - 1);
+    int s = findSlot(0, idx);
+    if (s >= 0) {
+        return (m_current & ~(uint64_t)(LEVEL0_SIZE - 1)) + s;
+    }
+    uint64_t boundary = (m_current | (LEVEL0_SIZE - 1)) + 1;
+    uint64_t best = ~0ull;
+    s = findSlot(0, 0);
+    if (s >= 0) {
+        best = boundary + s;
+    }
+    //上层的槽在落下来的那一刻之前都不会到期，算出最早落下来的时间
+    for (int level = 1; level <= LEVELN_COUNT; ++level) {
+        uint64_t bits = m_bitmapN[level - 1];
+        if (!bits) {
+            continue;
+        }
+        int shift = LEVEL0_BITS + LEVELN_BITS * (level - 1);
+        uint64_t cur = m_current >> shift;
+        //m_current正好在这一层的边界上的话，这一层当前的槽还没落下来
+        bool aligned = (m_current & ((1ull << shift) - 1)) == 0;
+        uint64_t start = aligned ? cur : cur + 1;
+        int r = start & (LEVELN_SIZE - 1);
+        uint64_t rotated = r ? (bits >> r) | (bits << (64 - r)) : bits;
+        uint64_t t = (start + __builtin_ctzll(rotated)) << shift;
+        if (t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+}
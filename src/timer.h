@@ -0,0 +1,117 @@
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+#include "mutex.h"
+
+namespace cpp_high_perf {
+
+class TimerManager;
+
+//定时器，由TimerManager创建
+class Timer : public std::enable_shared_from_this<Timer> {
+friend class TimerManager;
+public:
+    typedef std::shared_ptr<Timer> ptr;
+
+    //取消，已经触发过(非循环)或者取消过的返回false
+    bool cancel();
+    //从现在开始重新计时，间隔不变
+    bool refresh();
+    //改间隔，from_now为false的时候从上次开始计时的时间算
+    bool reset(uint64_t ms, bool from_now);
+
+    uint64_t getMs() const { return m_ms; }
+    bool isRecurring() const { return m_recurring; }
+private:
+    Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager* manager);
+private:
+    bool m_recurring = false;//是不是循环定时器
+    uint64_t m_ms = 0;//间隔
+    uint64_t m_next = 0;//到期的时间，时间轮的刻度(毫秒)
+    std::function<void()> m_cb;
+    TimerManager* m_manager = nullptr;
+
+    //在时间轮的哪个槽里，槽里的定时器串成双向链表，取消的时候O(1)摘下来
+    int m_level = -1;//-1表示不在时间轮里
+    int m_slot = 0;
+    Timer* m_prev = nullptr;
+    Timer* m_nextInSlot = nullptr;
+    Timer::ptr m_self;//在时间轮里的时候自己持有自己，时间轮里只放裸指针
+};
+
+//定时器管理，分层时间轮: 第0层256个槽，每个槽1毫秒；上面4层每层64个槽，每个槽是下一层一圈的时间
+//一共能放2^32毫秒(49天多)以内的定时器，再远的先放在最上层，转到的时候重新算
+//插入和取消都是O(1)；每一层有一个位图记哪些槽里有定时器，找下一个到期的定时器和跳过空槽都不用一个个槽看
+//时间轮的刻度只按单调时钟走过的时间往前推，时钟往回跳的时候能检测出来，当作时间没有走，不会乱触发
+class TimerManager {
+friend class Timer;
+public:
+    typedef Mutex MutexType;
+
+    TimerManager();
+    virtual ~TimerManager();
+
+    Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false);
+    //weak_cond对应的对象已经没了的话，到期也不执行回调
+    Timer::ptr addConditionTimer(uint64_t ms, std::function<void()> cb,
+            std::weak_ptr<void> weak_cond, bool recurring = false);
+
+    //离最近的定时器到期还有多少毫秒，已经到期的返回0，没有定时器返回~0ull
+    //最近的定时器在上层时间轮里的话，返回的是它落到下层的时间，可能比真正到期早一点
+    uint64_t getNextTimer();
+    //取出所有到期的定时器的回调，循环定时器会重新放回去
+    void listExpiredCb(std::vector<std::function<void()>>& cbs);
+
+    bool hasTimer();
+    size_t getTimerCount();
+    //检测到时钟往回跳的次数
+    uint64_t getRollbackCount() const { return m_rollbackCount; }
+protected:
+    //加的定时器比现在等着的最近的定时器还要早，epoll_wait要提前醒
+    virtual void onTimerInsertedAtFront() = 0;
+private:
+    static const int LEVEL0_BITS = 8;
+    static const int LEVEL0_SIZE = 1 << LEVEL0_BITS;
+    static const int LEVELN_BITS = 6;
+    static const int LEVELN_SIZE = 1 << LEVELN_BITS;
+    static const int LEVELN_COUNT = 4;
+
+    //现在是时间轮上的哪一刻，会顺便把时钟走过的时间记上
+    uint64_t now();
+    //放进时间轮，返回是不是比外面等着的最近的定时器还早；锁要拿着
+    bool insertTimer(Timer* timer);
+    void insert(Timer* timer);
+    void remove(Timer* timer);
+    //把上层一个槽里的定时器重新放到下面的层
+    void cascade(int level, int slot);
+    //时间轮推到target这一刻，到期的放到expired里
+    void advance(uint64_t target, std::vector<Timer*>& expired);
+    //最近一个有定时器的刻度，没有返回~0ull
+    uint64_t nextExpire();
+
+    Timer*& slotHead(int level, int slot);
+    void setBit(int level, int slot);
+    void clearBit(int level, int slot);
+    //level层从from开始(包括)第一个有定时器的槽，没有返回-1
+    int findSlot(int level, int from);
+private:
+    MutexType m_mutex;
+    Timer* m_level0[LEVEL0_SIZE];
+    Timer* m_levelN[LEVELN_COUNT][LEVELN_SIZE];
+    uint64_t m_bitmap0[LEVEL0_SIZE / 64];
+    uint64_t m_bitmapN[LEVELN_COUNT];
+
+    uint64_t m_current = 1;//下一个要处理的刻度，之前的刻度都处理过了
+    uint64_t m_lastClock = 0;//m_current - 1这一刻对应的单调时钟(毫秒)
+    size_t m_count = 0;
+    uint64_t m_waitUntil = ~0ull;//上次getNextTimer告诉外面的刻度，比它早的定时器加进来要叫醒
+    uint64_t m_rollbackCount = 0;
+};
+
+}
+
+#endif
@@ -1,11 +1,106 @@
 #include "util.h"
+#include "fiber.h"
+#include <time.h>
 
 namespace cpp_high_perf {
+    static thread_local pid_t t_tid = 0;
+
+    //fork出来的子进程里只有调fork的那个线程，它缓存的是父进程里的id，要清掉
+    static void ResetTidAfterFork() {
+        t_tid = 0;
+    }
+
+    struct TidAtforkIniter {
+        TidAtforkIniter() {
+            pthread_atfork(nullptr, nullptr, &ResetTidAfterFork);
+        }
+    };
+
+    static TidAtforkIniter s_tid_atfork_initer;
+
     pid_t GetThreadId() {
-        return syscall(SYS_gettid);
+        if (t_tid == 0) {
+            t_tid = syscall(SYS_gettid);
+        }
+        return t_tid;
     }
 
     uint32_t GetFiberId() {
-        return 0;
+        return Fiber::GetFiberId();
+    }
+
+    uint64_t GetCurrentUS() {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+    }
+
+    static uint64_t GetStartMS() {
+        static const uint64_t s_start = GetMonotonicMS();
+        return s_start;
+    }
+
+    //别的静态初始化里没写日志的话，启动时间就在这里记下
+    struct StartTimeIniter {
+        StartTimeIniter() {
+            GetStartMS();
+        }
+    };
+
+    static StartTimeIniter s_start_time_initer;
+
+    uint64_t GetElapseMS() {
+        return GetMonotonicMS() - GetStartMS();
+    }
+
+    uint64_t GetMonotonicMS() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+    }
+
+    //两位两位地转换，查表比一位一位除10快
+    static const char s_digits[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    size_t Uint64ToStr(char* buf, uint64_t v) {
+        char tmp[24];
+        char* p = tmp + sizeof(tmp);
+        while (v >= 100) {
+            unsigned idx = (v % 100) * 2;
+            v /= 100;
+            *--p = s_digits[idx + 1];
+            *--p = s_digits[idx];
+        }
+        if (v >= 10) {
+            unsigned idx = v * 2;
+            *--p = s_digits[idx + 1];
+            *--p = s_digits[idx];
+        } else {
+            *--p = '0' + v;
+        }
+        size_t len = tmp + sizeof(tmp) - p;
+        for (size_t i = 0; i < len; ++i) {
+            buf[i] = p[i];
+        }
+        return len;
+    }
+
+    size_t Int64ToStr(char* buf, int64_t v) {
+        if (v < 0) {
+            buf[0] = '-';
+            //INT64_MIN取反会溢出，先转成无符号再取反
+            return 1 + Uint64ToStr(buf + 1, 0 - (uint64_t)v);
+        }
+        return Uint64ToStr(buf, v);
     }
 }
\ No newline at end of file
@@ -7,9 +7,22 @@
 #include <sys/syscall.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <time.h>
 namespace cpp_high_perf {
+    //线程id，第一次调用之后缓存在线程局部变量里，不用每次都系统调用
     pid_t GetThreadId();
     uint32_t GetFiberId();
+    //单调时钟的毫秒数，只能用来算时间间隔
+    uint64_t GetMonotonicMS();
+    //墙上时间的微秒数，clock_gettime走vDSO不进内核
+    uint64_t GetCurrentUS();
+    //进程启动到现在的毫秒数，单调时钟，改系统时间不影响
+    uint64_t GetElapseMS();
+
+    //整数转字符串，不走ostream，buf至少要有21个字节，返回写入的长度(不带'\0')
+    size_t Uint64ToStr(char* buf, uint64_t v);
+    size_t Int64ToStr(char* buf, int64_t v);
 }
 
 #endif
\ No newline at end of file
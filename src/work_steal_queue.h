@@ -0,0 +1,140 @@
+#ifndef __WORK_STEAL_QUEUE_H__
+#define __WORK_STEAL_QUEUE_H__
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include "mutex.h"
+
+namespace cpp_high_perf {
+
+//Chase-Lev的工作窃取队列(按Lê等人2013年那篇的C11内存序写的)
+//只有拥有者线程能push/pop(在bottom那头，后进先出，缓存友好)，别的线程从top那头steal
+//满了就扩容成两倍，旧的数组不能马上释放(可能有偷的线程还在读)，放到m_garbage里面等队列析构
+//T只能是指针这种可以原子读写的类型，空的时候返回nullptr
+template <class T>
+class WorkStealQueue : Noncopyable {
+public:
+    explicit WorkStealQueue(size_t capacity = 256) {
+        size_t cap = 1;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        m_array.store(new Array(cap), std::memory_order_relaxed);
+    }
+
+    ~WorkStealQueue() {
+        delete m_array.load(std::memory_order_relaxed);
+        for (auto a : m_garbage) {
+            delete a;
+        }
+    }
+
+    //只有拥有者线程调用
+    void push(T x) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Array* a = m_array.load(std::memory_order_relaxed);
+        if (b - t > (int64_t)a->capacity - 1) {
+            a = grow(a, b, t);
+        }
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    //只有拥有者线程调用
+    T pop() {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        if (t > b) {
+            //空的
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T x = a->get(b);
+        if (t == b) {
+            //最后一个，和偷的线程抢
+            if (!m_top.compare_exchange_strong(t, t + 1,
+                        std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                x = nullptr;
+            }
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    //任何线程都可以调用，抢失败了也返回nullptr
+    T steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Array* a = m_array.load(std::memory_order_acquire);
+        T x = a->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return x;
+    }
+
+    //大概的长度，统计和判断有没有活的时候用
+    size_t size() const {
+        int64_t b = m_bottom.load(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_seq_cst);
+        return b > t ? (size_t)(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+private:
+    struct Array {
+        size_t capacity;
+        size_t mask;
+        std::atomic<T>* buf;
+
+        explicit Array(size_t cap)
+            :capacity(cap)
+            ,mask(cap - 1)
+            ,buf(new std::atomic<T>[cap]) {
+        }
+
+        ~Array() {
+            delete[] buf;
+        }
+
+        T get(int64_t i) const {
+            return buf[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T x) {
+            buf[i & mask].store(x, std::memory_order_relaxed);
+        }
+    };
+
+    Array* grow(Array* a, int64_t b, int64_t t) {
+        Array* na = new Array(a->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            na->put(i, a->get(i));
+        }
+        m_garbage.push_back(a);
+        m_array.store(na, std::memory_order_release);
+        return na;
+    }
+private:
+    std::atomic<int64_t> m_top{0};//偷的线程改这个
+    char m_pad[64];//top和bottom分开放，不然老是互相让缓存行失效(C++11的new不支持alignas(64))
+    std::atomic<int64_t> m_bottom{0};//拥有者线程改这个
+    std::atomic<Array*> m_array;
+    std::vector<Array*> m_garbage;//只有拥有者线程扩容的时候会动
+};
+
+}
+
+#endif
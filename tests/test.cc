@@ -1,6 +1,7 @@
 #include <iostream>
 #include "../src/log.h"
 #include "../src/util.h"
+#include "../src/thread.h"
 
 int main()
 {
@@ -26,5 +27,51 @@ int main()
 
     auto it = cpp_high_perf::LoggerMgr::GetInstance()->getLogger("xx");
     CHPE_LOG_INFO(it) << "xxx";
+
+    //按'.'分层，system.net.http没有自己的appender和级别，都是从祖先继承的
+    auto http = CHPE_LOG_NAME("system.net.http");
+    CHPE_LOG_NAME("system")->setLevel(cpp_high_perf::LogLevel::WARN);
+    CHPE_LOG_INFO(http) << "should not print";
+    CHPE_LOG_NAME("system")->setLevel(cpp_high_perf::LogLevel::DEBUG);
+    CHPE_LOG_INFO(http) << "http level=" << cpp_high_perf::LogLevel::ToString(http->getLevel())
+                        << " parent=" << http->getParent()->getName();
+
+    //%N是线程名，在Thread里跑的日志带上线程的名字
+    cpp_high_perf::LogFormatter::ptr name_fmt(new cpp_high_perf::LogFormatter("%t %N %m"));
+    std::string formatted;
+    cpp_high_perf::Thread name_thread([&]() {
+        cpp_high_perf::LogEventWrap wrap(logger, cpp_high_perf::LogLevel::INFO, __FILE__, __LINE__);
+        wrap.getSS() << "hi";
+        formatted = name_fmt->format(logger, cpp_high_perf::LogLevel::INFO, *wrap.getEvent());
+    }, "log_name");
+    name_thread.join();
+    std::cout << "thread name format: " << formatted << std::endl;
+
+    //%d里面的%ms %us是毫秒和微秒，%r是进程启动到现在的毫秒数
+    cpp_high_perf::LogFormatter::ptr time_fmt(new cpp_high_perf::LogFormatter("%d{%S.%ms|%us|%%ms} %r"));
+    cpp_high_perf::LogEvent time_event(logger, cpp_high_perf::LogLevel::INFO, __FILE__, __LINE__, 42
+            , 0, 0, 1700000007123456ULL);
+    std::string time_str = time_fmt->format(logger, cpp_high_perf::LogLevel::INFO, time_event);
+    std::cout << "time format: " << time_str
+              << (time_str == "27.123|123456|%ms 42" ? " ok" : " FAILED") << std::endl;
+
+    //级别不够的日志只有一次判断，线程id和时间都不会去拿
+    logger->setLevel(cpp_high_perf::LogLevel::ERROR);
+    uint64_t begin = cpp_high_perf::GetMonotonicMS();
+    for (int i = 0; i < 1000000; ++i) {
+        CHPE_LOG_DEBUG(logger) << "filtered " << i;
+    }
+    std::cout << "1000000 filtered logs used " << cpp_high_perf::GetMonotonicMS() - begin << "ms" << std::endl;
+    logger->setLevel(cpp_high_perf::LogLevel::DEBUG);
+
+    //异步模式，日志先进缓冲区，由后台线程写出
+    logger->setAsync(true);
+    for (int i = 0; i < 10; ++i) {
+        CHPE_LOG_INFO(logger) << "test async " << i;
+    }
+    logger->flush();
+    auto flusher = cpp_high_perf::AsyncLogFlusherMgr::GetInstance();
+    std::cout << "async flushed=" << flusher->getFlushed() << " dropped=" << flusher->getDropped()
+              << " depth=" << flusher->getQueueDepth() << std::endl;
     return 0;
 }
\ No newline at end of file
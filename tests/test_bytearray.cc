@@ -0,0 +1,187 @@
+#include "../src/bytearray.h"
+#include "../src/log.h"
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+//写进去再读出来，块很小的时候每个值都会跨块
+#define XX(type, len, write_fun, read_fun, base_len) { \
+    std::vector<type> vec; \
+    for (int i = 0; i < len; ++i) { \
+        vec.push_back((type)((uint64_t)rand() * rand() * (i % 2 ? -1 : 1))); \
+    } \
+    cpp_high_perf::ByteArray::ptr ba(new cpp_high_perf::ByteArray(base_len)); \
+    for (auto& i : vec) { \
+        ba->write_fun(i); \
+    } \
+    ba->setPosition(0); \
+    for (size_t i = 0; i < vec.size(); ++i) { \
+        type v = ba->read_fun(); \
+        if (v != vec[i]) { \
+            std::cout << #write_fun " base_len=" << base_len << " i=" << i \
+                      << " FAILED" << std::endl; \
+            ok = false; \
+            break; \
+        } \
+    } \
+    ok = ok && ba->getReadSize() == 0; \
+}
+
+bool test_number() {
+    bool ok = true;
+    size_t base_lens[] = {1, 3, 4096};
+    for (size_t b : base_lens) {
+        XX(int8_t, 100, writeFint8, readFint8, b);
+        XX(uint8_t, 100, writeFuint8, readFuint8, b);
+        XX(int16_t, 100, writeFint16, readFint16, b);
+        XX(uint16_t, 100, writeFuint16, readFuint16, b);
+        XX(int32_t, 100, writeFint32, readFint32, b);
+        XX(uint32_t, 100, writeFuint32, readFuint32, b);
+        XX(int64_t, 100, writeFint64, readFint64, b);
+        XX(uint64_t, 100, writeFuint64, readFuint64, b);
+        XX(int32_t, 100, writeInt32, readInt32, b);
+        XX(uint32_t, 100, writeUint32, readUint32, b);
+        XX(int64_t, 100, writeInt64, readInt64, b);
+        XX(uint64_t, 100, writeUint64, readUint64, b);
+        XX(double, 100, writeDouble, readDouble, b);
+    }
+    std::cout << "number ok=" << ok << std::endl;
+    return ok;
+}
+
+#undef XX
+
+//字节序和编码的长度
+bool test_encoding() {
+    bool ok = true;
+    cpp_high_perf::ByteArray ba(16);
+    ok = ok && !ba.isLittleEndian();
+    ba.writeFuint32(0x01020304);
+    ok = ok && ba.toHexString() == "" && ba.getSize() == 4;
+    ba.setPosition(0);
+    ok = ok && ba.toHexString() == "01 02 03 04 ";
+
+    ba.clear();
+    ba.setIsLittleEndian(true);
+    ok = ok && ba.isLittleEndian();
+    ba.writeFuint32(0x01020304);
+    ba.setPosition(0);
+    ok = ok && ba.toHexString() == "04 03 02 01 ";
+
+    //zigzag: -1 -> 1，一个字节；300的varint是 ac 02
+    ba.clear();
+    ba.writeInt32(-1);
+    ba.writeUint32(300);
+    ok = ok && ba.getSize() == 3;
+    ba.setPosition(0);
+    ok = ok && ba.toHexString() == "01 ac 02 ";
+
+    //最长的是10个字节
+    ba.clear();
+    ba.writeUint64(~0ull);
+    ok = ok && ba.getSize() == 10;
+
+    //读过头抛异常
+    ba.setPosition(0);
+    ba.readUint64();
+    bool thrown = false;
+    try {
+        ba.readFuint8();
+    } catch (std::out_of_range&) {
+        thrown = true;
+    }
+    ok = ok && thrown;
+    std::cout << "encoding ok=" << ok << std::endl;
+    return ok;
+}
+
+bool test_string() {
+    bool ok = true;
+    std::string big(10000, 'x');
+    cpp_high_perf::ByteArray ba(7);
+    ba.writeStringF16("hello");
+    ba.writeStringF32("");
+    ba.writeStringF64("world");
+    ba.writeStringVint(big);
+    ba.writeStringWithoutLength("tail");
+    ba.setPosition(0);
+    ok = ok && ba.readStringF16() == "hello";
+    ok = ok && ba.readStringF32() == "";
+    ok = ok && ba.readStringF64() == "world";
+    ok = ok && ba.readStringVint() == big;
+    ok = ok && ba.toString() == "tail";
+    std::cout << "string ok=" << ok << std::endl;
+    return ok;
+}
+
+//导出的iovec拼起来要和toString一样；往getWriteBuffers里填数据再setPosition就能读出来
+bool test_buffers() {
+    bool ok = true;
+    cpp_high_perf::ByteArray ba(4);
+    ba.writeStringWithoutLength("0123456789");
+    ba.setPosition(3);
+    std::vector<iovec> iovs;
+    uint64_t len = ba.getReadBuffers(iovs);
+    std::string joined;
+    for (auto& i : iovs) {
+        joined.append((const char*)i.iov_base, i.iov_len);
+    }
+    ok = ok && len == 7 && iovs.size() == 3 && joined == "3456789" && ba.getPosition() == 3;
+
+    iovs.clear();
+    //7在第二块的最后一个字节，8在第三块，跨块要拆成两个
+    ok = ok && ba.getReadBuffers(iovs, 2, 7) == 2 && iovs.size() == 2
+        && *(const char*)iovs[0].iov_base == '7' && *(const char*)iovs[1].iov_base == '8';
+
+    ba.setPosition(ba.getSize());
+    iovs.clear();
+    len = ba.getWriteBuffers(iovs, 6);
+    const char* src = "abcdef";
+    size_t off = 0;
+    for (auto& i : iovs) {
+        memcpy(i.iov_base, src + off, i.iov_len);
+        off += i.iov_len;
+    }
+    ok = ok && len == 6 && iovs.size() == 2 && off == 6;
+    ba.setPosition(ba.getPosition() + len);
+    ba.setPosition(0);
+    ok = ok && ba.toString() == "0123456789abcdef";
+    std::cout << "buffers ok=" << ok << std::endl;
+    return ok;
+}
+
+bool test_file() {
+    bool ok = true;
+    std::string path = "/tmp/test_bytearray.dat";
+    cpp_high_perf::ByteArray ba(5);
+    for (int i = 0; i < 1000; ++i) {
+        ba.writeInt32(i - 500);
+    }
+    ba.setPosition(0);
+    ok = ok && ba.writeToFile(path);
+
+    cpp_high_perf::ByteArray ba2(3);
+    ok = ok && ba2.readFromFile(path);
+    ba2.setPosition(0);
+    ok = ok && ba.toString() == ba2.toString();
+    for (int i = 0; i < 1000 && ok; ++i) {
+        ok = ba2.readInt32() == i - 500;
+    }
+    unlink(path.c_str());
+    std::cout << "file ok=" << ok << " size=" << ba2.getSize() << std::endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_number();
+    ok = test_encoding() && ok;
+    ok = test_string() && ok;
+    ok = test_buffers() && ok;
+    ok = test_file() && ok;
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
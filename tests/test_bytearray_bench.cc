@@ -0,0 +1,92 @@
+#include "../src/bytearray.h"
+#include "../src/log.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+//ByteArray的压测: N个uint64，varint编码/解码 对比 直接memcpy到连续内存里
+//数值一半是小数(一两个字节)，一半是随机的大数，接近rpc里长度、id混在一起的情况
+//用法: test_bytearray_bench [个数] [块大小]
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void report(const char* name, size_t count, size_t bytes, double ms) {
+    std::cout << name << ": " << ms << "ms "
+              << (ms > 0 ? ms * 1e6 / count : 0) << "ns/op "
+              << (ms > 0 ? bytes / 1024.0 / 1024.0 / (ms / 1000.0) : 0) << "MB/s"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? atoi(argv[1]) : 1000000;
+    size_t base_size = argc > 2 ? atoi(argv[2]) : 4096;
+    CHPE_LOG_ROOT()->setLevel(cpp_high_perf::LogLevel::ERROR);
+
+    std::vector<uint64_t> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = i % 2 ? (uint64_t)rand() * rand() : i % 300;
+    }
+
+    //基准: memcpy到一块连续的内存，再拷回来
+    std::vector<char> flat(count * sizeof(uint64_t));
+    double begin = now_ms();
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(&flat[i * sizeof(uint64_t)], &values[i], sizeof(uint64_t));
+    }
+    double memcpy_enc = now_ms() - begin;
+
+    std::vector<uint64_t> out(count);
+    begin = now_ms();
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(&out[i], &flat[i * sizeof(uint64_t)], sizeof(uint64_t));
+    }
+    double memcpy_dec = now_ms() - begin;
+    bool ok = out == values;
+
+    //定长
+    cpp_high_perf::ByteArray fixed(base_size);
+    begin = now_ms();
+    for (size_t i = 0; i < count; ++i) {
+        fixed.writeFuint64(values[i]);
+    }
+    double fixed_enc = now_ms() - begin;
+    fixed.setPosition(0);
+    begin = now_ms();
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = fixed.readFuint64();
+    }
+    double fixed_dec = now_ms() - begin;
+    ok = ok && out == values;
+
+    //varint
+    cpp_high_perf::ByteArray var(base_size);
+    begin = now_ms();
+    for (size_t i = 0; i < count; ++i) {
+        var.writeUint64(values[i]);
+    }
+    double var_enc = now_ms() - begin;
+    var.setPosition(0);
+    begin = now_ms();
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = var.readUint64();
+    }
+    double var_dec = now_ms() - begin;
+    ok = ok && out == values;
+
+    size_t raw = count * sizeof(uint64_t);
+    std::cout << "count=" << count << " base_size=" << base_size
+              << " raw=" << raw << " varint=" << var.getSize() << std::endl;
+    report("memcpy encode", count, raw, memcpy_enc);
+    report("memcpy decode", count, raw, memcpy_dec);
+    report("fixed  encode", count, raw, fixed_enc);
+    report("fixed  decode", count, raw, fixed_dec);
+    report("varint encode", count, raw, var_enc);
+    report("varint decode", count, raw, var_dec);
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -2,8 +2,14 @@
 #include "../src/config.h"
 #include "yaml-cpp/yaml.h"
 #include <cstddef>
+#include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+//配置文件的路径，默认在项目根目录下运行，也可以通过第一个参数指定
+static std::string s_conf_file = "conf/log.yaml";
 
 //上面实现的是简单类型的配置信息，比如int float等等；但是还有一些自定义类型
 cpp_high_perf::ConfigVar<int>::ptr g_int_value_config = 
@@ -52,7 +58,7 @@ void print_yaml(const YAML::Node& node, int level) {
 //测试一下yaml安装功能是否可以正常使用
 void test_yaml() {
     //是加载进来了配置文件
-    YAML::Node root = YAML::LoadFile("/home/zpw/cpp_high_perf_server/conf/log.yaml");
+    YAML::Node root = YAML::LoadFile(s_conf_file);
     print_yaml(root, 0);
     //CHPE_LOG_INFO(CHPE_LOG_ROOT()) << root;
 }
@@ -87,7 +93,7 @@ void test_config() {
     XX_M(g_str_int_map_value_config, str_int_map, before);
     XX_M(g_str_int_umap_value_config, str_int_umap, before);
 
-    YAML::Node root = YAML::LoadFile("/home/zpw/cpp_high_perf_server/conf/log.yaml");
+    YAML::Node root = YAML::LoadFile(s_conf_file);
     cpp_high_perf::Config::loadFromYaml(root);
 
     CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "after: " << g_int_value_config->getValue();
@@ -156,6 +162,12 @@ cpp_high_perf::ConfigVar<std::map<std::string, Person> >::ptr g_person_map =
 void test_class() {
     CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "before: " << g_persopn->getValue().toString() << " - " << g_persopn->toString();
 
+    //Person没有==，比较的是序列化之后的字符串，值真的变了才会通知
+    uint64_t id = g_persopn->addListener([](const Person& old_value, const Person& new_value) {
+        CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "old_value=" << old_value.toString()
+                << " new_value=" << new_value.toString();
+    });
+
 #define XX_PM(g_var, prefix) \
     { \
         auto m = g_person_map->getValue(); \
@@ -167,19 +179,77 @@ void test_class() {
 
     XX_PM(g_person_map, "class map before");
 
-    YAML::Node root = YAML::LoadFile("/home/zpw/cpp_high_perf_server/conf/log.yaml");
+    YAML::Node root = YAML::LoadFile(s_conf_file);
     cpp_high_perf::Config::loadFromYaml(root);
 
     CHPE_LOG_INFO(CHPE_LOG_ROOT()) << "after: " << g_persopn->getValue().toString() << " - " << g_persopn->toString();
     XX_PM(g_person_map, "class map after");
+    g_persopn->delListener(id);
+}
+
+//logs配置加载前后logger的变化
+void test_log() {
+    static cpp_high_perf::Logger::ptr system_log = CHPE_LOG_NAME("system");
+    CHPE_LOG_INFO(system_log) << "hello system" << std::endl;
+    auto defines = cpp_high_perf::Config::lookupBase("logs");
+    std::cout << "before: " << defines->toString() << std::endl;
+
+    YAML::Node root = YAML::LoadFile(s_conf_file);
+    cpp_high_perf::Config::loadFromYaml(root);
+    std::cout << "after: " << defines->toString() << std::endl;
+    std::cout << "system level=" << cpp_high_perf::LogLevel::ToString(system_log->getLevel())
+              << " async=" << system_log->isAsync() << std::endl;
+
+    CHPE_LOG_INFO(system_log) << "hello system";
+    system_log->setFormatter("%d - %m%n");
+    CHPE_LOG_INFO(system_log) << "hello system";
+    system_log->flush();
+}
+
+//多个线程同时注册、查找同一批名字，每个名字只能有一个ConfigVar；类型不对的查找返回nullptr
+bool test_registry() {
+    const int thread_count = 8;
+    const int name_count = 1000;
+    std::vector<std::vector<cpp_high_perf::ConfigVar<int>::ptr>> got(thread_count);
+    std::vector<std::thread> threads;
+    CHPE_LOG_ROOT()->setLevel(cpp_high_perf::LogLevel::ERROR);
+    for (int t = 0; t < thread_count; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            for (int i = 0; i < name_count; ++i) {
+                std::string name = "registry.v" + std::to_string(i);
+                got[t].push_back(cpp_high_perf::Config::lookup(name, i, "registry"));
+                cpp_high_perf::Config::lookup<int>(name);
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    CHPE_LOG_ROOT()->setLevel(cpp_high_perf::LogLevel::DEBUG);
+
+    bool ok = true;
+    for (int i = 0; i < name_count; ++i) {
+        for (int t = 1; t < thread_count; ++t) {
+            ok = ok && got[t][i] && got[t][i] == got[0][i];
+        }
+    }
+    ok = ok && cpp_high_perf::Config::lookup<int>("registry.v1") == got[0][1];
+    ok = ok && !cpp_high_perf::Config::lookup<float>("registry.v1");
+    ok = ok && !cpp_high_perf::Config::lookup<int>("registry.none");
+    std::cout << "registry: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
 }
 
 int main(int argc, char** argv) {
+    if (argc > 1) {
+        s_conf_file = argv[1];
+    }
     //test_yaml();
     //test_config();
 
     //test_yaml();
 
     test_class();
-    return 0;
+    test_log();
+    return test_registry() ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "../src/config.h"
+#include "../src/log.h"
+#include <yaml-cpp/yaml.h>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+//配置加载的压测: 1万个条目的嵌套容器配置，对比以前 节点->字符串->重新解析 的方式和现在直接从节点取值
+//用法: test_config_bench [条目数]
+
+//以前容器的转化方式，原样搬过来做对比
+template <class T>
+class LegacyCast {
+public:
+    T operator()(const std::string& str) {
+        return boost::lexical_cast<T>(str);
+    }
+};
+
+template <class T>
+class LegacyCast<std::vector<T>> {
+public:
+    std::vector<T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        std::vector<T> vec;
+        std::stringstream ss;
+        for (size_t i = 0; i < node.size(); ++i) {
+            ss.str("");
+            ss << node[i];
+            vec.push_back(LegacyCast<T>()(ss.str()));
+        }
+        return vec;
+    }
+};
+
+template <class T>
+class LegacyCast<std::map<std::string, T>> {
+public:
+    std::map<std::string, T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        std::map<std::string, T> vec;
+        std::stringstream ss;
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            ss.str("");
+            ss << it->second;
+            vec.insert(std::make_pair(it->first.Scalar(), LegacyCast<T>()(ss.str())));
+        }
+        return vec;
+    }
+};
+
+typedef std::map<std::string, std::vector<int>> BenchMap;
+
+cpp_high_perf::ConfigVar<BenchMap>::ptr g_bench_map =
+    cpp_high_perf::Config::lookup("bench.map", BenchMap(), "bench map");
+
+cpp_high_perf::ConfigVar<std::vector<int>>::ptr g_bench_list =
+    cpp_high_perf::Config::lookup("bench.list", std::vector<int>(), "bench list");
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 10000;
+    CHPE_LOG_ROOT()->setLevel(cpp_high_perf::LogLevel::ERROR);
+
+    std::stringstream ss;
+    ss << "bench:\n  map:\n";
+    for (int i = 0; i < count; ++i) {
+        ss << "    k" << i << ": [" << i << ", " << i + 1 << ", " << i + 2 << "]\n";
+    }
+    ss << "  list: [";
+    for (int i = 0; i < count; ++i) {
+        ss << (i ? ", " : "") << i;
+    }
+    ss << "]\n";
+    YAML::Node root = YAML::Load(ss.str());
+
+    //以前: 非标量的节点先输出成字符串，再让每一层容器自己Load一遍
+    double begin = now_ms();
+    std::stringstream out;
+    out << root["bench"]["map"];
+    BenchMap legacy_map = LegacyCast<BenchMap>()(out.str());
+    out.str("");
+    out << root["bench"]["list"];
+    std::vector<int> legacy_list = LegacyCast<std::vector<int>>()(out.str());
+    double legacy_ms = now_ms() - begin;
+
+    //现在: 直接从节点取值
+    begin = now_ms();
+    cpp_high_perf::Config::loadFromYaml(root);
+    double direct_ms = now_ms() - begin;
+
+    bool ok = *g_bench_map->getValuePtr() == legacy_map
+            && *g_bench_list->getValuePtr() == legacy_list
+            && (int)legacy_map.size() == count && (int)legacy_list.size() == count;
+
+    //反方向: 值转回节点 / 字符串
+    begin = now_ms();
+    YAML::Node node = g_bench_map->toYaml();
+    double encode_ms = now_ms() - begin;
+    ok = ok && (int)node.size() == count && node["k1"][2].as<int>() == 3;
+
+    std::cout << "entries=" << count
+              << " legacy_load=" << legacy_ms << "ms"
+              << " direct_load=" << direct_ms << "ms"
+              << " speedup=" << (direct_ms > 0 ? legacy_ms / direct_ms : 0) << "x"
+              << " encode=" << encode_ms << "ms"
+              << (ok ? " ok" : " FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+#include "../src/config.h"
+#include "../src/config_watcher.h"
+#include <iostream>
+#include <fstream>
+#include <unistd.h>
+#include <stdlib.h>
+
+//在临时目录里写yaml，改文件之后看配置有没有被热加载，内容不变的写入要被跳过
+
+static cpp_high_perf::ConfigVar<int>::ptr g_port =
+    cpp_high_perf::Config::lookup("watch.port", (int)8080, "watch port");
+static cpp_high_perf::ConfigVar<std::vector<int> >::ptr g_vec =
+    cpp_high_perf::Config::lookup("watch.vec", std::vector<int>{1}, "watch vec");
+
+static void write_file(const std::string& path, const std::string& content) {
+    //先写临时文件再rename，和编辑器保存的方式一样
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream ofs(tmp);
+        ofs << content;
+    }
+    rename(tmp.c_str(), path.c_str());
+}
+
+//等到条件成立或者超时
+template<class F>
+static bool wait_for(F f) {
+    for (int i = 0; i < 200; ++i) {
+        if (f()) {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    char dir_tmpl[] = "/tmp/chpe_conf_XXXXXX";
+    std::string dir = mkdtemp(dir_tmpl);
+    std::string file = dir + "/test.yaml";
+    write_file(file, "watch:\n    port: 9000\n    vec: [1, 2]\n");
+    cpp_high_perf::Config::loadFromConfDir(dir);
+    std::cout << "port=" << g_port->getValue() << std::endl;
+
+    cpp_high_perf::ConfigWatcher watcher(dir);
+    if (!watcher.start()) {
+        return 1;
+    }
+
+    bool ok = true;
+    //只改了port，vec的值没变不会重新应用
+    write_file(file, "watch:\n    port: 9100\n    vec: [1, 2]\n");
+    //等reload整个做完，port变了的时候统计可能还没更新
+    ok = wait_for([&]() { return watcher.getReloadCount() == 1; }) && ok;
+    ok = g_port->getValue() == 9100 && ok;
+    std::cout << "port=" << g_port->getValue() << " applied=" << watcher.getLastAppliedKeys()
+              << " used=" << watcher.getLastReloadUs() << "us" << std::endl;
+    ok = watcher.getLastAppliedKeys() == 1 && ok;
+
+    //内容完全一样，跳过
+    write_file(file, "watch:\n    port: 9100\n    vec: [1, 2]\n");
+    ok = wait_for([&]() { return watcher.getSkippedCount() == 1; }) && ok;
+    std::cout << "reload=" << watcher.getReloadCount() << " skipped=" << watcher.getSkippedCount() << std::endl;
+
+    //有key应用失败，同样的内容再写一遍不能当成没变跳过
+    write_file(file, "watch:\n    port: abc\n    vec: [1, 2]\n");
+    ok = wait_for([&]() { return watcher.getReloadCount() == 2; }) && ok;
+    write_file(file, "watch:\n    port: abc\n    vec: [1, 2]\n");
+    ok = wait_for([&]() { return watcher.getReloadCount() == 3; }) && ok;
+    ok = watcher.getSkippedCount() == 1 && g_port->getValue() == 9100 && ok;
+    std::cout << "reload=" << watcher.getReloadCount() << " skipped=" << watcher.getSkippedCount() << std::endl;
+
+    watcher.stop();
+    unlink(file.c_str());
+    rmdir(dir.c_str());
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
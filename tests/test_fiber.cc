@@ -0,0 +1,112 @@
+#include "../src/fiber.h"
+#include "../src/log.h"
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+void run_in_fiber() {
+    CHPE_LOG_INFO(g_logger) << "run_in_fiber begin";
+    cpp_high_perf::Fiber::YieldToHold();
+    CHPE_LOG_INFO(g_logger) << "run_in_fiber end";
+}
+
+//主协程和子协程来回切，日志里面的协程id跟着变
+bool test_fiber() {
+    CHPE_LOG_INFO(g_logger) << "main begin";
+    cpp_high_perf::Fiber::ptr fiber(new cpp_high_perf::Fiber(run_in_fiber));
+    fiber->resume();
+    CHPE_LOG_INFO(g_logger) << "main after resume";
+    fiber->resume();
+    CHPE_LOG_INFO(g_logger) << "main after end";
+    bool ok = fiber->getState() == cpp_high_perf::Fiber::TERM;
+
+    //跑完的协程换个回调接着用
+    int n = 0;
+    fiber->reset([&n]() { n = (int)cpp_high_perf::Fiber::GetFiberId(); });
+    fiber->resume();
+    ok = ok && n == (int)fiber->getId() && fiber->isFinished();
+    return ok;
+}
+
+//协程里面再resume别的协程，yield回到的是上一层
+bool test_nested() {
+    std::vector<int> order;
+    cpp_high_perf::Fiber::ptr inner(new cpp_high_perf::Fiber([&]() {
+        order.push_back(2);
+        cpp_high_perf::Fiber::GetThis()->yield();
+        order.push_back(4);
+    }));
+    cpp_high_perf::Fiber::ptr outer(new cpp_high_perf::Fiber([&]() {
+        order.push_back(1);
+        inner->resume();
+        order.push_back(3);
+        inner->resume();
+        order.push_back(5);
+    }));
+    outer->resume();
+    return order == std::vector<int>{1, 2, 3, 4, 5} && inner->isFinished() && outer->isFinished();
+}
+
+//切换开销，还有同时存在很多协程的时候栈的占用
+void bench() {
+    const int switches = 1000000;
+    cpp_high_perf::Fiber::ptr f(new cpp_high_perf::Fiber([]() {
+        while (true) {
+            cpp_high_perf::Fiber::YieldToReady();
+        }
+    }));
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < switches; ++i) {
+        f->resume();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "resume+yield: " << ns / switches << " ns" << std::endl;
+
+    const int count = 10000;
+    std::vector<cpp_high_perf::Fiber::ptr> fibers;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        fibers.push_back(cpp_high_perf::Fiber::ptr(new cpp_high_perf::Fiber([]() {
+            cpp_high_perf::Fiber::YieldToHold();
+        })));
+        fibers.back()->resume();
+    }
+    std::cout << count << " live fibers, total=" << cpp_high_perf::Fiber::TotalFibers() << " create+resume: "
+              << std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / count
+              << " us each" << std::endl;
+    for (auto& i : fibers) {
+        i->resume();
+    }
+    fibers.clear();
+    //栈回到池子里了，再创建的时候不用mmap
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        cpp_high_perf::Fiber::ptr tmp(new cpp_high_perf::Fiber([]() {}));
+        tmp->resume();
+    }
+    std::cout << "pooled create+run: "
+              << std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / count
+              << " us each" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+        threads.push_back(std::thread([&ok]() {
+            if (!test_fiber() || !test_nested()) {
+                ok = false;
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    g_logger->setLevel(cpp_high_perf::LogLevel::ERROR);
+    bench();
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
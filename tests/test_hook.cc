@@ -0,0 +1,144 @@
+#include "../src/hook.h"
+#include "../src/fd_manager.h"
+#include "../src/iomanager.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <iostream>
+#include <atomic>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+//一个工作线程上两个协程各睡一会，hook之后是一起睡的，总时间是长的那个不是加起来
+bool test_sleep() {
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    std::atomic<int> done{0};
+    {
+        cpp_high_perf::IOManager iom(1, false, "sleep");
+        iom.schedule([&]() {
+            sleep(1);
+            CHPE_LOG_INFO(g_logger) << "sleep 1s done";
+            ++done;
+        });
+        iom.schedule([&]() {
+            usleep(500 * 1000);
+            CHPE_LOG_INFO(g_logger) << "usleep 500ms done";
+            ++done;
+        });
+        iom.schedule([&]() {
+            struct timespec ts = {0, 800 * 1000 * 1000};
+            nanosleep(&ts, nullptr);
+            ++done;
+        });
+    }
+    uint64_t elapse = cpp_high_perf::GetMonotonicMS() - start;
+    std::cout << "sleep done=" << done << " elapse=" << elapse << "ms" << std::endl;
+    return done == 3 && elapse >= 1000 && elapse < 1500;
+}
+
+//同一个工作线程里一边accept/recv一边connect/send，阻塞的写法，不会卡死
+bool test_socket() {
+    std::atomic<int> port{0};
+    std::string received;
+    std::string replied;
+    {
+        cpp_high_perf::IOManager iom(1, false, "socket");
+        iom.schedule([&]() {
+            int lfd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            if (bind(lfd, (sockaddr*)&addr, sizeof(addr)) || listen(lfd, 16)) {
+                close(lfd);
+                return;
+            }
+            socklen_t len = sizeof(addr);
+            getsockname(lfd, (sockaddr*)&addr, &len);
+            port = ntohs(addr.sin_port);
+
+            int cfd = accept(lfd, nullptr, nullptr);
+            char buf[64] = {0};
+            ssize_t n = recv(cfd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                received.assign(buf, n);
+                send(cfd, "pong", 4, 0);
+            }
+            close(cfd);
+            close(lfd);
+        });
+        iom.schedule([&]() {
+            while (port == 0) {
+                usleep(1000);
+            }
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(port);
+            if (connect(fd, (sockaddr*)&addr, sizeof(addr))) {
+                CHPE_LOG_ERROR(g_logger) << "connect fail errno=" << errno;
+                close(fd);
+                return;
+            }
+            //用户看到的还是阻塞的
+            if (fcntl(fd, F_GETFL) & O_NONBLOCK) {
+                close(fd);
+                return;
+            }
+            send(fd, "ping", 4, 0);
+            char buf[64] = {0};
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n > 0) {
+                replied.assign(buf, n);
+            }
+            close(fd);
+        });
+    }
+    std::cout << "socket received=" << received << " replied=" << replied << std::endl;
+    return received == "ping" && replied == "pong";
+}
+
+//SO_RCVTIMEO设了超时，没数据的recv超时返回ETIMEDOUT
+bool test_timeout() {
+    int err = 0;
+    ssize_t rt = 0;
+    uint64_t elapse = 0;
+    {
+        cpp_high_perf::IOManager iom(1, false, "timeout");
+        iom.schedule([&]() {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+                return;
+            }
+            //socketpair不经过socket()，自己登记一下
+            cpp_high_perf::FdMgr::GetInstance()->get(fds[0], true);
+            timeval tv = {0, 100 * 1000};
+            setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            uint64_t start = cpp_high_perf::GetMonotonicMS();
+            char c;
+            rt = recv(fds[0], &c, 1, 0);
+            err = errno;
+            elapse = cpp_high_perf::GetMonotonicMS() - start;
+            close(fds[0]);
+            close(fds[1]);
+        });
+    }
+    std::cout << "timeout rt=" << rt << " errno=" << err << " elapse=" << elapse << "ms" << std::endl;
+    return rt == -1 && err == ETIMEDOUT && elapse >= 100 && elapse < 500;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_sleep();
+    ok = test_socket() && ok;
+    ok = test_timeout() && ok;
+    //主线程没开hook，走原来的函数
+    ok = !cpp_high_perf::is_hook_enable() && ok;
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include "../src/http_server.h"
+#include "../src/http_parser.h"
+#include "../src/config.h"
+#include "../src/log.h"
+#include <iostream>
+#include <string.h>
+#include <unistd.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+static const char s_request[] =
+    "POST /api/user?id=10&name=zpw#top HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Content-Type:  text/plain \r\n"
+    "X-Empty:\r\n"
+    "Content-Length: 5\r\n"
+    "\r\n"
+    "hello";
+
+//一个字节一个字节喂，每次都传从头开始的全部数据，结果和一次喂完一样
+bool test_request_parser() {
+    bool ok = true;
+    size_t len = strlen(s_request);
+    cpp_high_perf::HttpRequestParser parser;
+    int rt = 0;
+    for (size_t i = 1; i <= len && rt == 0; ++i) {
+        rt = parser.execute(s_request, i);
+    }
+    cpp_high_perf::HttpRequest::ptr req = parser.getData();
+    ok = ok && rt == (int)(len - 5) && req && !parser.hasError();
+    ok = ok && req->getMethod() == cpp_high_perf::HttpMethod::POST
+        && req->getPath() == "/api/user" && req->getQuery() == "id=10&name=zpw"
+        && req->getFragment() == "top" && req->getVersion() == 0x11 && !req->isClose()
+        && req->getParam("name") == "zpw" && req->getParam("id") == "10"
+        && req->getParam("none", "def") == "def";
+    //头不区分大小写，值去掉两头空格，而且就指向原来的缓冲区
+    cpp_high_perf::StringView host = req->getHeader("HOST");
+    ok = ok && host == "www.example.com" && host.data() == strstr(s_request, "www.example.com")
+        && req->getHeader("content-type") == "text/plain" && req->hasHeader("x-empty")
+        && req->getHeader("x-empty").empty() && parser.getContentLength() == 5;
+
+    //detach之后不再指向原来的缓冲区
+    req->detach();
+    ok = ok && req->getHeader("host") == "www.example.com"
+        && req->getHeader("host").data() != host.data() && req->getPath() == "/api/user";
+
+    //出错的情况
+    struct Case {
+        const char* data;
+        int error;
+    } cases[] = {
+        {"GET / HTTP/1.1\r\nBad Header: x\r\n\r\n", 400},
+        {"GET / HTTP/2.0\r\n\r\n", 505},
+        {"FOO / HTTP/1.1\r\n\r\n", 501},
+        {"GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 2\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", 501},
+        {"GET / HTTP/1.1\r\n folded\r\n\r\n", 400},
+    };
+    for (auto& c : cases) {
+        parser.reset();
+        rt = parser.execute(c.data, strlen(c.data));
+        if (rt != -1 || parser.getError() != c.error) {
+            std::cout << "case " << c.data << " rt=" << rt << " error=" << parser.getError() << std::endl;
+            ok = false;
+        }
+    }
+
+    //1.0默认短连接，带keep-alive是长连接
+    parser.reset();
+    const char* v10 = "GET http://host/a/b HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n";
+    ok = ok && parser.execute(v10, strlen(v10)) > 0 && !parser.getData()->isClose()
+        && parser.getData()->getPath() == "/a/b";
+
+    //头超过http.request.buffer_size
+    std::string big = "GET / HTTP/1.1\r\nX-Big: " + std::string(8192, 'a') + "\r\n\r\n";
+    parser.reset();
+    ok = ok && parser.execute(big.c_str(), big.size()) == -1 && parser.getError() == 431;
+
+    std::cout << "request parser ok=" << ok << std::endl;
+    return ok;
+}
+
+bool test_response_parser() {
+    bool ok = true;
+    const char* data = "HTTP/1.1 404 Not Found\r\nContent-Length: 3\r\n\r\nabc";
+    cpp_high_perf::HttpResponseParser parser;
+    int rt = parser.execute(data, strlen(data));
+    cpp_high_perf::HttpResponse::ptr rsp = parser.getData();
+    ok = ok && rt == (int)strlen(data) - 3 && rsp->getStatus() == cpp_high_perf::HttpStatus::NOT_FOUND
+        && rsp->getReason() == "Not Found" && parser.getContentLength() == 3 && !parser.isUntilClose();
+
+    parser.reset();
+    data = "HTTP/1.0 200 OK\r\n\r\n";
+    ok = ok && parser.execute(data, strlen(data)) > 0 && parser.isUntilClose()
+        && parser.getData()->isClose();
+
+    parser.reset();
+    data = "HTTP/1.1 204\r\n\r\n";
+    ok = ok && parser.execute(data, strlen(data)) > 0 && !parser.isUntilClose()
+        && parser.getData()->getStatus() == cpp_high_perf::HttpStatus::NO_CONTENT;
+
+    //304的content-length是原来资源的长度，204带了chunked，都没有body，也不能一直收到关闭
+    parser.reset();
+    data = "HTTP/1.1 304 Not Modified\r\nContent-Length: 100\r\n\r\n";
+    ok = ok && parser.execute(data, strlen(data)) > 0 && parser.getContentLength() == 0
+        && !parser.isChunked() && !parser.isUntilClose() && !parser.getData()->isClose()
+        && parser.getData()->getStatus() == cpp_high_perf::HttpStatus::NOT_MODIFIED;
+
+    parser.reset();
+    data = "HTTP/1.1 204 No Content\r\nTransfer-Encoding: chunked\r\n\r\n";
+    ok = ok && parser.execute(data, strlen(data)) > 0 && parser.getContentLength() == 0
+        && !parser.isChunked() && !parser.isUntilClose() && !parser.getData()->isChunked();
+    std::cout << "response parser ok=" << ok << std::endl;
+    return ok;
+}
+
+//普通的阻塞socket发请求，最后一个请求都带了Connection: close，收到对端关闭为止
+static std::string request(uint16_t port, const std::string& data) {
+    cpp_high_perf::Socket::ptr sock = cpp_high_perf::Socket::CreateTCPSocket();
+    if (!sock->connect(cpp_high_perf::IPAddress::Create("127.0.0.1", port))) {
+        return "";
+    }
+    sock->send(data.c_str(), data.size());
+    std::string out;
+    char buf[4096];
+    while (true) {
+        ssize_t n = sock->recv(buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        out.append(buf, n);
+    }
+    return out;
+}
+
+bool test_server() {
+    bool ok = true;
+    cpp_high_perf::IOManager iom(2, false, "http");
+    cpp_high_perf::HttpServer::ptr server(new cpp_high_perf::HttpServer(true, &iom, &iom));
+    auto dispatch = server->getServletDispatch();
+    dispatch->addServlet("/hello", [](cpp_high_perf::HttpRequest::ptr req,
+                cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+        rsp->setBody("hello " + req->getParam("name", "world").toString());
+        return 0;
+    });
+    dispatch->addGlobServlet("/echo/*", [](cpp_high_perf::HttpRequest::ptr req,
+                cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+        rsp->setBody(req->getPath().toString() + ":" + std::to_string(req->getBody().size())
+                + ":" + req->getBody().substr(0, 4).toString());
+        return 0;
+    });
+    dispatch->addServlet("/empty", [](cpp_high_perf::HttpRequest::ptr req,
+                cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+        rsp->setStatus(cpp_high_perf::HttpStatus::NO_CONTENT);
+        rsp->setBody("ignored");
+        return 0;
+    });
+    ok = ok && server->bind(cpp_high_perf::IPAddress::Create("127.0.0.1", 0)) && server->start();
+    uint16_t port = std::static_pointer_cast<cpp_high_perf::IPAddress>(
+            server->getAddresses()[0])->getPort();
+
+    //短连接
+    std::string out = request(port, "GET /hello?name=zpw HTTP/1.1\r\nConnection: close\r\n\r\n");
+    ok = ok && out.find("HTTP/1.1 200 OK\r\n") == 0 && out.find("connection: close") != std::string::npos
+        && out.find("\r\n\r\nhello zpw") != std::string::npos;
+
+    //pipeline: 三个请求一次发过去，响应按顺序回来
+    out = request(port, "GET /hello HTTP/1.1\r\n\r\n"
+            "GET /nothing HTTP/1.1\r\n\r\n"
+            "POST /echo/a HTTP/1.1\r\nContent-Length: 3\r\nConnection: close\r\n\r\nabc");
+    size_t p1 = out.find("hello world");
+    size_t p2 = out.find("HTTP/1.1 404");
+    size_t p3 = out.find("/echo/a:3:abc");
+    ok = ok && p1 != std::string::npos && p2 != std::string::npos && p3 != std::string::npos
+        && p1 < p2 && p2 < p3;
+
+    //HEAD: content-length是GET时body的长度，但是不发body，404也一样；204不带content-length和body
+    //后面的响应必须紧接着头开始，不然长连接就错位了
+    out = request(port, "HEAD /hello HTTP/1.1\r\n\r\n"
+            "HEAD /nothing HTTP/1.1\r\n\r\n"
+            "GET /empty HTTP/1.1\r\n\r\n"
+            "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+    p1 = out.find("\r\n\r\n");
+    p2 = out.find("\r\n\r\n", p1 + 4);
+    p3 = out.find("\r\n\r\n", p2 + 4);
+    ok = ok && out.find("HTTP/1.1 200 OK\r\n") == 0 && out.find("content-length: 11\r\n") < p1
+        && out.compare(p1 + 4, 12, "HTTP/1.1 404") == 0
+        && p2 != std::string::npos && out.compare(p2 + 4, 12, "HTTP/1.1 204") == 0
+        && p3 != std::string::npos && out.find("content-length", p2) > p3
+        && out.compare(p3 + 4, 12, "HTTP/1.1 200") == 0
+        && out.size() >= 11 && out.compare(out.size() - 11, 11, "hello world") == 0
+        && out.find("ignored") == std::string::npos;
+    if (!ok) {
+        std::cout << "head: " << out << std::endl;
+    }
+
+    //body比缓冲区大，直接收进请求自己的内存
+    std::string body(100000, 'x');
+    out = request(port, "POST /echo/big HTTP/1.1\r\nContent-Length: 100000\r\nConnection: close\r\n\r\n" + body);
+    ok = ok && out.find("/echo/big:100000:xxxx") != std::string::npos;
+
+    //chunked
+    out = request(port, "POST /echo/chunk HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "4\r\nwiki\r\n5;ext=1\r\npedia\r\n0\r\nTrailer: x\r\n\r\n"
+            "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+    ok = ok && out.find("/echo/chunk:9:wiki") != std::string::npos
+        && out.find("hello world") != std::string::npos;
+
+    //body太大
+    cpp_high_perf::Config::lookup<uint64_t>("http.request.max_body_size")->setValue(10);
+    out = request(port, "POST /echo/x HTTP/1.1\r\nContent-Length: 11\r\n\r\n01234567890");
+    ok = ok && out.find("HTTP/1.1 413 Payload Too Large") == 0;
+    cpp_high_perf::Config::lookup<uint64_t>("http.request.max_body_size")->setValue(64 * 1024 * 1024);
+
+    //乱七八糟的请求
+    out = request(port, "hello\r\n\r\n");
+    ok = ok && out.find("HTTP/1.1 400 Bad Request") == 0;
+
+    std::cout << "server ok=" << ok << " requests=" << server->getRequestCount() << std::endl;
+    server->stop();
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_request_parser();
+    ok = test_response_parser() && ok;
+    ok = test_server() && ok;
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+#include "../src/http_connection.h"
+#include "../src/http_server.h"
+#include "../src/config.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <iostream>
+#include <unistd.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+static bool check(bool v, const char* what) {
+    if (!v) {
+        std::cout << "FAILED: " << what << std::endl;
+    }
+    return v;
+}
+
+//收到请求之后响应一个字节一个字节慢慢发，每次读都不会超时，整个请求要超时
+static uint16_t start_trickle_server(cpp_high_perf::IOManager* iom) {
+    std::atomic<uint16_t> port{0};
+    iom->schedule([&port]() {
+        //fd要在协程里创建，hook才会接管
+        cpp_high_perf::Socket::ptr server = cpp_high_perf::Socket::CreateTCPSocket();
+        if (!server->bind(cpp_high_perf::IPAddress::Create("127.0.0.1", 0)) || !server->listen()) {
+            port = 1;
+            return;
+        }
+        port = std::static_pointer_cast<cpp_high_perf::IPAddress>(server->getLocalAddress())->getPort();
+        cpp_high_perf::Socket::ptr client = server->accept();
+        if (!client) {
+            return;
+        }
+        std::string req;
+        char buf[256];
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = client->recv(buf, sizeof(buf));
+            if (n <= 0) {
+                return;
+            }
+            req.append(buf, n);
+        }
+        std::string head = "HTTP/1.1 200 OK\r\ncontent-length: 20\r\n\r\n";
+        client->send(head.c_str(), head.size());
+        for (int i = 0; i < 20; ++i) {
+            usleep(30 * 1000);
+            if (client->send("x", 1) != 1) {
+                break;
+            }
+        }
+    });
+    while (port == 0) {
+        usleep(1000);
+    }
+    return port;
+}
+
+//连接池的各种情况，在协程里跑，server是另一个IOManager上的HttpServer
+static bool run_client(cpp_high_perf::HttpServer::ptr server, uint16_t port, uint16_t trickle_port) {
+    bool ok = true;
+    //最多留2个空闲连接，一个连接最多用3次
+    cpp_high_perf::HttpConnectionPool::ptr pool(
+            new cpp_high_perf::HttpConnectionPool("127.0.0.1", port, 2, 1000, 3));
+
+    //连续5个请求: 第一个连接用了3次关掉，第二个连接用2次
+    uint64_t accepted = server->getAcceptCount();
+    for (int i = 0; i < 5; ++i) {
+        auto r = pool->doGet("/hello?name=" + std::to_string(i), 1000);
+        if (r->result != cpp_high_perf::HttpResult::Error::OK) {
+            std::cout << r->toString() << std::endl;
+        }
+        ok = check(r->result == cpp_high_perf::HttpResult::Error::OK && r->response
+                && r->response->getBody() == "hello " + std::to_string(i), "get") && ok;
+    }
+    ok = check(server->getAcceptCount() - accepted == 2, "max request") && ok;
+    ok = check(pool->getIdleCount() == 1 && pool->getActiveCount() == 0, "idle count") && ok;
+
+    //post，响应已经detach，连接再用也不影响它
+    auto r = pool->doPost("/echo", 1000, {{"content-type", "text/plain"}}, "abc");
+    auto r2 = pool->doGet("/hello", 1000);
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::OK && r->response->getBody() == "/echo:abc"
+            && r2->response && r2->response->getBody() == "hello world", "post") && ok;
+
+    //服务器要关的连接不放回去
+    r = pool->doGet("/close", 1000);
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::OK && r->response->isClose()
+            && pool->getIdleCount() == 0, "close") && ok;
+
+    //超时
+    r = pool->doGet("/slow", 50);
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::RECV_FAIL, "timeout") && ok;
+
+    //响应一直在来，但是整个请求超过了timeout_ms
+    cpp_high_perf::HttpConnectionPool::ptr trickle_pool(
+            new cpp_high_perf::HttpConnectionPool("127.0.0.1", trickle_port));
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    r = trickle_pool->doGet("/trickle", 200);
+    uint64_t elapse = cpp_high_perf::GetMonotonicMS() - start;
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::RECV_FAIL
+            && elapse >= 200 && elapse < 500, "trickle timeout") && ok;
+
+    //空闲太久的不要了
+    cpp_high_perf::HttpConnectionPool::ptr idle_pool(
+            new cpp_high_perf::HttpConnectionPool("127.0.0.1", port, 2, 100, 100));
+    idle_pool->doGet("/hello", 1000);
+    accepted = server->getAcceptCount();
+    usleep(200 * 1000);
+    r = idle_pool->doGet("/hello", 1000);
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::OK
+            && server->getAcceptCount() - accepted == 1, "idle timeout") && ok;
+
+    //服务器那边读超时把空闲连接关掉了，拿出来之前就发现，换新连接
+    auto read_timeout = cpp_high_perf::Config::lookup<uint64_t>("tcp_server.read_timeout");
+    uint64_t old_timeout = read_timeout->getValue();
+    read_timeout->setValue(100);
+    r = pool->doGet("/hello", 1000);
+    usleep(300 * 1000);
+    r = pool->doGet("/hello", 1000);
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::OK, "unhealthy") && ok;
+    read_timeout->setValue(old_timeout);
+
+    //连不上
+    cpp_high_perf::HttpConnectionPool::ptr bad_pool(
+            new cpp_high_perf::HttpConnectionPool("127.0.0.1", 1));
+    r = bad_pool->doGet("/hello", 1000);
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::CONNECT_FAIL, "connect fail") && ok;
+    r = pool->doGet("hello", 1000);
+    ok = check(r->result == cpp_high_perf::HttpResult::Error::INVALID_URL, "invalid url") && ok;
+
+    std::cout << pool->toString() << std::endl;
+    return ok;
+}
+
+//好几个协程一起用一个池子，空闲连接不超过max_size
+static bool run_concurrent(uint16_t port) {
+    cpp_high_perf::HttpConnectionPool::ptr pool =
+        cpp_high_perf::HttpConnectionPoolMgr::GetInstance()->get("127.0.0.1", port);
+    std::atomic<int> fails{0};
+    {
+        cpp_high_perf::IOManager iom(2, false, "client");
+        for (int i = 0; i < 8; ++i) {
+            iom.schedule([pool, &fails]() {
+                for (int j = 0; j < 50; ++j) {
+                    auto r = pool->doPost("/echo", 1000, {}, std::string(j, 'x'));
+                    if (r->result != cpp_high_perf::HttpResult::Error::OK
+                            || r->response->getBody().size() != 6 + (size_t)j) {
+                        ++fails;
+                    }
+                }
+            });
+        }
+    }
+    std::cout << pool->toString() << std::endl;
+    return check(fails == 0 && pool->getActiveCount() == 0
+            && pool->getIdleCount() <= 32 && pool->getIdleCount() > 0, "concurrent");
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    cpp_high_perf::IOManager iom(2, false, "http");
+    cpp_high_perf::HttpServer::ptr server(new cpp_high_perf::HttpServer(true, &iom, &iom));
+    auto dispatch = server->getServletDispatch();
+    dispatch->addServlet("/hello", [](cpp_high_perf::HttpRequest::ptr req,
+                cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+        rsp->setBody("hello " + req->getParam("name", "world").toString());
+        return 0;
+    });
+    dispatch->addServlet("/echo", [](cpp_high_perf::HttpRequest::ptr req,
+                cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+        rsp->setBody("/echo:" + req->getBody().toString());
+        return 0;
+    });
+    dispatch->addServlet("/close", [](cpp_high_perf::HttpRequest::ptr req,
+                cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+        rsp->setClose(true);
+        return 0;
+    });
+    dispatch->addServlet("/slow", [](cpp_high_perf::HttpRequest::ptr req,
+                cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+        usleep(200 * 1000);
+        return 0;
+    });
+    if (!server->bind(cpp_high_perf::IPAddress::Create("127.0.0.1", 0)) || !server->start()) {
+        std::cout << "server start FAILED" << std::endl;
+        return 1;
+    }
+    uint16_t port = std::static_pointer_cast<cpp_high_perf::IPAddress>(
+            server->getAddresses()[0])->getPort();
+
+    uint16_t trickle_port = start_trickle_server(&iom);
+
+    {
+        cpp_high_perf::IOManager client(1, false, "client");
+        client.schedule([server, port, trickle_port, &ok]() {
+            ok = run_client(server, port, trickle_port) && ok;
+        });
+    }
+    ok = run_concurrent(port) && ok;
+    server->stop();
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
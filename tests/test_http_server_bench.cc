@@ -0,0 +1,172 @@
+#include "../src/http_server.h"
+#include "../src/http_parser.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+//http服务器的压测，和wrk一样: 固定数量的长连接，每个连接不停地发请求收响应，跑固定的时间
+//客户端和服务器在同一个进程里的不同IOManager上，走回环地址
+//pipeline大于1的时候一次发好几个请求再一起收
+//用法: test_http_server_bench [连接数] [秒数] [pipeline] [服务器线程数] [客户端线程数]
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ConnStats {
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    std::vector<uint32_t> latency;//每一批请求的往返时间(微秒)
+};
+
+//一个连接: 发depth个请求，收depth个响应，直到deadline
+static void run_conn(uint16_t port, int depth, uint64_t deadline, ConnStats* stats) {
+    cpp_high_perf::Socket::ptr sock = cpp_high_perf::Socket::CreateTCPSocket();
+    if (!sock->connect(cpp_high_perf::IPAddress::Create("127.0.0.1", port))) {
+        ++stats->errors;
+        return;
+    }
+    std::string req;
+    for (int i = 0; i < depth; ++i) {
+        req += "GET /hello HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: bench\r\nAccept: */*\r\n\r\n";
+    }
+    std::vector<char> buf(64 * 1024);
+    size_t begin = 0;
+    size_t end = 0;
+    cpp_high_perf::HttpResponseParser parser;
+
+    while (now_us() < deadline) {
+        uint64_t start = now_us();
+        if (sock->send(req.c_str(), req.size()) != (ssize_t)req.size()) {
+            ++stats->errors;
+            return;
+        }
+        for (int i = 0; i < depth; ++i) {
+            parser.reset();
+            int head = 0;
+            while ((head = parser.execute(&buf[begin], end - begin)) == 0) {
+                if (begin == end) {
+                    begin = end = 0;
+                } else if (end == buf.size()) {
+                    memmove(&buf[0], &buf[begin], end - begin);
+                    end -= begin;
+                    begin = 0;
+                }
+                ssize_t n = sock->recv(&buf[end], buf.size() - end);
+                if (n <= 0) {
+                    ++stats->errors;
+                    return;
+                }
+                stats->bytes += n;
+                end += n;
+            }
+            if (head < 0 || parser.getData()->getStatus() != cpp_high_perf::HttpStatus::OK) {
+                ++stats->errors;
+                return;
+            }
+            //body就在后面，不够就接着收
+            size_t need = head + parser.getContentLength();
+            while (end - begin < need) {
+                if (end == buf.size()) {
+                    memmove(&buf[0], &buf[begin], end - begin);
+                    end -= begin;
+                    begin = 0;
+                }
+                ssize_t n = sock->recv(&buf[end], buf.size() - end);
+                if (n <= 0) {
+                    ++stats->errors;
+                    return;
+                }
+                stats->bytes += n;
+                end += n;
+            }
+            begin += need;
+        }
+        stats->requests += depth;
+        stats->latency.push_back(now_us() - start);
+    }
+}
+
+int main(int argc, char** argv) {
+    int conns = argc > 1 ? atoi(argv[1]) : 16;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    int depth = argc > 3 ? atoi(argv[3]) : 1;
+    int server_threads = argc > 4 ? atoi(argv[4]) : 1;
+    int client_threads = argc > 5 ? atoi(argv[5]) : 1;
+    CHPE_LOG_ROOT()->setLevel(cpp_high_perf::LogLevel::ERROR);
+    CHPE_LOG_NAME("system")->setLevel(cpp_high_perf::LogLevel::ERROR);
+
+    std::vector<ConnStats> stats(conns);
+    uint64_t elapse = 0;
+    uint64_t server_requests = 0;
+    {
+        cpp_high_perf::IOManager server_iom(server_threads, false, "server");
+        cpp_high_perf::HttpServer::ptr server(new cpp_high_perf::HttpServer(true, &server_iom, &server_iom));
+        server->getServletDispatch()->addServlet("/hello", [](cpp_high_perf::HttpRequest::ptr req,
+                    cpp_high_perf::HttpResponse::ptr rsp, cpp_high_perf::HttpSession::ptr session) {
+            static const std::string body = "hello world";
+            rsp->setHeader("content-type", "text/plain");
+            rsp->setBodyRef(body);
+            return 0;
+        });
+        if (!server->bind(cpp_high_perf::IPAddress::Create("127.0.0.1", 0)) || !server->start()) {
+            std::cout << "server start FAILED" << std::endl;
+            return 1;
+        }
+        uint16_t port = std::static_pointer_cast<cpp_high_perf::IPAddress>(
+                server->getAddresses()[0])->getPort();
+
+        uint64_t start = now_us();
+        uint64_t deadline = start + seconds * 1000000ull;
+        {
+            cpp_high_perf::IOManager client_iom(client_threads, false, "client");
+            for (int i = 0; i < conns; ++i) {
+                ConnStats* s = &stats[i];
+                client_iom.schedule([port, depth, deadline, s]() {
+                    run_conn(port, depth, deadline, s);
+                });
+            }
+        }
+        elapse = now_us() - start;
+        server_requests = server->getRequestCount();
+        server->stop();
+    }
+
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    std::vector<uint32_t> latency;
+    for (auto& s : stats) {
+        requests += s.requests;
+        bytes += s.bytes;
+        errors += s.errors;
+        latency.insert(latency.end(), s.latency.begin(), s.latency.end());
+    }
+    std::sort(latency.begin(), latency.end());
+    auto pct = [&latency](double p) -> uint32_t {
+        return latency.empty() ? 0 : latency[std::min(latency.size() - 1, (size_t)(latency.size() * p))];
+    };
+    uint64_t sum = 0;
+    for (auto l : latency) {
+        sum += l;
+    }
+    double secs = elapse / 1e6;
+    std::cout << "connections=" << conns << " duration=" << secs << "s pipeline=" << depth
+              << " server_threads=" << server_threads << " client_threads=" << client_threads << std::endl;
+    std::cout << "requests=" << requests << " errors=" << errors
+              << " req/s=" << (secs > 0 ? requests / secs : 0)
+              << " transfer=" << (secs > 0 ? bytes / 1024.0 / 1024.0 / secs : 0) << "MB/s" << std::endl;
+    std::cout << "latency(us) avg=" << (latency.empty() ? 0 : sum / latency.size())
+              << " p50=" << pct(0.5) << " p90=" << pct(0.9) << " p99=" << pct(0.99)
+              << " max=" << (latency.empty() ? 0 : latency.back()) << std::endl;
+    bool ok = errors == 0 && requests > 0 && server_requests >= requests;
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
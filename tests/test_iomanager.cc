@@ -0,0 +1,106 @@
+#include "../src/iomanager.h"
+#include "../src/log.h"
+#include <iostream>
+#include <atomic>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+static void set_nonblock(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+//一对socket来回传，读的一方挂在读事件上等，写的一方写完了它才被叫醒
+bool test_pingpong(int rounds) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        return false;
+    }
+    set_nonblock(fds[0]);
+    set_nonblock(fds[1]);
+    std::atomic<int> received{0};
+    {
+        cpp_high_perf::IOManager iom(4, false, "pingpong");
+        for (int side = 0; side < 2; ++side) {
+            iom.schedule([&, side]() {
+                int fd = fds[side];
+                auto io = cpp_high_perf::IOManager::GetThis();
+                //side 0先发
+                if (side == 0) {
+                    write(fd, "x", 1);
+                }
+                for (int i = 0; i < rounds; ++i) {
+                    char c;
+                    while (read(fd, &c, 1) != 1) {
+                        io->addEvent(fd, cpp_high_perf::IOManager::READ);
+                        cpp_high_perf::Fiber::YieldToHold();
+                    }
+                    ++received;
+                    if (side == 1 || i + 1 < rounds) {
+                        write(fd, "x", 1);
+                    }
+                }
+            });
+        }
+    }
+    close(fds[0]);
+    close(fds[1]);
+    std::cout << "pingpong received=" << received << std::endl;
+    return received == rounds * 2;
+}
+
+//没有数据来，cancelEvent把等的协程叫醒
+bool test_cancel() {
+    int fds[2];
+    if (pipe(fds)) {
+        return false;
+    }
+    set_nonblock(fds[0]);
+    std::atomic<bool> woke{false};
+    {
+        cpp_high_perf::IOManager iom(2, false, "cancel");
+        iom.schedule([&]() {
+            cpp_high_perf::IOManager::GetThis()->addEvent(fds[0], cpp_high_perf::IOManager::READ);
+            CHPE_LOG_INFO(g_logger) << "wait read";
+            cpp_high_perf::Fiber::YieldToHold();
+            CHPE_LOG_INFO(g_logger) << "woke by cancel";
+            woke = true;
+        });
+        //等它挂上去
+        while (iom.getPendingEventCount() == 0) {
+            usleep(1000);
+        }
+        iom.cancelEvent(fds[0], cpp_high_perf::IOManager::READ);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return woke;
+}
+
+//回调形式的事件，还有delEvent去掉之后不会触发
+bool test_callback() {
+    int fds[2];
+    if (pipe(fds)) {
+        return false;
+    }
+    std::atomic<int> calls{0};
+    {
+        cpp_high_perf::IOManager iom(1, true, "callback");
+        iom.addEvent(fds[1], cpp_high_perf::IOManager::WRITE, [&]() { ++calls; });
+        iom.addEvent(fds[0], cpp_high_perf::IOManager::READ, [&]() { calls += 100; });
+        iom.delEvent(fds[0], cpp_high_perf::IOManager::READ);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return calls == 1;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_pingpong(10000);
+    ok = test_cancel() && ok;
+    ok = test_callback() && ok;
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
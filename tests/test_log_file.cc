@@ -0,0 +1,215 @@
+#include "../src/log.h"
+#include "../src/log_file.h"
+#include "../src/config.h"
+#include "../src/util.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <signal.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+static std::string s_dir;
+
+static std::string read_file(const std::string& path) {
+    std::ifstream ifs(path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+static std::string read_gz(const std::string& path) {
+    gzFile gz = gzopen(path.c_str(), "rb");
+    if (!gz) {
+        return "";
+    }
+    std::string str;
+    char buf[1024];
+    int n = 0;
+    while ((n = gzread(gz, buf, sizeof(buf))) > 0) {
+        str.append(buf, n);
+    }
+    gzclose(gz);
+    return str;
+}
+
+//目录下以prefix开头的文件，不包括prefix本身
+static std::vector<std::string> list_rotated(const std::string& prefix) {
+    std::vector<std::string> files;
+    DIR* d = opendir(s_dir.c_str());
+    struct dirent* dp = nullptr;
+    while (d && (dp = readdir(d)) != nullptr) {
+        std::string name = dp->d_name;
+        if (name.size() > prefix.size() && name.compare(0, prefix.size() + 1, prefix + ".") == 0) {
+            files.push_back(name);
+        }
+    }
+    if (d) {
+        closedir(d);
+    }
+    return files;
+}
+
+//重新打开是追加，原来的内容还在
+bool test_append() {
+    std::string path = s_dir + "/append.log";
+    {
+        cpp_high_perf::LogFile::ptr f = cpp_high_perf::LogFile::Get(path);
+        f->write("first\n", 6, cpp_high_perf::GetCurrentUS());
+        f->reopen();
+        f->write("second\n", 7, cpp_high_perf::GetCurrentUS());
+    }
+    {
+        cpp_high_perf::LogFile::ptr f = cpp_high_perf::LogFile::Get(path);
+        f->write("third\n", 6, cpp_high_perf::GetCurrentUS());
+    }
+    std::string str = read_file(path);
+    std::cout << "append: " << str;
+    return str == "first\nsecond\nthird\n";
+}
+
+//按大小切，后台压缩，只留最新的两个
+bool test_size_rotate() {
+    std::string path = s_dir + "/size.log";
+    cpp_high_perf::LogRotateConfig conf;
+    conf.maxSize = 100;
+    conf.maxFiles = 2;
+    conf.compress = true;
+    cpp_high_perf::FileLogAppender::ptr ap(new cpp_high_perf::FileLogAppender(path, conf));
+    cpp_high_perf::LogFile::ptr f = ap->getFile();
+    std::string line(39, 'x');
+    line += '\n';
+    for (int i = 0; i < 20; ++i) {
+        f->write(line.data(), line.size(), cpp_high_perf::GetCurrentUS());
+        if (f->getSize() > 100) {
+            return false;
+        }
+    }
+    cpp_high_perf::Singleton<cpp_high_perf::LogFileCompressor>::GetInstance()->waitIdle();
+    std::vector<std::string> files = list_rotated("size.log");
+    bool ok = files.size() == 2;
+    for (auto& i : files) {
+        std::string str = read_gz(s_dir + "/" + i);
+        std::cout << "rotated: " << i << " size=" << str.size() << std::endl;
+        ok = ok && i.size() > 3 && i.compare(i.size() - 3, 3, ".gz") == 0 && str == line + line;
+    }
+    return ok;
+}
+
+//按小时切，传进去的时间过了整点就切
+bool test_time_rotate() {
+    std::string path = s_dir + "/time.log";
+    cpp_high_perf::LogRotateConfig conf;
+    conf.period = cpp_high_perf::LogRotateConfig::HOURLY;
+    conf.compress = false;
+    cpp_high_perf::LogFile::ptr f = cpp_high_perf::LogFile::Get(path);
+    f->setRotateConfig(conf);
+    uint64_t now = cpp_high_perf::GetCurrentUS();
+    f->write("old\n", 4, now);
+    f->write("new\n", 4, now + 3600ull * 1000 * 1000);
+    f->flush();
+    std::vector<std::string> files = list_rotated("time.log");
+    bool ok = files.size() == 1 && read_file(s_dir + "/" + files[0]) == "old\n"
+        && read_file(path) == "new\n";
+    std::cout << "time rotate ok=" << ok << std::endl;
+    return ok;
+}
+
+//文件被外面挪走，发SIGHUP之后新写的进新文件，之前缓冲的留在挪走的文件里
+bool test_sighup() {
+    YAML::Node node = YAML::Load("log:\n  reopen_on_sighup: true");
+    cpp_high_perf::Config::loadFromYaml(node);
+
+    std::string path = s_dir + "/hup.log";
+    cpp_high_perf::LogFile::ptr f = cpp_high_perf::LogFile::Get(path);
+    f->write("before\n", 7, cpp_high_perf::GetCurrentUS());
+    rename(path.c_str(), (path + ".moved").c_str());
+    raise(SIGHUP);
+    f->write("after\n", 6, cpp_high_perf::GetCurrentUS());
+    f->flush();
+    bool ok = read_file(path + ".moved") == "before\n" && read_file(path) == "after\n";
+    std::cout << "sighup ok=" << ok << std::endl;
+    return ok;
+}
+
+//yaml里的切分配置能读进来，也能写回去
+bool test_config() {
+    YAML::Node node = YAML::Load(
+        "name: rotate\n"
+        "appender:\n"
+        "  - type: FileLogAppender\n"
+        "    file: " + s_dir + "/conf.log\n"
+        "    max_size: 1K\n"
+        "    rotate: daily\n"
+        "    max_files: 3\n"
+        "    compress: false\n"
+        "    sync: 200\n");
+    cpp_high_perf::LogDefine ld = cpp_high_perf::LexicalCast<YAML::Node, cpp_high_perf::LogDefine>()(node);
+    const cpp_high_perf::LogRotateConfig& r = ld.appenders[0].rotate;
+    bool ok = r.maxSize == 1024 && r.period == cpp_high_perf::LogRotateConfig::DAILY
+        && r.maxFiles == 3 && !r.compress
+        && ld.appenders[0].sync.policy == cpp_high_perf::LogSyncConfig::INTERVAL
+        && ld.appenders[0].sync.intervalMs == 200;
+    YAML::Node out = cpp_high_perf::LexicalCast<cpp_high_perf::LogDefine, YAML::Node>()(ld);
+    cpp_high_perf::LogDefine ld2 = cpp_high_perf::LexicalCast<YAML::Node, cpp_high_perf::LogDefine>()(out);
+    ok = ok && ld2 == ld;
+    std::cout << "config ok=" << ok << std::endl;
+    return ok;
+}
+
+//一万行日志攒在缓冲区里批量写，系统调用次数远少于行数；ON_ERROR只在ERROR的时候落盘
+bool test_batch() {
+    std::string path = s_dir + "/batch.log";
+    cpp_high_perf::FileLogAppender::ptr ap(new cpp_high_perf::FileLogAppender(path));
+    cpp_high_perf::LogSyncConfig sync;
+    bool ok = cpp_high_perf::LogSyncConfig::FromString("error", sync);
+    ap->setSyncConfig(sync);
+    cpp_high_perf::LogFile::ptr f = ap->getFile();
+    std::string line(99, 'x');
+    line += '\n';
+    const int count = 10000;
+    for (int i = 0; i < count; ++i) {
+        f->write(line.data(), line.size(), cpp_high_perf::GetCurrentUS());
+    }
+    ok = ok && f->getSyncCalls() == 0;
+    f->write(line.data(), line.size(), cpp_high_perf::GetCurrentUS(), true);
+    ok = ok && f->getSyncCalls() == 1;
+    f->flush();
+    struct stat st;
+    ok = ok && stat(path.c_str(), &st) == 0 && (size_t)st.st_size == line.size() * (count + 1);
+    std::cout << "batch lines=" << count + 1 << " writes=" << f->getWriteCalls()
+              << " syncs=" << f->getSyncCalls() << std::endl;
+    ok = ok && f->getWriteCalls() * 100 < (uint64_t)count;
+
+    cpp_high_perf::LogSyncConfig conf;
+    ok = ok && cpp_high_perf::LogSyncConfig::FromString("500ms", conf)
+        && conf.policy == cpp_high_perf::LogSyncConfig::INTERVAL && conf.intervalMs == 500
+        && cpp_high_perf::LogSyncConfig::ToString(conf) == "500"
+        && !cpp_high_perf::LogSyncConfig::FromString("sometimes", conf);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    char tmpl[] = "/tmp/test_log_file_XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        return 1;
+    }
+    s_dir = tmpl;
+
+    bool ok = test_append();
+    ok = test_size_rotate() && ok;
+    ok = test_time_rotate() && ok;
+    ok = test_sighup() && ok;
+    ok = test_config() && ok;
+    ok = test_batch() && ok;
+
+    if (ok) {
+        std::string cmd = "rm -rf " + s_dir;
+        ok = system(cmd.c_str()) == 0;
+    }
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
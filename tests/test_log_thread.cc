@@ -0,0 +1,101 @@
+#include "../src/log.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <string.h>
+#include <unistd.h>
+
+//多线程压测: 很多线程同时写同一个文件，另外一个线程不停地增删appender、换格式器、改级别
+//最后把文件读回来，检查每一行都是完整的，每个线程的序号都是连续的
+
+static const int s_thread_count = 16;
+static const int s_line_count = 20000;
+
+static bool check_file(const std::string& path, uint64_t dropped) {
+    std::ifstream in(path);
+    std::vector<int> next(s_thread_count, 0);
+    std::string line;
+    uint64_t total = 0;
+    while (std::getline(in, line)) {
+        int id = -1, seq = -1;
+        char tail[16] = {0};
+        if (sscanf(line.c_str(), "thread=%d seq=%d payload=%*[x] %15s", &id, &seq, tail) != 3
+                || strcmp(tail, "end") != 0 || id < 0 || id >= s_thread_count) {
+            std::cout << "broken line: " << line << std::endl;
+            return false;
+        }
+        //异步模式下丢弃的日志会让序号跳过，但是不能乱序
+        if (seq < next[id] || (dropped == 0 && seq != next[id])) {
+            std::cout << "thread " << id << " expect seq " << next[id] << " got " << seq << std::endl;
+            return false;
+        }
+        next[id] = seq + 1;
+        ++total;
+    }
+    uint64_t expect = (uint64_t)s_thread_count * s_line_count;
+    if (total + dropped != expect) {
+        std::cout << "line count " << total << " + dropped " << dropped << " != " << expect << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool run(bool async) {
+    std::string path = async ? "/tmp/chpe_test_log_thread_async.log" : "/tmp/chpe_test_log_thread_sync.log";
+    //文件是追加打开的，上一次跑留下来的先删掉
+    unlink(path.c_str());
+    cpp_high_perf::Logger::ptr logger(new cpp_high_perf::Logger("stress"));
+    cpp_high_perf::FileLogAppender::ptr file(new cpp_high_perf::FileLogAppender(path));
+    file->setFormatter(cpp_high_perf::LogFormatter::ptr(new cpp_high_perf::LogFormatter("%m%n")));
+    logger->addAppender(file);
+    logger->setAsync(async);
+
+    auto flusher = cpp_high_perf::AsyncLogFlusherMgr::GetInstance();
+    flusher->setMaxPending(1 << 20);
+    uint64_t dropped_before = flusher->getDropped();
+
+    std::atomic<bool> stop{false};
+    //不停地改配置的线程
+    std::thread reconfig([&]() {
+        int n = 0;
+        while (!stop) {
+            cpp_high_perf::LogAppender::ptr extra(new cpp_high_perf::FileLogAppender("/dev/null"));
+            logger->addAppender(extra);
+            file->setFormatter(cpp_high_perf::LogFormatter::ptr(new cpp_high_perf::LogFormatter("%m%n")));
+            extra->setLevel(n++ % 2 ? cpp_high_perf::LogLevel::DEBUG : cpp_high_perf::LogLevel::ERROR);
+            logger->setLevel(cpp_high_perf::LogLevel::DEBUG);
+            logger->delAppender(extra);
+        }
+    });
+
+    std::string payload(64, 'x');
+    std::vector<std::thread> threads;
+    for (int i = 0; i < s_thread_count; ++i) {
+        threads.push_back(std::thread([&, i]() {
+            for (int j = 0; j < s_line_count; ++j) {
+                CHPE_LOG_INFO(logger) << "thread=" << i << " seq=" << j << " payload=" << payload << " end";
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    stop = true;
+    reconfig.join();
+    logger->flush();
+
+    uint64_t dropped = flusher->getDropped() - dropped_before;
+    bool ok = check_file(path, dropped);
+    std::cout << (async ? "async" : "sync") << " mode: " << (ok ? "ok" : "FAILED")
+              << " dropped=" << dropped << std::endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool ok = run(false);
+    ok = run(true) && ok;
+    return ok ? 0 : 1;
+}
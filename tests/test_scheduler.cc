@@ -0,0 +1,111 @@
+#include "../src/scheduler.h"
+#include "../src/log.h"
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+static std::atomic<int> s_done{0};
+
+//在工作线程里面不停地派生任务，任务都进了自己的队列，别的线程得靠偷才有活干
+void spawn(int depth) {
+    ++s_done;
+    if (depth > 0) {
+        for (int i = 0; i < 2; ++i) {
+            cpp_high_perf::Scheduler::GetThis()->schedule(std::bind(spawn, depth - 1));
+        }
+    }
+}
+
+bool test_steal(cpp_high_perf::Scheduler& sc) {
+    const int depth = 16;
+    s_done = 0;
+    auto begin = std::chrono::steady_clock::now();
+    sc.schedule(std::bind(spawn, depth));
+    while (s_done < (1 << (depth + 1)) - 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "spawned " << s_done << " tasks in " << ms << " ms" << std::endl;
+    uint64_t steals = 0;
+    for (size_t i = 0; i < sc.getWorkerCount(); ++i) {
+        steals += sc.getWorkerStats(i).steals;
+    }
+    return steals > 0;
+}
+
+//指定线程的任务只能在那个线程上跑
+bool test_pin(cpp_high_perf::Scheduler& sc) {
+    std::atomic<int> wrong{0};
+    std::atomic<int> count{0};
+    for (int i = 0; i < 1000; ++i) {
+        int worker = i % sc.getWorkerCount();
+        sc.schedule([worker, &wrong, &count]() {
+            if (cpp_high_perf::Scheduler::GetWorkerIndex() != worker) {
+                ++wrong;
+            }
+            ++count;
+        }, worker);
+    }
+    while (count < 1000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return wrong == 0;
+}
+
+//协程让出之后还会被调度回来接着跑
+bool test_yield(cpp_high_perf::Scheduler& sc) {
+    std::atomic<int> steps{0};
+    for (int i = 0; i < 10; ++i) {
+        sc.schedule([&steps]() {
+            for (int j = 0; j < 3; ++j) {
+                ++steps;
+                CHPE_LOG_DEBUG(g_logger) << "yield step " << j;
+                cpp_high_perf::Fiber::YieldToReady();
+            }
+            ++steps;
+        });
+    }
+    while (steps < 40) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(cpp_high_perf::LogLevel::INFO);
+    bool ok = true;
+    {
+        //调用线程不参与，方便在外面等结果
+        cpp_high_perf::Scheduler sc(4, false, "test");
+        sc.start();
+        ok = test_steal(sc) && ok;
+        ok = test_pin(sc) && ok;
+        ok = test_yield(sc) && ok;
+        sc.dump(std::cout);
+        sc.stop();
+    }
+    {
+        //调用线程也当工作线程，stop的时候进去把剩下的任务跑完
+        cpp_high_perf::Scheduler sc(2, true, "caller");
+        std::atomic<int> count{0};
+        std::atomic<int> on_caller{0};
+        int caller_tid = cpp_high_perf::GetThreadId();
+        for (int i = 0; i < 100; ++i) {
+            sc.schedule([&]() {
+                ++count;
+                if (cpp_high_perf::GetThreadId() == caller_tid) {
+                    ++on_caller;
+                }
+            }, i % 2);
+        }
+        sc.start();
+        sc.stop();
+        std::cout << "use_caller count=" << count << " on_caller=" << on_caller << std::endl;
+        ok = ok && count == 100 && on_caller == 50;
+    }
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+#include "../src/socket.h"
+#include "../src/address.h"
+#include "../src/iomanager.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+//地址的解析和格式化
+bool test_address() {
+    bool ok = true;
+    cpp_high_perf::IPAddress::ptr v4 = cpp_high_perf::IPAddress::Create("127.0.0.1", 8080);
+    ok = ok && v4 && v4->getFamily() == AF_INET && v4->toString() == "127.0.0.1:8080";
+    v4->setPort(80);
+    ok = ok && v4->toString() == "127.0.0.1:80";
+
+    cpp_high_perf::IPAddress::ptr v6 = cpp_high_perf::IPAddress::Create("::1", 80);
+    ok = ok && v6 && v6->getFamily() == AF_INET6 && v6->toString() == "[::1]:80";
+    ok = ok && !cpp_high_perf::IPv4Address::Create("256.1.1.1");
+
+    cpp_high_perf::UnixAddress::ptr ua(new cpp_high_perf::UnixAddress("/tmp/test.sock"));
+    ok = ok && ua->getPath() == "/tmp/test.sock" && ua->toString() == "/tmp/test.sock";
+
+    //走getaddrinfo，localhost在hosts里，不需要网络
+    cpp_high_perf::IPAddress::ptr lo = cpp_high_perf::Address::LookupAnyIPAddress("localhost:9900");
+    ok = ok && lo && lo->toString() == "127.0.0.1:9900";
+    std::vector<cpp_high_perf::Address::ptr> addrs;
+    ok = ok && cpp_high_perf::Address::Lookup(addrs, "[::1]:80", AF_INET6, SOCK_STREAM)
+        && addrs[0]->toString() == "[::1]:80";
+    std::cout << "address ok=" << ok << " lo=" << (lo ? lo->toString() : "null") << std::endl;
+    return ok;
+}
+
+//一个工作线程上: 服务端accept之后用两个iovec收，客户端用两个iovec发，头和体不拼接
+bool test_socket() {
+    std::string head;
+    std::string body;
+    std::string reply;
+    bool remote_ok = false;
+    uint16_t port = 0;
+    cpp_high_perf::IPAddress::ptr addr = cpp_high_perf::IPAddress::Create("127.0.0.1", 0);
+    {
+        cpp_high_perf::IOManager iom(1, false, "socket");
+        cpp_high_perf::Socket::ptr server = cpp_high_perf::Socket::CreateTCP(addr);
+        iom.schedule([&]() {
+            //fd要在协程里创建，hook才会接管
+            if (!server->setReusePort(true) || !server->bind(addr) || !server->listen()) {
+                return;
+            }
+            port = std::static_pointer_cast<cpp_high_perf::IPAddress>(server->getLocalAddress())->getPort();
+            cpp_high_perf::Socket::ptr client = server->accept();
+            if (!client) {
+                return;
+            }
+            char h[4] = {0};
+            char b[16] = {0};
+            iovec iov[2];
+            iov[0].iov_base = h;
+            iov[0].iov_len = sizeof(h);
+            iov[1].iov_base = b;
+            iov[1].iov_len = sizeof(b);
+            size_t total = 0;
+            while (total < 9) {
+                ssize_t n = client->recv(iov, 2);
+                if (n <= 0) {
+                    return;
+                }
+                total += n;
+                //没收满，接着往剩下的地方收
+                size_t skip = n;
+                for (auto& i : iov) {
+                    size_t d = std::min(skip, i.iov_len);
+                    i.iov_base = (char*)i.iov_base + d;
+                    i.iov_len -= d;
+                    skip -= d;
+                }
+            }
+            head.assign(h, 4);
+            body.assign(b, total - 4);
+            remote_ok = client->getRemoteAddress()->getFamily() == AF_INET;
+            client->send("pong", 4);
+        });
+        iom.schedule([&]() {
+            while (port == 0) {
+                usleep(1000);
+            }
+            cpp_high_perf::Socket::ptr sock = cpp_high_perf::Socket::CreateTCP(addr);
+            if (!sock->connect(cpp_high_perf::IPAddress::Create("127.0.0.1", port), 1000)) {
+                return;
+            }
+            std::string h = "HEAD";
+            std::string b = "hello";
+            iovec iov[2];
+            iov[0].iov_base = &h[0];
+            iov[0].iov_len = h.size();
+            iov[1].iov_base = &b[0];
+            iov[1].iov_len = b.size();
+            sock->send(iov, 2);
+            char buf[8] = {0};
+            ssize_t n = sock->recv(buf, sizeof(buf));
+            if (n > 0) {
+                reply.assign(buf, n);
+            }
+            CHPE_LOG_INFO(g_logger) << *sock;
+        });
+    }
+    std::cout << "socket head=" << head << " body=" << body << " reply=" << reply << std::endl;
+    return head == "HEAD" && body == "hello" && reply == "pong" && remote_ok;
+}
+
+//设了接收超时，没数据就超时返回，而且不会把工作线程卡住
+bool test_timeout() {
+    int err = 0;
+    ssize_t rt = 0;
+    uint64_t elapse = 0;
+    int64_t timeout = 0;
+    {
+        cpp_high_perf::IOManager iom(1, false, "timeout");
+        iom.schedule([&]() {
+            cpp_high_perf::Socket::ptr server = cpp_high_perf::Socket::CreateUDPSocket();
+            server->bind(cpp_high_perf::IPAddress::Create("127.0.0.1", 0));
+            server->setRecvTimeout(100);
+            timeout = server->getRecvTimeout();
+            uint64_t start = cpp_high_perf::GetMonotonicMS();
+            char c;
+            cpp_high_perf::Address::ptr from(new cpp_high_perf::IPv4Address);
+            rt = server->recvFrom(&c, 1, from);
+            err = errno;
+            elapse = cpp_high_perf::GetMonotonicMS() - start;
+        });
+    }
+    std::cout << "timeout rt=" << rt << " errno=" << err << " elapse=" << elapse << "ms" << std::endl;
+    return timeout == 100 && rt == -1 && err == ETIMEDOUT && elapse >= 100 && elapse < 500;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_address();
+    ok = test_socket() && ok;
+    ok = test_timeout() && ok;
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include "../src/tcp_server.h"
+#include "../src/config.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <iostream>
+#include <errno.h>
+#include <unistd.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+//回显服务器，对端关了或者超时了就返回
+class EchoServer : public cpp_high_perf::TcpServer {
+public:
+    typedef std::shared_ptr<EchoServer> ptr;
+
+    EchoServer(cpp_high_perf::IOManager* io, cpp_high_perf::IOManager* accept)
+        :TcpServer(io, accept) {
+    }
+
+    std::atomic<int> timeouts{0};
+protected:
+    void handleClient(cpp_high_perf::Socket::ptr client) override {
+        char buf[256];
+        while (true) {
+            ssize_t n = client->recv(buf, sizeof(buf));
+            if (n <= 0) {
+                if (n < 0 && errno == ETIMEDOUT) {
+                    ++timeouts;
+                }
+                break;
+            }
+            client->send(buf, n);
+        }
+    }
+};
+
+//普通的阻塞socket(主线程没开hook)，连上发一句收一句
+static bool echo_once(uint16_t port, const std::string& msg) {
+    cpp_high_perf::Socket::ptr sock = cpp_high_perf::Socket::CreateTCPSocket();
+    if (!sock->connect(cpp_high_perf::IPAddress::Create("127.0.0.1", port))) {
+        return false;
+    }
+    sock->send(msg.c_str(), msg.size());
+    std::string reply(msg.size(), '\0');
+    size_t got = 0;
+    while (got < reply.size()) {
+        ssize_t n = sock->recv(&reply[got], reply.size() - got);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return reply == msg;
+}
+
+bool test_server() {
+    bool ok = true;
+    cpp_high_perf::Config::lookup<uint64_t>("tcp_server.graceful_timeout")->setValue(100);
+    auto read_timeout = cpp_high_perf::Config::lookup<uint64_t>("tcp_server.read_timeout");
+
+    cpp_high_perf::IOManager io(2, false, "io");
+    cpp_high_perf::IOManager acceptor(2, false, "accept");
+    EchoServer::ptr server(new EchoServer(&io, &acceptor));
+    ok = ok && server->bind(cpp_high_perf::IPAddress::Create("127.0.0.1", 0));
+
+    //两个accept线程，两个监听socket绑在同一个端口上
+    std::vector<cpp_high_perf::Address::ptr> addrs = server->getAddresses();
+    ok = ok && addrs.size() == 2 && *addrs[0] == *addrs[1];
+    uint16_t port = std::static_pointer_cast<cpp_high_perf::IPAddress>(addrs[0])->getPort();
+    ok = ok && port != 0 && server->start();
+    std::cout << server->toString();
+
+    for (int i = 0; i < 20 && ok; ++i) {
+        ok = echo_once(port, "hello " + std::to_string(i));
+    }
+    std::cout << "echo ok=" << ok << " accepted=" << server->getAcceptCount() << std::endl;
+    ok = ok && server->getAcceptCount() == 20;
+
+    //配置改了，之后的连接马上用新的读超时
+    read_timeout->setValue(100);
+    cpp_high_perf::Socket::ptr idle = cpp_high_perf::Socket::CreateTCPSocket();
+    ok = ok && idle->connect(cpp_high_perf::IPAddress::Create("127.0.0.1", port));
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    char c;
+    ssize_t n = idle->recv(&c, 1);
+    uint64_t elapse = cpp_high_perf::GetMonotonicMS() - start;
+    std::cout << "read timeout n=" << n << " elapse=" << elapse << "ms timeouts="
+              << server->timeouts << std::endl;
+    ok = ok && n == 0 && elapse >= 80 && elapse < 1000 && server->timeouts == 1;
+
+    //平滑停止: 不超时的空闲连接，stop之后过了graceful_timeout被关掉
+    read_timeout->setValue(0);
+    cpp_high_perf::Socket::ptr hold = cpp_high_perf::Socket::CreateTCPSocket();
+    ok = ok && hold->connect(cpp_high_perf::IPAddress::Create("127.0.0.1", port))
+        && echo_once(port, "last");
+    while (ok && server->getConnectionCount() != 1) {
+        usleep(1000);
+    }
+    start = cpp_high_perf::GetMonotonicMS();
+    server->stop();
+    n = hold->recv(&c, 1);
+    elapse = cpp_high_perf::GetMonotonicMS() - start;
+    std::cout << "graceful n=" << n << " elapse=" << elapse << "ms" << std::endl;
+    ok = ok && n == 0 && elapse >= 80 && elapse < 1000;
+
+    //监听socket关掉了，连不上
+    usleep(10 * 1000);
+    cpp_high_perf::Socket::ptr late = cpp_high_perf::Socket::CreateTCPSocket();
+    ok = ok && !late->connect(cpp_high_perf::IPAddress::Create("127.0.0.1", port));
+    while (ok && server->getConnectionCount() != 0) {
+        usleep(1000);
+    }
+    ok = ok && server->getAcceptCount() == 23;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_server();
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
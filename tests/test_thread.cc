@@ -0,0 +1,103 @@
+#include "../src/thread.h"
+#include "../src/mutex.h"
+#include "../src/config.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <iostream>
+#include <vector>
+#include <sstream>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+//名字和id在构造完就能拿到，线程里面也能拿到自己
+bool test_thread() {
+    std::vector<cpp_high_perf::Thread::ptr> threads;
+    std::vector<std::string> names(4);
+    std::vector<pid_t> ids(4);
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(cpp_high_perf::Thread::ptr(new cpp_high_perf::Thread([&names, &ids, i]() {
+            names[i] = cpp_high_perf::Thread::GetName();
+            ids[i] = cpp_high_perf::GetThreadId();
+        }, "name_" + std::to_string(i))));
+    }
+    bool ok = true;
+    for (int i = 0; i < 4; ++i) {
+        pid_t id = threads[i]->getId();
+        threads[i]->join();
+        ok = ok && id > 0 && id == ids[i] && names[i] == "name_" + std::to_string(i);
+    }
+    ok = ok && cpp_high_perf::Thread::GetThis() == nullptr
+        && cpp_high_perf::Thread::GetName() == "UNKNOWN";
+    std::cout << "thread ok=" << ok << std::endl;
+    return ok;
+}
+
+bool test_semaphore() {
+    cpp_high_perf::Semaphore sem;
+    int value = 0;
+    cpp_high_perf::Thread t([&]() {
+        value = 1;
+        sem.notify();
+    }, "sem");
+    sem.wait();
+    t.join();
+    return value == 1;
+}
+
+//几个线程一起加一个计数，结果对，挂了统计的锁次数也对
+template<class MutexType, class LockType>
+bool test_lock(const std::string& name, int threads, int loops) {
+    MutexType mutex;
+    cpp_high_perf::LockStats* stats = cpp_high_perf::LockStats::Get("test." + name);
+    mutex.setStats(stats);
+    uint64_t count = 0;
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    std::vector<cpp_high_perf::Thread::ptr> ts;
+    for (int i = 0; i < threads; ++i) {
+        ts.push_back(cpp_high_perf::Thread::ptr(new cpp_high_perf::Thread([&]() {
+            for (int j = 0; j < loops; ++j) {
+                LockType lock(mutex);
+                ++count;
+            }
+        }, name)));
+    }
+    for (auto& t : ts) {
+        t->join();
+    }
+    uint64_t used = cpp_high_perf::GetMonotonicMS() - start;
+    std::cout << name << " count=" << count << " used=" << used << "ms"
+              << " acquisitions=" << stats->acquisitions
+              << " contended=" << stats->contended << std::endl;
+    uint64_t expect = (uint64_t)threads * loops;
+    return count == expect && stats->acquisitions == expect && stats->contended <= expect;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_thread();
+    ok = test_semaphore() && ok;
+
+    //先不开统计，挂了统计的锁也不记
+    {
+        cpp_high_perf::Mutex m;
+        cpp_high_perf::LockStats* stats = cpp_high_perf::LockStats::Get("test.disabled");
+        m.setStats(stats);
+        cpp_high_perf::Mutex::Lock lock(m);
+        ok = stats->acquisitions == 0 && ok;
+    }
+
+    //通过配置打开
+    YAML::Node node = YAML::Load("lock:\n  stats: true");
+    cpp_high_perf::Config::loadFromYaml(node);
+    ok = cpp_high_perf::LockStats::IsEnabled() && ok;
+
+    ok = test_lock<cpp_high_perf::Mutex, cpp_high_perf::Mutex::Lock>("mutex", 4, 100000) && ok;
+    ok = test_lock<cpp_high_perf::Spinlock, cpp_high_perf::Spinlock::Lock>("spinlock", 4, 100000) && ok;
+    ok = test_lock<cpp_high_perf::CASLock, cpp_high_perf::CASLock::Lock>("caslock", 4, 100000) && ok;
+    ok = test_lock<cpp_high_perf::RWMutex, cpp_high_perf::RWMutex::WriteLock>("rwmutex", 4, 100000) && ok;
+
+    std::stringstream ss;
+    cpp_high_perf::LockStats::Dump(ss);
+    std::cout << ss.str();
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+#include "../src/iomanager.h"
+#include "../src/timer.h"
+#include "../src/log.h"
+#include "../src/util.h"
+#include <iostream>
+#include <atomic>
+#include <vector>
+#include <unistd.h>
+
+static cpp_high_perf::Logger::ptr g_logger = CHPE_LOG_ROOT();
+
+//不带epoll的定时器管理，自己调listExpiredCb
+class ManualTimerManager : public cpp_high_perf::TimerManager {
+public:
+    int fronts = 0;
+protected:
+    void onTimerInsertedAtFront() override { ++fronts; }
+};
+
+//一直取到期的回调执行，直到cond为true或者超时
+template<class Cond>
+static void run_until(ManualTimerManager& mgr, Cond cond, uint64_t max_ms) {
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    while (!cond() && cpp_high_perf::GetMonotonicMS() - start < max_ms) {
+        uint64_t next = mgr.getNextTimer();
+        usleep((next == ~0ull || next > 10 ? 10 : next) * 1000);
+        std::vector<std::function<void()>> cbs;
+        mgr.listExpiredCb(cbs);
+        for (auto& cb : cbs) {
+            cb();
+        }
+    }
+}
+
+//先后顺序、循环、取消、改间隔
+bool test_basic() {
+    ManualTimerManager mgr;
+    std::vector<int> order;
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    uint64_t fired_at = 0;
+    mgr.addTimer(50, [&]() { order.push_back(50); });
+    mgr.addTimer(10, [&]() { order.push_back(10); });
+    //超过第0层一圈，要从上层落下来
+    mgr.addTimer(300, [&]() { order.push_back(300); fired_at = cpp_high_perf::GetMonotonicMS(); });
+    auto canceled = mgr.addTimer(20, [&]() { order.push_back(-1); });
+    int recurring = 0;
+    auto rec = mgr.addTimer(30, [&]() { ++recurring; }, true);
+    auto reset = mgr.addTimer(1000, [&]() { order.push_back(100); });
+    if (!canceled->cancel() || canceled->cancel()) {
+        return false;
+    }
+    reset->reset(100, true);
+
+    run_until(mgr, [&]() { return order.size() >= 4; }, 2000);
+    rec->cancel();
+    std::cout << "basic order:";
+    for (auto i : order) {
+        std::cout << " " << i;
+    }
+    std::cout << " recurring=" << recurring << " elapse=" << fired_at - start
+              << " fronts=" << mgr.fronts << std::endl;
+    return order == std::vector<int>({10, 50, 100, 300})
+        && recurring >= 8
+        && fired_at - start >= 300 && fired_at - start < 400
+        && !mgr.hasTimer();
+}
+
+//条件对象没了，回调就不执行
+bool test_condition() {
+    ManualTimerManager mgr;
+    int calls = 0;
+    std::shared_ptr<int> alive(new int(0));
+    std::shared_ptr<int> dead(new int(0));
+    mgr.addConditionTimer(10, [&]() { ++calls; }, alive);
+    mgr.addConditionTimer(10, [&]() { calls += 100; }, dead);
+    dead.reset();
+    run_until(mgr, [&]() { return !mgr.hasTimer(); }, 1000);
+    return calls == 1;
+}
+
+//大量定时器加了又取消，插入和取消都是O(1)
+bool test_many(size_t n) {
+    ManualTimerManager mgr;
+    std::vector<cpp_high_perf::Timer::ptr> timers;
+    timers.reserve(n);
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    for (size_t i = 0; i < n; ++i) {
+        //分散到各层
+        timers.push_back(mgr.addTimer(1000 + (i * 7919) % 3600000, []() {}));
+    }
+    uint64_t added = cpp_high_perf::GetMonotonicMS();
+    for (size_t i = 0; i < n; i += 2) {
+        timers[i]->cancel();
+    }
+    uint64_t canceled = cpp_high_perf::GetMonotonicMS();
+    size_t left = mgr.getTimerCount();
+    std::cout << "many n=" << n << " add=" << added - start << "ms cancel(half)="
+              << canceled - added << "ms left=" << left
+              << " next=" << mgr.getNextTimer() << "ms" << std::endl;
+    return left == n / 2 && mgr.getNextTimer() <= 1000;
+}
+
+//IOManager里用定时器，协程sleep和超时
+bool test_iomanager() {
+    std::atomic<int> calls{0};
+    std::atomic<int> recurring{0};
+    uint64_t start = cpp_high_perf::GetMonotonicMS();
+    uint64_t end = 0;
+    {
+        cpp_high_perf::IOManager iom(2, false, "timer");
+        cpp_high_perf::Timer::ptr rec = iom.addTimer(20, [&]() {
+            if (++recurring == 5) {
+                rec->cancel();
+            }
+        }, true);
+        iom.schedule([&]() {
+            auto io = cpp_high_perf::IOManager::GetThis();
+            auto fiber = cpp_high_perf::Fiber::GetThis();
+            //先挂一个很远的，再加一个近的，要把epoll_wait提前叫醒
+            io->addTimer(10000, [&]() { calls += 100; })->cancel();
+            io->addTimer(50, [io, fiber]() {
+                io->schedule(fiber);
+            });
+            cpp_high_perf::Fiber::YieldToHold();
+            ++calls;
+            end = cpp_high_perf::GetMonotonicMS();
+        });
+    }
+    CHPE_LOG_INFO(g_logger) << "iomanager timer calls=" << calls << " recurring=" << recurring
+        << " elapse=" << end - start;
+    return calls == 1 && recurring == 5 && end - start >= 50 && end - start < 1000;
+}
+
+int main(int argc, char** argv) {
+    bool ok = test_basic();
+    ok = test_condition() && ok;
+    ok = test_many(200000) && ok;
+    ok = test_iomanager() && ok;
+    std::cout << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}